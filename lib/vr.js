@@ -113,6 +113,27 @@ vr.DataSource.prototype.queryHmdInfo = function() {
 };
 
 
+/**
+ * Lists the HMD devices the data source can track, the first being the one
+ * {@link vr.DataSource#queryHmdInfo} describes.
+ * @return {Array.<!Object>} Devices or null if only one is supported.
+ */
+vr.DataSource.prototype.queryHmdDevices = function() {
+  return null;
+};
+
+
+/**
+ * Queries one of the HMD devices listed by
+ * {@link vr.DataSource#queryHmdDevices}.
+ * @param {number} index Device index.
+ * @return {vr.HmdInfo} Device info or null if none attached.
+ */
+vr.DataSource.prototype.queryHmdDeviceInfo = function(index) {
+  return index ? null : this.queryHmdInfo();
+};
+
+
 /**
  * Queries the connected Sixense device.
  * @return {vr.SixenseInfo} Device info or null if none attached.
@@ -124,8 +145,87 @@ vr.DataSource.prototype.querySixenseInfo = function() {
 
 /**
  * Resets the HMD orientation to its default.
+ * @param {number=} opt_deviceIndex HMD device to reset, the first if omitted.
+ */
+vr.DataSource.prototype.resetHmdOrientation = function(opt_deviceIndex) {
+};
+
+
+/**
+ * Selects the sensor fusion filter used for the HMD orientation.
+ * @param {vr.FusionMode} mode Fusion mode.
+ */
+vr.DataSource.prototype.setFusionMode = function(mode) {
+};
+
+
+/**
+ * Computes the stereo rendering parameters for the connected HMD.
+ * @param {number} interpupillaryDistance IPD, or zero to use the HMD's.
+ * @param {number} zNear Near plane Z.
+ * @param {number} zFar Far plane Z.
+ * @return {Array.<number>} Parameters in the layout of exec 9, or null if
+ *     the data source cannot compute them.
+ */
+vr.DataSource.prototype.queryStereoParams = function(
+    interpupillaryDistance, zNear, zFar) {
+  return null;
+};
+
+
+/**
+ * Generates a mesh that applies the lens distortion and chromatic aberration
+ * correction for the connected HMD in the vertex stage.
+ * @param {number} columns Cells across each eye.
+ * @param {number} rows Cells down each eye.
+ * @return {vr.WarpMesh} Mesh or null if the data source cannot generate one.
+ */
+vr.DataSource.prototype.queryWarpMesh = function(columns, rows) {
+  return null;
+};
+
+
+/**
+ * Distorts radii as {@link vr.HmdInfo#distort} does for the connected HMD, or
+ * undistorts them.
+ * @param {!Array.<number>|!Float32Array} radii Radii.
+ * @param {boolean} inverse Undistort instead.
+ * @return {Float32Array} Radii or null if the data source cannot map them.
+ */
+vr.DataSource.prototype.mapDistortionRadii = function(radii, inverse) {
+  return null;
+};
+
+
+/**
+ * Maps points through the lens warp of one eye of the connected HMD.
+ * @param {number} eyeIndex 0 for the left eye, 1 for the right.
+ * @param {!Array.<number>|!Float32Array} points x, y pairs in [0-1] across
+ *     the render target.
+ * @param {boolean} inverse Map from the render target to the screen.
+ * @return {Float32Array} Points or null if the data source cannot map them.
+ */
+vr.DataSource.prototype.mapWarpPoints = function(eyeIndex, points, inverse) {
+  return null;
+};
+
+
+/**
+ * Queries the sensor-to-poll latency measured over recent polls.
+ * @param {boolean=} opt_reset Start a new measurement after this one.
+ * @return {Object} Latency statistics or null if unsupported.
+ */
+vr.DataSource.prototype.queryLatency = function(opt_reset) {
+  return null;
+};
+
+
+/**
+ * Writes the recent latency trace to the file configured outside the page.
+ * @return {boolean} True if the trace was written.
  */
-vr.DataSource.prototype.resetHmdOrientation = function() {
+vr.DataSource.prototype.writeLatencyTrace = function() {
+  return false;
 };
 
 
@@ -133,8 +233,32 @@ vr.DataSource.prototype.resetHmdOrientation = function() {
  * Polls active devices and fills in the state structure.
  * @param {!vr.State} state State structure to fill in. This must be created by
  *     the caller and should be cached across calls to prevent extra garbage.
+ * @param {number=} opt_predictionMs How far ahead to predict the HMD
+ *     orientation, in milliseconds. If omitted or zero the predicted rotation
+ *     matches the current rotation.
+ */
+vr.DataSource.prototype.poll = function(state, opt_predictionMs) {
+};
+
+
+/**
+ * Starts filling in the state as new device data arrives, instead of on
+ * poll. Replaces any previous subscription.
+ * @param {!vr.State} state State structure to fill in. Must not also be
+ *     passed to poll.
+ * @param {function()} callback Called after each update of the state.
+ * @param {number} rateHz Most updates per second.
+ * @return {boolean} False if the data source cannot push updates.
+ */
+vr.DataSource.prototype.subscribe = function(state, callback, rateHz) {
+  return false;
+};
+
+
+/**
+ * Stops the updates started by {@link vr.DataSource#subscribe}.
  */
-vr.DataSource.prototype.poll = function(state) {
+vr.DataSource.prototype.unsubscribe = function() {
 };
 
 
@@ -162,10 +286,105 @@ vr.PluginDataSource = function(document) {
    * @private
    */
   this.native_ = null;
+
+  /**
+   * Scratch bytes that binary poll records are decoded into.
+   * Grown as needed and reused across polls to prevent garbage.
+   * @type {!Uint8Array}
+   * @private
+   */
+  this.pollBytes_ = new Uint8Array(1024);
+
+  /**
+   * Little-endian view over {@link vr.PluginDataSource#pollBytes_}.
+   * @type {!DataView}
+   * @private
+   */
+  this.pollView_ = new DataView(this.pollBytes_.buffer);
+
+  /**
+   * State object the most recent binary poll was decoded into. Delta polls
+   * are only requested when polling into it again, as it alone holds the
+   * values a delta leaves out.
+   * @type {vr.State}
+   * @private
+   */
+  this.pollState_ = null;
+
+  /**
+   * Generation returned by the most recent binary poll.
+   * @type {number}
+   * @private
+   */
+  this.pollGeneration_ = 0;
+
+  /**
+   * HMD info returned by the most recent query.
+   * @type {vr.HmdInfo}
+   * @private
+   */
+  this.hmdInfo_ = null;
+
+  /**
+   * Connection generation {@link vr.PluginDataSource#hmdInfo_} is for, or -1
+   * if unknown.
+   * @type {number}
+   * @private
+   */
+  this.hmdInfoGeneration_ = -1;
+
+  /**
+   * HMD info returned by the most recent query for each device past the
+   * first, with the connection generation it is for.
+   * @type {!Array.<{info: vr.HmdInfo, generation: number}>}
+   * @private
+   */
+  this.hmdDeviceInfos_ = [];
 };
 inherits(vr.PluginDataSource, vr.DataSource);
 
 
+/**
+ * Poll formats understood by the plugin.
+ * @enum {number}
+ * @private
+ */
+vr.PluginDataSource.PollFormat_ = {
+  TEXT: 0,
+  BINARY: 1
+};
+
+
+/**
+ * Bits for the poll flags argument.
+ * @enum {number}
+ * @private
+ */
+vr.PluginDataSource.PollFlag_ = {
+  SIXENSE_HISTORY: 1 << 0,
+  DELTA: 1 << 1,
+  HMD_DEVICES: 1 << 2
+};
+
+
+/**
+ * Binary poll record version this code can decode.
+ * @const
+ * @type {number}
+ * @private
+ */
+vr.PluginDataSource.BINARY_POLL_VERSION_ = 2;
+
+
+/**
+ * Most values exec 10 and 11 map per call. Longer batches are split.
+ * @const
+ * @type {number}
+ * @private
+ */
+vr.PluginDataSource.MAX_DISTORTION_VALUES_ = 512;
+
+
 /**
  * @override
  */
@@ -234,7 +453,8 @@ vr.PluginDataSource.prototype.load = function(callback, opt_scope) {
   function checkLoaded() {
     if (global._vr_native_) {
       self.native_ = global._vr_native_;
-      callback.call(opt_scope, null);
+      startTime = Date.now();
+      checkReady();
     } else {
       var elapsed = Date.now() - startTime;
       if (elapsed > 5 * 1000) {
@@ -249,10 +469,44 @@ vr.PluginDataSource.prototype.load = function(callback, opt_scope) {
       }
     }
   };
+  // The plugin brings devices up on background threads; wait for that to
+  // finish so queryHmdInfo has an answer when the callback runs.
+  function checkReady() {
+    var elapsed = Date.now() - startTime;
+    if (self.isReady_() ||
+        elapsed > vr.PluginDataSource.READY_TIMEOUT_MS_) {
+      // On timeout carry on without devices rather than failing the load.
+      callback.call(opt_scope, null);
+    } else {
+      global.setTimeout(checkReady, 50);
+    }
+  };
   checkLoaded();
 };
 
 
+/**
+ * Longest time to wait for the plugin to finish device bring-up, in
+ * milliseconds.
+ * @const
+ * @type {number}
+ * @private
+ */
+vr.PluginDataSource.READY_TIMEOUT_MS_ = 10 * 1000;
+
+
+/**
+ * Whether the plugin has finished bringing up its devices.
+ * @return {boolean} True if ready.
+ * @private
+ */
+vr.PluginDataSource.prototype.isReady_ = function() {
+  // Plugins predating the readiness query return an empty string and did
+  // their bring-up synchronously.
+  return this.execCommand_(3) != '0';
+};
+
+
 /**
  * Executes a command in the plugin and returns the raw result.
  * @param {number} commandId Command ID.
@@ -273,12 +527,76 @@ vr.PluginDataSource.prototype.execCommand_ = function(
  * @override
  */
 vr.PluginDataSource.prototype.queryHmdInfo = function() {
-  var queryData = this.execCommand_(1);
+  var queryData = this.execCommand_(1, String(this.hmdInfoGeneration_));
+  if (queryData == '=') {
+    // Same HMD as last time.
+    return this.hmdInfo_;
+  }
   if (!queryData || !queryData.length) {
+    this.hmdInfo_ = null;
+    this.hmdInfoGeneration_ = -1;
     return null;
   }
   var values = queryData.split(',');
-  return new vr.HmdInfo(values);
+  // Plugins that understand the generation append it to the info.
+  this.hmdInfoGeneration_ = values.length > 21 ? parseInt(values[21], 10) : -1;
+  this.hmdInfo_ = new vr.HmdInfo(values);
+  return this.hmdInfo_;
+};
+
+
+/**
+ * @override
+ */
+vr.PluginDataSource.prototype.queryHmdDevices = function() {
+  // [index],[present],[generation],[serial id],[serial]|...
+  var queryData = this.execCommand_(7);
+  if (!queryData || !queryData.length) {
+    return null;
+  }
+  var devices = [];
+  var chunks = queryData.split('|');
+  for (var n = 0; n < chunks.length; n++) {
+    var values = chunks[n].split(',');
+    if (values.length != 5) {
+      continue;
+    }
+    devices.push({
+      index: parseInt(values[0], 10),
+      present: values[1] == '1',
+      connectionGeneration: parseInt(values[2], 10),
+      serialId: Number(values[3]),
+      serial: values[4]
+    });
+  }
+  return devices;
+};
+
+
+/**
+ * @override
+ */
+vr.PluginDataSource.prototype.queryHmdDeviceInfo = function(index) {
+  if (!index) {
+    return this.queryHmdInfo();
+  }
+  var cached = this.hmdDeviceInfos_[index];
+  var queryData = this.execCommand_(
+      8, index + ',' + (cached ? cached.generation : -1));
+  if (queryData == '=') {
+    return cached.info;
+  }
+  if (!queryData || !queryData.length) {
+    this.hmdDeviceInfos_[index] = null;
+    return null;
+  }
+  var values = queryData.split(',');
+  var info = new vr.HmdInfo(values);
+  this.hmdDeviceInfos_[index] = {
+    info: info,
+    generation: values.length > 21 ? parseInt(values[21], 10) : -1
+  };
+  return info;
 };
 
 
@@ -294,28 +612,277 @@ vr.PluginDataSource.prototype.querySixenseInfo = function() {
 /**
  * @override
  */
-vr.PluginDataSource.prototype.resetHmdOrientation = function() {
-  this.execCommand_(2);
+vr.PluginDataSource.prototype.resetHmdOrientation = function(opt_deviceIndex) {
+  this.execCommand_(2, opt_deviceIndex ? String(opt_deviceIndex) : '');
+};
+
+
+/**
+ * @override
+ */
+vr.PluginDataSource.prototype.setFusionMode = function(mode) {
+  this.execCommand_(4, String(mode));
+};
+
+
+/**
+ * @override
+ */
+vr.PluginDataSource.prototype.queryLatency = function(opt_reset) {
+  // n,[count]|[stage],[p50],[p90],[p99],[max]|...
+  var queryData = this.execCommand_(5, opt_reset ? '1' : '');
+  if (!queryData || !queryData.length) {
+    return null;
+  }
+  var chunks = queryData.split('|');
+  var stats = {
+    count: Number(chunks[0].split(',')[1]),
+    stages: {}
+  };
+  for (var n = 1; n < chunks.length; n++) {
+    var values = chunks[n].split(',');
+    if (values.length != 5) {
+      continue;
+    }
+    stats.stages[values[0]] = {
+      p50: Number(values[1]),
+      p90: Number(values[2]),
+      p99: Number(values[3]),
+      max: Number(values[4])
+    };
+  }
+  return stats;
+};
+
+
+/**
+ * @override
+ */
+vr.PluginDataSource.prototype.queryStereoParams = function(
+    interpupillaryDistance, zNear, zFar) {
+  // [generation],[distortion scale],[fov y]|[eye values]|[eye values]|
+  var queryData = this.execCommand_(9,
+      interpupillaryDistance + ',' + zNear + ',' + zFar);
+  if (!queryData || !queryData.length) {
+    return null;
+  }
+  var values = queryData.replace(/\|/g, ',').split(',');
+  // Three header values, 39 per eye and the empty string after the last |.
+  if (values.length != 3 + 2 * 39 + 1) {
+    return null;
+  }
+  var params = new Array(values.length - 1);
+  for (var n = 0; n < params.length; n++) {
+    params[n] = Number(values[n]);
+  }
+  return params;
+};
+
+
+/**
+ * @override
+ */
+vr.PluginDataSource.prototype.queryWarpMesh = function(columns, rows) {
+  if (!this.native_ || !this.native_.warpMesh) {
+    return null;
+  }
+  var data = this.native_.warpMesh(columns, rows);
+  if (!data || !data.length) {
+    return null;
+  }
+
+  // See src/npvr/warp_mesh.h for the record layout.
+  var length = data.length;
+  var bytes = new Uint8Array(length);
+  for (var n = 0; n < length; n++) {
+    bytes[n] = data.charCodeAt(n) & 0xFF;
+  }
+  var view = new DataView(bytes.buffer);
+  if (bytes[0] != 1 || bytes[1] != 2) {
+    return null;
+  }
+  var vertexCount = view.getUint32(12, true);
+  var indexCount = view.getUint32(16, true);
+  var o = 20;
+  var vertices = new Float32Array(2 * vertexCount * 8);
+  for (var n = 0; n < vertices.length; n++, o += 4) {
+    vertices[n] = view.getFloat32(o, true);
+  }
+  var indices = new Uint16Array(indexCount);
+  for (var n = 0; n < indexCount; n++, o += 2) {
+    indices[n] = view.getUint16(o, true);
+  }
+  return {
+    connectionGeneration: view.getUint32(8, true),
+    vertexCount: vertexCount,
+    vertices: vertices,
+    indices: indices
+  };
 };
 
 
 /**
  * @override
  */
-vr.PluginDataSource.prototype.poll = function(state) {
+vr.PluginDataSource.prototype.mapDistortionRadii = function(radii, inverse) {
+  return this.mapValues_(10, inverse ? '1' : '0', radii);
+};
+
+
+/**
+ * @override
+ */
+vr.PluginDataSource.prototype.mapWarpPoints = function(
+    eyeIndex, points, inverse) {
+  if (points.length % 2) {
+    return null;
+  }
+  return this.mapValues_(11, eyeIndex + (inverse ? ',1' : ',0'), points);
+};
+
+
+/**
+ * Runs a batch mapping command over values, split into as many calls as it
+ * takes. Chunks are an even number of values, so points stay whole.
+ * @param {number} commandId Command ID, 10 or 11.
+ * @param {string} args Command arguments that precede the values.
+ * @param {!Array.<number>|!Float32Array} values Values to map.
+ * @return {Float32Array} Mapped values or null if the plugin cannot map them.
+ * @private
+ */
+vr.PluginDataSource.prototype.mapValues_ = function(commandId, args, values) {
+  var result = new Float32Array(values.length);
+  var chunkSize = vr.PluginDataSource.MAX_DISTORTION_VALUES_;
+  for (var offset = 0; offset < values.length; offset += chunkSize) {
+    var end = Math.min(offset + chunkSize, values.length);
+    var commandData = args;
+    for (var n = offset; n < end; n++) {
+      commandData += ',' + values[n];
+    }
+    var queryData = this.execCommand_(commandId, commandData);
+    if (!queryData || !queryData.length) {
+      return null;
+    }
+    var mapped = queryData.split(',');
+    if (mapped.length != end - offset) {
+      return null;
+    }
+    for (var n = 0; n < mapped.length; n++) {
+      result[offset + n] = Number(mapped[n]);
+    }
+  }
+  return result;
+};
+
+
+/**
+ * @override
+ */
+vr.PluginDataSource.prototype.writeLatencyTrace = function() {
+  return this.execCommand_(6) == '1';
+};
+
+
+/**
+ * @override
+ */
+vr.PluginDataSource.prototype.poll = function(state, opt_predictionMs) {
   if (!this.native_) {
     return;
   }
 
+  // Until told otherwise the prediction is the current rotation.
+  state.hmd.hasPrediction_ = false;
+
+  var pollFlags = 0;
+  if (state.sixense.historyEnabled) {
+    pollFlags |= vr.PluginDataSource.PollFlag_.SIXENSE_HISTORY;
+  }
+  if (state.hmdDevicesEnabled) {
+    pollFlags |= vr.PluginDataSource.PollFlag_.HMD_DEVICES;
+  }
+
+  // Only what changed since the previous poll is sent when polling into the
+  // same state again. Otherwise generation zero asks for everything.
+  pollFlags |= vr.PluginDataSource.PollFlag_.DELTA;
+  var generation = state == this.pollState_ ? this.pollGeneration_ : 0;
+
+  // Request the binary format. Older plugins ignore the argument and return
+  // text, which never starts with a character above 0xFF.
+  var pollData = this.native_.poll(
+      vr.PluginDataSource.PollFormat_.BINARY, opt_predictionMs || 0,
+      pollFlags, generation);
+  if (pollData.length && pollData.charCodeAt(0) > 0xFF) {
+    // Later polls into this state can be deltas against this one.
+    this.pollGeneration_ = this.decodeBinaryPoll_(state, pollData);
+    this.pollState_ = this.pollGeneration_ ? state : null;
+  } else {
+    this.pollState_ = null;
+    this.parseTextPoll_(state, pollData);
+  }
+
+  if (!state.hmd.hasPrediction_) {
+    state.hmd.predictedRotation.set(state.hmd.rotation);
+  }
+};
+
+
+/**
+ * @override
+ */
+vr.PluginDataSource.prototype.subscribe = function(state, callback, rateHz) {
+  if (!this.native_ || !this.native_.subscribe) {
+    return false;
+  }
+
+  var pollFlags = 0;
+  if (state.sixense.historyEnabled) {
+    pollFlags |= vr.PluginDataSource.PollFlag_.SIXENSE_HISTORY;
+  }
+  if (state.hmdDevicesEnabled) {
+    pollFlags |= vr.PluginDataSource.PollFlag_.HMD_DEVICES;
+  }
+
+  // Each delivery is a binary record, a delta against the previous one.
+  var self = this;
+  return !!this.native_.subscribe(function(data) {
+    state.sixense.historyLength = 0;
+    state.hmd.hasPrediction_ = false;
+    self.decodeBinaryPoll_(state, data);
+    if (!state.hmd.hasPrediction_) {
+      state.hmd.predictedRotation.set(state.hmd.rotation);
+    }
+    callback();
+  }, rateHz, pollFlags);
+};
+
+
+/**
+ * @override
+ */
+vr.PluginDataSource.prototype.unsubscribe = function() {
+  if (this.native_ && this.native_.unsubscribe) {
+    this.native_.unsubscribe();
+  }
+};
+
+
+/**
+ * Parses a text poll response and sets the state.
+ * @param {!vr.State} state Target state.
+ * @param {string} pollData Poll response.
+ * @private
+ */
+vr.PluginDataSource.prototype.parseTextPoll_ = function(state, pollData) {
   // Data is chunked into devices by |.
   // Data inside the device chunk is split on ,.
   // The first entry inside a chunk is the device type.
   // So:
-  // s,1,2,3|r,4,5,6|
+  // s,1,2,3|g,1|r,4,5,6|
   // is:
   //   - sixense with data 1,2,3
+  //   - rift connection generation 1
   //   - rift with data 4,5,6
-  var pollData = this.native_.poll();
   var deviceChunks = pollData.split('|');
   for (var n = 0; n < deviceChunks.length; n++) {
     var deviceChunk = deviceChunks[n].split(',');
@@ -327,15 +894,166 @@ vr.PluginDataSource.prototype.poll = function(state) {
         // Sixense data.
         this.parseSixenseChunk_(state, deviceChunk, 1);
         break;
+      case 'g':
+        // Oculus connection generation.
+        state.hmd.connectionGeneration = parseInt(deviceChunk[1], 10);
+        break;
       case 'r':
         // Oculus data.
         this.parseHmdChunk_(state, deviceChunk, 1);
         break;
+      case 'p':
+        // Predicted Oculus orientation.
+        this.parsePredictedHmdChunk_(state, deviceChunk, 1);
+        break;
+      case 'h':
+        // Sixense sample history.
+        this.parseSixenseHistoryChunk_(state, deviceChunk, 1);
+        break;
+      case 'd':
+        // Another HMD device.
+        this.parseHmdDeviceChunk_(state, deviceChunk, 1);
+        break;
     }
   }
 };
 
 
+/**
+ * Decodes a binary poll record and sets the state.
+ * See src/npvr/binary_writer.h for the record layout. Each character of the
+ * string carries one byte of the record in its low 8 bits.
+ * @param {!vr.State} state Target state.
+ * @param {string} data Encoded record.
+ * @return {number} Generation of a delta record, or zero.
+ * @private
+ */
+vr.PluginDataSource.prototype.decodeBinaryPoll_ = function(state, data) {
+  var length = data.length;
+  if (length > this.pollBytes_.length) {
+    this.pollBytes_ = new Uint8Array(length * 2);
+    this.pollView_ = new DataView(this.pollBytes_.buffer);
+  }
+  var bytes = this.pollBytes_;
+  var view = this.pollView_;
+  for (var n = 0; n < length; n++) {
+    bytes[n] = data.charCodeAt(n) & 0xFF;
+  }
+
+  if (bytes[0] != vr.PluginDataSource.BINARY_POLL_VERSION_) {
+    return 0;
+  }
+  var flags = bytes[1];
+  var controllerCount = bytes[2];
+  var historyCount = bytes[3];
+  var o = 4;
+
+  var generation = 0;
+  if (flags & 16) {
+    generation = view.getUint32(o, true);
+    o += 4;
+  }
+
+  var hmd = state.hmd;
+  hmd.present = !!(flags & 1);
+  if (flags & 32) {
+    // Unchanged: rotation and predictedRotation still hold the values last
+    // decoded, or that poll copied, so they must be left alone.
+    hmd.hasPrediction_ = true;
+  } else {
+    hmd.connectionGeneration = view.getUint32(o, true);
+    if (hmd.present) {
+      hmd.rotation[0] = view.getFloat32(o + 4, true);
+      hmd.rotation[1] = view.getFloat32(o + 8, true);
+      hmd.rotation[2] = view.getFloat32(o + 12, true);
+      hmd.rotation[3] = view.getFloat32(o + 16, true);
+    }
+    o += 20;
+  }
+  if (flags & 4 && !(flags & 32)) {
+    hmd.hasPrediction_ = true;
+    hmd.predictedRotation[0] = view.getFloat32(o, true);
+    hmd.predictedRotation[1] = view.getFloat32(o + 4, true);
+    hmd.predictedRotation[2] = view.getFloat32(o + 8, true);
+    hmd.predictedRotation[3] = view.getFloat32(o + 12, true);
+    o += 16;
+  }
+
+  if (flags & 64) {
+    var deviceCount = bytes[o];
+    o += 4;
+    for (var n = 0; n < deviceCount; n++, o += 44) {
+      var device = state.hmdDevices[bytes[o]];
+      if (!device || !bytes[o]) {
+        continue;
+      }
+      device.present = !!(bytes[o + 1] & 1);
+      device.serialId = view.getUint32(o + 4, true);
+      device.connectionGeneration = view.getUint32(o + 8, true);
+      device.rotation[0] = view.getFloat32(o + 12, true);
+      device.rotation[1] = view.getFloat32(o + 16, true);
+      device.rotation[2] = view.getFloat32(o + 20, true);
+      device.rotation[3] = view.getFloat32(o + 24, true);
+      if (bytes[o + 1] & 2) {
+        device.predictedRotation[0] = view.getFloat32(o + 28, true);
+        device.predictedRotation[1] = view.getFloat32(o + 32, true);
+        device.predictedRotation[2] = view.getFloat32(o + 36, true);
+        device.predictedRotation[3] = view.getFloat32(o + 40, true);
+      } else {
+        device.predictedRotation.set(device.rotation);
+      }
+    }
+  }
+
+  state.sixense.present = !!(flags & 2);
+  var controllers = state.sixense.controllers;
+  for (var n = 0; n < controllerCount; n++, o += 48) {
+    var controller = controllers[bytes[o + 1]];
+    if (!controller) {
+      continue;
+    }
+    controller.hand = bytes[o + 2];
+    controller.isDocked = !!(bytes[o + 3] & 1);
+    controller.isTrackingHemispheres = !!(bytes[o + 3] & 2);
+    controller.position[0] = view.getFloat32(o + 4, true);
+    controller.position[1] = view.getFloat32(o + 8, true);
+    controller.position[2] = view.getFloat32(o + 12, true);
+    controller.rotation[0] = view.getFloat32(o + 16, true);
+    controller.rotation[1] = view.getFloat32(o + 20, true);
+    controller.rotation[2] = view.getFloat32(o + 24, true);
+    controller.rotation[3] = view.getFloat32(o + 28, true);
+    controller.joystick[0] = view.getFloat32(o + 32, true);
+    controller.joystick[1] = view.getFloat32(o + 36, true);
+    controller.trigger = view.getFloat32(o + 40, true);
+    controller.buttons = view.getUint32(o + 44, true);
+  }
+
+  if (flags & 8) {
+    var sixense = state.sixense;
+    for (var n = 0; n < historyCount; n++, o += 48) {
+      var sample = sixense.allocateHistorySample_();
+      sample.base = bytes[o];
+      sample.controller = bytes[o + 1];
+      sample.sequence = bytes[o + 2];
+      sample.isDocked = !!(bytes[o + 3] & 1);
+      sample.position[0] = view.getFloat32(o + 4, true);
+      sample.position[1] = view.getFloat32(o + 8, true);
+      sample.position[2] = view.getFloat32(o + 12, true);
+      sample.rotation[0] = view.getFloat32(o + 16, true);
+      sample.rotation[1] = view.getFloat32(o + 20, true);
+      sample.rotation[2] = view.getFloat32(o + 24, true);
+      sample.rotation[3] = view.getFloat32(o + 28, true);
+      sample.joystick[0] = view.getFloat32(o + 32, true);
+      sample.joystick[1] = view.getFloat32(o + 36, true);
+      sample.trigger = view.getFloat32(o + 40, true);
+      sample.buttons = view.getUint32(o + 44, true);
+    }
+  }
+
+  return generation;
+};
+
+
 /**
  * Parses a Sixense data poll chunk and sets the state.
  * @param {!vr.State} state Target state.
@@ -383,6 +1101,40 @@ vr.PluginDataSource.prototype.parseSixenseChunk_ = function(state, data, o) {
 };
 
 
+/**
+ * Parses a Sixense history poll chunk and appends to the state history.
+ * @param {!vr.State} state Target state.
+ * @param {!Array.<string>} data Data elements.
+ * @param {number} o Offset into data elements to start at.
+ * @private
+ */
+vr.PluginDataSource.prototype.parseSixenseHistoryChunk_ = function(
+    state, data, o) {
+  // [base],[controller],[sequence],
+  //   [x],[y],[z],[q0],[q1],[q2],[q3],[jx],[jy],[tr],[buttons],[docked],
+  // ...
+  var sixense = state.sixense;
+  while (o + 15 <= data.length) {
+    var sample = sixense.allocateHistorySample_();
+    sample.base = parseInt(data[o++], 10);
+    sample.controller = parseInt(data[o++], 10);
+    sample.sequence = parseInt(data[o++], 10);
+    sample.position[0] = parseFloat(data[o++]);
+    sample.position[1] = parseFloat(data[o++]);
+    sample.position[2] = parseFloat(data[o++]);
+    sample.rotation[0] = parseFloat(data[o++]);
+    sample.rotation[1] = parseFloat(data[o++]);
+    sample.rotation[2] = parseFloat(data[o++]);
+    sample.rotation[3] = parseFloat(data[o++]);
+    sample.joystick[0] = parseFloat(data[o++]);
+    sample.joystick[1] = parseFloat(data[o++]);
+    sample.trigger = parseFloat(data[o++]);
+    sample.buttons = parseInt(data[o++], 10);
+    sample.isDocked = data[o++] == '1';
+  }
+};
+
+
 /**
  * Parses an HMD data poll chunk and sets the state.
  * @param {!vr.State} state Target state.
@@ -404,6 +1156,60 @@ vr.PluginDataSource.prototype.parseHmdChunk_ = function(state, data, o) {
 
 
 
+/**
+ * Parses a predicted HMD orientation poll chunk and sets the state.
+ * @param {!vr.State} state Target state.
+ * @param {!Array.<string>} data Data elements.
+ * @param {number} o Offset into data elements to start at.
+ * @private
+ */
+vr.PluginDataSource.prototype.parsePredictedHmdChunk_ = function(
+    state, data, o) {
+  if (data.length == 5) {
+    state.hmd.hasPrediction_ = true;
+    state.hmd.predictedRotation[0] = parseFloat(data[o++]);
+    state.hmd.predictedRotation[1] = parseFloat(data[o++]);
+    state.hmd.predictedRotation[2] = parseFloat(data[o++]);
+    state.hmd.predictedRotation[3] = parseFloat(data[o++]);
+  }
+};
+
+
+/**
+ * Parses an HMD device poll chunk and sets the state.
+ * @param {!vr.State} state Target state.
+ * @param {!Array.<string>} data Data elements.
+ * @param {number} o Offset into data elements to start at.
+ * @private
+ */
+vr.PluginDataSource.prototype.parseHmdDeviceChunk_ = function(
+    state, data, o) {
+  var index = parseInt(data[o++], 10);
+  var device = index ? state.hmdDevices[index] : null;
+  if (!device) {
+    return;
+  }
+  device.connectionGeneration = parseInt(data[o++], 10);
+  device.serialId = Number(data[o++]);
+  device.present = data.length >= 8;
+  if (device.present) {
+    device.rotation[0] = parseFloat(data[o++]);
+    device.rotation[1] = parseFloat(data[o++]);
+    device.rotation[2] = parseFloat(data[o++]);
+    device.rotation[3] = parseFloat(data[o++]);
+  }
+  if (data.length == 12) {
+    device.predictedRotation[0] = parseFloat(data[o++]);
+    device.predictedRotation[1] = parseFloat(data[o++]);
+    device.predictedRotation[2] = parseFloat(data[o++]);
+    device.predictedRotation[3] = parseFloat(data[o++]);
+  } else {
+    device.predictedRotation.set(device.rotation);
+  }
+};
+
+
+
 /**
  * Javascript USB driver-based data source.
  * @param {!Object} driver Driver instance.
@@ -474,7 +1280,11 @@ vr.DriverDataSource.prototype.querySixenseInfo = function() {
 /**
  * @override
  */
-vr.DriverDataSource.prototype.resetHmdOrientation = function() {
+vr.DriverDataSource.prototype.resetHmdOrientation = function(
+    opt_deviceIndex) {
+  if (opt_deviceIndex) {
+    return;
+  }
   this.driver_.resetOrientation();
 };
 
@@ -482,7 +1292,7 @@ vr.DriverDataSource.prototype.resetHmdOrientation = function() {
 /**
  * @override
  */
-vr.DriverDataSource.prototype.poll = function(state) {
+vr.DriverDataSource.prototype.poll = function(state, opt_predictionMs) {
   var present = this.driver_.isPresent();
   state.hmd.present = present;
   if (present) {
@@ -491,6 +1301,8 @@ vr.DriverDataSource.prototype.poll = function(state) {
     state.hmd.rotation[0] = state.hmd.rotation[1] = state.hmd.rotation[2] = 0;
     state.hmd.rotation[3] = 0;
   }
+  // The driver does not predict.
+  state.hmd.predictedRotation.set(state.hmd.rotation);
 };
 
 
@@ -582,6 +1394,13 @@ vr.Runtime = function(document) {
    */
   this.hmdInfo_ = null;
 
+  /**
+   * HMD connection generation {@link vr.Runtime#hmdInfo_} was queried at.
+   * @type {number}
+   * @private
+   */
+  this.hmdGeneration_ = 0;
+
   /**
    * Sixense info, if any device is attached.
    * @type {vr.SixenseInfo}
@@ -700,15 +1519,18 @@ vr.Runtime.prototype.completeLoad_ = function(opt_error) {
  * This also takes care of dispatching device notifications/etc.
  * @param {!vr.State} state State structure to fill in. This must be created by
  *     the caller and should be cached across calls to prevent extra garbage.
+ * @param {number=} opt_predictionMs How far ahead to predict the HMD
+ *     orientation, in milliseconds.
  * @return {boolean} True if the state query was successful.
  */
-vr.Runtime.prototype.poll = function(state) {
+vr.Runtime.prototype.poll = function(state, opt_predictionMs) {
   // Reset.
   state.sixense.present = false;
+  state.sixense.historyLength = 0;
   state.hmd.present = false;
 
   // Poll data.
-  this.dataSource_.poll(state);
+  this.dataSource_.poll(state, opt_predictionMs);
 
   // Query any info if needed.
   if (state.sixense.present && !this.sixenseInfo_) {
@@ -720,9 +1542,12 @@ vr.Runtime.prototype.poll = function(state) {
     this.sixenseInfo_ = null;
     // TODO(benvanik): fire event?
   }
-  if (state.hmd.present && !this.hmdInfo_) {
-    // HMD connected.
+  if (state.hmd.present &&
+      (!this.hmdInfo_ ||
+       state.hmd.connectionGeneration != this.hmdGeneration_)) {
+    // HMD connected, or swapped for another between polls.
     this.hmdInfo_ = this.dataSource_.queryHmdInfo();
+    this.hmdGeneration_ = state.hmd.connectionGeneration;
     // TODO(benvanik): fire event?
   } else if (!state.hmd.present && this.hmdInfo_) {
     // HMD disconnected.
@@ -854,8 +1679,176 @@ vr.getHmdInfo = function() {
  * change.
  * @memberof vr
  */
-vr.resetHmdOrientation = function() {
-  vr.runtime_.dataSource_.resetHmdOrientation();
+vr.resetHmdOrientation = function(opt_deviceIndex) {
+  vr.runtime_.dataSource_.resetHmdOrientation(opt_deviceIndex);
+};
+
+
+/**
+ * Lists the HMD devices the plugin can track. The first is always the one
+ * {@link vr.getHmdInfo} describes and {@link vr.State#hmd} holds; the others
+ * are polled into {@link vr.State#hmdDevices} when
+ * {@link vr.State#hmdDevicesEnabled} is set. Each entry has the device index,
+ * whether it is present, its connection generation, its serial number and the
+ * serial id polls identify it by.
+ * @return {Array.<!Object>} Devices or null if only one is supported.
+ * @memberof vr
+ */
+vr.getHmdDevices = function() {
+  return vr.runtime_.dataSource_.queryHmdDevices();
+};
+
+
+/**
+ * Gets the information of one of the HMD devices listed by
+ * {@link vr.getHmdDevices}. Unlike {@link vr.getHmdInfo} this queries the
+ * plugin, so cache the result until the device's connection generation
+ * changes.
+ * @param {number} index Device index.
+ * @return {vr.HmdInfo} HMD info, if any.
+ * @memberof vr
+ */
+vr.getHmdDeviceInfo = function(index) {
+  return vr.runtime_.dataSource_.queryHmdDeviceInfo(index);
+};
+
+
+/**
+ * Distorts radii as {@link vr.HmdInfo#distort} does for the current HMD, or
+ * with opt_inverse set undistorts them as {@link vr.HmdInfo#undistort} does.
+ * The plugin maps the whole batch at once; without it each value is mapped
+ * in script.
+ * @param {!Array.<number>|!Float32Array} radii Radii.
+ * @param {boolean=} opt_inverse Undistort instead.
+ * @return {!Float32Array} Mapped radii.
+ * @memberof vr
+ */
+vr.distortRadii = function(radii, opt_inverse) {
+  var result = vr.runtime_.dataSource_.mapDistortionRadii(
+      radii, !!opt_inverse);
+  if (result) {
+    return result;
+  }
+  var info = vr.getHmdInfo() || vr.HmdInfo.DEFAULT;
+  result = new Float32Array(radii.length);
+  for (var n = 0; n < radii.length; n++) {
+    result[n] = opt_inverse ? info.undistort(radii[n]) : info.distort(radii[n]);
+  }
+  return result;
+};
+
+
+/**
+ * Maps points through the lens warp {@link vr.StereoRenderer} applies to one
+ * eye. Points are x, y pairs in [0-1] across the whole render target, which
+ * is also where they land on the screen before the warp. The result is
+ * where the warp samples the render target for each screen point, so it
+ * maps a click or gaze direction on the screen to what was rendered there.
+ * With opt_inverse set it maps the other way, from a point in the render
+ * target to where it appears on the screen.
+ * @param {number} eyeIndex 0 for the left eye, 1 for the right.
+ * @param {!Array.<number>|!Float32Array} points x, y pairs.
+ * @param {boolean=} opt_inverse Map from the render target to the screen.
+ * @return {Float32Array} Mapped points or null if there is no HMD or
+ *     the data source cannot map them.
+ * @memberof vr
+ */
+vr.warpPoints = function(eyeIndex, points, opt_inverse) {
+  return vr.runtime_.dataSource_.mapWarpPoints(
+      eyeIndex, points, !!opt_inverse);
+};
+
+
+/**
+ * Sensor fusion filters that can produce the HMD orientation.
+ * @enum {number}
+ * @memberof vr
+ */
+vr.FusionMode = {
+  /** The filter built into the Oculus SDK. */
+  SDK: 0,
+  /** The plugin's own filter, fed the same sensor samples. */
+  NATIVE: 1
+};
+
+
+/**
+ * Selects the sensor fusion filter used for the HMD orientation.
+ * Switching to {@link vr.FusionMode.NATIVE} starts from the current
+ * orientation; switching back may jump. Ignored by data sources that cannot
+ * choose.
+ * @param {vr.FusionMode} mode Fusion mode.
+ * @memberof vr
+ */
+vr.setFusionMode = function(mode) {
+  vr.runtime_.dataSource_.setFusionMode(mode);
+};
+
+
+/**
+ * Gets how long poses take to get from the tracker to the page, measured by
+ * the plugin over its most recent polls (up to 4096).
+ *
+ * The result has a <code>count</code> of polls measured and, under
+ * <code>stages</code>, the p50/p90/p99/max time in microseconds spent in each
+ * stage: <code>fusion</code> (sample arrival to fused), <code>publish</code>,
+ * <code>wait</code> (until a poll picked it up), <code>poll</code>,
+ * <code>handoff</code> (copying the result to the browser) and
+ * <code>age</code>, the whole path. Null if the data source cannot measure
+ * latency.
+ * @param {boolean=} opt_reset Start a new measurement after this one.
+ * @return {Object} Latency statistics.
+ * @memberof vr
+ */
+vr.getLatencyStats = function(opt_reset) {
+  return vr.runtime_.dataSource_.queryLatency(opt_reset);
+};
+
+
+/**
+ * Writes the plugin's recent latency trace as a Chrome trace-event JSON file
+ * to the path in the NPVR_TRACE_FILE environment variable of the browser.
+ * Load it alongside a browser trace in chrome://tracing to line the two up.
+ * @return {boolean} True if the trace was written.
+ * @memberof vr
+ */
+vr.writeLatencyTrace = function() {
+  return vr.runtime_.dataSource_.writeLatencyTrace();
+};
+
+
+/**
+ * Fills in a state as new device data arrives, up to opt_rateHz times a
+ * second, and calls back after each update. Unlike {@link vr.pollState} this
+ * runs at sensor rate rather than display rate, so input handling sees
+ * changes between frames. Updates that arrive while the page is busy are
+ * combined into one; with {@link vr.SixenseState#historyEnabled} set the
+ * samples in between are still in the history.
+ *
+ * Only the plugin can push updates, and only one subscription is active at
+ * a time. Use a different state than the one passed to {@link vr.pollState}.
+ * @param {!vr.State} state State structure to fill in.
+ * @param {function(this:T, !vr.State)} callback Called after each update.
+ * @param {T=} opt_scope Scope to call the callback in.
+ * @param {number=} opt_rateHz Most updates per second, 1-1000. Defaults to
+ *     250.
+ * @return {boolean} False if updates cannot be pushed.
+ * @template T
+ * @memberof vr
+ */
+vr.subscribeState = function(state, callback, opt_scope, opt_rateHz) {
+  return vr.runtime_.dataSource_.subscribe(state, function() {
+    callback.call(opt_scope, state);
+  }, opt_rateHz || 250);
+};
+
+
+/**
+ * Stops the updates started by {@link vr.subscribeState}.
+ * @memberof vr
+ */
+vr.unsubscribeState = function() {
+  vr.runtime_.dataSource_.unsubscribe();
 };
 
 
@@ -875,6 +1868,11 @@ vr.getSixenseInfo = function() {
  * This also takes care of dispatching device notifications/etc.
  * @param {!vr.State} state State structure to fill in. This must be created by
  *     the caller and should be cached across calls to prevent extra garbage.
+ *     Polling into the same state each frame lets the plugin skip devices
+ *     that have not changed, so do not modify it between polls.
+ * @param {number=} opt_predictionMs How far ahead to predict the HMD
+ *     orientation, in milliseconds. Pass the expected time until the frame
+ *     is displayed and render with {@link vr.HmdState#predictedRotation}.
  * @return {boolean} True if the state query was successful.
  * @memberof vr
  *
@@ -890,8 +1888,8 @@ vr.getSixenseInfo = function() {
  *   // TODO: render with the latest data.
  * };
  */
-vr.pollState = function(state) {
-  return vr.runtime_.poll(state);
+vr.pollState = function(state, opt_predictionMs) {
+  return vr.runtime_.poll(state, opt_predictionMs);
 };
 
 
@@ -1198,6 +2196,29 @@ vr.HmdInfo.prototype.distort = function(r) {
 };
 
 
+/**
+ * Inverts {@link vr.HmdInfo#distort} with Newton's method. Starting from
+ * r / K0 it closes in on the result from above, and stops after 10 steps or
+ * once the result distorts to within a millionth of r, as the plugin does.
+ * @param {number} r Distorted value.
+ * @return {number} Value that distorts to r.
+ */
+vr.HmdInfo.prototype.undistort = function(r) {
+  var K = this.distortionK;
+  var result = r / K[0];
+  for (var n = 0; n < 10; n++) {
+    var error = this.distort(result) - r;
+    if (Math.abs(error) <= 1e-6 * Math.abs(r)) {
+      break;
+    }
+    var rsq = result * result;
+    result -= error / (K[0] + 3 * K[1] * rsq + 5 * K[2] * rsq * rsq +
+        7 * K[3] * rsq * rsq * rsq);
+  }
+  return result;
+};
+
+
 /**
  * Default HMD info.
  * Do not modify.
@@ -1226,6 +2247,40 @@ vr.HmdState = function() {
    * @readonly
    */
   this.rotation = new Float32Array(4);
+
+  /**
+   * Rotation quaternion extrapolated by the plugin to the prediction interval
+   * passed to {@link vr.pollState}. Equal to {@link vr.HmdState#rotation} if
+   * no prediction was requested or the data source cannot predict.
+   * @type {!Float32Array}
+   * @readonly
+   */
+  this.predictedRotation = new Float32Array(4);
+
+  /**
+   * Whether the data source filled in the predicted rotation this poll.
+   * @type {boolean}
+   * @private
+   */
+  this.hasPrediction_ = false;
+
+  /**
+   * Counter the plugin bumps every time an HMD is attached or detached.
+   * A change means any cached {@link vr.HmdInfo} is stale. Always zero with
+   * data sources that do not support hotplug.
+   * @type {number}
+   * @readonly
+   */
+  this.connectionGeneration = 0;
+
+  /**
+   * Identifies which physical HMD this is, as listed by
+   * {@link vr.getHmdDevices}. Zero if unknown. Only set for the devices in
+   * {@link vr.State#hmdDevices} past the first.
+   * @type {number}
+   * @readonly
+   */
+  this.serialId = 0;
 };
 
 
@@ -1268,33 +2323,141 @@ vr.SixenseHand = {
  * @param {Array.<number>=} opt_values Device values.
  * @constructor
  */
-vr.SixenseInfo = function(opt_values) {
+vr.SixenseInfo = function(opt_values) {
+};
+
+
+
+/**
+ * Sixense state data.
+ * @constructor
+ */
+vr.SixenseState = function() {
+  /**
+   * Whether any sixense data is present in this state update.
+   * Do not use any other values on this type if this is false.
+   * @type {boolean}
+   * @readonly
+   */
+  this.present = false;
+
+  /**
+   * Connected controllers.
+   * @type {!Array.<!vr.SixenseControllerState>}
+   * @readonly
+   */
+  this.controllers = [
+    new vr.SixenseControllerState(),
+    new vr.SixenseControllerState()
+  ];
+
+  /**
+   * Set to true to have each poll fill in {@link vr.SixenseState#history}
+   * with every sample the hardware produced since the previous poll, instead
+   * of only the newest one per controller.
+   * @type {boolean}
+   */
+  this.historyEnabled = false;
+
+  /**
+   * Samples received since the previous poll, oldest first per controller.
+   * Only the first {@link vr.SixenseState#historyLength} entries are valid;
+   * entries are reused across polls.
+   * @type {!Array.<!vr.SixenseSample>}
+   * @readonly
+   */
+  this.history = [];
+
+  /**
+   * Number of valid entries in {@link vr.SixenseState#history}.
+   * @type {number}
+   * @readonly
+   */
+  this.historyLength = 0;
+};
+
+
+/**
+ * Returns the next unused history sample, growing the pool if needed.
+ * @return {!vr.SixenseSample} Sample to fill in.
+ * @private
+ */
+vr.SixenseState.prototype.allocateHistorySample_ = function() {
+  if (this.historyLength == this.history.length) {
+    this.history.push(new vr.SixenseSample());
+  }
+  return this.history[this.historyLength++];
 };
 
 
 
 /**
- * Sixense state data.
+ * A single Sixense controller sample from the history.
  * @constructor
  */
-vr.SixenseState = function() {
+vr.SixenseSample = function() {
   /**
-   * Whether any sixense data is present in this state update.
-   * Do not use any other values on this type if this is false.
-   * @type {boolean}
+   * Base the controller is attached to.
+   * @type {number}
    * @readonly
    */
-  this.present = false;
+  this.base = 0;
 
   /**
-   * Connected controllers.
-   * @type {!Array.<!vr.SixenseControllerState>}
+   * Controller index; matches {@link vr.SixenseState#controllers}.
+   * @type {number}
    * @readonly
    */
-  this.controllers = [
-    new vr.SixenseControllerState(),
-    new vr.SixenseControllerState()
-  ];
+  this.controller = 0;
+
+  /**
+   * Hardware sequence number. Wraps at 256.
+   * @type {number}
+   * @readonly
+   */
+  this.sequence = 0;
+
+  /**
+   * Position XYZ.
+   * @type {!Float32Array}
+   * @readonly
+   */
+  this.position = new Float32Array(3);
+
+  /**
+   * Rotation quaternion.
+   * @type {!Float32Array}
+   * @readonly
+   */
+  this.rotation = new Float32Array(4);
+
+  /**
+   * Joystick XY.
+   * @type {!Float32Array}
+   * @readonly
+   */
+  this.joystick = new Float32Array(2);
+
+  /**
+   * Trigger press value [0-1].
+   * @type {number}
+   * @readonly
+   */
+  this.trigger = 0.0;
+
+  /**
+   * A bitmask of {@link vr.SixenseButton} values.
+   * @type {number}
+   * @readonly
+   */
+  this.buttons = vr.SixenseButton.NONE;
+
+  /**
+   * Whether the controller was docked in the station.
+   * @type {boolean}
+   * @readonly
+   */
+  this.isDocked = false;
 };
 
 
@@ -1386,9 +2549,35 @@ vr.State = function() {
    * @readonly
    */
   this.hmd = new vr.HmdState();
+
+  /**
+   * Whether to poll every HMD device rather than only the first.
+   * @type {boolean}
+   */
+  this.hmdDevicesEnabled = false;
+
+  /**
+   * State of each HMD device, indexed as in {@link vr.getHmdDevices}. The
+   * first is {@link vr.State#hmd}; the others are only updated when
+   * {@link vr.State#hmdDevicesEnabled} is set.
+   * @type {!Array.<!vr.HmdState>}
+   * @readonly
+   */
+  this.hmdDevices = [this.hmd];
+  for (var n = 1; n < vr.State.MAX_HMD_DEVICES; n++) {
+    this.hmdDevices.push(new vr.HmdState());
+  }
 };
 
 
+/**
+ * Most HMD devices the plugin tracks at once.
+ * @const
+ * @type {number}
+ */
+vr.State.MAX_HMD_DEVICES = 4;
+
+
 // TODO(benvanik): move math to its own file
 
 
@@ -1720,6 +2909,24 @@ vr.Program.prototype.use = function() {
 // TODO(benvanik): move stereo eye/params its own file
 
 
+/**
+ * A warp mesh generated by the plugin.
+ * vertices holds vertexCount vertices for the left eye and then as many for
+ * the right, each [x, y, red u, red v, green u, green v, blue u, blue v]:
+ * a position in [0-1] across the eye and where to sample each color channel
+ * of the render target. indices is a triangle list into either eye's
+ * vertices.
+ * @typedef {{
+ *   connectionGeneration: number,
+ *   vertexCount: number,
+ *   vertices: !Float32Array,
+ *   indices: !Uint16Array
+ * }}
+ */
+vr.WarpMesh;
+
+
+
 /**
  * An eye.
  * Contains matrices used when rendering the viewport.
@@ -1842,6 +3049,35 @@ vr.StereoParams = function() {
    * @private
    */
   this.tmpMat4s_ = [vr.mat4f.create(), vr.mat4f.create()];
+
+  /**
+   * HMD info the eyes were last computed from.
+   * Everything is recomputed when it, the IPD or the clip planes change.
+   * @type {vr.HmdInfo}
+   * @private
+   */
+  this.updatedInfo_ = null;
+
+  /**
+   * IPD override the eyes were last computed with.
+   * @type {number|undefined}
+   * @private
+   */
+  this.updatedInterpupillaryDistance_ = undefined;
+
+  /**
+   * Near plane Z the eyes were last computed with.
+   * @type {number}
+   * @private
+   */
+  this.updatedZNear_ = 0;
+
+  /**
+   * Far plane Z the eyes were last computed with.
+   * @type {number}
+   * @private
+   */
+  this.updatedZFar_ = 0;
 };
 
 
@@ -1909,6 +3145,27 @@ vr.StereoParams.prototype.getEyes = function() {
  * @param {!vr.HmdInfo} info HMD info.
  */
 vr.StereoParams.prototype.update = function(info) {
+  // Nothing here changes from frame to frame.
+  if (info === this.updatedInfo_ &&
+      this.interpupillaryDistance_ === this.updatedInterpupillaryDistance_ &&
+      this.zNear_ == this.updatedZNear_ && this.zFar_ == this.updatedZFar_) {
+    return;
+  }
+  this.updatedInfo_ = info;
+  this.updatedInterpupillaryDistance_ = this.interpupillaryDistance_;
+  this.updatedZNear_ = this.zNear_;
+  this.updatedZFar_ = this.zFar_;
+
+  // The plugin computes them for the info it reported, if it can.
+  if (info === vr.getHmdInfo()) {
+    var params = vr.runtime_.dataSource_.queryStereoParams(
+        this.interpupillaryDistance_ || 0, this.zNear_, this.zFar_);
+    if (params) {
+      this.setFromValues_(params);
+      return;
+    }
+  }
+
   var interpupillaryDistance = info.interpupillaryDistance;
   if (this.interpupillaryDistance_ !== undefined) {
     interpupillaryDistance = this.interpupillaryDistance_;
@@ -1998,6 +3255,36 @@ vr.StereoParams.prototype.update = function(info) {
 };
 
 
+/**
+ * Sets the distortion scale and eyes from the values returned by
+ * {@link vr.DataSource#queryStereoParams}.
+ * @param {!Array.<number>} values Stereo parameter values.
+ * @private
+ */
+vr.StereoParams.prototype.setFromValues_ = function(values) {
+  // values[0] is the connection generation and values[2] the FOV, which the
+  // eyes already include.
+  this.distortionScale_ = values[1];
+  var o = 3;
+  for (var n = 0; n < this.eyes_.length; n++) {
+    var eye = this.eyes_[n];
+    for (var i = 0; i < 4; i++) {
+      eye.viewport[i] = values[o++];
+    }
+    eye.distortionCenterOffsetX = values[o++];
+    eye.distortionCenterOffsetY = values[o++];
+    vr.mat4f.makeIdentity(eye.viewAdjustMatrix);
+    eye.viewAdjustMatrix[12] = values[o++];
+    for (var i = 0; i < 16; i++) {
+      eye.projectionMatrix[i] = values[o++];
+    }
+    for (var i = 0; i < 16; i++) {
+      eye.orthoProjectionMatrix[i] = values[o++];
+    }
+  }
+};
+
+
 
 // TODO(benvanik): move stereo renderer to its own file
 
@@ -2019,7 +3306,13 @@ vr.PostProcessingMode = {
   /**
    * Distort and also apply chromatic aberration correction.
    */
-  WARP_CHROMEAB: 2
+  WARP_CHROMEAB: 2,
+  /**
+   * As WARP_CHROMEAB, but with the distortion computed per vertex of a mesh
+   * the plugin generates instead of per pixel. Much cheaper on fill-limited
+   * GPUs. Falls back to WARP_CHROMEAB when no mesh is available.
+   */
+  WARP_MESH: 3
 };
 
 
@@ -2082,6 +3375,14 @@ vr.StereoRenderer = function(gl, opt_attributes) {
    */
   this.hmdPresent_ = false;
 
+  /**
+   * Connection generation of the HMD {@link vr.StereoRenderer#hmdInfo_}
+   * describes, or -1 if none is present.
+   * @type {number}
+   * @private
+   */
+  this.hmdGeneration_ = -1;
+
   /**
    * Current HMD info.
    * If no HMD is present this is set to the default info used for testing.
@@ -2148,6 +3449,60 @@ vr.StereoRenderer = function(gl, opt_attributes) {
       vr.StereoRenderer.PROGRAM_ATTRIBUTE_NAMES_,
       vr.StereoRenderer.PROGRAM_UNIFORM_NAMES_);
 
+  /**
+   * Warp mesh program.
+   * Draws a single eye with the distortion precomputed per vertex.
+   * @type {!vr.Program}
+   * @private
+   */
+  this.warpMeshProgram_ = new vr.Program(gl,
+      'vr.StereoRendererWarpMesh',
+      vr.StereoRenderer.MESH_VERTEX_SOURCE_,
+      vr.StereoRenderer.MESH_FRAGMENT_SOURCE_,
+      vr.StereoRenderer.MESH_ATTRIBUTE_NAMES_,
+      vr.StereoRenderer.PROGRAM_UNIFORM_NAMES_);
+
+  /**
+   * Warp mesh vertices for both eyes.
+   * Managed by {@link vr.StereoRenderer#updateWarpMesh_}.
+   * @type {!WebGLBuffer}
+   * @private
+   */
+  this.warpMeshVertexBuffer_ = gl.createBuffer();
+  this.warpMeshVertexBuffer_.displayName = 'vr.StereoRendererMeshVertices';
+
+  /**
+   * Warp mesh indices, shared by both eyes.
+   * Managed by {@link vr.StereoRenderer#updateWarpMesh_}.
+   * @type {!WebGLBuffer}
+   * @private
+   */
+  this.warpMeshIndexBuffer_ = gl.createBuffer();
+  this.warpMeshIndexBuffer_.displayName = 'vr.StereoRendererMeshIndices';
+
+  /**
+   * Vertices per eye in the warp mesh buffers, or 0 if they hold no mesh
+   * for the current HMD.
+   * @type {number}
+   * @private
+   */
+  this.warpMeshVertexCount_ = 0;
+
+  /**
+   * Number of indices in the warp mesh index buffer.
+   * @type {number}
+   * @private
+   */
+  this.warpMeshIndexCount_ = 0;
+
+  /**
+   * Whether the warp mesh must be requested again before it is next drawn,
+   * as the HMD changed.
+   * @type {boolean}
+   * @private
+   */
+  this.warpMeshDirty_ = true;
+
   /**
    * Current post processing mode.
    * Updated by {@link vr.StereoRenderer#setPostProcessingMode}.
@@ -2235,7 +3590,8 @@ vr.StereoRenderer = function(gl, opt_attributes) {
   var programs = [
     this.straightProgram_,
     this.warpProgram_,
-    this.warpChromeAbProgram_
+    this.warpChromeAbProgram_,
+    this.warpMeshProgram_
   ];
   for (var n = 0; n < programs.length; n++) {
     programs[n].beginLinking();
@@ -2270,6 +3626,17 @@ vr.StereoRenderer.Attributes;
 vr.StereoRenderer.RENDER_TARGET_SCALE_ = 2;
 
 
+/**
+ * Cells across and down each eye of the warp mesh. At this density on a DK1
+ * the mesh is within a pixel of the per-pixel warp everywhere, as checked by
+ * src/bench/warp_mesh_bench.cpp.
+ * @type {number}
+ * @const
+ * @private
+ */
+vr.StereoRenderer.WARP_MESH_CELLS_ = 64;
+
+
 /**
  * Disposes the object.
  */
@@ -2281,6 +3648,11 @@ vr.StereoRenderer.prototype.dispose = function() {
   gl.deleteTexture(this.renderTexture_);
   gl.deleteFramebuffer(this.framebuffer_);
   gl.deleteBuffer(this.quadBuffer_);
+  gl.deleteBuffer(this.warpMeshVertexBuffer_);
+  gl.deleteBuffer(this.warpMeshIndexBuffer_);
+  if (this.warpMeshProgram_) {
+    this.warpMeshProgram_.dispose();
+  }
   if (this.straightProgram_) {
     this.straightProgram_.dispose();
   }
@@ -2328,6 +3700,9 @@ vr.StereoRenderer.prototype.setPostProcessingMode = function(value) {
     case vr.PostProcessingMode.WARP:
       this.postProcessingProgram_ = this.warpProgram_;
       break;
+    case vr.PostProcessingMode.WARP_MESH:
+      this.postProcessingProgram_ = this.warpMeshProgram_;
+      break;
     default:
     case vr.PostProcessingMode.WARP_CHROMEAB:
       this.postProcessingProgram_ = this.warpChromeAbProgram_;
@@ -2361,11 +3736,45 @@ vr.StereoRenderer.prototype.initialize_ = function() {
 
   // Update program uniforms next render.
   this.updateAllUniforms_ = true;
+  this.warpMeshDirty_ = true;
 
   this.isInitialized_ = true;
 };
 
 
+/**
+ * Requests a warp mesh for the current HMD and uploads it.
+ * Leaves {@link vr.StereoRenderer#warpMeshVertexCount_} zero if there is
+ * none, in which case eyes are drawn with the per-pixel warp instead.
+ * @private
+ */
+vr.StereoRenderer.prototype.updateWarpMesh_ = function() {
+  var gl = this.gl_;
+  this.warpMeshDirty_ = false;
+  this.warpMeshVertexCount_ = 0;
+
+  // The plugin can only generate meshes for the HMD it reports.
+  if (this.hmdInfo_ !== vr.getHmdInfo()) {
+    return;
+  }
+  var cells = vr.StereoRenderer.WARP_MESH_CELLS_;
+  var mesh = vr.runtime_.dataSource_.queryWarpMesh(cells, cells);
+  if (!mesh) {
+    return;
+  }
+
+  var previousBuffer = gl.getParameter(gl.ARRAY_BUFFER_BINDING);
+  gl.bindBuffer(gl.ARRAY_BUFFER, this.warpMeshVertexBuffer_);
+  gl.bufferData(gl.ARRAY_BUFFER, mesh.vertices, gl.STATIC_DRAW);
+  gl.bindBuffer(gl.ARRAY_BUFFER, previousBuffer);
+  gl.bindBuffer(gl.ELEMENT_ARRAY_BUFFER, this.warpMeshIndexBuffer_);
+  gl.bufferData(gl.ELEMENT_ARRAY_BUFFER, mesh.indices, gl.STATIC_DRAW);
+  gl.bindBuffer(gl.ELEMENT_ARRAY_BUFFER, null);
+  this.warpMeshVertexCount_ = mesh.vertexCount;
+  this.warpMeshIndexCount_ = mesh.indices.length;
+};
+
+
 /**
  * Sets up the render target for drawing the scene.
  * @param {number} width Render target width.
@@ -2483,14 +3892,22 @@ vr.StereoRenderer.prototype.setInterpupillaryDistance = function(value) {
 vr.StereoRenderer.prototype.render = function(vrstate, callback, opt_scope) {
   var gl = this.gl_;
 
+  // Reinitialize whenever the HMD is plugged, unplugged or replaced, or its
+  // info is queried again; each of these invalidates the warp mesh.
   var nowPresent = vrstate.hmd.present;
-  if (nowPresent != this.hmdPresent_) {
-    this.hmdPresent_ = true;
-    if (nowPresent) {
+  var nowInfo = nowPresent ? vr.getHmdInfo() : null;
+  if (nowPresent != this.hmdPresent_ ||
+      (nowPresent &&
+       (vrstate.hmd.connectionGeneration != this.hmdGeneration_ ||
+        (nowInfo && nowInfo !== this.hmdInfo_)))) {
+    this.hmdPresent_ = nowPresent;
+    this.hmdGeneration_ =
+        nowPresent ? vrstate.hmd.connectionGeneration : -1;
+    if (nowInfo) {
       // HMD connected! Query info.
-      this.hmdInfo_ = vr.getHmdInfo();
+      this.hmdInfo_ = nowInfo;
     } else {
-      // Disconnected. Reset to defaults.
+      // Disconnected, or not queried yet. Reset to defaults.
       this.hmdInfo_ = new vr.HmdInfo();
     }
     this.initialize_();
@@ -2523,7 +3940,11 @@ vr.StereoRenderer.prototype.render = function(vrstate, callback, opt_scope) {
     // Distort to the screen.
     // TODO(benvanik): allow the user to specify a render target?
     gl.bindFramebuffer(gl.FRAMEBUFFER, null);
-    this.renderEye_(eye);
+    if (this.postProcessingMode_ == vr.PostProcessingMode.WARP_MESH) {
+      this.renderEyeMesh_(eye, n);
+    } else {
+      this.renderEye_(eye);
+    }
   }
 
   // User shouldn't be doing anything after this. Flush now.
@@ -2531,12 +3952,78 @@ vr.StereoRenderer.prototype.render = function(vrstate, callback, opt_scope) {
 };
 
 
+/**
+ * Renders the given eye to the target framebuffer with the warp mesh.
+ * @param {!StereoEye} eye Eye to render.
+ * @param {number} eyeIndex Index of the eye, 0 for the left.
+ * @private
+ */
+vr.StereoRenderer.prototype.renderEyeMesh_ = function(eye, eyeIndex) {
+  var gl = this.gl_;
+
+  if (this.warpMeshDirty_) {
+    this.updateWarpMesh_();
+  }
+  if (!this.warpMeshVertexCount_) {
+    this.renderEye_(eye, this.warpChromeAbProgram_);
+    return;
+  }
+
+  // Source the input texture.
+  gl.activeTexture(gl.TEXTURE0);
+  gl.bindTexture(gl.TEXTURE_2D, this.renderTexture_);
+
+  var program = this.warpMeshProgram_;
+  program.use();
+  gl.uniform1i(program.uniforms['u_tex0'], 0);
+  var x = eye.viewport[0];
+  var y = eye.viewport[1];
+  var w = eye.viewport[2];
+  var h = eye.viewport[3];
+  gl.uniform2f(program.uniforms['u_screenCenter'],
+      x + w / 2, y + h / 2);
+
+  // Viewport (in screen coordinates).
+  var fullWidth = this.hmdInfo_.resolutionHorz;
+  var fullHeight = this.hmdInfo_.resolutionVert;
+  gl.viewport(x * fullWidth, 0, w * fullWidth, fullHeight);
+
+  // Setup attribs. Each eye's vertices follow the previous eye's.
+  var a_xy = program.attributes.a_xy;
+  var a_uvRed = program.attributes.a_uvRed;
+  var a_uvGreen = program.attributes.a_uvGreen;
+  var a_uvBlue = program.attributes.a_uvBlue;
+  var base = eyeIndex * this.warpMeshVertexCount_ * 8 * 4;
+  gl.enableVertexAttribArray(a_xy);
+  gl.enableVertexAttribArray(a_uvRed);
+  gl.enableVertexAttribArray(a_uvGreen);
+  gl.enableVertexAttribArray(a_uvBlue);
+  gl.bindBuffer(gl.ARRAY_BUFFER, this.warpMeshVertexBuffer_);
+  gl.vertexAttribPointer(a_xy, 2, gl.FLOAT, false, 8 * 4, base);
+  gl.vertexAttribPointer(a_uvRed, 2, gl.FLOAT, false, 8 * 4, base + 2 * 4);
+  gl.vertexAttribPointer(a_uvGreen, 2, gl.FLOAT, false, 8 * 4, base + 4 * 4);
+  gl.vertexAttribPointer(a_uvBlue, 2, gl.FLOAT, false, 8 * 4, base + 6 * 4);
+  gl.bindBuffer(gl.ELEMENT_ARRAY_BUFFER, this.warpMeshIndexBuffer_);
+
+  // Draw the mesh.
+  gl.drawElements(gl.TRIANGLES, this.warpMeshIndexCount_,
+      gl.UNSIGNED_SHORT, 0);
+
+  // NOTE: the user must cleanup attributes themselves.
+  gl.bindBuffer(gl.ELEMENT_ARRAY_BUFFER, null);
+  gl.bindBuffer(gl.ARRAY_BUFFER, null);
+  gl.bindTexture(gl.TEXTURE_2D, null);
+};
+
+
 /**
  * Renders the given eye to the target framebuffer with distortion.
  * @param {!StereoEye} eye Eye to render.
+ * @param {vr.Program=} opt_program Program to use instead of the one for the
+ *     current post processing mode.
  * @private
  */
-vr.StereoRenderer.prototype.renderEye_ = function(eye) {
+vr.StereoRenderer.prototype.renderEye_ = function(eye, opt_program) {
   var gl = this.gl_;
 
   // Source the input texture.
@@ -2544,11 +4031,11 @@ vr.StereoRenderer.prototype.renderEye_ = function(eye) {
   gl.bindTexture(gl.TEXTURE_2D, this.renderTexture_);
 
   // Activate program.
-  var program = this.postProcessingProgram_;
+  var program = opt_program || this.postProcessingProgram_;
   program.use();
 
-  // Update all uniforms, if needed.
-  if (this.updateAllUniforms_) {
+  // Update all uniforms, if needed. A fallback program has not kept them.
+  if (this.updateAllUniforms_ || opt_program) {
     this.updateAllUniforms_ = false;
     gl.uniform1i(program.uniforms['u_tex0'], 0);
     gl.uniform4fv(program.uniforms['u_hmdWarpParam'],
@@ -2626,6 +4113,16 @@ vr.StereoRenderer.PROGRAM_UNIFORM_NAMES_ = [
 ];
 
 
+/**
+ * Attribute names for the warp mesh program.
+ * @type {!Array.<string>}
+ * @private
+ */
+vr.StereoRenderer.MESH_ATTRIBUTE_NAMES_ = [
+  'a_xy', 'a_uvRed', 'a_uvGreen', 'a_uvBlue'
+];
+
+
 /**
  * Source code for the shared vertex shader.
  * @type {string}
@@ -2739,6 +4236,61 @@ vr.StereoRenderer.WARP_CHROMEAB_FRAGMENT_SOURCE_ = [
 
 
 
+/**
+ * Source code for the warp mesh vertex shader.
+ * The mesh already holds the warped texture coordinates.
+ * @type {string}
+ * @const
+ * @private
+ */
+vr.StereoRenderer.MESH_VERTEX_SOURCE_ = [
+  'attribute vec2 a_xy;',
+  'attribute vec2 a_uvRed;',
+  'attribute vec2 a_uvGreen;',
+  'attribute vec2 a_uvBlue;',
+  'varying vec2 v_uvRed;',
+  'varying vec2 v_uvGreen;',
+  'varying vec2 v_uvBlue;',
+  'void main() {',
+  '  gl_Position = vec4(2.0 * a_xy - 1.0, 0.0, 1.0);',
+  '  v_uvRed = a_uvRed;',
+  '  v_uvGreen = a_uvGreen;',
+  '  v_uvBlue = a_uvBlue;',
+  '}'
+].join('\n');
+
+
+/**
+ * Source code for the warp mesh fragment shader.
+ * Samples each channel where the mesh says to, blacking out anything that
+ * would come from outside the eye as the per-pixel warp does.
+ * @type {string}
+ * @const
+ * @private
+ */
+vr.StereoRenderer.MESH_FRAGMENT_SOURCE_ = [
+  'precision highp float;',
+  'varying vec2 v_uvRed;',
+  'varying vec2 v_uvGreen;',
+  'varying vec2 v_uvBlue;',
+  'uniform sampler2D u_tex0;',
+  'uniform vec2 u_screenCenter;',
+  'void main() {',
+  '  if (any(greaterThan(abs(v_uvBlue - u_screenCenter),',
+  '      vec2(0.25, 0.5)))) {',
+  '    gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);',
+  '    return;',
+  '  }',
+  '  gl_FragColor = vec4(',
+  '      texture2D(u_tex0, v_uvRed).r,',
+  '      texture2D(u_tex0, v_uvGreen).g,',
+  '      texture2D(u_tex0, v_uvBlue).b,',
+  '      1);',
+  '}'
+].join('\n');
+
+
+
 /**
  * @global
  * @alias module vr
@@ -34,6 +34,16 @@
           'libovr.a',
         ],
       }],
+      ['OS == "linux"', {
+        'third_party_libs': [
+          '-lovr',
+          '-ludev',
+          '-lX11',
+          '-lXinerama',
+          '-lpthread',
+          '-lrt',
+        ],
+      }],
     ],
   },
 
@@ -66,6 +76,15 @@
           'XP_MACOSX=1',
         ],
       }],
+      ['OS == "linux"', {
+        'defines': [
+          'XP_UNIX=1',
+          'USE_HIDRAW=1',
+        ],
+        'cflags': [
+          '-fPIC',
+        ],
+      }],
     ],
 
     'configurations': {
@@ -219,6 +238,17 @@
             'src/main_win.cpp',
           ],
         }],
+        ['OS != "linux"', {
+          'sources!': [
+            'src/npvr/hidraw_provider.cpp',
+            'src/npvr/hidraw_provider.h',
+          ],
+        }],
+        ['OS == "linux"', {
+          'ldflags': [
+            '-L$(srcdir)/third_party/oculus-sdk/LibOVR/Lib/Linux/Release/x86_64',
+          ],
+        }],
         ['OS == "mac"', {
           'libraries': [
             '$(SDKROOT)/System/Library/Frameworks/CoreFoundation.framework',
@@ -247,10 +277,53 @@
         'src/npvr.h',
         'src/npvr/plugin.cpp',
         'src/npvr/plugin.h',
+        'src/npvr/binary_writer.cpp',
+        'src/npvr/binary_writer.h',
+        'src/npvr/text_writer.cpp',
+        'src/npvr/text_writer.h',
         'src/npvr/vr_object.cpp',
         'src/npvr/vr_object.h',
         'src/npvr/ovr_manager.cpp',
         'src/npvr/ovr_manager.h',
+        'src/npvr/atomic.h',
+        'src/npvr/capture.cpp',
+        'src/npvr/capture.h',
+        'src/npvr/clock.cpp',
+        'src/npvr/clock.h',
+        'src/npvr/distortion.cpp',
+        'src/npvr/distortion.h',
+        'src/npvr/fusion_engine.cpp',
+        'src/npvr/fusion_engine.h',
+        'src/npvr/hidraw_provider.cpp',
+        'src/npvr/hidraw_provider.h',
+        'src/npvr/latency_trace.cpp',
+        'src/npvr/latency_trace.h',
+        'src/npvr/pose_prediction.cpp',
+        'src/npvr/pose_prediction.h',
+        'src/npvr/provider_factory.cpp',
+        'src/npvr/provider_factory.h',
+        'src/npvr/seqlock.h',
+        'src/npvr/sequenced_ring.h',
+        'src/npvr/shared_memory.cpp',
+        'src/npvr/shared_memory.h',
+        'src/npvr/shared_tracking.cpp',
+        'src/npvr/shared_tracking.h',
+        'src/npvr/sixense_frame.cpp',
+        'src/npvr/sixense_frame.h',
+        'src/npvr/sixense_manager.cpp',
+        'src/npvr/sixense_manager.h',
+        'src/npvr/stereo_params.cpp',
+        'src/npvr/stereo_params.h',
+        'src/npvr/synthetic_provider.cpp',
+        'src/npvr/synthetic_provider.h',
+        'src/npvr/thread.cpp',
+        'src/npvr/thread.h',
+        'src/npvr/tracker_decoder.cpp',
+        'src/npvr/tracker_decoder.h',
+        'src/npvr/tracking_provider.cpp',
+        'src/npvr/tracking_provider.h',
+        'src/npvr/warp_mesh.cpp',
+        'src/npvr/warp_mesh.h',
 
         'src/main_win.cpp',
 
@@ -259,5 +332,319 @@
         'src/npvr.def',
       ],
     },
+
+    {
+      'target_name': 'npvr_daemon',
+      'product_name': 'npvr_daemon',
+      'type': 'executable',
+
+      'libraries': [
+        '<@(third_party_libs)',
+      ],
+      'conditions': [
+        ['OS != "linux"', {
+          'sources!': [
+            'src/npvr/hidraw_provider.cpp',
+            'src/npvr/hidraw_provider.h',
+          ],
+        }],
+        ['OS == "linux"', {
+          'ldflags': [
+            '-L$(srcdir)/third_party/oculus-sdk/LibOVR/Lib/Linux/Release/x86_64',
+          ],
+        }],
+        ['OS == "mac"', {
+          'libraries': [
+            '$(SDKROOT)/System/Library/Frameworks/CoreFoundation.framework',
+            '$(SDKROOT)/System/Library/Frameworks/CoreGraphics.framework',
+            '$(SDKROOT)/System/Library/Frameworks/IOKit.framework',
+          ],
+        }],
+      ],
+
+      'include_dirs': [
+        '.',
+        'src/',
+        '<@(third_party_include_paths)'
+      ],
+
+      'sources': [
+        'src/daemon/npvr_daemon.cpp',
+
+        'src/npvr/atomic.h',
+        'src/npvr/capture.cpp',
+        'src/npvr/capture.h',
+        'src/npvr/clock.cpp',
+        'src/npvr/clock.h',
+        'src/npvr/fusion_engine.cpp',
+        'src/npvr/fusion_engine.h',
+        'src/npvr/hidraw_provider.cpp',
+        'src/npvr/hidraw_provider.h',
+        'src/npvr/ovr_manager.cpp',
+        'src/npvr/ovr_manager.h',
+        'src/npvr/pose_prediction.cpp',
+        'src/npvr/pose_prediction.h',
+        'src/npvr/provider_factory.cpp',
+        'src/npvr/provider_factory.h',
+        'src/npvr/seqlock.h',
+        'src/npvr/sequenced_ring.h',
+        'src/npvr/shared_memory.cpp',
+        'src/npvr/shared_memory.h',
+        'src/npvr/shared_tracking.cpp',
+        'src/npvr/shared_tracking.h',
+        'src/npvr/sixense_frame.cpp',
+        'src/npvr/sixense_frame.h',
+        'src/npvr/sixense_manager.cpp',
+        'src/npvr/sixense_manager.h',
+        'src/npvr/synthetic_provider.cpp',
+        'src/npvr/synthetic_provider.h',
+        'src/npvr/thread.cpp',
+        'src/npvr/thread.h',
+        'src/npvr/tracker_decoder.cpp',
+        'src/npvr/tracker_decoder.h',
+        'src/npvr/tracking_provider.cpp',
+        'src/npvr/tracking_provider.h',
+      ],
+    },
+
+    {
+      'target_name': 'npvr_bench',
+      'product_name': 'npvr_bench',
+      'type': 'executable',
+
+      'include_dirs': [
+        '.',
+        'src/',
+        '<@(third_party_include_paths)'
+      ],
+
+      'sources': [
+        'src/bench/npvr_bench.cpp',
+        'src/bench/expect.h',
+
+        'src/np_object_base.cpp',
+        'src/np_object_base.h',
+        'src/npvr/binary_writer.cpp',
+        'src/npvr/binary_writer.h',
+        'src/npvr/clock.cpp',
+        'src/npvr/clock.h',
+        'src/npvr/distortion.cpp',
+        'src/npvr/distortion.h',
+        'src/npvr/fusion_engine.cpp',
+        'src/npvr/fusion_engine.h',
+        'src/npvr/latency_trace.cpp',
+        'src/npvr/latency_trace.h',
+        'src/npvr/pose_prediction.cpp',
+        'src/npvr/pose_prediction.h',
+        'src/npvr/sixense_frame.cpp',
+        'src/npvr/sixense_frame.h',
+        'src/npvr/stereo_params.cpp',
+        'src/npvr/stereo_params.h',
+        'src/npvr/text_writer.cpp',
+        'src/npvr/text_writer.h',
+        'src/npvr/thread.cpp',
+        'src/npvr/thread.h',
+        'src/npvr/tracking_provider.cpp',
+        'src/npvr/tracking_provider.h',
+        'src/npvr/vr_object.cpp',
+        'src/npvr/vr_object.h',
+        'src/npvr/warp_mesh.cpp',
+        'src/npvr/warp_mesh.h',
+      ],
+    },
+
+    {
+      'target_name': 'tracker_bench',
+      'product_name': 'tracker_bench',
+      'type': 'executable',
+
+      'include_dirs': [
+        '.',
+        'src/',
+        '<@(third_party_include_paths)'
+      ],
+
+      'sources': [
+        'src/bench/tracker_bench.cpp',
+        'src/bench/expect.h',
+
+        'src/npvr/clock.cpp',
+        'src/npvr/clock.h',
+        'src/npvr/tracker_decoder.cpp',
+        'src/npvr/tracker_decoder.h',
+      ],
+    },
+
+    {
+      'target_name': 'fusion_bench',
+      'product_name': 'fusion_bench',
+      'type': 'executable',
+
+      'include_dirs': [
+        '.',
+        'src/',
+        '<@(third_party_include_paths)'
+      ],
+
+      'sources': [
+        'src/bench/fusion_bench.cpp',
+        'src/bench/expect.h',
+
+        'src/npvr/clock.cpp',
+        'src/npvr/clock.h',
+        'src/npvr/fusion_engine.cpp',
+        'src/npvr/fusion_engine.h',
+      ],
+    },
+
+    {
+      'target_name': 'capture_bench',
+      'product_name': 'capture_bench',
+      'type': 'executable',
+
+      'include_dirs': [
+        '.',
+        'src/',
+        '<@(third_party_include_paths)'
+      ],
+
+      'sources': [
+        'src/bench/capture_bench.cpp',
+        'src/bench/expect.h',
+
+        'src/npvr/capture.cpp',
+        'src/npvr/capture.h',
+        'src/npvr/clock.cpp',
+        'src/npvr/clock.h',
+        'src/npvr/fusion_engine.cpp',
+        'src/npvr/fusion_engine.h',
+        'src/npvr/thread.cpp',
+        'src/npvr/thread.h',
+      ],
+    },
+
+    {
+      'target_name': 'synthetic_bench',
+      'product_name': 'synthetic_bench',
+      'type': 'executable',
+
+      'include_dirs': [
+        '.',
+        'src/',
+        '<@(third_party_include_paths)'
+      ],
+
+      'sources': [
+        'src/bench/synthetic_bench.cpp',
+        'src/bench/expect.h',
+
+        'src/npvr/clock.cpp',
+        'src/npvr/clock.h',
+        'src/npvr/pose_prediction.cpp',
+        'src/npvr/pose_prediction.h',
+        'src/npvr/sixense_frame.cpp',
+        'src/npvr/sixense_frame.h',
+        'src/npvr/synthetic_provider.cpp',
+        'src/npvr/synthetic_provider.h',
+        'src/npvr/thread.cpp',
+        'src/npvr/thread.h',
+        'src/npvr/tracking_provider.cpp',
+        'src/npvr/tracking_provider.h',
+      ],
+    },
+
+    {
+      'target_name': 'warp_mesh_bench',
+      'product_name': 'warp_mesh_bench',
+      'type': 'executable',
+
+      'include_dirs': [
+        '.',
+        'src/',
+        '<@(third_party_include_paths)'
+      ],
+
+      'sources': [
+        'src/bench/warp_mesh_bench.cpp',
+        'src/bench/expect.h',
+
+        'src/npvr/clock.cpp',
+        'src/npvr/clock.h',
+        'src/npvr/pose_prediction.cpp',
+        'src/npvr/pose_prediction.h',
+        'src/npvr/stereo_params.cpp',
+        'src/npvr/stereo_params.h',
+        'src/npvr/tracking_provider.cpp',
+        'src/npvr/tracking_provider.h',
+        'src/npvr/warp_mesh.cpp',
+        'src/npvr/warp_mesh.h',
+      ],
+    },
+
+    {
+      'target_name': 'distortion_bench',
+      'product_name': 'distortion_bench',
+      'type': 'executable',
+
+      'include_dirs': [
+        '.',
+        'src/',
+        '<@(third_party_include_paths)'
+      ],
+
+      'sources': [
+        'src/bench/distortion_bench.cpp',
+        'src/bench/expect.h',
+
+        'src/npvr/clock.cpp',
+        'src/npvr/clock.h',
+        'src/npvr/distortion.cpp',
+        'src/npvr/distortion.h',
+        'src/npvr/pose_prediction.cpp',
+        'src/npvr/pose_prediction.h',
+        'src/npvr/stereo_params.cpp',
+        'src/npvr/stereo_params.h',
+        'src/npvr/tracking_provider.cpp',
+        'src/npvr/tracking_provider.h',
+        'src/npvr/warp_mesh.cpp',
+        'src/npvr/warp_mesh.h',
+      ],
+    },
+
+    {
+      'target_name': 'host_bench',
+      'product_name': 'host_bench',
+      'type': 'executable',
+
+      # Loads the plugin at runtime rather than linking it.
+      'dependencies': [
+        'npvr',
+      ],
+
+      'conditions': [
+        ['OS == "linux"', {
+          'libraries': [
+            '-ldl',
+            '-lpthread',
+          ],
+        }],
+      ],
+
+      'include_dirs': [
+        '.',
+        'src/',
+        '<@(third_party_include_paths)'
+      ],
+
+      'sources': [
+        'src/bench/host_bench.cpp',
+        'src/bench/expect.h',
+
+        'src/npvr/clock.cpp',
+        'src/npvr/clock.h',
+        'src/npvr/thread.cpp',
+        'src/npvr/thread.h',
+      ],
+    },
   ],
 }
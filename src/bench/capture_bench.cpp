@@ -0,0 +1,205 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Capture write and replay throughput. Writes a synthetic session (1kHz IMU
+// samples and poses, two controllers at 60Hz) to a file, replays it as fast
+// as possible through FusionEngine and checks that every record came back
+// intact and that replayed fusion matches fusing the samples directly.
+// Exits non-zero if a check fails.
+
+#include <npvr.h>
+#include <bench/expect.h>
+#include <npvr/capture.h>
+#include <npvr/clock.h>
+#include <npvr/fusion_engine.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace npvr;
+
+
+namespace {
+
+const int kImuRate = 1000;
+const int kSixenseRate = 60;
+
+void MakeImuSample(int n, FusionSample* out) {
+  float t = (float)n / kImuRate;
+  out->time_delta = 1.0f / kImuRate;
+  out->acceleration[0] = 0.1f * sinf(t);
+  out->acceleration[1] = 9.81f;
+  out->acceleration[2] = 0.1f * cosf(t);
+  out->rotation_rate[0] = 0.2f * sinf(t * 2);
+  out->rotation_rate[1] = 0.8f * sinf(t * 3);
+  out->rotation_rate[2] = 0.1f;
+  out->magnetic_field[0] = 0.2f;
+  out->magnetic_field[1] = -0.4f;
+  out->magnetic_field[2] = 0.1f;
+}
+
+void MakeSixenseFrame(int n, int controller, SixenseFrame* out) {
+  memset(out, 0, sizeof(*out));
+  out->controller = (uint8_t)controller;
+  out->sequence = (uint8_t)n;
+  out->hand = (uint8_t)(controller + 1);
+  out->position[0] = (float)n;
+  out->position[1] = (float)controller;
+  out->rotation[3] = 1;
+  out->buttons = (uint32_t)n;
+}
+
+// Counts what it is handed and fuses the IMU samples.
+class BenchSink : public CaptureSink {
+public:
+  BenchSink() :
+      hmd_info_count(0),
+      imu_count(0),
+      pose_count(0),
+      sixense_count(0),
+      sixense_mismatches(0) {
+  }
+
+  virtual void OnHmdInfo(const CaptureHmdInfo& info) {
+    hmd_info_count++;
+    hmd_info = info;
+  }
+  virtual void OnImuSample(const FusionSample& sample) {
+    imu_count++;
+    engine.Update(sample);
+  }
+  virtual void OnHmdPose(const CaptureHmdPose& pose) {
+    pose_count++;
+    last_pose = pose;
+  }
+  virtual void OnSixenseFrame(const SixenseFrame& frame) {
+    SixenseFrame expected;
+    MakeSixenseFrame(frame.sequence, frame.controller, &expected);
+    if (frame.buttons % 256 != frame.sequence ||
+        frame.hand != expected.hand ||
+        frame.position[1] != expected.position[1]) {
+      sixense_mismatches++;
+    }
+    sixense_count++;
+  }
+
+  int hmd_info_count;
+  int imu_count;
+  int pose_count;
+  int sixense_count;
+  int sixense_mismatches;
+  CaptureHmdInfo hmd_info;
+  CaptureHmdPose last_pose;
+  FusionEngine engine;
+};
+
+}  // namespace
+
+
+int main(int argc, char** argv) {
+  const char* path = argc > 1 ? argv[1] : "capture_bench.npvrcap";
+  // Five minutes of head tracking.
+  const int kSeconds = 300;
+  const int kImuCount = kSeconds * kImuRate;
+  const int kSixenseCount = kSeconds * kSixenseRate;
+
+  CaptureHmdInfo info;
+  memset(&info, 0, sizeof(info));
+  strcpy(info.product_name, "Bench HMD");
+  info.h_resolution = 1280;
+  info.v_resolution = 800;
+  info.distortion_k[0] = 1;
+
+  FusionEngine direct;
+  CaptureWriter writer;
+  if (!writer.Open(path)) {
+    printf("unable to open %s\n", path);
+    return 1;
+  }
+  uint64_t start = NowNanos();
+  writer.WriteHmdInfo(info);
+  int records = 1;
+  int sixense_frames = 0;
+  for (int n = 0; n < kImuCount; n++) {
+    FusionSample sample;
+    MakeImuSample(n, &sample);
+    writer.WriteImuSample(sample);
+    direct.Update(sample);
+    CaptureHmdPose pose;
+    memcpy(pose.orientation, direct.orientation(), sizeof(pose.orientation));
+    memcpy(pose.angular_velocity, direct.angular_velocity(),
+           sizeof(pose.angular_velocity));
+    memset(pose.angular_acceleration, 0, sizeof(pose.angular_acceleration));
+    memcpy(pose.acceleration, direct.acceleration(),
+           sizeof(pose.acceleration));
+    writer.WriteHmdPose(pose);
+    records += 2;
+    // Controllers are polled whenever a 60Hz frame falls due, which the
+    // 1kHz IMU clock does not divide evenly.
+    if (sixense_frames * kImuRate <= n * kSixenseRate) {
+      for (int c = 0; c < 2; c++) {
+        SixenseFrame frame;
+        MakeSixenseFrame(sixense_frames, c, &frame);
+        writer.WriteSixenseFrame(frame);
+        records++;
+      }
+      sixense_frames++;
+    }
+  }
+  writer.Close();
+  double write_elapsed = (double)(NowNanos() - start);
+
+  CaptureReader reader;
+  if (!reader.Open(path)) {
+    printf("unable to map %s\n", path);
+    return 1;
+  }
+  BenchSink sink;
+  CapturePlayer player(&reader, false);
+  start = NowNanos();
+  while (player.Step(&sink)) {
+  }
+  double read_elapsed = (double)(NowNanos() - start);
+
+  printf("round trip:\n");
+  Expect(player.record_count() == (uint64_t)records, "records replayed",
+         (double)player.record_count());
+  Expect(sink.hmd_info_count == 1 &&
+         !strcmp(sink.hmd_info.product_name, "Bench HMD") &&
+         sink.hmd_info.h_resolution == 1280, "hmd info records",
+         sink.hmd_info_count);
+  Expect(sink.imu_count == kImuCount, "imu records", sink.imu_count);
+  Expect(sink.pose_count == kImuCount, "pose records", sink.pose_count);
+  Expect(sink.sixense_count == 2 * kSixenseCount && !sink.sixense_mismatches,
+         "sixense records", sink.sixense_count);
+  float error = 0;
+  for (int i = 0; i < 4; i++) {
+    error += fabsf(sink.engine.orientation()[i] - direct.orientation()[i]);
+    error += fabsf(sink.last_pose.orientation[i] - direct.orientation()[i]);
+  }
+  Expect(error == 0, "replayed fusion vs direct, error", error);
+  printf("\n");
+
+  printf("%d records:\n", records);
+  printf("  %-16s %6.1f ns/record\n", "write", write_elapsed / records);
+  printf("  %-16s %6.1f ns/record  (fusion included)\n", "replay",
+         read_elapsed / records);
+
+  reader.Close();
+  remove(path);
+  return BenchExitCode();
+}
@@ -0,0 +1,291 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Checks the batch distortion kernels in distortion.h on a DK1, then reports
+// their throughput against the scalar path. Forward distortion is compared
+// with the polynomial in double precision, the inverse by distorting its
+// result again, and point warps with WarpTexCoord and by unwarping them. The
+// SSE2 path must match the scalar one bit for bit. Radii span the eye out to
+// the far corner of its viewport, where the inverse needs the most
+// iterations. Exits non-zero if a check fails.
+
+#include <npvr.h>
+#include <bench/expect.h>
+#include <npvr/clock.h>
+#include <npvr/distortion.h>
+#include <npvr/tracking_provider.h>
+
+#include <math.h>
+
+using namespace npvr;
+
+
+namespace {
+
+double DistortDouble(const float* k, double r) {
+  double r_sq = r * r;
+  return r * (k[0] + k[1] * r_sq + k[2] * r_sq * r_sq +
+              k[3] * r_sq * r_sq * r_sq);
+}
+
+// The largest undistorted radius either eye's viewport reaches.
+float GetMaxRadius(const StereoParams& params, const WarpParams* warp) {
+  float max_r = 0;
+  for (int eye = 0; eye < 2; eye++) {
+    const float* v = params.eyes[eye].viewport;
+    for (int corner = 0; corner < 4; corner++) {
+      float x = (v[0] + (corner & 1) * v[2] - warp[eye].lens_center[0]) *
+          warp[eye].scale_in[0];
+      float y = (v[1] + (corner >> 1) * v[3] - warp[eye].lens_center[1]) *
+          warp[eye].scale_in[1];
+      float r = sqrtf(x * x + y * y);
+      max_r = r > max_r ? r : max_r;
+    }
+  }
+  return max_r;
+}
+
+void CheckRadii(const float* k, float max_r, size_t count) {
+  float* radii = new float[count];
+  float* scalar = new float[count];
+  float* simd = new float[count];
+  float* round_trip = new float[count];
+  for (size_t n = 0; n < count; n++) {
+    radii[n] = max_r * n / (count - 1);
+  }
+
+  DistortRadii(k, radii, count, scalar, false);
+  double max_error = 0;
+  for (size_t n = 0; n < count; n++) {
+    double expected = DistortDouble(k, radii[n]);
+    double error = fabs(scalar[n] - expected) / (expected > 1 ? expected : 1);
+    max_error = error > max_error ? error : max_error;
+  }
+  Expect(max_error < 1e-6, "distort: max relative error", max_error);
+  if (DistortionSimdSupported()) {
+    DistortRadii(k, radii, count, simd, true);
+    Expect(!memcmp(scalar, simd, count * sizeof(float)),
+           "distort: sse2 matches scalar", 0);
+  }
+
+  // Undistort the distorted radii in place, then distort them again.
+  UndistortRadii(k, scalar, count, round_trip, false);
+  double max_residual = 0;
+  double max_radius_error = 0;
+  for (size_t n = 0; n < count; n++) {
+    double residual = fabs(DistortDouble(k, round_trip[n]) - scalar[n]) /
+        (scalar[n] > 1 ? scalar[n] : 1);
+    max_residual = residual > max_residual ? residual : max_residual;
+    double error = fabs(round_trip[n] - radii[n]);
+    max_radius_error = error > max_radius_error ? error : max_radius_error;
+  }
+  // A few float roundings on top of kUndistortTolerance; running out of
+  // iterations leaves orders of magnitude more.
+  Expect(max_residual < 4 * kUndistortTolerance,
+         "undistort: max relative residual", max_residual);
+  Expect(max_radius_error < 1e-5, "undistort: max round trip error",
+         max_radius_error);
+  if (DistortionSimdSupported()) {
+    UndistortRadii(k, scalar, count, simd, true);
+    Expect(!memcmp(round_trip, simd, count * sizeof(float)),
+           "undistort: sse2 matches scalar", 0);
+  }
+
+  delete[] radii;
+  delete[] scalar;
+  delete[] simd;
+  delete[] round_trip;
+}
+
+// A grid of x, y points across the eye's viewport.
+float* BuildPoints(const StereoParams& params, int eye, int columns,
+                   int rows) {
+  const float* v = params.eyes[eye].viewport;
+  float* points = new float[columns * rows * 2];
+  float* p = points;
+  for (int j = 0; j < rows; j++) {
+    for (int i = 0; i < columns; i++) {
+      *p++ = v[0] + v[2] * i / (columns - 1);
+      *p++ = v[1] + v[3] * j / (rows - 1);
+    }
+  }
+  return points;
+}
+
+void CheckPoints(const StereoParams& params, const WarpParams& warp,
+                 int eye) {
+  // An odd number of points leaves a scalar tail after the SSE2 groups.
+  const int kColumns = 101;
+  const int kRows = 81;
+  const size_t count = kColumns * kRows;
+  float* points = BuildPoints(params, eye, kColumns, kRows);
+  float* scalar = new float[count * 2];
+  float* simd = new float[count * 2];
+  float* round_trip = new float[count * 2];
+
+  WarpPoints(warp, points, count, scalar, false);
+  double max_error = 0;
+  for (size_t n = 0; n < count; n++) {
+    float red[2];
+    float green[2];
+    float blue[2];
+    WarpTexCoord(warp, points + n * 2, red, green, blue);
+    for (int i = 0; i < 2; i++) {
+      double error = fabs(scalar[n * 2 + i] - green[i]);
+      max_error = error > max_error ? error : max_error;
+    }
+  }
+  char what[64];
+  sprintf(what, "eye %d warp: max error from WarpTexCoord", eye);
+  Expect(max_error < 1e-6, what, max_error);
+  if (DistortionSimdSupported()) {
+    WarpPoints(warp, points, count, simd, true);
+    sprintf(what, "eye %d warp: sse2 matches scalar", eye);
+    Expect(!memcmp(scalar, simd, count * 2 * sizeof(float)), what, 0);
+  }
+
+  UnwarpPoints(warp, scalar, count, round_trip, false);
+  max_error = 0;
+  for (size_t n = 0; n < count * 2; n++) {
+    double error = fabs(round_trip[n] - points[n]);
+    max_error = error > max_error ? error : max_error;
+  }
+  sprintf(what, "eye %d unwarp: max round trip error", eye);
+  Expect(max_error < 1e-5, what, max_error);
+  if (DistortionSimdSupported()) {
+    UnwarpPoints(warp, scalar, count, simd, true);
+    sprintf(what, "eye %d unwarp: sse2 matches scalar", eye);
+    Expect(!memcmp(round_trip, simd, count * 2 * sizeof(float)), what, 0);
+  }
+
+  delete[] points;
+  delete[] scalar;
+  delete[] simd;
+  delete[] round_trip;
+}
+
+typedef void (*BatchFunction)(const float* in, size_t count, float* out,
+                              bool use_simd);
+
+const float* g_k = NULL;
+const WarpParams* g_warp = NULL;
+
+void RunDistortRadii(const float* in, size_t count, float* out,
+                     bool use_simd) {
+  DistortRadii(g_k, in, count, out, use_simd);
+}
+
+void RunUndistortRadii(const float* in, size_t count, float* out,
+                       bool use_simd) {
+  UndistortRadii(g_k, in, count, out, use_simd);
+}
+
+void RunWarpPoints(const float* in, size_t count, float* out,
+                   bool use_simd) {
+  WarpPoints(*g_warp, in, count, out, use_simd);
+}
+
+void RunUnwarpPoints(const float* in, size_t count, float* out,
+                     bool use_simd) {
+  UnwarpPoints(*g_warp, in, count, out, use_simd);
+}
+
+// Returns ns per value over enough passes to take about a quarter second.
+double Measure(BatchFunction function, const float* in, size_t count,
+               float* out, bool use_simd) {
+  int passes = 1;
+  while (true) {
+    uint64_t start = NowNanos();
+    for (int pass = 0; pass < passes; pass++) {
+      function(in, count, out, use_simd);
+    }
+    uint64_t elapsed = NowNanos() - start;
+    if (elapsed > 250000000ull) {
+      return (double)elapsed / ((double)count * passes);
+    }
+    passes *= 2;
+  }
+}
+
+void Report(const char* name, BatchFunction function, const float* in,
+            size_t count, float* out) {
+  double scalar = Measure(function, in, count, out, false);
+  printf("  %-16s scalar %7.2f ns/value %8.1f M/s", name, scalar,
+         1e3 / scalar);
+  if (DistortionSimdSupported()) {
+    double simd = Measure(function, in, count, out, true);
+    printf("   sse2 %7.2f ns/value %8.1f M/s  (%.1fx)", simd, 1e3 / simd,
+           scalar / simd);
+  }
+  printf("\n");
+}
+
+}  // namespace
+
+
+int main(int argc, char** argv) {
+  OVR::HMDInfo info;
+  SetDefaultHmdInfo(&info);
+  StereoConfig config;
+  config.interpupillary_distance = 0;
+  config.z_near = 0.01f;
+  config.z_far = 1000;
+  StereoParams params;
+  ComputeStereoParams(info, config, &params);
+  WarpParams warp[2];
+  for (int eye = 0; eye < 2; eye++) {
+    GetWarpParams(info, params, eye, &warp[eye]);
+  }
+  const float* k = info.DistortionK;
+  float max_r = GetMaxRadius(params, warp);
+
+  printf("accuracy, radii 0-%.3f (distorted 0-%.3f):\n", max_r,
+         DistortRadius(k, max_r));
+  CheckRadii(k, max_r, 100001);
+  for (int eye = 0; eye < 2; eye++) {
+    CheckPoints(params, warp[eye], eye);
+  }
+  printf("\n");
+
+  // About what a page maps per call; small enough to stay in cache.
+  const size_t kCount = 4096;
+  float* radii = new float[kCount];
+  float* distorted = new float[kCount];
+  float* out = new float[kCount * 2];
+  for (size_t n = 0; n < kCount; n++) {
+    radii[n] = max_r * n / (kCount - 1);
+  }
+  DistortRadii(k, radii, kCount, distorted);
+  float* points = BuildPoints(params, 0, 64, (int)kCount / 64);
+  float* warped = new float[kCount * 2];
+  WarpPoints(warp[0], points, kCount, warped);
+
+  g_k = k;
+  g_warp = &warp[0];
+  printf("throughput, %d values per call:\n", (int)kCount);
+  Report("distort radii", RunDistortRadii, radii, kCount, out);
+  Report("undistort radii", RunUndistortRadii, distorted, kCount, out);
+  Report("warp points", RunWarpPoints, points, kCount, out);
+  Report("unwarp points", RunUnwarpPoints, warped, kCount, out);
+
+  delete[] radii;
+  delete[] distorted;
+  delete[] out;
+  delete[] points;
+  delete[] warped;
+  return BenchExitCode();
+}
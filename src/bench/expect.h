@@ -0,0 +1,59 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef NPVR_BENCH_EXPECT_H_
+#define NPVR_BENCH_EXPECT_H_
+
+#include <stdio.h>
+
+
+namespace npvr {
+
+// Self-checks shared by the benches. Each check is printed as a row of the
+// bench's results, and main returns BenchExitCode(), which is non-zero if
+// any check failed.
+
+// Checks failed so far.
+inline int& BenchFailures() {
+  static int failures = 0;
+  return failures;
+}
+
+// Prints what and value marked ok or FAILED.
+inline void Expect(bool condition, const char* what, double value) {
+  printf("  %-40s %12.6g  %s\n", what, value, condition ? "ok" : "FAILED");
+  if (!condition) {
+    BenchFailures()++;
+  }
+}
+
+// For checks made in bulk: prints what only if the check fails.
+inline void Expect(bool condition, const char* what) {
+  if (!condition) {
+    printf("  FAILED: %s\n", what);
+    BenchFailures()++;
+  }
+}
+
+inline int BenchExitCode() {
+  return BenchFailures() ? 1 : 0;
+}
+
+}  // namespace npvr
+
+
+#endif  // NPVR_BENCH_EXPECT_H_
@@ -0,0 +1,164 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Per-sample cost benchmark for FusionEngine, plus convergence checks run
+// first on synthetic 1kHz data: pure gyro integration against the closed
+// form, tilt correction from a wrong initial attitude and yaw hold against a
+// gyro bias. Exits non-zero if a check fails.
+
+#include <npvr.h>
+#include <bench/expect.h>
+#include <npvr/clock.h>
+#include <npvr/fusion_engine.h>
+
+#include <math.h>
+#include <stdlib.h>
+
+using namespace npvr;
+
+
+namespace {
+
+const float kDt = 0.001f;
+
+void MakeSample(float ax, float ay, float az, float wx, float wy, float wz,
+                FusionSample* out) {
+  out->time_delta = kDt;
+  out->acceleration[0] = ax;
+  out->acceleration[1] = ay;
+  out->acceleration[2] = az;
+  out->rotation_rate[0] = wx;
+  out->rotation_rate[1] = wy;
+  out->rotation_rate[2] = wz;
+  out->magnetic_field[0] = 0.2f;
+  out->magnetic_field[1] = -0.4f;
+  out->magnetic_field[2] = 0.1f;
+}
+
+// Heading of the body +Z axis in the world XZ plane.
+float Yaw(const float q[4]) {
+  // Third column of the rotation matrix.
+  float x = 2 * (q[0] * q[2] + q[3] * q[1]);
+  float z = 1 - 2 * (q[0] * q[0] + q[1] * q[1]);
+  return atan2f(x, z);
+}
+
+// Angle between the body +Y axis in world space and world +Y.
+float Tilt(const float q[4]) {
+  float y = 1 - 2 * (q[0] * q[0] + q[2] * q[2]);
+  return acosf(y > 1 ? 1 : y < -1 ? -1 : y);
+}
+
+void CheckGyroIntegration() {
+  FusionEngine engine;
+  FusionSample sample;
+  MakeSample(0, 9.81f, 0, 0, 1, 0, &sample);
+  for (int n = 0; n < 1000; n++) {
+    engine.Update(sample);
+  }
+  const float* q = engine.orientation();
+  float error = fabsf(q[1] - sinf(0.5f)) + fabsf(q[3] - cosf(0.5f)) +
+                fabsf(q[0]) + fabsf(q[2]);
+  Expect(error < 1e-4f, "1 rad/s yaw for 1s, quaternion error", error);
+}
+
+void CheckTiltCorrection() {
+  // The tracker is really pitched 0.3 rad about X but starts at identity.
+  const float pitch = 0.3f;
+  FusionEngine engine;
+  FusionSample sample;
+  MakeSample(0, 9.81f * cosf(pitch), 9.81f * sinf(pitch), 0, 0, 0, &sample);
+  for (int n = 0; n < 30000; n++) {
+    engine.Update(sample);
+  }
+  // Converged means the engine's orientation matches the real pitch.
+  float error = fabsf(Tilt(engine.orientation()) - pitch);
+  Expect(error < 0.06f, "0.3 rad tilt after 30s, residual", error);
+}
+
+float RunYawDrift(bool correct) {
+  FusionEngine engine;
+  engine.set_yaw_correction_enabled(correct);
+  FusionSample sample;
+  // Level and still, with a gyro bias under the stillness threshold.
+  MakeSample(0, 9.81f, 0, 0, 0.003f, 0, &sample);
+  for (int n = 0; n < 120000; n++) {
+    engine.Update(sample);
+  }
+  return fabsf(Yaw(engine.orientation()));
+}
+
+void CheckYawCorrection() {
+  float drift = RunYawDrift(false);
+  float held = RunYawDrift(true);
+  Expect(drift > 0.3f, "yaw drift after 120s, uncorrected", drift);
+  Expect(held < 0.02f, "yaw drift after 120s, corrected", held);
+}
+
+// Head motion: still stretches broken up by turns, so both the integration
+// and correction paths get exercised.
+void BuildMotion(FusionSample* samples, int count) {
+  for (int n = 0; n < count; n++) {
+    float t = n * kDt;
+    bool moving = (n / 2000) % 2 == 1;
+    float w = moving ? 1.5f * sinf(t * 3) : 0.01f;
+    float noise = (rand() % 1000 - 500) * 1e-5f;
+    MakeSample(noise, 9.81f + noise, -noise, w * 0.2f, w, noise, &samples[n]);
+  }
+}
+
+void Run(const char* name, bool gravity, bool yaw,
+         const FusionSample* samples, int count, int passes) {
+  FusionEngine engine;
+  engine.set_gravity_correction_enabled(gravity);
+  engine.set_yaw_correction_enabled(yaw);
+  uint64_t start = NowNanos();
+  for (int pass = 0; pass < passes; pass++) {
+    for (int n = 0; n < count; n++) {
+      engine.Update(samples[n]);
+    }
+  }
+  double elapsed = (double)(NowNanos() - start);
+  // Keep the result live.
+  const float* q = engine.orientation();
+  printf("  %-16s %6.1f ns/sample  (q.w %+.3f)\n",
+         name, elapsed / ((double)count * passes), q[3]);
+}
+
+}  // namespace
+
+
+int main(int argc, char** argv) {
+  printf("convergence:\n");
+  CheckGyroIntegration();
+  CheckTiltCorrection();
+  CheckYawCorrection();
+  printf("\n");
+
+  // Ten minutes at 1kHz.
+  const int kSampleCount = 600 * 1000;
+  const int kPasses = 5;
+  FusionSample* samples = new FusionSample[kSampleCount];
+  BuildMotion(samples, kSampleCount);
+
+  printf("update, %d samples x %d passes:\n", kSampleCount, kPasses);
+  Run("gyro", false, false, samples, kSampleCount, kPasses);
+  Run("gyro+gravity", true, false, samples, kSampleCount, kPasses);
+  Run("gyro+gravity+yaw", true, true, samples, kSampleCount, kPasses);
+
+  delete[] samples;
+  return BenchExitCode();
+}
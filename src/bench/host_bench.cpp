@@ -0,0 +1,856 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Stand-in browser for measuring the plugin end to end. Loads the built
+// plugin library, initializes it through NP_Initialize/NP_GetEntryPoints
+// with a host function table, brings instances up through NPP_New and
+// NPP_SetWindow, finds window._vr_native_ the way vr.js does, and calls
+// exec and poll on it through the object's NPClass as a page script would.
+// Everything between the call and the returned string is the real plugin:
+// NPObjectBase dispatch, VRObject, the writers and NPN_MemAlloc through
+// npn_gate.cpp.
+//
+// Prints a latency distribution per call for one instance and for many
+// instances polled in turn, and how a push subscription delivers to a page
+// that keeps up and to one that only gets to it once per frame. Then tears
+// everything down and checks that the plugin returned every allocation it
+// was handed. Exits non-zero if loading
+// or a check fails.
+//
+// As in a browser, every call is made on the thread that loaded the plugin;
+// many instances means many pages sharing one plugin, not parallel callers.
+// NPVR_PROVIDER defaults to synthetic so results do not depend on what is
+// plugged in.
+//
+// Usage: host_bench [plugin library] [instance count]
+
+#include <npvr.h>
+#include <bench/expect.h>
+#include <npvr/clock.h>
+#include <npvr/thread.h>
+
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#if defined(XP_WIN)
+#define PLUGIN_LIBRARY  "npvr.dll"
+#else
+#include <dlfcn.h>
+#if defined(XP_MACOSX)
+#define PLUGIN_LIBRARY  "npvr.plugin/Contents/MacOS/npvr"
+#else
+#define PLUGIN_LIBRARY  "./libnpvr.so"
+#endif  // XP_MACOSX
+#endif  // XP_WIN
+
+using namespace npvr;
+
+
+namespace {
+
+// Host bookkeeping, checked after teardown.
+int64_t g_live_allocations = 0;
+int64_t g_live_objects = 0;
+int g_forced_deallocations = 0;
+int g_exceptions = 0;
+
+
+// Identifiers are interned for the life of the process, so equal names give
+// equal pointers as NPAPI requires.
+struct HostIdentifier {
+  bool        is_string;
+  std::string name;
+  int32_t     value;
+};
+
+std::map<std::string, HostIdentifier*> g_string_identifiers;
+std::map<int32_t, HostIdentifier*> g_int_identifiers;
+
+
+void* HostMemAlloc(uint32_t size) {
+  g_live_allocations++;
+  return malloc(size);
+}
+
+void HostMemFree(void* ptr) {
+  if (ptr) {
+    g_live_allocations--;
+    free(ptr);
+  }
+}
+
+uint32_t HostMemFlush(uint32_t size) {
+  return 0;
+}
+
+NPIdentifier HostGetStringIdentifier(const NPUTF8* name) {
+  HostIdentifier*& identifier = g_string_identifiers[name];
+  if (!identifier) {
+    identifier = new HostIdentifier();
+    identifier->is_string = true;
+    identifier->name = name;
+    identifier->value = 0;
+  }
+  return identifier;
+}
+
+void HostGetStringIdentifiers(const NPUTF8** names, int32_t name_count,
+                              NPIdentifier* identifiers) {
+  for (int32_t n = 0; n < name_count; n++) {
+    identifiers[n] = HostGetStringIdentifier(names[n]);
+  }
+}
+
+NPIdentifier HostGetIntIdentifier(int32_t value) {
+  HostIdentifier*& identifier = g_int_identifiers[value];
+  if (!identifier) {
+    identifier = new HostIdentifier();
+    identifier->is_string = false;
+    identifier->value = value;
+  }
+  return identifier;
+}
+
+bool HostIdentifierIsString(NPIdentifier identifier) {
+  return ((HostIdentifier*)identifier)->is_string;
+}
+
+NPUTF8* HostUTF8FromIdentifier(NPIdentifier identifier) {
+  const std::string& name = ((HostIdentifier*)identifier)->name;
+  NPUTF8* result = (NPUTF8*)HostMemAlloc((uint32_t)name.size() + 1);
+  memcpy(result, name.c_str(), name.size() + 1);
+  return result;
+}
+
+int32_t HostIntFromIdentifier(NPIdentifier identifier) {
+  return ((HostIdentifier*)identifier)->value;
+}
+
+
+// Objects are tracked per instance so the ones the plugin still holds can be
+// invalidated and freed at NPP_Destroy, as browsers do.
+std::multimap<NPP, NPObject*> g_objects;
+
+NPObject* HostCreateObject(NPP npp, NPClass* np_class) {
+  NPObject* object = np_class->allocate ?
+      np_class->allocate(npp, np_class) :
+      (NPObject*)malloc(sizeof(NPObject));
+  object->_class = np_class;
+  object->referenceCount = 1;
+  g_objects.insert(std::make_pair(npp, object));
+  g_live_objects++;
+  return object;
+}
+
+void DeallocateObject(NPObject* object) {
+  g_live_objects--;
+  if (object->_class->deallocate) {
+    object->_class->deallocate(object);
+  } else {
+    free(object);
+  }
+}
+
+NPObject* HostRetainObject(NPObject* object) {
+  object->referenceCount++;
+  return object;
+}
+
+void HostReleaseObject(NPObject* object) {
+  if (--object->referenceCount) {
+    return;
+  }
+  for (std::multimap<NPP, NPObject*>::iterator it = g_objects.begin();
+       it != g_objects.end(); ++it) {
+    if (it->second == object) {
+      g_objects.erase(it);
+      break;
+    }
+  }
+  DeallocateObject(object);
+}
+
+void HostReleaseVariantValue(NPVariant* variant) {
+  if (NPVARIANT_IS_STRING(*variant)) {
+    HostMemFree((void*)NPVARIANT_TO_STRING(*variant).UTF8Characters);
+  } else if (NPVARIANT_IS_OBJECT(*variant)) {
+    HostReleaseObject(NPVARIANT_TO_OBJECT(*variant));
+  }
+  VOID_TO_NPVARIANT(*variant);
+}
+
+void DestroyInstanceObjects(NPP npp) {
+  std::pair<std::multimap<NPP, NPObject*>::iterator,
+            std::multimap<NPP, NPObject*>::iterator> range =
+      g_objects.equal_range(npp);
+  std::vector<NPObject*> objects;
+  for (std::multimap<NPP, NPObject*>::iterator it = range.first;
+       it != range.second; ++it) {
+    objects.push_back(it->second);
+  }
+  g_objects.erase(range.first, range.second);
+  for (size_t n = 0; n < objects.size(); n++) {
+    if (objects[n]->_class->invalidate) {
+      objects[n]->_class->invalidate(objects[n]);
+    }
+  }
+  for (size_t n = 0; n < objects.size(); n++) {
+    g_forced_deallocations++;
+    DeallocateObject(objects[n]);
+  }
+}
+
+
+bool HostInvoke(NPP npp, NPObject* object, NPIdentifier name,
+                const NPVariant* args, uint32_t arg_count,
+                NPVariant* result) {
+  return object->_class->invoke &&
+      object->_class->invoke(object, name, args, arg_count, result);
+}
+
+bool HostInvokeDefault(NPP npp, NPObject* object, const NPVariant* args,
+                       uint32_t arg_count, NPVariant* result) {
+  return object->_class->invokeDefault &&
+      object->_class->invokeDefault(object, args, arg_count, result);
+}
+
+bool HostGetProperty(NPP npp, NPObject* object, NPIdentifier name,
+                     NPVariant* result) {
+  return object->_class->getProperty &&
+      object->_class->getProperty(object, name, result);
+}
+
+bool HostSetProperty(NPP npp, NPObject* object, NPIdentifier name,
+                     const NPVariant* value) {
+  return object->_class->setProperty &&
+      object->_class->setProperty(object, name, value);
+}
+
+bool HostRemoveProperty(NPP npp, NPObject* object, NPIdentifier name) {
+  return object->_class->removeProperty &&
+      object->_class->removeProperty(object, name);
+}
+
+bool HostHasProperty(NPP npp, NPObject* object, NPIdentifier name) {
+  return object->_class->hasProperty &&
+      object->_class->hasProperty(object, name);
+}
+
+bool HostHasMethod(NPP npp, NPObject* object, NPIdentifier name) {
+  return object->_class->hasMethod &&
+      object->_class->hasMethod(object, name);
+}
+
+bool HostEnumerate(NPP npp, NPObject* object, NPIdentifier** identifiers,
+                   uint32_t* count) {
+  return object->_class->enumerate &&
+      object->_class->enumerate(object, identifiers, count);
+}
+
+void HostSetException(NPObject* object, const NPUTF8* message) {
+  printf("  exception: %s\n", message);
+  g_exceptions++;
+}
+
+
+// Calls made from plugin threads, run on the main thread between script
+// calls.
+struct AsyncCall {
+  NPP   npp;
+  void  (*function)(void*);
+  void* user_data;
+};
+
+Mutex g_async_lock;
+std::vector<AsyncCall> g_async_calls;
+
+void HostPluginThreadAsyncCall(NPP npp, void (*function)(void*),
+                               void* user_data) {
+  AsyncCall call = { npp, function, user_data };
+  MutexLock lock(&g_async_lock);
+  g_async_calls.push_back(call);
+}
+
+// Browsers drop the calls still queued for an instance when it is destroyed.
+void DropAsyncCalls(NPP npp) {
+  MutexLock lock(&g_async_lock);
+  std::vector<AsyncCall> calls;
+  for (size_t n = 0; n < g_async_calls.size(); n++) {
+    if (g_async_calls[n].npp != npp) {
+      calls.push_back(g_async_calls[n]);
+    }
+  }
+  calls.swap(g_async_calls);
+}
+
+void RunAsyncCalls() {
+  std::vector<AsyncCall> calls;
+  {
+    MutexLock lock(&g_async_lock);
+    calls.swap(g_async_calls);
+  }
+  for (size_t n = 0; n < calls.size(); n++) {
+    calls[n].function(calls[n].user_data);
+  }
+}
+
+
+// The page's window object: a property bag, which is all the plugin uses it
+// for.
+struct HostWindow : public NPObject {
+  std::map<NPIdentifier, NPVariant> properties;
+};
+
+NPObject* WindowAllocate(NPP npp, NPClass* np_class) {
+  return new HostWindow();
+}
+
+void WindowDeallocate(NPObject* object) {
+  HostWindow* window = (HostWindow*)object;
+  for (std::map<NPIdentifier, NPVariant>::iterator it =
+       window->properties.begin(); it != window->properties.end(); ++it) {
+    HostReleaseVariantValue(&it->second);
+  }
+  delete window;
+}
+
+bool WindowHasProperty(NPObject* object, NPIdentifier name) {
+  HostWindow* window = (HostWindow*)object;
+  return window->properties.count(name) != 0;
+}
+
+bool WindowGetProperty(NPObject* object, NPIdentifier name,
+                       NPVariant* result) {
+  HostWindow* window = (HostWindow*)object;
+  std::map<NPIdentifier, NPVariant>::iterator it =
+      window->properties.find(name);
+  if (it == window->properties.end()) {
+    VOID_TO_NPVARIANT(*result);
+    return false;
+  }
+  *result = it->second;
+  if (NPVARIANT_IS_OBJECT(*result)) {
+    HostRetainObject(NPVARIANT_TO_OBJECT(*result));
+  }
+  return true;
+}
+
+// Only objects and plain values; the plugin never stores strings.
+bool WindowSetProperty(NPObject* object, NPIdentifier name,
+                       const NPVariant* value) {
+  HostWindow* window = (HostWindow*)object;
+  if (NPVARIANT_IS_STRING(*value)) {
+    return false;
+  }
+  NPVariant& slot = window->properties[name];
+  HostReleaseVariantValue(&slot);
+  slot = *value;
+  if (NPVARIANT_IS_OBJECT(slot)) {
+    HostRetainObject(NPVARIANT_TO_OBJECT(slot));
+  }
+  return true;
+}
+
+NPClass g_window_class = {
+  NP_CLASS_STRUCT_VERSION,
+  WindowAllocate,
+  WindowDeallocate,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  WindowHasProperty,
+  WindowGetProperty,
+  WindowSetProperty,
+  NULL,
+  NULL,
+  NULL,
+};
+
+// A page function that records when it was called and what it was passed.
+struct HostFunction : public NPObject {
+  std::vector<uint64_t> call_nanos;
+  uint64_t              argument_bytes;
+};
+
+NPObject* FunctionAllocate(NPP npp, NPClass* np_class) {
+  HostFunction* function = new HostFunction();
+  function->argument_bytes = 0;
+  return function;
+}
+
+void FunctionDeallocate(NPObject* object) {
+  delete (HostFunction*)object;
+}
+
+bool FunctionInvokeDefault(NPObject* object, const NPVariant* args,
+                           uint32_t arg_count, NPVariant* result) {
+  HostFunction* function = (HostFunction*)object;
+  function->call_nanos.push_back(NowNanos());
+  if (arg_count >= 1 && NPVARIANT_IS_STRING(args[0])) {
+    function->argument_bytes += NPVARIANT_TO_STRING(args[0]).UTF8Length;
+  }
+  VOID_TO_NPVARIANT(*result);
+  return true;
+}
+
+NPClass g_function_class = {
+  NP_CLASS_STRUCT_VERSION,
+  FunctionAllocate,
+  FunctionDeallocate,
+  NULL,
+  NULL,
+  NULL,
+  FunctionInvokeDefault,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+};
+
+// One window per instance, owned by the host; ndata points at it.
+struct HostInstance {
+  NPP_t       npp;
+  NPWindow    np_window;
+  NPObject*   window;
+  NPObject*   vr;
+};
+
+NPError HostGetValue(NPP npp, NPNVariable variable, void* value) {
+  switch (variable) {
+  case NPNVWindowNPObject:
+    *(NPObject**)value =
+        HostRetainObject(((HostInstance*)npp->ndata)->window);
+    return NPERR_NO_ERROR;
+  case NPNVSupportsWindowless:
+    *(NPBool*)value = true;
+    return NPERR_NO_ERROR;
+  default:
+    return NPERR_GENERIC_ERROR;
+  }
+}
+
+NPError HostSetValue(NPP npp, NPPVariable variable, void* value) {
+  return NPERR_NO_ERROR;
+}
+
+const char* HostUserAgent(NPP npp) {
+  return "npvr host_bench";
+}
+
+void InitializeHostFunctions(NPNetscapeFuncs* funcs) {
+  memset(funcs, 0, sizeof(*funcs));
+  funcs->size = sizeof(*funcs);
+  funcs->version = (NP_VERSION_MAJOR << 8) | NP_VERSION_MINOR;
+  funcs->uagent = HostUserAgent;
+  funcs->memalloc = HostMemAlloc;
+  funcs->memfree = HostMemFree;
+  funcs->memflush = HostMemFlush;
+  funcs->getvalue = HostGetValue;
+  funcs->setvalue = HostSetValue;
+  funcs->getstringidentifier = HostGetStringIdentifier;
+  funcs->getstringidentifiers = HostGetStringIdentifiers;
+  funcs->getintidentifier = HostGetIntIdentifier;
+  funcs->identifierisstring = HostIdentifierIsString;
+  funcs->utf8fromidentifier = HostUTF8FromIdentifier;
+  funcs->intfromidentifier = HostIntFromIdentifier;
+  funcs->createobject = HostCreateObject;
+  funcs->retainobject = HostRetainObject;
+  funcs->releaseobject = HostReleaseObject;
+  funcs->invoke = HostInvoke;
+  funcs->invokeDefault = HostInvokeDefault;
+  funcs->getproperty = HostGetProperty;
+  funcs->setproperty = HostSetProperty;
+  funcs->removeproperty = HostRemoveProperty;
+  funcs->hasproperty = HostHasProperty;
+  funcs->hasmethod = HostHasMethod;
+  funcs->enumerate = HostEnumerate;
+  funcs->releasevariantvalue = HostReleaseVariantValue;
+  funcs->setexception = HostSetException;
+  funcs->pluginthreadasynccall = HostPluginThreadAsyncCall;
+}
+
+
+// The loaded plugin module.
+class PluginLibrary {
+public:
+  PluginLibrary() : handle_(NULL) {
+    memset(&funcs_, 0, sizeof(funcs_));
+    funcs_.size = sizeof(funcs_);
+  }
+
+  bool Load(const char* path, NPNetscapeFuncs* host_funcs) {
+#if defined(XP_WIN)
+    handle_ = LoadLibraryA(path);
+#else
+    handle_ = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+#endif  // XP_WIN
+    if (!handle_) {
+      return false;
+    }
+#if defined(XP_UNIX) && !defined(XP_MACOSX)
+    NP_InitializeFunc initialize =
+        (NP_InitializeFunc)Symbol("NP_Initialize");
+    return initialize &&
+        initialize(host_funcs, &funcs_) == NPERR_NO_ERROR;
+#else
+    NP_InitializeFunc initialize =
+        (NP_InitializeFunc)Symbol("NP_Initialize");
+    NP_GetEntryPointsFunc get_entry_points =
+        (NP_GetEntryPointsFunc)Symbol("NP_GetEntryPoints");
+    return initialize && get_entry_points &&
+        initialize(host_funcs) == NPERR_NO_ERROR &&
+        get_entry_points(&funcs_) == NPERR_NO_ERROR;
+#endif  // XP_UNIX && !XP_MACOSX
+  }
+
+  void Unload() {
+    if (!handle_) {
+      return;
+    }
+    NP_ShutdownFunc shutdown = (NP_ShutdownFunc)Symbol("NP_Shutdown");
+    if (shutdown) {
+      shutdown();
+    }
+#if defined(XP_WIN)
+    FreeLibrary((HMODULE)handle_);
+#else
+    dlclose(handle_);
+#endif  // XP_WIN
+    handle_ = NULL;
+  }
+
+  const NPPluginFuncs& funcs() const { return funcs_; }
+
+private:
+  void* Symbol(const char* name) {
+#if defined(XP_WIN)
+    return (void*)GetProcAddress((HMODULE)handle_, name);
+#else
+    return dlsym(handle_, name);
+#endif  // XP_WIN
+  }
+
+  void*         handle_;
+  NPPluginFuncs funcs_;
+};
+
+
+bool CreateInstance(const PluginLibrary& plugin, HostInstance* instance) {
+  memset(&instance->npp, 0, sizeof(instance->npp));
+  memset(&instance->np_window, 0, sizeof(instance->np_window));
+  instance->npp.ndata = instance;
+  instance->window = HostCreateObject(NULL, &g_window_class);
+  instance->vr = NULL;
+
+  char mime_type[] = "application/x-vnd-vr";
+  if (plugin.funcs().newp(mime_type, &instance->npp, NP_EMBED, 0, NULL, NULL,
+                          NULL) != NPERR_NO_ERROR) {
+    return false;
+  }
+  instance->np_window.width = 1;
+  instance->np_window.height = 1;
+  instance->np_window.type = NPWindowTypeDrawable;
+  if (plugin.funcs().setwindow(&instance->npp, &instance->np_window) !=
+      NPERR_NO_ERROR) {
+    return false;
+  }
+
+  NPVariant vr;
+  if (!HostGetProperty(&instance->npp, instance->window,
+                       HostGetStringIdentifier("_vr_native_"), &vr) ||
+      !NPVARIANT_IS_OBJECT(vr)) {
+    return false;
+  }
+  instance->vr = NPVARIANT_TO_OBJECT(vr);
+  return true;
+}
+
+void DestroyInstance(const PluginLibrary& plugin, HostInstance* instance) {
+  if (instance->vr) {
+    HostReleaseObject(instance->vr);
+    instance->vr = NULL;
+  }
+  DropAsyncCalls(&instance->npp);
+  NPSavedData* saved = NULL;
+  plugin.funcs().destroy(&instance->npp, &saved);
+  HostReleaseObject(instance->window);
+  DestroyInstanceObjects(&instance->npp);
+}
+
+
+// A script call: the method and the arguments it is made with.
+struct Call {
+  const char* name;
+  const char* method;
+  NPVariant   args[6];
+  uint32_t    arg_count;
+};
+
+Call MakeExec(const char* name, int32_t command_id) {
+  Call call;
+  call.name = name;
+  call.method = "exec";
+  INT32_TO_NPVARIANT(command_id, call.args[0]);
+  STRINGZ_TO_NPVARIANT("", call.args[1]);
+  call.arg_count = 2;
+  return call;
+}
+
+// The commands of a page bringing its HMD state up to date, in one call.
+Call MakeExecBatch(const char* name) {
+  Call call;
+  call.name = name;
+  call.method = "execBatch";
+  INT32_TO_NPVARIANT(0x0003, call.args[0]);
+  STRINGZ_TO_NPVARIANT("", call.args[1]);
+  INT32_TO_NPVARIANT(0x0001, call.args[2]);
+  STRINGZ_TO_NPVARIANT("", call.args[3]);
+  INT32_TO_NPVARIANT(0x0004, call.args[4]);
+  STRINGZ_TO_NPVARIANT("", call.args[5]);
+  call.arg_count = 6;
+  return call;
+}
+
+Call MakePoll(const char* name, int32_t format, double prediction_ms,
+              int32_t poll_flags) {
+  Call call;
+  call.name = name;
+  call.method = "poll";
+  INT32_TO_NPVARIANT(format, call.args[0]);
+  DOUBLE_TO_NPVARIANT(prediction_ms, call.args[1]);
+  INT32_TO_NPVARIANT(poll_flags, call.args[2]);
+  call.arg_count = 3;
+  return call;
+}
+
+const int kCallsPerRun = 20000;
+
+// Makes kCallsPerRun calls spread over the instances in turn and prints the
+// distribution of single call latencies.
+void RunCalls(const Call& call, std::vector<HostInstance*>& instances) {
+  NPIdentifier method = HostGetStringIdentifier(call.method);
+  std::vector<uint64_t> nanos(kCallsPerRun);
+  int failures = 0;
+  for (int n = -kCallsPerRun / 10; n < kCallsPerRun; n++) {
+    HostInstance* instance = instances[(n + kCallsPerRun) % instances.size()];
+    NPVariant result;
+    VOID_TO_NPVARIANT(result);
+    uint64_t start = NowNanos();
+    bool ok = HostInvoke(&instance->npp, instance->vr, method, call.args,
+                         call.arg_count, &result);
+    uint64_t elapsed = NowNanos() - start;
+    HostReleaseVariantValue(&result);
+    RunAsyncCalls();
+    // The first tenth warms caches and is not recorded.
+    if (n >= 0) {
+      nanos[n] = elapsed;
+      failures += ok ? 0 : 1;
+    }
+  }
+
+  std::sort(nanos.begin(), nanos.end());
+  double total = 0;
+  for (int n = 0; n < kCallsPerRun; n++) {
+    total += nanos[n];
+  }
+  printf("  %-26s %8.0f %8llu %8llu %8llu %8llu %9llu\n", call.name,
+         total / kCallsPerRun,
+         (unsigned long long)nanos[kCallsPerRun / 2],
+         (unsigned long long)nanos[kCallsPerRun * 90 / 100],
+         (unsigned long long)nanos[kCallsPerRun * 99 / 100],
+         (unsigned long long)nanos[kCallsPerRun * 999 / 1000],
+         (unsigned long long)nanos[kCallsPerRun - 1]);
+  if (failures) {
+    printf("  %d calls failed\n", failures);
+    BenchFailures()++;
+  }
+}
+
+void RunSuite(std::vector<HostInstance*>& instances) {
+  const Call kCalls[] = {
+    MakeExec("exec/query_readiness", 0x0003),
+    MakeExec("exec/query_hmd_info", 0x0001),
+    MakeExecBatch("execBatch/3 commands"),
+    MakePoll("poll/text", 0, 0, 0),
+    MakePoll("poll/text/predict+history", 0, 20, 1),
+    MakePoll("poll/binary", 1, 0, 0),
+    MakePoll("poll/binary/predict+history", 1, 20, 1),
+  };
+  printf("  %-26s %8s %8s %8s %8s %8s %9s\n", "ns", "mean", "p50", "p90",
+         "p99", "p99.9", "max");
+  for (size_t n = 0; n < sizeof(kCalls) / sizeof(kCalls[0]); n++) {
+    RunCalls(kCalls[n], instances);
+  }
+}
+
+// Subscribes at rate and runs the main thread for a second, running async
+// calls every frame_micros (as often as possible if zero), and prints how
+// the deliveries were spaced.
+void RunSubscription(HostInstance* instance, const char* name, double rate,
+                     uint32_t frame_micros) {
+  NPObject* callback = HostCreateObject(&instance->npp, &g_function_class);
+  HostFunction* function = (HostFunction*)callback;
+  NPVariant args[3];
+  OBJECT_TO_NPVARIANT(callback, args[0]);
+  DOUBLE_TO_NPVARIANT(rate, args[1]);
+  // Sixense history, so samples between deliveries are not lost.
+  INT32_TO_NPVARIANT(1, args[2]);
+  NPVariant result;
+  VOID_TO_NPVARIANT(result);
+  if (!HostInvoke(&instance->npp, instance->vr,
+                  HostGetStringIdentifier("subscribe"), args, 3, &result)) {
+    printf("  %-26s subscribe failed\n", name);
+    BenchFailures()++;
+    HostReleaseObject(callback);
+    return;
+  }
+  HostReleaseVariantValue(&result);
+
+  uint64_t start = NowNanos();
+  while (NowNanos() - start < 1000000000ull) {
+    RunAsyncCalls();
+    SleepMicros(frame_micros ? frame_micros : 100);
+  }
+  HostInvoke(&instance->npp, instance->vr,
+             HostGetStringIdentifier("unsubscribe"), NULL, 0, &result);
+  HostReleaseVariantValue(&result);
+  RunAsyncCalls();
+
+  std::vector<uint64_t> intervals;
+  for (size_t n = 1; n < function->call_nanos.size(); n++) {
+    intervals.push_back(function->call_nanos[n] - function->call_nanos[n - 1]);
+  }
+  std::sort(intervals.begin(), intervals.end());
+  size_t count = function->call_nanos.size();
+  if (intervals.empty()) {
+    printf("  %-26s %8d deliveries\n", name, (int)count);
+    BenchFailures()++;
+  } else {
+    printf("  %-26s %8d %8.0f %8.0f %8.0f %8.0f\n", name, (int)count,
+           (double)function->argument_bytes / count,
+           intervals[intervals.size() / 2] / 1000.0,
+           intervals[intervals.size() * 99 / 100] / 1000.0,
+           intervals.back() / 1000.0);
+  }
+  HostReleaseObject(callback);
+}
+
+}  // namespace
+
+
+int main(int argc, char** argv) {
+  const char* path = argc > 1 ? argv[1] : PLUGIN_LIBRARY;
+  int instance_count = argc > 2 ? atoi(argv[2]) : 16;
+  if (instance_count < 1) {
+    instance_count = 1;
+  }
+
+  if (!getenv("NPVR_PROVIDER")) {
+#if defined(XP_WIN)
+    _putenv("NPVR_PROVIDER=synthetic");
+#else
+    setenv("NPVR_PROVIDER", "synthetic", 0);
+#endif  // XP_WIN
+  }
+
+  NPNetscapeFuncs host_funcs;
+  InitializeHostFunctions(&host_funcs);
+  PluginLibrary plugin;
+  if (!plugin.Load(path, &host_funcs)) {
+    printf("unable to load %s\n", path);
+    return 1;
+  }
+
+  std::vector<HostInstance*> instances(instance_count);
+  for (int n = 0; n < instance_count; n++) {
+    instances[n] = new HostInstance();
+    if (!CreateInstance(plugin, instances[n])) {
+      printf("unable to create instance %d\n", n);
+      return 1;
+    }
+  }
+
+  // Let device bring-up finish so polls return data rather than nothing.
+  uint64_t start = NowNanos();
+  NPIdentifier exec_id = HostGetStringIdentifier("exec");
+  Call readiness = MakeExec("", 0x0003);
+  while (NowNanos() - start < 2000000000ull) {
+    NPVariant result;
+    VOID_TO_NPVARIANT(result);
+    HostInvoke(&instances[0]->npp, instances[0]->vr, exec_id, readiness.args,
+               readiness.arg_count, &result);
+    bool ready = NPVARIANT_IS_STRING(result) &&
+        NPVARIANT_TO_STRING(result).UTF8Length == 1 &&
+        NPVARIANT_TO_STRING(result).UTF8Characters[0] == '1';
+    HostReleaseVariantValue(&result);
+    RunAsyncCalls();
+    if (ready) {
+      break;
+    }
+    SleepMicros(1000);
+  }
+
+  std::vector<HostInstance*> first(1, instances[0]);
+  printf("1 instance:\n");
+  RunSuite(first);
+  printf("\n%d instances, polled in turn:\n", instance_count);
+  RunSuite(instances);
+  printf("\n");
+
+  printf("push subscription, 1 second:\n");
+  printf("  %-26s %8s %8s %8s %8s %8s\n", "interval us", "count",
+         "bytes", "p50", "p99", "max");
+  RunSubscription(instances[0], "500Hz", 500, 0);
+  RunSubscription(instances[0], "500Hz, page at 60Hz", 500, 16667);
+  printf("\n");
+
+  // What the plugin's own tracing saw over the most recent polls.
+  Call latency = MakeExec("", 0x0005);
+  NPVariant result;
+  VOID_TO_NPVARIANT(result);
+  HostInvoke(&instances[0]->npp, instances[0]->vr, exec_id, latency.args,
+             latency.arg_count, &result);
+  if (NPVARIANT_IS_STRING(result)) {
+    std::string report(NPVARIANT_TO_STRING(result).UTF8Characters,
+                       NPVARIANT_TO_STRING(result).UTF8Length);
+    std::replace(report.begin(), report.end(), '|', '\n');
+    printf("latency trace, us (stage,p50,p90,p99,max):\n%s\n",
+           report.c_str());
+  }
+  HostReleaseVariantValue(&result);
+
+  for (int n = 0; n < instance_count; n++) {
+    DestroyInstance(plugin, instances[n]);
+    delete instances[n];
+  }
+  plugin.Unload();
+
+  printf("teardown:\n");
+  Expect(g_live_allocations == 0, "NPN_MemAlloc blocks not freed",
+         (double)g_live_allocations);
+  Expect(g_live_objects == 0, "objects alive", (double)g_live_objects);
+  Expect(g_exceptions == 0, "exceptions set", g_exceptions);
+  printf("  %-40s %12d\n", "objects freed at NPP_Destroy",
+         g_forced_deallocations);
+
+  return BenchExitCode();
+}
@@ -0,0 +1,875 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Microbenchmark suite for the per-frame plugin path. Drives a real VRObject
+// through its NPAPI entry points (exec and poll in each format) against stub
+// device providers, alongside the serialization and fusion pieces on their
+// own, and prints ns/op and allocations/op for each. Before timing anything
+// it runs each exec and poll once and checks what comes back, and exits
+// non-zero if any check fails.
+//
+// ns/op is the median of several timed runs, each long enough to swamp timer
+// resolution, with the spread across runs printed beside it; a spread above
+// a few percent means the machine was too noisy for the figure to be trusted.
+// Allocations count operator new and NPN_MemAlloc. A poll should cost exactly
+// one: the string handed back to the browser.
+//
+// Pass a substring to run only the benchmarks whose names contain it.
+
+#include <npvr.h>
+#include <bench/expect.h>
+#include <npvr/binary_writer.h>
+#include <npvr/clock.h>
+#include <npvr/distortion.h>
+#include <npvr/fusion_engine.h>
+#include <npvr/provider_factory.h>
+#include <npvr/text_writer.h>
+#include <npvr/vr_object.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace npvr;
+
+
+namespace {
+
+uint64_t g_allocations = 0;
+
+}  // namespace
+
+
+void* operator new(size_t size) {
+  g_allocations++;
+  void* ptr = malloc(size ? size : 1);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* ptr) throw() {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) throw() {
+  free(ptr);
+}
+
+
+// Stand-ins for the browser. Identifiers are interned names, so equal
+// strings give equal pointers as NPAPI requires.
+void* NPN_MemAlloc(uint32_t size) {
+  g_allocations++;
+  return malloc(size);
+}
+
+void NPN_MemFree(void* ptr) {
+  free(ptr);
+}
+
+NPIdentifier NPN_GetStringIdentifier(const NPUTF8* name) {
+  static const char* names[16];
+  static int name_count = 0;
+  for (int n = 0; n < name_count; n++) {
+    if (!strcmp(names[n], name)) {
+      return (NPIdentifier)names[n];
+    }
+  }
+  names[name_count] = strdup(name);
+  return (NPIdentifier)names[name_count++];
+}
+
+// Subscriptions are not benchmarked here; host_bench drives them.
+NPObject* NPN_RetainObject(NPObject* object) {
+  return object;
+}
+
+void NPN_ReleaseObject(NPObject* object) {
+}
+
+bool NPN_InvokeDefault(NPP npp, NPObject* object, const NPVariant* args,
+                       uint32_t arg_count, NPVariant* result) {
+  return false;
+}
+
+void NPN_ReleaseVariantValue(NPVariant* variant) {
+}
+
+bool NPN_HasPluginThreadAsyncCall() {
+  return true;
+}
+
+void NPN_PluginThreadAsyncCall(NPP npp, void (*function)(void*),
+                               void* user_data) {
+}
+
+
+namespace {
+
+// A still-ish HMD with fixed rates, so prediction does the same work every
+// call.
+class StubHmdProvider : public HmdProvider {
+public:
+  StubHmdProvider() {
+    snapshot_.timestamp = 0;
+    snapshot_.orientation = OVR::Quatf(0.0012345f, -0.3826834f, 0.0f,
+                                       0.9238795f);
+    snapshot_.angular_velocity = OVR::Vector3f(0.1f, 1.2f, -0.05f);
+    snapshot_.angular_acceleration = OVR::Vector3f(0.5f, -2.0f, 0.1f);
+    snapshot_.acceleration = OVR::Vector3f(0.0f, 9.81f, 0.0f);
+    // Stamped so that polls pay for latency tracing as they would live.
+    snapshot_.sample_nanos = NowNanos();
+    snapshot_.fusion_nanos = snapshot_.sample_nanos;
+    snapshot_.publish_nanos = snapshot_.sample_nanos;
+  }
+
+  virtual void Acquire() {}
+  virtual void Release() {}
+  virtual bool IsReady() const { return true; }
+  virtual bool DevicePresent() const { return true; }
+  virtual uint32_t connection_generation() const { return 1; }
+  virtual bool GetDeviceInfo(OVR::HMDInfo* out_info) const {
+    strcpy(out_info->ProductName, "Oculus Rift DK1");
+    strcpy(out_info->Manufacturer, "Oculus VR, Inc.");
+    SetDefaultHmdInfo(out_info);
+    return true;
+  }
+  virtual bool GetSnapshot(HmdSnapshot* out_snapshot) const {
+    *out_snapshot = snapshot_;
+    return true;
+  }
+  virtual OVR::Quatf PredictOrientation(const HmdSnapshot& snapshot,
+                                        float interval) const {
+    return ExtrapolateSnapshot(snapshot, interval);
+  }
+  virtual void ResetOrientation() {}
+  virtual FusionMode fusion_mode() const { return kFusionModeSdk; }
+  virtual void SetFusionMode(FusionMode mode) {}
+
+private:
+  HmdSnapshot snapshot_;
+};
+
+// Reports controller_count controllers and, when asked, history_per_poll
+// history frames, all moving a little every call unless idle.
+class StubControllerProvider : public ControllerProvider {
+public:
+  StubControllerProvider() :
+      controller_count(2),
+      history_per_poll(0),
+      idle(false),
+      tick_(0) {
+  }
+
+  virtual void Acquire() {}
+  virtual void Release() {}
+  virtual bool IsReady() const { return true; }
+  virtual bool IsAvailable() const { return true; }
+  virtual void Gather(bool include_history, ControllerCursor* cursor,
+                      SixensePoll* poll) {
+    tick_++;
+    poll->base_count = 0;
+    poll->controller_count = 0;
+    poll->history_count = 0;
+    for (int n = 0; n < controller_count; n++) {
+      SixenseFrame& frame = poll->controllers[poll->controller_count++];
+      MakeFrame(n, tick_, idle ? 0 : tick_, &frame);
+      if (!frame.controller) {
+        poll->bases[poll->base_count++] = frame.base;
+      }
+    }
+    if (include_history) {
+      for (int n = 0; n < history_per_poll; n++) {
+        uint32_t tick = tick_ - n / controller_count;
+        MakeFrame(n % controller_count, tick, idle ? 0 : tick,
+                  &poll->history[poll->history_count++]);
+      }
+    }
+  }
+
+  int controller_count;
+  int history_per_poll;
+  // Every frame holds the same pose, as docked controllers do, though the
+  // sequence numbers still advance.
+  bool idle;
+
+private:
+  static void MakeFrame(int n, uint32_t sequence, uint32_t tick,
+                        SixenseFrame* out) {
+    float t = tick * 0.001f;
+    memset(out, 0, sizeof(*out));
+    out->base = (uint8_t)(n / kMaxSixenseControllers);
+    out->controller = (uint8_t)(n % kMaxSixenseControllers);
+    out->sequence = (uint8_t)sequence;
+    out->flags = kSixenseFrameFlagHemiTracking;
+    out->hand = (uint8_t)(1 + n % 2);
+    out->position[0] = -103.52f + t * (n + 1);
+    out->position[1] = 251.0967f - t;
+    out->position[2] = -315.6f + t * 0.5f;
+    out->rotation[0] = 0.0192832f + t * 0.01f;
+    out->rotation[1] = -0.707106f;
+    out->rotation[2] = 0.12345679f - t * 0.01f;
+    out->rotation[3] = 0.696539f;
+    out->joystick[0] = n ? 0.0f : 0.25f;
+    out->trigger = (tick % 100) / 100.0f;
+    out->buttons = (tick & 1) ? 0x20 : 0;
+  }
+
+  uint32_t tick_;
+};
+
+StubHmdProvider g_hmd;
+StubControllerProvider g_controllers;
+
+}  // namespace
+
+
+// The bench links these in place of provider_factory.cpp, so VRObject runs
+// against the stubs and no SDK is touched.
+HmdProvider* npvr::GetHmdProvider() {
+  return &g_hmd;
+}
+
+ControllerProvider* npvr::GetControllerProvider() {
+  return &g_controllers;
+}
+
+
+namespace {
+
+// Canned values in the shape of sixenseControllerData.
+struct Controller {
+  float pos[3];
+  float rot_quat[4];
+  float joystick_x;
+  float joystick_y;
+  float trigger;
+  unsigned int buttons;
+  unsigned char is_docked;
+  unsigned char which_hand;
+  unsigned char hemi_tracking_enabled;
+};
+
+struct PollData {
+  Controller controllers[2];
+  float orientation[4];
+};
+
+// Perturbs the values each poll so neither path sees identical input.
+void Jitter(PollData& data, int n) {
+  float t = n * 0.001f;
+  for (int c = 0; c < 2; c++) {
+    Controller& cd = data.controllers[c];
+    cd.pos[0] = -103.52f + t * (c + 1);
+    cd.pos[1] = 251.0967f - t;
+    cd.pos[2] = -315.6f + t * 0.5f;
+    cd.rot_quat[0] = 0.0192832f + t * 0.01f;
+    cd.rot_quat[1] = -0.707106f;
+    cd.rot_quat[2] = 0.12345679f - t * 0.01f;
+    cd.rot_quat[3] = 0.696539f;
+    cd.joystick_x = c ? 0.0f : 0.25f;
+    cd.joystick_y = 0.0f;
+    cd.trigger = (n % 100) / 100.0f;
+    cd.buttons = (n & 1) ? 0x20 : 0;
+    cd.is_docked = 0;
+    cd.which_hand = (unsigned char)(c + 1);
+    cd.hemi_tracking_enabled = 1;
+  }
+  data.orientation[0] = 0.0012345f + t * 0.001f;
+  data.orientation[1] = -0.3826834f;
+  data.orientation[2] = 0.0f;
+  data.orientation[3] = 0.9238795f;
+}
+
+// The serialization VRObject::InvokePoll did before TextWriter.
+char* PollOStringStream(const PollData& data) {
+  std::ostringstream s;
+  s << "s,";
+  s << "b," << 0 << ",";
+  for (int cont = 0; cont < 2; cont++) {
+    const Controller& cd = data.controllers[cont];
+    s << "c," << cont << ",";
+    s << cd.pos[0] << ",";
+    s << cd.pos[1] << ",";
+    s << cd.pos[2] << ",";
+    s << cd.rot_quat[0] << ",";
+    s << cd.rot_quat[1] << ",";
+    s << cd.rot_quat[2] << ",";
+    s << cd.rot_quat[3] << ",";
+    s << cd.joystick_x << ",";
+    s << cd.joystick_y << ",";
+    s << cd.trigger << ",";
+    s << cd.buttons << ",";
+    s << (cd.is_docked ? "1," : "0,");
+    s << (int)cd.which_hand << ",";
+    s << (int)cd.hemi_tracking_enabled << ",";
+  }
+  s << "|";
+  s << "r,";
+  s << data.orientation[0] << "," << data.orientation[1] << ",";
+  s << data.orientation[2] << "," << data.orientation[3];
+  s << "|";
+
+  std::string s_value = s.str();
+  size_t s_len = s_value.length();
+  char* ret_str = (char*)NPN_MemAlloc(s_len + 1);
+  strcpy(ret_str, s_value.c_str());
+  return ret_str;
+}
+
+// The serialization VRObject::InvokePoll does now.
+char* PollTextWriter(TextWriter& s, const PollData& data) {
+  s.Reset();
+  s << "s,";
+  s << "b," << 0 << ",";
+  for (int cont = 0; cont < 2; cont++) {
+    const Controller& cd = data.controllers[cont];
+    s << "c," << cont << ",";
+    s << cd.pos[0] << ",";
+    s << cd.pos[1] << ",";
+    s << cd.pos[2] << ",";
+    s << cd.rot_quat[0] << ",";
+    s << cd.rot_quat[1] << ",";
+    s << cd.rot_quat[2] << ",";
+    s << cd.rot_quat[3] << ",";
+    s << cd.joystick_x << ",";
+    s << cd.joystick_y << ",";
+    s << cd.trigger << ",";
+    s << cd.buttons << ",";
+    s << (cd.is_docked ? "1," : "0,");
+    s << (int32_t)cd.which_hand << ",";
+    s << (int32_t)cd.hemi_tracking_enabled << ",";
+  }
+  s << "|";
+  s << "r,";
+  s << data.orientation[0] << "," << data.orientation[1] << ",";
+  s << data.orientation[2] << "," << data.orientation[3];
+  s << "|";
+
+  NPVariant result;
+  s.ToNPVariant(&result);
+  return (char*)NPVARIANT_TO_STRING(result).UTF8Characters;
+}
+
+// Runs one operation per call.
+typedef void (*BenchFunction)();
+
+VRObject* g_object = NULL;
+NPIdentifier g_exec_id = NULL;
+NPIdentifier g_exec_batch_id = NULL;
+NPIdentifier g_poll_id = NULL;
+
+// Set while checking results, so that the last call's result is kept in
+// g_result. Timed runs do not keep it, as that would allocate.
+bool g_keep_result = false;
+std::string g_result;
+
+void FreeResult(NPVariant& result) {
+  if (g_keep_result) {
+    g_result.clear();
+    if (NPVARIANT_IS_STRING(result)) {
+      g_result.assign(NPVARIANT_TO_STRING(result).UTF8Characters,
+                      NPVARIANT_TO_STRING(result).UTF8Length);
+    }
+  }
+  if (NPVARIANT_IS_STRING(result)) {
+    NPN_MemFree((void*)NPVARIANT_TO_STRING(result).UTF8Characters);
+  }
+}
+
+void Exec(int32_t command_id, const char* command_str) {
+  NPVariant args[2];
+  INT32_TO_NPVARIANT(command_id, args[0]);
+  STRINGZ_TO_NPVARIANT(command_str, args[1]);
+  NPVariant result;
+  VOID_TO_NPVARIANT(result);
+  g_object->Invoke(g_exec_id, args, 2, &result);
+  FreeResult(result);
+}
+
+// Returns the generation of a binary delta record, or zero.
+uint32_t Poll(int32_t format, double prediction_ms, uint32_t poll_flags,
+              uint32_t since_generation = 0) {
+  NPVariant args[4];
+  INT32_TO_NPVARIANT(format, args[0]);
+  DOUBLE_TO_NPVARIANT(prediction_ms, args[1]);
+  INT32_TO_NPVARIANT((int32_t)poll_flags, args[2]);
+  DOUBLE_TO_NPVARIANT(since_generation, args[3]);
+  NPVariant result;
+  VOID_TO_NPVARIANT(result);
+  g_object->Invoke(g_poll_id, args, 4, &result);
+  uint32_t generation = 0;
+  if (format == 1 && NPVARIANT_IS_STRING(result) &&
+      NPVARIANT_TO_STRING(result).UTF8Length >= 16) {
+    // Each record byte is two UTF-8 bytes; see BinaryWriter::Encode.
+    const uint8_t* p =
+        (const uint8_t*)NPVARIANT_TO_STRING(result).UTF8Characters;
+    uint8_t bytes[8];
+    for (int n = 0; n < 8; n++) {
+      bytes[n] = (uint8_t)(((p[n * 2] & 0x03) << 6) | (p[n * 2 + 1] & 0x3F));
+    }
+    if (bytes[1] & kBinaryPollFlagDelta) {
+      generation = bytes[4] | (bytes[5] << 8) | (bytes[6] << 16) |
+          ((uint32_t)bytes[7] << 24);
+    }
+  }
+  FreeResult(result);
+  return generation;
+}
+
+void SetControllers(int controller_count, int history_per_poll) {
+  g_controllers.controller_count = controller_count;
+  g_controllers.history_per_poll = history_per_poll;
+  g_controllers.idle = false;
+}
+
+void BenchExecQueryHmdInfo() {
+  Exec(0x0001, "");
+}
+
+void BenchExecQueryHmdInfoUnchanged() {
+  // The stub HMD is always connection generation 1.
+  Exec(0x0001, "1");
+}
+
+void BenchExecQueryReadiness() {
+  Exec(0x0003, "");
+}
+
+void BenchExecQueryStereoParams() {
+  // The same key every call, as when several renderers share a page.
+  Exec(0x0009, "0,0.01,1000");
+}
+
+void BenchExecQueryStereoParamsChanged() {
+  // Alternates the IPD so that every call recomputes.
+  static bool odd = false;
+  odd = !odd;
+  Exec(0x0009, odd ? "0.064,0.01,1000" : "0.065,0.01,1000");
+}
+
+// 64 radii or 32 points spread across the eye, about what a page maps when
+// picking against a few UI elements.
+std::string g_distort_radii_command;
+std::string g_undistort_radii_command;
+std::string g_unwarp_points_command;
+
+void BuildDistortionCommands() {
+  char value[32];
+  g_distort_radii_command = "0";
+  g_undistort_radii_command = "1";
+  for (int n = 0; n < 64; n++) {
+    sprintf(value, ",%g", n / 40.0);
+    g_distort_radii_command += value;
+    g_undistort_radii_command += value;
+  }
+  g_unwarp_points_command = "0,1";
+  for (int n = 0; n < 32; n++) {
+    sprintf(value, ",%g,%g", (n % 8) / 16.0, (n / 8) / 4.0);
+    g_unwarp_points_command += value;
+  }
+}
+
+void BenchExecDistortRadii() {
+  Exec(0x000A, g_distort_radii_command.c_str());
+}
+
+void BenchExecUndistortRadii() {
+  Exec(0x000A, g_undistort_radii_command.c_str());
+}
+
+void BenchExecUnwarpPoints() {
+  Exec(0x000B, g_unwarp_points_command.c_str());
+}
+
+void BenchExecBatch() {
+  NPVariant args[6];
+  INT32_TO_NPVARIANT(0x0003, args[0]);
+  STRINGZ_TO_NPVARIANT("", args[1]);
+  INT32_TO_NPVARIANT(0x0001, args[2]);
+  STRINGZ_TO_NPVARIANT("", args[3]);
+  INT32_TO_NPVARIANT(0x0004, args[4]);
+  STRINGZ_TO_NPVARIANT("", args[5]);
+  NPVariant result;
+  VOID_TO_NPVARIANT(result);
+  g_object->Invoke(g_exec_batch_id, args, 6, &result);
+  FreeResult(result);
+}
+
+void BenchPollText() {
+  SetControllers(2, 0);
+  Poll(0, 0, 0);
+}
+
+void BenchPollTextPredictedHistory() {
+  SetControllers(2, 2);
+  Poll(0, 20, VRObject::kPollFlagSixenseHistory);
+}
+
+void BenchPollTextLoaded() {
+  SetControllers(kMaxSixenseBases * kMaxSixenseControllers,
+                 kMaxSixenseHistorySamples);
+  Poll(0, 20, VRObject::kPollFlagSixenseHistory);
+}
+
+void BenchPollBinary() {
+  SetControllers(2, 0);
+  Poll(1, 0, 0);
+}
+
+void BenchPollBinaryPredictedHistory() {
+  SetControllers(2, 2);
+  Poll(1, 20, VRObject::kPollFlagSixenseHistory);
+}
+
+void BenchPollBinaryNoControllers() {
+  SetControllers(0, 0);
+  Poll(1, 0, 0);
+}
+
+void BenchPollBinaryLoaded() {
+  SetControllers(kMaxSixenseBases * kMaxSixenseControllers,
+                 kMaxSixenseHistorySamples);
+  Poll(1, 20, VRObject::kPollFlagSixenseHistory);
+}
+
+uint32_t g_poll_generation = 0;
+
+void BenchPollBinaryIdle() {
+  SetControllers(kMaxSixenseBases * kMaxSixenseControllers, 0);
+  g_controllers.idle = true;
+  Poll(1, 20, 0);
+}
+
+void BenchPollBinaryIdleDelta() {
+  SetControllers(kMaxSixenseBases * kMaxSixenseControllers, 0);
+  g_controllers.idle = true;
+  g_poll_generation = Poll(1, 20, VRObject::kPollFlagDelta,
+                           g_poll_generation);
+}
+
+void BenchPollBinaryMovingDelta() {
+  SetControllers(kMaxSixenseBases * kMaxSixenseControllers, 0);
+  g_poll_generation = Poll(1, 20, VRObject::kPollFlagDelta,
+                           g_poll_generation);
+}
+
+int g_serialize_tick = 0;
+
+void BenchSerializeOStringStream() {
+  PollData data;
+  Jitter(data, g_serialize_tick++);
+  NPN_MemFree(PollOStringStream(data));
+}
+
+TextWriter* g_writer = NULL;
+
+void BenchSerializeTextWriter() {
+  PollData data;
+  Jitter(data, g_serialize_tick++);
+  NPN_MemFree(PollTextWriter(*g_writer, data));
+}
+
+FusionEngine* g_engine = NULL;
+FusionSample g_fusion_samples[1024];
+int g_fusion_tick = 0;
+
+void BenchFusionUpdate() {
+  g_engine->Update(g_fusion_samples[g_fusion_tick++ & 1023]);
+}
+
+struct Benchmark {
+  const char*   name;
+  BenchFunction function;
+};
+
+const Benchmark kBenchmarks[] = {
+  { "exec/query_hmd_info", BenchExecQueryHmdInfo },
+  { "exec/query_hmd_info/unchanged", BenchExecQueryHmdInfoUnchanged },
+  { "exec/query_readiness", BenchExecQueryReadiness },
+  { "exec/query_stereo_params", BenchExecQueryStereoParams },
+  { "exec/query_stereo_params/changed", BenchExecQueryStereoParamsChanged },
+  { "exec/distort_radii/64", BenchExecDistortRadii },
+  { "exec/undistort_radii/64", BenchExecUndistortRadii },
+  { "exec/unwarp_points/32", BenchExecUnwarpPoints },
+  { "exec/batch3", BenchExecBatch },
+  { "poll/text", BenchPollText },
+  { "poll/text/predict+history", BenchPollTextPredictedHistory },
+  { "poll/text/16c+64h", BenchPollTextLoaded },
+  { "poll/binary/0c", BenchPollBinaryNoControllers },
+  { "poll/binary", BenchPollBinary },
+  { "poll/binary/predict+history", BenchPollBinaryPredictedHistory },
+  { "poll/binary/16c+64h", BenchPollBinaryLoaded },
+  { "poll/binary/16c/idle", BenchPollBinaryIdle },
+  { "poll/binary/16c/idle/delta", BenchPollBinaryIdleDelta },
+  { "poll/binary/16c/delta", BenchPollBinaryMovingDelta },
+  { "serialize/ostringstream", BenchSerializeOStringStream },
+  { "serialize/text_writer", BenchSerializeTextWriter },
+  { "fusion/update", BenchFusionUpdate },
+};
+
+// Each timed run lasts at least this long.
+const uint64_t kMinRunNanos = 20000000;
+const int kRuns = 9;
+
+struct Result {
+  double ns_per_op;
+  double spread;
+  double allocs_per_op;
+};
+
+uint64_t TimeIterations(BenchFunction function, uint64_t iterations) {
+  uint64_t start = NowNanos();
+  for (uint64_t n = 0; n < iterations; n++) {
+    function();
+  }
+  return NowNanos() - start;
+}
+
+Result Run(BenchFunction function) {
+  // Warm up and find an iteration count that fills a run.
+  uint64_t iterations = 1;
+  while (TimeIterations(function, iterations) < kMinRunNanos) {
+    iterations *= 2;
+  }
+
+  double ns_per_op[kRuns];
+  uint64_t allocations = g_allocations;
+  for (int run = 0; run < kRuns; run++) {
+    ns_per_op[run] =
+        (double)TimeIterations(function, iterations) / iterations;
+  }
+  allocations = g_allocations - allocations;
+
+  std::sort(ns_per_op, ns_per_op + kRuns);
+  Result result;
+  result.ns_per_op = ns_per_op[kRuns / 2];
+  result.spread = (ns_per_op[kRuns - 1] - ns_per_op[0]) / result.ns_per_op;
+  result.allocs_per_op = (double)allocations / (iterations * kRuns);
+  return result;
+}
+
+void BuildFusionSamples() {
+  for (int n = 0; n < 1024; n++) {
+    float t = n * 0.001f;
+    FusionSample& sample = g_fusion_samples[n];
+    sample.time_delta = 0.001f;
+    sample.acceleration[0] = 0.01f * sinf(t);
+    sample.acceleration[1] = 9.81f;
+    sample.acceleration[2] = -0.01f * cosf(t);
+    sample.rotation_rate[0] = 0.2f * sinf(t * 3);
+    sample.rotation_rate[1] = 1.5f * sinf(t * 2);
+    sample.rotation_rate[2] = 0.01f;
+    sample.magnetic_field[0] = 0.2f;
+    sample.magnetic_field[1] = -0.4f;
+    sample.magnetic_field[2] = 0.1f;
+  }
+}
+
+// Splits a text result into fields on ',' and '|' and parses each one.
+std::vector<double> ParseValues(const std::string& text) {
+  std::vector<double> values;
+  const char* p = text.c_str();
+  while (*p) {
+    values.push_back(strtod(p, NULL));
+    p += strcspn(p, ",|");
+    if (*p) {
+      p++;
+    }
+  }
+  return values;
+}
+
+// Undoes the UTF-8 encoding of a binary poll record; see BinaryWriter.
+std::string DecodeBinary(const std::string& text) {
+  std::string bytes;
+  for (size_t n = 0; n + 1 < text.size(); n += 2) {
+    bytes += (char)(((text[n] & 0x03) << 6) | (text[n + 1] & 0x3F));
+  }
+  return bytes;
+}
+
+// Runs each exec and poll once with results kept and checks them against
+// what the stubs report. Prints only the checks that fail.
+void CheckResults() {
+  g_keep_result = true;
+
+  BenchExecQueryReadiness();
+  Expect(g_result == "1", "exec/query_readiness is 1");
+  BenchExecQueryHmdInfo();
+  Expect(g_result.compare(0, 16, "Oculus Rift DK1,") == 0,
+         "exec/query_hmd_info names the stub HMD");
+  BenchExecQueryHmdInfoUnchanged();
+  Expect(g_result == "=", "exec/query_hmd_info/unchanged is =");
+
+  BenchExecQueryStereoParams();
+  std::vector<double> values = ParseValues(g_result);
+  Expect(values.size() == 3 + 2 * 39 && values[0] == 1,
+         "exec/query_stereo_params has 81 values");
+  BenchExecQueryStereoParamsChanged();
+  Expect(ParseValues(g_result).size() == 3 + 2 * 39,
+         "exec/query_stereo_params/changed has 81 values");
+  Exec(0x0009, "0,nan,1000");
+  Expect(g_result.empty(), "exec/query_stereo_params rejects a NaN z near");
+  Exec(0x0009, "0,0.01,nan");
+  Expect(g_result.empty(), "exec/query_stereo_params rejects a NaN z far");
+
+  OVR::HMDInfo info;
+  SetDefaultHmdInfo(&info);
+  BenchExecDistortRadii();
+  values = ParseValues(g_result);
+  bool radii_ok = values.size() == 64;
+  for (size_t n = 0; radii_ok && n < values.size(); n++) {
+    double expected = DistortRadius(info.DistortionK, n / 40.0f);
+    radii_ok = fabs(values[n] - expected) <= 1e-5 * (1 + expected);
+  }
+  Expect(radii_ok, "exec/distort_radii/64 matches DistortRadius");
+  BenchExecUndistortRadii();
+  values = ParseValues(g_result);
+  radii_ok = values.size() == 64;
+  for (size_t n = 0; radii_ok && n < values.size(); n++) {
+    double distorted = DistortRadius(info.DistortionK, (float)values[n]);
+    radii_ok = fabs(distorted - n / 40.0) <= 1e-4;
+  }
+  Expect(radii_ok, "exec/undistort_radii/64 inverts DistortRadius");
+  BenchExecUnwarpPoints();
+  Expect(ParseValues(g_result).size() == 64,
+         "exec/unwarp_points/32 has 64 values");
+
+  BenchExecBatch();
+  Expect(std::count(g_result.begin(), g_result.end(), '\x1e') == 2 &&
+         g_result.compare(0, 2, "1\x1e") == 0,
+         "exec/batch3 has three results");
+
+  SetControllers(2, 0);
+  Poll(0, 0, 0);
+  Expect(g_result.compare(0, 6, "s,b,0,") == 0 &&
+         g_result.find("|r,0.0012345,-0.3826834,0,0.9238795|") !=
+             std::string::npos,
+         "poll/text reports the stub HMD");
+
+  BenchPollBinaryNoControllers();
+  std::string record = DecodeBinary(g_result);
+  Expect(record.size() == kBinaryPollHeaderSize &&
+         (uint8_t)record[0] == kBinaryPollVersion &&
+         record[1] == kBinaryPollFlagHmdPresent &&
+         record[2] == 0,
+         "poll/binary/0c is header and HMD only");
+  BenchPollBinary();
+  record = DecodeBinary(g_result);
+  Expect(record.size() == kBinaryPollHeaderSize +
+             2 * kBinaryPollControllerSize && record[2] == 2,
+         "poll/binary has 2 controllers");
+  BenchPollBinaryLoaded();
+  record = DecodeBinary(g_result);
+  Expect(record.size() == kBinaryPollHeaderSize +
+             kBinaryPollPredictedSize +
+             (kMaxSixenseBases * kMaxSixenseControllers +
+              kMaxSixenseHistorySamples) * kBinaryPollControllerSize &&
+         record[2] == kMaxSixenseBases * kMaxSixenseControllers &&
+         record[3] == kMaxSixenseHistorySamples,
+         "poll/binary/16c+64h has every frame");
+
+  // Two idle delta polls: the second has nothing left to send.
+  g_poll_generation = 0;
+  BenchPollBinaryIdleDelta();
+  Expect(g_poll_generation != 0, "poll/binary/16c/idle/delta generation");
+  BenchPollBinaryIdleDelta();
+  record = DecodeBinary(g_result);
+  Expect(record.size() == 8 &&
+         (record[1] & kBinaryPollFlagDelta) &&
+         (record[1] & kBinaryPollFlagHmdUnchanged) && record[2] == 0,
+         "poll/binary/16c/idle/delta repeat is header only");
+  g_poll_generation = 0;
+
+  // Both serializers print the same record, TextWriter to more digits.
+  PollData data;
+  Jitter(data, 17);
+  char* old_text = PollOStringStream(data);
+  char* new_text = PollTextWriter(*g_writer, data);
+  std::vector<double> old_values = ParseValues(old_text);
+  std::vector<double> new_values = ParseValues(new_text);
+  bool same = old_values.size() == new_values.size();
+  for (size_t n = 0; same && n < old_values.size(); n++) {
+    same = fabs(old_values[n] - new_values[n]) <=
+        1e-5 * fabs(new_values[n]);
+  }
+  Expect(same, "serialize/text_writer matches ostringstream");
+  NPN_MemFree(old_text);
+  NPN_MemFree(new_text);
+
+  g_keep_result = false;
+  g_result.clear();
+}
+
+}  // namespace
+
+
+int main(int argc, char** argv) {
+  const char* filter = argc > 1 ? argv[1] : NULL;
+
+  NPP_t npp;
+  memset(&npp, 0, sizeof(npp));
+  g_object = (VRObject*)VRObject::Allocate(&npp, VRObject::np_class());
+  g_exec_id = NPN_GetStringIdentifier("exec");
+  g_exec_batch_id = NPN_GetStringIdentifier("execBatch");
+  g_poll_id = NPN_GetStringIdentifier("poll");
+  g_writer = new TextWriter();
+  g_engine = new FusionEngine();
+  g_engine->set_yaw_correction_enabled(true);
+  BuildFusionSamples();
+  BuildDistortionCommands();
+  CheckResults();
+
+  printf("%-30s %10s %8s %10s\n", "benchmark", "ns/op", "spread",
+         "allocs/op");
+  double binary_empty = 0;
+  for (size_t n = 0; n < sizeof(kBenchmarks) / sizeof(kBenchmarks[0]); n++) {
+    const Benchmark& benchmark = kBenchmarks[n];
+    if (filter && !strstr(benchmark.name, filter)) {
+      continue;
+    }
+    Result result = Run(benchmark.function);
+    printf("%-30s %10.1f %7.1f%% %10.2f\n", benchmark.name, result.ns_per_op,
+           result.spread * 100.0, result.allocs_per_op);
+
+    // The loaded binary poll is the empty one plus 80 Sixense frames; the
+    // difference gives the cost of encoding one.
+    if (benchmark.function == BenchPollBinaryNoControllers) {
+      binary_empty = result.ns_per_op;
+    } else if (benchmark.function == BenchPollBinaryLoaded && binary_empty) {
+      int frames = kMaxSixenseBases * kMaxSixenseControllers +
+          kMaxSixenseHistorySamples;
+      printf("%-30s %10.1f\n", "  encode/sixense_frame",
+             (result.ns_per_op - binary_empty) / frames);
+    }
+  }
+
+  delete g_engine;
+  delete g_writer;
+  NPObjectBase::_Deallocate(g_object);
+  return BenchExitCode();
+}
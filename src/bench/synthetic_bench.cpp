@@ -0,0 +1,183 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs SyntheticProvider well past real hardware (an 8kHz HMD and sixteen
+// controllers at 1kHz) while a consumer polls it every millisecond the way
+// VRObject does, and reports the cost of each consumer call under that load.
+// Checks that the configured rates are met and every controller is reported,
+// then that adding HMDs adds throughput: each runs on its own thread, so every
+// one of kMaxHmdDevices should keep the full rate. Exits non-zero if a check
+// fails.
+//
+// Dropped history frames are reported rather than checked: a poll carries at
+// most kMaxSixenseHistorySamples frames, so at this load any poll that runs
+// 4ms late loses some, and how often that happens is up to the scheduler.
+
+#include <npvr.h>
+#include <bench/expect.h>
+#include <npvr/clock.h>
+#include <npvr/synthetic_provider.h>
+
+#include <math.h>
+
+using namespace npvr;
+
+
+namespace {
+
+// Runs 1 to kMaxHmdDevices synthetic HMDs at hmd_rate each, polling every
+// device's snapshot each millisecond, and checks that every device keeps the
+// rate.
+void MeasureDeviceScaling(uint32_t hmd_rate, double seconds) {
+  printf("hmd devices, %u samples/s each:\n", hmd_rate);
+  for (int count = 1; count <= kMaxHmdDevices; count++) {
+    SyntheticConfig config;
+    config.hmd_rate = hmd_rate;
+    config.controller_rate = 0;
+    config.controller_count = 0;
+    config.hmd_count = count;
+    SyntheticProvider provider(config);
+    for (int n = 0; n < count; n++) {
+      provider.device(n)->Acquire();
+    }
+    uint64_t polls = 0;
+    uint64_t poll_nanos = 0;
+    uint64_t start = NowNanos();
+    while (NowNanos() - start < (uint64_t)(seconds * 1e9)) {
+      uint64_t t0 = NowNanos();
+      for (int n = 0; n < count; n++) {
+        HmdSnapshot snapshot;
+        provider.device(n)->GetSnapshot(&snapshot);
+      }
+      poll_nanos += NowNanos() - t0;
+      polls++;
+      SleepMicros(1000);
+    }
+    for (int n = 0; n < count; n++) {
+      provider.device(n)->Release();
+    }
+    double elapsed = (NowNanos() - start) / 1e9;
+
+    uint64_t total = 0;
+    double slowest = hmd_rate;
+    for (int n = 0; n < count; n++) {
+      SyntheticProvider* device =
+          static_cast<SyntheticProvider*>(provider.device(n));
+      double rate = device->hmd_sample_count() / elapsed;
+      slowest = rate < slowest ? rate : slowest;
+      total += device->hmd_sample_count();
+    }
+    char what[64];
+    sprintf(what, "%d: slowest device samples/s", count);
+    Expect(fabs(slowest - hmd_rate) < hmd_rate * 0.05, what, slowest);
+    printf("  %-40s %12.3f  (%.1f ns/poll)\n", "   total samples/s",
+           total / elapsed, (double)poll_nanos / polls);
+  }
+}
+
+}  // namespace
+
+
+int main(int argc, char** argv) {
+  SyntheticConfig config;
+  config.hmd_rate = 8000;
+  config.controller_rate = 1000;
+  config.controller_count = kMaxSyntheticControllers;
+  config.hmd_count = 1;
+  const double kSeconds = 2.0;
+
+  SyntheticProvider provider(config);
+  ControllerCursor cursor;
+  SixensePoll poll;
+  uint8_t last_sequence[kMaxSyntheticControllers];
+  bool seen[kMaxSyntheticControllers];
+  memset(seen, 0, sizeof(seen));
+
+  uint64_t polls = 0;
+  uint64_t snapshot_nanos = 0;
+  uint64_t predict_nanos = 0;
+  uint64_t gather_nanos = 0;
+  uint64_t history_frames = 0;
+  uint64_t dropped = 0;
+  float checksum = 0;
+
+  provider.Acquire();
+  uint64_t start = NowNanos();
+  while (NowNanos() - start < (uint64_t)(kSeconds * 1e9)) {
+    uint64_t t0 = NowNanos();
+    HmdSnapshot snapshot;
+    bool has_snapshot = provider.GetSnapshot(&snapshot);
+    uint64_t t1 = NowNanos();
+    if (has_snapshot) {
+      OVR::Quatf p = provider.PredictOrientation(snapshot, 0.02f);
+      checksum += p.w;
+    }
+    uint64_t t2 = NowNanos();
+    provider.Gather(true, &cursor, &poll);
+    uint64_t t3 = NowNanos();
+    snapshot_nanos += t1 - t0;
+    predict_nanos += t2 - t1;
+    gather_nanos += t3 - t2;
+    polls++;
+
+    for (int n = 0; n < poll.history_count; n++) {
+      const SixenseFrame& frame = poll.history[n];
+      int index = frame.base * kMaxSixenseControllers + frame.controller;
+      if (seen[index]) {
+        dropped += (uint8_t)(frame.sequence - last_sequence[index] - 1);
+      }
+      last_sequence[index] = frame.sequence;
+      seen[index] = true;
+    }
+    history_frames += poll.history_count;
+    SleepMicros(1000);
+  }
+  provider.Release();
+  double elapsed = (NowNanos() - start) / 1e9;
+
+  double hmd_rate = provider.hmd_sample_count() / elapsed;
+  double controller_rate =
+      provider.controller_sample_count() / elapsed / config.controller_count;
+  printf("rates over %.2fs:\n", elapsed);
+  Expect(fabs(hmd_rate - config.hmd_rate) < config.hmd_rate * 0.05,
+         "hmd samples/s", hmd_rate);
+  Expect(fabs(controller_rate - config.controller_rate) <
+         config.controller_rate * 0.05, "controller samples/s per device",
+         controller_rate);
+  Expect(poll.controller_count == config.controller_count,
+         "controllers reported", poll.controller_count);
+  // Released, the provider generates nothing, so it reports no controllers.
+  provider.Gather(false, &cursor, &poll);
+  Expect(poll.controller_count == 0, "controllers reported after release",
+         poll.controller_count);
+  printf("\n");
+
+  printf("consumer, %llu polls (%llu history frames, %llu dropped):\n",
+         (unsigned long long)polls, (unsigned long long)history_frames,
+         (unsigned long long)dropped);
+  printf("  %-20s %8.1f ns/call\n", "GetSnapshot",
+         (double)snapshot_nanos / polls);
+  printf("  %-20s %8.1f ns/call\n", "PredictOrientation",
+         (double)predict_nanos / polls);
+  printf("  %-20s %8.1f ns/call  (%.1f frames/call)\n", "Gather",
+         (double)gather_nanos / polls, (double)history_frames / polls);
+  printf("  (checksum %.3f)\n", checksum);
+  printf("\n");
+
+  MeasureDeviceScaling(config.hmd_rate, 1.0);
+
+  return BenchExitCode();
+}
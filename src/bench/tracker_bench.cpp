@@ -0,0 +1,239 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput benchmark for TrackerDecoder. Decodes a synthetic capture of
+// 1kHz tracker reports with the scalar and SSE2 unpack paths and reports
+// ns/report and samples/s.
+//
+// Before timing it checks hand-packed golden reports against their known
+// values, including the 21-bit extremes, timestamp wraparound and a dropped
+// report, and checks that both paths produce bit-identical output for the
+// whole synthetic capture. It exits non-zero if either check fails.
+
+#include <npvr.h>
+#include <bench/expect.h>
+#include <npvr/clock.h>
+#include <npvr/tracker_decoder.h>
+
+#include <math.h>
+#include <stdlib.h>
+
+using namespace npvr;
+
+
+namespace {
+
+// Packs three 21-bit values the way the tracker does.
+void Pack21(int32_t x, int32_t y, int32_t z, uint8_t* out) {
+  uint64_t v = ((uint64_t)(x & 0x1FFFFF) << 43) |
+               ((uint64_t)(y & 0x1FFFFF) << 22) |
+               ((uint64_t)(z & 0x1FFFFF) << 1);
+  for (int n = 0; n < 8; n++) {
+    out[n] = (uint8_t)(v >> (56 - 8 * n));
+  }
+}
+
+void WriteInt16(int16_t value, uint8_t* out) {
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)((uint16_t)value >> 8);
+}
+
+struct ReportValues {
+  uint8_t sample_count;
+  uint16_t timestamp;
+  int16_t temperature;
+  int16_t mag[3];
+  int32_t motion[3][6];
+};
+
+void BuildReport(const ReportValues& values, uint8_t* out) {
+  memset(out, 0, kTrackerReportSize);
+  out[0] = 1;
+  out[1] = values.sample_count;
+  out[2] = (uint8_t)values.timestamp;
+  out[3] = (uint8_t)(values.timestamp >> 8);
+  WriteInt16(values.temperature, out + 6);
+  for (int n = 0; n < 3; n++) {
+    const int32_t* m = values.motion[n];
+    Pack21(m[0], m[1], m[2], out + 8 + 16 * n);
+    Pack21(m[3], m[4], m[5], out + 16 + 16 * n);
+  }
+  WriteInt16(values.mag[0], out + 56);
+  WriteInt16(values.mag[1], out + 58);
+  WriteInt16(values.mag[2], out + 60);
+}
+
+int32_t Random21() {
+  return (int32_t)((((uint32_t)rand() << 16) ^ rand()) & 0x1FFFFF) -
+      0x100000;
+}
+
+// A capture shaped like a real one: mostly single-sample reports, some
+// batched ones, a dropped report every so often and a timestamp that wraps.
+uint8_t* BuildCapture(size_t report_count) {
+  uint8_t* reports = new uint8_t[report_count * kTrackerReportSize];
+  uint16_t timestamp = 0xFF00;
+  for (size_t n = 0; n < report_count; n++) {
+    ReportValues values;
+    values.sample_count = (n % 50 == 0) ? 3 : (n % 7 == 0) ? 2 : 1;
+    if (n % 997 == 0) {
+      // Dropped reports.
+      timestamp += 5;
+    }
+    timestamp += values.sample_count;
+    values.timestamp = timestamp;
+    values.temperature = (int16_t)(2500 + rand() % 100);
+    for (int axis = 0; axis < 3; axis++) {
+      values.mag[axis] = (int16_t)(rand() % 20000 - 10000);
+    }
+    for (int s = 0; s < 3; s++) {
+      for (int f = 0; f < 6; f++) {
+        values.motion[s][f] = Random21();
+      }
+    }
+    BuildReport(values, reports + n * kTrackerReportSize);
+  }
+  return reports;
+}
+
+bool Near(float a, float b) {
+  return fabs(a - b) <= fabs(b) * 1e-6f + 1e-9f;
+}
+
+void CheckGolden(bool use_simd) {
+  TrackerDecoder decoder(use_simd);
+  TrackerSamples samples(16);
+  uint8_t reports[3 * kTrackerReportSize];
+
+  ReportValues a;
+  memset(&a, 0, sizeof(a));
+  a.sample_count = 2;
+  a.timestamp = 0xFFFF;
+  a.temperature = 2512;
+  a.mag[0] = -300;
+  a.mag[1] = 150;
+  a.mag[2] = 7;
+  int32_t golden[2][6] = {
+    { -1048576, 1048575, 0, -1, 1, 12345 },
+    { 98100, -98100, 4, -123456, 654321, -2 },
+  };
+  memcpy(a.motion, golden, sizeof(golden));
+  BuildReport(a, reports);
+
+  // Wraps to 1: one sample after a's two, so nothing was dropped.
+  ReportValues b = a;
+  b.sample_count = 1;
+  b.timestamp = 1;
+  BuildReport(b, reports + kTrackerReportSize);
+
+  // Jumps by 4 after a single-sample report: three samples dropped.
+  ReportValues c = b;
+  c.timestamp = 5;
+  c.sample_count = 5;
+  BuildReport(c, reports + 2 * kTrackerReportSize);
+
+  size_t consumed = decoder.Decode(reports, 3, &samples);
+  Expect(consumed == 3, "consumed all reports");
+  // 2 + 1 + 1 repeat + 3 (sample count clamped).
+  Expect(samples.count() == 7, "sample count");
+
+  for (int s = 0; s < 2; s++) {
+    for (int axis = 0; axis < 3; axis++) {
+      Expect(Near(samples.acceleration(axis)[s],
+                  golden[s][axis] * 0.0001f), "acceleration");
+      Expect(Near(samples.rotation_rate(axis)[s],
+                  golden[s][3 + axis] * 0.0001f), "rotation rate");
+    }
+    Expect(Near(samples.time_delta()[s], 0.001f), "time delta");
+    Expect(Near(samples.temperature()[s], 25.12f), "temperature");
+    Expect(Near(samples.magnetic_field(0)[s], -0.03f), "magnetic x");
+    Expect(Near(samples.magnetic_field(1)[s], 0.0007f), "magnetic y (XZY)");
+    Expect(Near(samples.magnetic_field(2)[s], 0.015f), "magnetic z (XZY)");
+  }
+  // The repeat carries the last sample of b with the length of the gap.
+  Expect(Near(samples.time_delta()[3], 0.003f), "repeat time delta");
+  Expect(Near(samples.acceleration(0)[3], -1048576 * 0.0001f),
+         "repeat acceleration");
+}
+
+bool SamplesEqual(const TrackerSamples& a, const TrackerSamples& b) {
+  if (a.count() != b.count()) {
+    return false;
+  }
+  size_t size = a.count() * sizeof(float);
+  bool equal = !memcmp(a.time_delta(), b.time_delta(), size) &&
+               !memcmp(a.temperature(), b.temperature(), size);
+  for (int axis = 0; axis < 3; axis++) {
+    equal = equal &&
+        !memcmp(a.acceleration(axis), b.acceleration(axis), size) &&
+        !memcmp(a.rotation_rate(axis), b.rotation_rate(axis), size) &&
+        !memcmp(a.magnetic_field(axis), b.magnetic_field(axis), size);
+  }
+  return equal;
+}
+
+void Run(const char* name, bool use_simd, const uint8_t* reports,
+         size_t report_count, TrackerSamples* samples, int passes) {
+  TrackerDecoder decoder(use_simd);
+  uint64_t start = NowNanos();
+  for (int pass = 0; pass < passes; pass++) {
+    decoder.Reset();
+    samples->Clear();
+    decoder.Decode(reports, report_count, samples);
+  }
+  double elapsed = (double)(NowNanos() - start);
+  double reports_total = (double)report_count * passes;
+  double samples_total = (double)samples->count() * passes;
+  printf("  %-7s %7.2f ns/report  %7.1f Msamples/s  %7.1f MB/s\n",
+         name, elapsed / reports_total, samples_total / elapsed * 1e3,
+         reports_total * kTrackerReportSize / elapsed * 1e3);
+}
+
+}  // namespace
+
+
+int main(int argc, char** argv) {
+  printf("golden reports:\n");
+  CheckGolden(false);
+  if (TrackerDecoder::simd_supported()) {
+    CheckGolden(true);
+  }
+
+  // An hour at 1kHz.
+  const size_t kReportCount = 3600 * 1000;
+  uint8_t* reports = BuildCapture(kReportCount);
+  TrackerSamples scalar(kReportCount * kTrackerMaxSamplesPerReport);
+  TrackerSamples simd(kReportCount * kTrackerMaxSamplesPerReport);
+
+  if (TrackerDecoder::simd_supported()) {
+    TrackerDecoder scalar_decoder(false);
+    TrackerDecoder simd_decoder(true);
+    scalar_decoder.Decode(reports, kReportCount, &scalar);
+    simd_decoder.Decode(reports, kReportCount, &simd);
+    Expect(SamplesEqual(scalar, simd), "SSE2 output matches scalar");
+  }
+  printf("  %s\n\n", BenchFailures() ? "FAILED" : "ok");
+
+  const int kPasses = 5;
+  printf("decode, %d reports x %d passes:\n", (int)kReportCount, kPasses);
+  Run("scalar", false, reports, kReportCount, &scalar, kPasses);
+  if (TrackerDecoder::simd_supported()) {
+    Run("sse2", true, reports, kReportCount, &simd, kPasses);
+  }
+
+  delete[] reports;
+  return BenchExitCode();
+}
@@ -0,0 +1,269 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks warp meshes against the per-pixel warp they replace, then reports
+// what generating them costs. For every screen pixel of each eye on a DK1,
+// the texture coordinates interpolated across the mesh triangle covering it
+// are compared with what the WARP_CHROMEAB fragment shader computes there,
+// transcribed here from vr.js in double precision. Errors are in screen
+// pixels, over the pixels the shader does not black out. Linear
+// interpolation should make them fall fourfold each time the density
+// doubles, and at the density vr.js asks for keep under a pixel. Exits
+// non-zero if a check fails.
+
+#include <npvr.h>
+#include <bench/expect.h>
+#include <npvr/clock.h>
+#include <npvr/tracking_provider.h>
+#include <npvr/warp_mesh.h>
+
+#include <math.h>
+
+using namespace npvr;
+
+
+namespace {
+
+// vr.StereoRenderer.renderEye_ and WARP_CHROMEAB_FRAGMENT_SOURCE_ for the
+// render target coordinate (s, t). Returns false where the shader draws
+// black.
+bool ShaderWarp(const OVR::HMDInfo& info, const StereoParams& params, int eye,
+                double s, double t, double out_tc[3][2]) {
+  const StereoParams::Eye& e = params.eyes[eye];
+  double x = e.viewport[0];
+  double y = e.viewport[1];
+  double w = e.viewport[2];
+  double h = e.viewport[3];
+  double aspect = (w * info.HResolution) / (h * info.VResolution);
+  double scale = 1 / (double)params.distortion_scale;
+  double lens_center[2] = {
+    x + (w + e.distortion_center_offset_x / 2) / 2, y + h / 2
+  };
+  double screen_center[2] = { x + w / 2, y + h / 2 };
+  double u_scale[2] = { w / 2 * scale, h / 2 * scale * aspect };
+  double scale_in[2] = { 2 / w, 2 / h / aspect };
+  const float* k = info.DistortionK;
+  const float* c = info.ChromaAbCorrection;
+
+  double theta[2] = {
+    (s - lens_center[0]) * scale_in[0], (t - lens_center[1]) * scale_in[1]
+  };
+  double r_sq = theta[0] * theta[0] + theta[1] * theta[1];
+  double distortion =
+      k[0] + k[1] * r_sq + k[2] * r_sq * r_sq + k[3] * r_sq * r_sq * r_sq;
+  double factors[3] = {
+    distortion * (c[0] + c[1] * r_sq),
+    distortion,
+    distortion * (c[2] + c[3] * r_sq)
+  };
+  for (int channel = 0; channel < 3; channel++) {
+    for (int n = 0; n < 2; n++) {
+      out_tc[channel][n] =
+          lens_center[n] + u_scale[n] * theta[n] * factors[channel];
+    }
+  }
+  const double* blue = out_tc[2];
+  return fabs(blue[0] - screen_center[0]) <= 0.25 &&
+         fabs(blue[1] - screen_center[1]) <= 0.5;
+}
+
+const float* Channel(const WarpVertex& vertex, int channel) {
+  return channel == 0 ? vertex.red : channel == 1 ? vertex.green : vertex.blue;
+}
+
+struct MeshError {
+  double max_pixels;
+  double mean_pixels;
+  double vertex_pixels;
+};
+
+// Rasterizes the eye's mesh the way the GPU does, interpolating linearly
+// within each triangle, and compares every pixel with ShaderWarp.
+MeshError MeasureMesh(const OVR::HMDInfo& info, const StereoParams& params,
+                      int eye, int columns, int rows) {
+  WarpParams warp;
+  GetWarpParams(info, params, eye, &warp);
+  const float* viewport = params.eyes[eye].viewport;
+  WarpVertex* vertices =
+      new WarpVertex[GetWarpMeshVertexCount(columns, rows)];
+  GenerateWarpMesh(warp, viewport, columns, rows, vertices);
+
+  // Texture coordinates are converted to screen pixels of the whole display.
+  double to_pixels[2] = { (double)info.HResolution, (double)info.VResolution };
+  int width = (int)(viewport[2] * info.HResolution + 0.5f);
+  int height = (int)(viewport[3] * info.VResolution + 0.5f);
+
+  MeshError error = { 0, 0, 0 };
+  uint64_t counted = 0;
+  for (int py = 0; py < height; py++) {
+    double v = (py + 0.5) / height;
+    for (int px = 0; px < width; px++) {
+      double u = (px + 0.5) / width;
+      double tc[3][2];
+      if (!ShaderWarp(info, params, eye, viewport[0] + u * viewport[2],
+                      viewport[1] + v * viewport[3], tc)) {
+        continue;
+      }
+      // The cell, then which of its two triangles (TL TR BL, TR BR BL).
+      double cu = u * columns;
+      double cv = v * rows;
+      int i = (int)cu;
+      int j = (int)cv;
+      double fu = cu - i;
+      double fv = cv - j;
+      const WarpVertex& top_left = vertices[j * (columns + 1) + i];
+      const WarpVertex& top_right = vertices[j * (columns + 1) + i + 1];
+      const WarpVertex& bottom_left = vertices[(j + 1) * (columns + 1) + i];
+      const WarpVertex& bottom_right =
+          vertices[(j + 1) * (columns + 1) + i + 1];
+      for (int channel = 0; channel < 3; channel++) {
+        double d = 0;
+        for (int n = 0; n < 2; n++) {
+          double value;
+          if (fu + fv <= 1) {
+            value = Channel(top_left, channel)[n] +
+                fu * (Channel(top_right, channel)[n] -
+                      Channel(top_left, channel)[n]) +
+                fv * (Channel(bottom_left, channel)[n] -
+                      Channel(top_left, channel)[n]);
+          } else {
+            value = Channel(bottom_right, channel)[n] +
+                (1 - fu) * (Channel(bottom_left, channel)[n] -
+                            Channel(bottom_right, channel)[n]) +
+                (1 - fv) * (Channel(top_right, channel)[n] -
+                            Channel(bottom_right, channel)[n]);
+          }
+          double e = (value - tc[channel][n]) * to_pixels[n];
+          d += e * e;
+        }
+        d = sqrt(d);
+        error.max_pixels = d > error.max_pixels ? d : error.max_pixels;
+        error.mean_pixels += d;
+      }
+      counted += 3;
+    }
+  }
+  error.mean_pixels /= counted ? counted : 1;
+
+  // At the vertices the mesh is the shader, up to float rounding.
+  for (int j = 0; j <= rows; j++) {
+    for (int i = 0; i <= columns; i++) {
+      const WarpVertex& vertex = vertices[j * (columns + 1) + i];
+      double tc[3][2];
+      ShaderWarp(info, params, eye,
+                 viewport[0] + vertex.position[0] * viewport[2],
+                 viewport[1] + vertex.position[1] * viewport[3], tc);
+      for (int channel = 0; channel < 3; channel++) {
+        for (int n = 0; n < 2; n++) {
+          double e = fabs(Channel(vertex, channel)[n] - tc[channel][n]) *
+              to_pixels[n];
+          error.vertex_pixels =
+              e > error.vertex_pixels ? e : error.vertex_pixels;
+        }
+      }
+    }
+  }
+
+  delete[] vertices;
+  return error;
+}
+
+double MeasureGenerateNanos(const OVR::HMDInfo& info,
+                            const StereoParams& params, int columns,
+                            int rows) {
+  WarpVertex* vertices =
+      new WarpVertex[GetWarpMeshVertexCount(columns, rows)];
+  uint16_t* indices = new uint16_t[GetWarpMeshIndexCount(columns, rows)];
+  int iterations = 0;
+  float checksum = 0;
+  uint64_t start = NowNanos();
+  uint64_t elapsed = 0;
+  while (elapsed < 200000000) {
+    for (int eye = 0; eye < 2; eye++) {
+      WarpParams warp;
+      GetWarpParams(info, params, eye, &warp);
+      GenerateWarpMesh(warp, params.eyes[eye].viewport, columns, rows,
+                       vertices);
+      checksum += vertices[columns].red[0];
+    }
+    GenerateWarpMeshIndices(columns, rows, indices);
+    iterations++;
+    elapsed = NowNanos() - start;
+  }
+  delete[] indices;
+  delete[] vertices;
+  return checksum ? (double)elapsed / iterations : 0;
+}
+
+}  // namespace
+
+
+int main(int argc, char** argv) {
+  OVR::HMDInfo info;
+  SetDefaultHmdInfo(&info);
+  StereoConfig config;
+  config.interpupillary_distance = 0;
+  config.z_near = 0.01f;
+  config.z_far = 1000;
+  StereoParams params;
+  ComputeStereoParams(info, config, &params);
+
+  const int kDensities[] = { 8, 16, 32, 64, kMaxWarpMeshCells };
+  const int kDensityCount = sizeof(kDensities) / sizeof(kDensities[0]);
+  // vr.StereoRenderer.WARP_MESH_CELLS_.
+  const int kDefaultCells = 64;
+
+  printf("accuracy against the fragment shader, screen pixels:\n");
+  double previous_max = 1e9;
+  for (int d = 0; d < kDensityCount; d++) {
+    int cells = kDensities[d];
+    MeshError worst = { 0, 0, 0 };
+    for (int eye = 0; eye < 2; eye++) {
+      MeshError error = MeasureMesh(info, params, eye, cells, cells);
+      worst.max_pixels = error.max_pixels > worst.max_pixels ?
+          error.max_pixels : worst.max_pixels;
+      worst.mean_pixels += error.mean_pixels / 2;
+      worst.vertex_pixels = error.vertex_pixels > worst.vertex_pixels ?
+          error.vertex_pixels : worst.vertex_pixels;
+    }
+    char what[64];
+    sprintf(what, "%dx%d: max at vertices", cells, cells);
+    Expect(worst.vertex_pixels < 0.01, what, worst.vertex_pixels);
+    sprintf(what, "%dx%d: mean", cells, cells);
+    Expect(cells != kDefaultCells || worst.mean_pixels < 0.25, what,
+           worst.mean_pixels);
+    sprintf(what, "%dx%d: max", cells, cells);
+    Expect(cells != kDefaultCells || worst.max_pixels < 1, what,
+           worst.max_pixels);
+    if (d) {
+      sprintf(what, "%dx%d: max reduction", cells, cells);
+      double reduction = previous_max / worst.max_pixels;
+      Expect(reduction > 3, what, reduction);
+    }
+    previous_max = worst.max_pixels;
+  }
+  printf("\n");
+
+  printf("generation, both eyes and indices:\n");
+  for (int d = 0; d < kDensityCount; d++) {
+    int cells = kDensities[d];
+    double nanos = MeasureGenerateNanos(info, params, cells, cells);
+    printf("  %3dx%-3d %6d vertices/eye %12.1f us\n", cells, cells,
+           GetWarpMeshVertexCount(cells, cells), nanos / 1000);
+  }
+
+  return BenchExitCode();
+}
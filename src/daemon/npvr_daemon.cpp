@@ -0,0 +1,97 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Holds the tracking devices open on behalf of every browser process and
+// publishes their state into shared memory, where the plugin reads it (see
+// SharedTrackingProvider). Without it each browser process that loads the
+// plugin opens the devices itself, and the Oculus SDK lets only one succeed.
+//
+// Uses the same providers and environment variables (NPVR_PROVIDER,
+// NPVR_FUSION, NPVR_CAPTURE, ...) the plugin would in-process. Runs until
+// interrupted.
+
+#include <npvr.h>
+#include <npvr/clock.h>
+#include <npvr/provider_factory.h>
+#include <npvr/shared_tracking.h>
+
+#include <signal.h>
+
+using namespace npvr;
+
+
+namespace {
+
+// How often device state is copied out. Sleeps round down to a millisecond
+// on Windows.
+#if defined(XP_WIN)
+const uint32_t kPublishIntervalMicros = 1000;
+#else
+const uint32_t kPublishIntervalMicros = 500;
+#endif  // XP_WIN
+
+volatile sig_atomic_t g_exit_requested = 0;
+
+void OnExitSignal(int signal) {
+  g_exit_requested = 1;
+}
+
+}  // namespace
+
+
+int main(int argc, char** argv) {
+  SharedTrackingPublisher publisher;
+  if (!publisher.Open()) {
+    fprintf(stderr, "npvr_daemon: another daemon is running, or shared "
+            "memory is unavailable\n");
+    return 1;
+  }
+
+  signal(SIGINT, OnExitSignal);
+  signal(SIGTERM, OnExitSignal);
+
+  HmdProvider* hmd = GetLocalHmdProvider();
+  ControllerProvider* controllers = GetLocalControllerProvider();
+  // Every HMD device is published, so all of them are held open.
+  int hmd_count = hmd->device_count();
+  for (int n = 0; n < hmd_count; n++) {
+    hmd->device(n)->Acquire();
+  }
+  controllers->Acquire();
+
+  bool was_present[kMaxHmdDevices] = { false };
+  while (!g_exit_requested) {
+    publisher.Publish(hmd, controllers);
+
+    for (int n = 0; n < hmd_count; n++) {
+      bool present = hmd->device(n)->DevicePresent();
+      if (present != was_present[n]) {
+        was_present[n] = present;
+        printf("npvr_daemon: hmd %d %s\n", n,
+               present ? "attached" : "detached");
+        fflush(stdout);
+      }
+    }
+    SleepMicros(kPublishIntervalMicros);
+  }
+
+  publisher.Close();
+  controllers->Release();
+  for (int n = hmd_count - 1; n >= 0; n--) {
+    hmd->device(n)->Release();
+  }
+  return 0;
+}
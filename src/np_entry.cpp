@@ -48,7 +48,7 @@
 #ifdef XP_WIN
 #define EXPORT
 #else   // XP_WIN
-#define EXPORT __attribute__((visibility("default"))) extern "C"
+#define EXPORT extern "C" __attribute__((visibility("default")))
 #endif  // XP_WIN
 
 NPNetscapeFuncs NPNFuncs;
@@ -81,7 +81,8 @@ EXPORT NPError OSCALL NP_GetEntryPoints(NPPluginFuncs* pFuncs)
     return NPERR_NO_ERROR;
 }
 
-char *NPP_GetMIMEDescription();
+const char *NPP_GetMIMEDescription();
+NPError NPP_Initialize();
 
 const char *
 NP_GetMIMEDescription()
@@ -122,18 +123,19 @@ EXPORT NPError OSCALL NP_Initialize(NPNetscapeFuncs* pFuncs, NPPluginFuncs* plug
     */
     pluginFuncs->version    = (NP_VERSION_MAJOR << 8) + NP_VERSION_MINOR;
     pluginFuncs->size       = sizeof(NPPluginFuncs);
-    pluginFuncs->newp       = NewNPP_NewProc(NPP_New);
-    pluginFuncs->destroy    = NewNPP_DestroyProc(NPP_Destroy);
-    pluginFuncs->setwindow  = NewNPP_SetWindowProc(NPP_SetWindow);
-    pluginFuncs->newstream  = NewNPP_NewStreamProc(NPP_NewStream);
-    pluginFuncs->destroystream = NewNPP_DestroyStreamProc(NPP_DestroyStream);
-    pluginFuncs->asfile     = NewNPP_StreamAsFileProc(NPP_StreamAsFile);
-    pluginFuncs->writeready = NewNPP_WriteReadyProc(NPP_WriteReady);
-    pluginFuncs->write      = NewNPP_WriteProc(NPP_Write);
-    pluginFuncs->print      = NewNPP_PrintProc(NPP_Print);
-    pluginFuncs->urlnotify  = NewNPP_URLNotifyProc(NPP_URLNotify);
+    pluginFuncs->newp       = NPP_New;
+    pluginFuncs->destroy    = NPP_Destroy;
+    pluginFuncs->setwindow  = NPP_SetWindow;
+    pluginFuncs->newstream  = NPP_NewStream;
+    pluginFuncs->destroystream = NPP_DestroyStream;
+    pluginFuncs->asfile     = NPP_StreamAsFile;
+    pluginFuncs->writeready = NPP_WriteReady;
+    pluginFuncs->write      = NPP_Write;
+    pluginFuncs->print      = NPP_Print;
+    pluginFuncs->urlnotify  = NPP_URLNotify;
     pluginFuncs->event      = NULL;
-    pluginFuncs->getvalue   = NewNPP_GetValueProc(NPP_GetValue);
+    pluginFuncs->getvalue   = NPP_GetValue;
+    pluginFuncs->setvalue   = NPP_SetValue;
 #ifdef OJI
     pluginFuncs->javaClass  = NPP_GetJavaClass();
 #endif
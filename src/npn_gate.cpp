@@ -317,3 +317,17 @@ void NPN_SetException(NPObject* obj, const NPUTF8 *message)
 {
     NPNFuncs.setexception(obj, message);
 }
+
+bool NPN_HasPluginThreadAsyncCall()
+{
+    int navMinorVers = NPNFuncs.version & 0xFF;
+    return navMinorVers >= NPVERS_HAS_PLUGIN_THREAD_ASYNC_CALL &&
+           NPNFuncs.pluginthreadasynccall != NULL;
+}
+
+void NPN_PluginThreadAsyncCall(NPP instance, void (*func)(void *),
+                               void *userData)
+{
+    if( NPN_HasPluginThreadAsyncCall() )
+        NPNFuncs.pluginthreadasynccall(instance, func, userData);
+}
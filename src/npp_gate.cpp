@@ -47,7 +47,7 @@
 using namespace npvr;
 
 
-char*
+const char*
 NPP_GetMIMEDescription(void)
 {
   return "application/x-vnd-vr:.vr:VR plugin";
@@ -32,4 +32,8 @@
 
 extern NPNetscapeFuncs NPNFuncs;
 
+// Whether the browser provides NPN_PluginThreadAsyncCall; without it the
+// wrapper in npn_gate.cpp does nothing.
+bool NPN_HasPluginThreadAsyncCall();
+
 #endif  // NPVR_H_
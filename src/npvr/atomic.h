@@ -0,0 +1,107 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_ATOMIC_H_
+#define NPVR_ATOMIC_H_
+
+#include <npvr.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif  // _MSC_VER
+
+
+namespace npvr {
+
+// Minimal atomics for the few places that share state across threads (and,
+// for the seqlock, across processes). Kept free of the Oculus SDK so that
+// tools that do not link LibOVR can use them.
+
+// Returns the incremented value.
+inline int32_t AtomicIncrement(volatile int32_t* value) {
+#if defined(_MSC_VER)
+  return _InterlockedIncrement((volatile long*)value);
+#else
+  return __sync_add_and_fetch(value, 1);
+#endif  // _MSC_VER
+}
+
+// Returns the decremented value.
+inline int32_t AtomicDecrement(volatile int32_t* value) {
+#if defined(_MSC_VER)
+  return _InterlockedDecrement((volatile long*)value);
+#else
+  return __sync_sub_and_fetch(value, 1);
+#endif  // _MSC_VER
+}
+
+// Returns the value before the exchange; the exchange happened if it equals
+// expected.
+inline int32_t AtomicCompareExchange(volatile int32_t* value,
+                                     int32_t expected, int32_t desired) {
+#if defined(_MSC_VER)
+  return _InterlockedCompareExchange((volatile long*)value, desired, expected);
+#else
+  return __sync_val_compare_and_swap(value, expected, desired);
+#endif  // _MSC_VER
+}
+
+inline uint32_t AtomicLoadAcquire(const volatile uint32_t* value) {
+#if defined(_MSC_VER)
+  // Volatile reads have acquire semantics under MSVC.
+  uint32_t result = *value;
+  _ReadWriteBarrier();
+  return result;
+#else
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif  // _MSC_VER
+}
+
+inline void AtomicStoreRelease(volatile uint32_t* value, uint32_t new_value) {
+#if defined(_MSC_VER)
+  // Volatile writes have release semantics under MSVC.
+  _ReadWriteBarrier();
+  *value = new_value;
+#else
+  __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+#endif  // _MSC_VER
+}
+
+// Full barrier: no load or store moves across it in either direction.
+inline void AtomicFence() {
+#if defined(_MSC_VER)
+  MemoryBarrier();
+#else
+  __sync_synchronize();
+#endif  // _MSC_VER
+}
+
+// Keeps every load before it ahead of every load and store after it. All a
+// seqlock reader needs between copying the data and rechecking the
+// sequence, and free on x86, unlike AtomicFence.
+inline void AtomicFenceAcquire() {
+#if defined(_MSC_VER)
+  // x86 does not reorder loads with other loads; only the compiler might.
+  _ReadWriteBarrier();
+#else
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+#endif  // _MSC_VER
+}
+
+}  // namespace npvr
+
+
+#endif  // NPVR_ATOMIC_H_
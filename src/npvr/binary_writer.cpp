@@ -0,0 +1,94 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/binary_writer.h>
+
+
+using namespace npvr;
+
+
+BinaryWriter::BinaryWriter() :
+    buffer_(storage_), capacity_(kCapacity), length_(0), overflowed_(false) {
+}
+
+BinaryWriter::BinaryWriter(uint8_t* buffer, size_t capacity) :
+    buffer_(buffer), capacity_(capacity), length_(0), overflowed_(false) {
+}
+
+void BinaryWriter::Reset() {
+  length_ = 0;
+  overflowed_ = false;
+}
+
+void BinaryWriter::WriteUInt8(uint8_t value) {
+  if (length_ + 1 > capacity_) {
+    overflowed_ = true;
+    return;
+  }
+  buffer_[length_++] = value;
+}
+
+void BinaryWriter::WriteUInt16(uint16_t value) {
+  if (length_ + 2 > capacity_) {
+    overflowed_ = true;
+    return;
+  }
+  buffer_[length_++] = (uint8_t)(value);
+  buffer_[length_++] = (uint8_t)(value >> 8);
+}
+
+void BinaryWriter::WriteUInt32(uint32_t value) {
+  if (length_ + 4 > capacity_) {
+    overflowed_ = true;
+    return;
+  }
+  // Byte at a time so that the record is little-endian on any host.
+  buffer_[length_++] = (uint8_t)(value);
+  buffer_[length_++] = (uint8_t)(value >> 8);
+  buffer_[length_++] = (uint8_t)(value >> 16);
+  buffer_[length_++] = (uint8_t)(value >> 24);
+}
+
+void BinaryWriter::WriteFloat32(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  WriteUInt32(bits);
+}
+
+void BinaryWriter::PatchUInt8(size_t offset, uint8_t value) {
+  if (offset < length_) {
+    buffer_[offset] = value;
+  }
+}
+
+void BinaryWriter::PatchUInt32(size_t offset, uint32_t value) {
+  if (offset + 4 <= length_) {
+    buffer_[offset] = (uint8_t)(value);
+    buffer_[offset + 1] = (uint8_t)(value >> 8);
+    buffer_[offset + 2] = (uint8_t)(value >> 16);
+    buffer_[offset + 3] = (uint8_t)(value >> 24);
+  }
+}
+
+void BinaryWriter::Encode(char* out) const {
+  // Code point 0x100 + b is always the two byte sequence 110001xx 10xxxxxx.
+  for (size_t n = 0; n < length_; n++) {
+    uint8_t b = buffer_[n];
+    *out++ = (char)(0xC4 | (b >> 6));
+    *out++ = (char)(0x80 | (b & 0x3F));
+  }
+  *out = 0;
+}
@@ -0,0 +1,138 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_BINARY_WRITER_H_
+#define NPVR_BINARY_WRITER_H_
+
+#include <npvr.h>
+
+
+namespace npvr {
+
+// Binary poll record layout, version 2. All values are little-endian.
+//
+// Header (4b):
+//   u8  version                 kBinaryPollVersion
+//   u8  flags                   kBinaryPollFlag*
+//   u8  controller count
+//   u8  history sample count    zero unless kBinaryPollFlagSixenseHistory
+// Poll generation (4b, only if kBinaryPollFlagDelta is set):
+//   u32 generation              pass back to poll to get a delta record
+// HMD (20b, omitted if kBinaryPollFlagHmdUnchanged is set):
+//   u32 connection generation   bumped on every HMD attach and detach
+//   f32 orientation x, y, z, w  zero if no HMD is present
+// Predicted HMD (16b, only if kBinaryPollFlagHmdPredicted is set):
+//   f32 orientation x, y, z, w
+// HMD devices (only if kBinaryPollFlagHmdDevices is set, which it is only when
+// the poll asked for them):
+//   u8  device count
+//   u8  reserved x3
+// HMD device (44b, repeated device count times; every device past the first,
+// or in a delta record only the ones that changed):
+//   u8  device index            1 to kMaxHmdDevices - 1
+//   u8  flags                   kBinaryHmdDeviceFlag*
+//   u16 reserved
+//   u32 serial id               hash of the serial, zero if unknown
+//   u32 connection generation
+//   f32 orientation x, y, z, w  zero if not present
+//   f32 predicted x, y, z, w    zero unless kBinaryHmdDeviceFlagPredicted
+// Controller (48b, repeated controller count times; in a delta record only the
+// controllers that changed):
+//   u8  base
+//   u8  controller
+//   u8  hand
+//   u8  flags                   kBinaryControllerFlag*
+//   f32 position x, y, z
+//   f32 rotation x, y, z, w
+//   f32 joystick x, y
+//   f32 trigger
+//   u32 buttons
+// History sample (48b, repeated history sample count times, oldest first per
+// controller):
+//   u8  base
+//   u8  controller
+//   u8  sequence number
+//   u8  flags                   kBinaryControllerFlag*
+//   f32 position, rotation, joystick, trigger, u32 buttons as above
+//
+// NPStrings must be valid UTF-8 and cannot contain NULs, so each record byte
+// is sent as the code point 0x100 + byte. Javascript reads it back with
+// charCodeAt(i) & 0xFF. The first character is always > 0xFF, which lets the
+// caller tell binary records apart from the text format.
+//
+// A delta record is relative to the record that returned its generation and
+// leaves out anything that has not changed since. The flags are always
+// current; history samples are always the ones since the previous poll.
+const uint8_t kBinaryPollVersion = 2;
+const uint8_t kBinaryPollFlagHmdPresent = 1 << 0;
+const uint8_t kBinaryPollFlagSixensePresent = 1 << 1;
+const uint8_t kBinaryPollFlagHmdPredicted = 1 << 2;
+const uint8_t kBinaryPollFlagSixenseHistory = 1 << 3;
+const uint8_t kBinaryPollFlagDelta = 1 << 4;
+const uint8_t kBinaryPollFlagHmdUnchanged = 1 << 5;
+const uint8_t kBinaryPollFlagHmdDevices = 1 << 6;
+const uint8_t kBinaryControllerFlagDocked = 1 << 0;
+const uint8_t kBinaryControllerFlagHemiTracking = 1 << 1;
+const uint8_t kBinaryHmdDeviceFlagPresent = 1 << 0;
+const uint8_t kBinaryHmdDeviceFlagPredicted = 1 << 1;
+const size_t kBinaryPollHeaderSize = 4 + 4 + 4 * 4;
+const size_t kBinaryPollPredictedSize = 4 * 4;
+const size_t kBinaryPollControllerSize = 4 + 10 * 4 + 4;
+const size_t kBinaryPollHmdDeviceSize = 4 + 4 + 4 + 8 * 4;
+
+class BinaryWriter {
+public:
+  // Writes into storage of its own, enough for any poll record.
+  BinaryWriter();
+  // Writes into a caller-owned buffer, for records too large for that.
+  BinaryWriter(uint8_t* buffer, size_t capacity);
+
+  void Reset();
+  size_t length() const { return length_; }
+  bool overflowed() const { return overflowed_; }
+
+  void WriteUInt8(uint8_t value);
+  void WriteUInt16(uint16_t value);
+  void WriteUInt32(uint32_t value);
+  void WriteFloat32(float value);
+  void PatchUInt8(size_t offset, uint8_t value);
+  void PatchUInt32(size_t offset, uint32_t value);
+
+  // Number of bytes Encode will write, excluding the trailing NUL.
+  size_t encoded_length() const { return length_ * 2; }
+  // Encodes the record as UTF-8 into the given buffer, which must have room
+  // for encoded_length() + 1 bytes.
+  void Encode(char* out) const;
+
+private:
+  // Large enough for the header, every HMD device, 4 bases * 4 controllers
+  // and a full poll of history samples.
+  static const size_t kCapacity = 4 * 1024;
+
+  uint8_t*  buffer_;
+  size_t    capacity_;
+  size_t    length_;
+  bool      overflowed_;
+  uint8_t   storage_[kCapacity];
+
+  BinaryWriter(const BinaryWriter&);
+  void operator=(const BinaryWriter&);
+};
+
+}  // namespace npvr
+
+
+#endif  // NPVR_BINARY_WRITER_H_
@@ -0,0 +1,355 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/capture.h>
+
+#include <npvr/clock.h>
+
+#include <stdlib.h>
+
+#if !defined(XP_WIN)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // !XP_WIN
+
+
+using namespace npvr;
+
+
+namespace {
+
+const char kCaptureMagic[8] = { 'N', 'P', 'V', 'R', 'C', 'A', 'P', 0 };
+
+struct FileHeader {
+  char      magic[8];
+  uint32_t  version;
+  uint32_t  header_size;
+  uint64_t  start_time;
+};
+
+struct RecordHeader {
+  uint64_t  timestamp;
+  uint16_t  type;
+  uint16_t  size;
+  uint32_t  reserved;
+};
+
+size_t PaddedSize(size_t size) {
+  return (size + 7) & ~(size_t)7;
+}
+
+}  // namespace
+
+
+CaptureWriter::CaptureWriter() :
+    file_(NULL),
+    start_time_(0),
+    flush_time_(0) {
+}
+
+CaptureWriter::~CaptureWriter() {
+  Close();
+}
+
+CaptureWriter* CaptureWriter::Instance() {
+  static CaptureWriter* instance = NULL;
+  static bool initialized = false;
+  if (!initialized) {
+    initialized = true;
+    const char* path = getenv("NPVR_CAPTURE");
+    if (path && *path) {
+      instance = new CaptureWriter();
+      if (!instance->Open(path)) {
+        delete instance;
+        instance = NULL;
+      }
+    }
+  }
+  return instance;
+}
+
+bool CaptureWriter::Open(const char* path) {
+  Close();
+  FILE* file = fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+  // Records are small and frequent; let stdio batch them between the
+  // periodic flushes in Write.
+  setvbuf(file, NULL, _IOFBF, 64 * 1024);
+
+  FileHeader header;
+  memcpy(header.magic, kCaptureMagic, sizeof(header.magic));
+  header.version = kCaptureVersion;
+  header.header_size = sizeof(FileHeader);
+  header.start_time = NowNanos();
+  if (fwrite(&header, sizeof(header), 1, file) != 1) {
+    fclose(file);
+    return false;
+  }
+
+  MutexLock lock(&mutex_);
+  file_ = file;
+  start_time_ = header.start_time;
+  flush_time_ = header.start_time;
+  return true;
+}
+
+void CaptureWriter::Close() {
+  MutexLock lock(&mutex_);
+  if (file_) {
+    fclose(file_);
+    file_ = NULL;
+  }
+}
+
+void CaptureWriter::WriteHmdInfo(const CaptureHmdInfo& info) {
+  Write(kCaptureRecordHmdInfo, &info, sizeof(info));
+}
+
+void CaptureWriter::WriteImuSample(const FusionSample& sample) {
+  Write(kCaptureRecordImuSample, &sample, sizeof(sample));
+}
+
+void CaptureWriter::WriteHmdPose(const CaptureHmdPose& pose) {
+  Write(kCaptureRecordHmdPose, &pose, sizeof(pose));
+}
+
+void CaptureWriter::WriteSixenseFrame(const SixenseFrame& frame) {
+  Write(kCaptureRecordSixenseFrame, &frame, sizeof(frame));
+}
+
+void CaptureWriter::Write(CaptureRecordType type, const void* payload,
+                          uint16_t size) {
+  static const uint8_t kPadding[8] = { 0 };
+  uint64_t now = NowNanos();
+
+  MutexLock lock(&mutex_);
+  if (!file_) {
+    return;
+  }
+  RecordHeader header;
+  // Threads race to the lock, so a record can be stamped slightly before
+  // the one written ahead of it; readers must not assume strict ordering.
+  header.timestamp = now > start_time_ ? now - start_time_ : 0;
+  header.type = (uint16_t)type;
+  header.size = size;
+  header.reserved = 0;
+  fwrite(&header, sizeof(header), 1, file_);
+  fwrite(payload, size, 1, file_);
+  fwrite(kPadding, PaddedSize(size) - size, 1, file_);
+  if (now >= flush_time_ + kCaptureFlushIntervalNanos) {
+    fflush(file_);
+    flush_time_ = now;
+  }
+}
+
+
+CaptureReader::CaptureReader() :
+    data_(NULL),
+    size_(0),
+    offset_(0) {
+#if defined(XP_WIN)
+  file_ = INVALID_HANDLE_VALUE;
+  mapping_ = NULL;
+#endif  // XP_WIN
+}
+
+CaptureReader::~CaptureReader() {
+  Close();
+}
+
+bool CaptureReader::Open(const char* path) {
+  Close();
+
+#if defined(XP_WIN)
+  file_ = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file_ == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file_, &size) || size.QuadPart < (LONGLONG)sizeof(FileHeader)) {
+    Close();
+    return false;
+  }
+  mapping_ = CreateFileMapping(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!mapping_) {
+    Close();
+    return false;
+  }
+  data_ = (const uint8_t*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+  size_ = (size_t)size.QuadPart;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) || (size_t)st.st_size < sizeof(FileHeader)) {
+    close(fd);
+    return false;
+  }
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file alive.
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  data_ = (const uint8_t*)data;
+  size_ = st.st_size;
+#endif  // XP_WIN
+  if (!data_) {
+    Close();
+    return false;
+  }
+
+  const FileHeader* header = (const FileHeader*)data_;
+  if (memcmp(header->magic, kCaptureMagic, sizeof(kCaptureMagic)) ||
+      header->version != kCaptureVersion ||
+      header->header_size < sizeof(FileHeader) ||
+      header->header_size > size_) {
+    Close();
+    return false;
+  }
+  Rewind();
+  return true;
+}
+
+void CaptureReader::Close() {
+#if defined(XP_WIN)
+  if (data_) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_) {
+    CloseHandle(mapping_);
+    mapping_ = NULL;
+  }
+  if (file_ != INVALID_HANDLE_VALUE) {
+    CloseHandle(file_);
+    file_ = INVALID_HANDLE_VALUE;
+  }
+#else
+  if (data_) {
+    munmap((void*)data_, size_);
+  }
+#endif  // XP_WIN
+  data_ = NULL;
+  size_ = 0;
+  offset_ = 0;
+}
+
+bool CaptureReader::Next(CaptureRecord* out_record) {
+  if (!data_ || size_ - offset_ < sizeof(RecordHeader)) {
+    return false;
+  }
+  const RecordHeader* header = (const RecordHeader*)(data_ + offset_);
+  size_t payload_offset = offset_ + sizeof(RecordHeader);
+  if (size_ - payload_offset < header->size) {
+    return false;
+  }
+  out_record->timestamp = header->timestamp;
+  out_record->type = header->type;
+  out_record->size = header->size;
+  out_record->data = data_ + payload_offset;
+  offset_ = payload_offset + PaddedSize(header->size);
+  if (offset_ > size_) {
+    // Final record's padding was cut off; the payload itself is whole.
+    offset_ = size_;
+  }
+  return true;
+}
+
+void CaptureReader::Rewind() {
+  offset_ = data_ ? ((const FileHeader*)data_)->header_size : 0;
+}
+
+
+CapturePlayer::CapturePlayer(CaptureReader* reader, bool realtime) :
+    reader_(reader),
+    realtime_(realtime),
+    started_(false),
+    start_time_(0),
+    has_pending_(false),
+    record_count_(0) {
+}
+
+bool CapturePlayer::Step(CaptureSink* sink) {
+  if (!started_) {
+    started_ = true;
+    start_time_ = NowNanos();
+  }
+  if (!has_pending_) {
+    has_pending_ = reader_->Next(&pending_);
+    if (!has_pending_) {
+      return false;
+    }
+  }
+  if (!realtime_) {
+    Dispatch(pending_, sink);
+    has_pending_ = false;
+    return true;
+  }
+
+  uint64_t elapsed = NowNanos() - start_time_;
+  while (pending_.timestamp <= elapsed) {
+    Dispatch(pending_, sink);
+    has_pending_ = reader_->Next(&pending_);
+    if (!has_pending_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void CapturePlayer::Dispatch(const CaptureRecord& record, CaptureSink* sink) {
+  record_count_++;
+  switch (record.type) {
+    case kCaptureRecordHmdInfo:
+      if (record.size == sizeof(CaptureHmdInfo)) {
+        sink->OnHmdInfo(*(const CaptureHmdInfo*)record.data);
+      }
+      break;
+    case kCaptureRecordImuSample:
+      if (record.size == sizeof(FusionSample)) {
+        sink->OnImuSample(*(const FusionSample*)record.data);
+      }
+      break;
+    case kCaptureRecordHmdPose:
+      if (record.size == sizeof(CaptureHmdPose)) {
+        sink->OnHmdPose(*(const CaptureHmdPose*)record.data);
+      }
+      break;
+    case kCaptureRecordSixenseFrame:
+      if (record.size == sizeof(SixenseFrame)) {
+        sink->OnSixenseFrame(*(const SixenseFrame*)record.data);
+      }
+      break;
+  }
+}
+
+
+const char* npvr::GetReplayPath() {
+  const char* path = getenv("NPVR_REPLAY");
+  return path && *path ? path : NULL;
+}
+
+bool npvr::IsReplayRealtime() {
+  const char* speed = getenv("NPVR_REPLAY_SPEED");
+  return !speed || strcmp(speed, "fast");
+}
@@ -0,0 +1,195 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_CAPTURE_H_
+#define NPVR_CAPTURE_H_
+
+#include <npvr.h>
+#include <npvr/fusion_engine.h>
+#include <npvr/sixense_frame.h>
+#include <npvr/thread.h>
+
+
+namespace npvr {
+
+// Capture file layout, version 1. Native (little-endian) byte order.
+//
+// File header (24b):
+//   char magic[8]               "NPVRCAP\0"
+//   u32  version                kCaptureVersion
+//   u32  header size            24; records start here
+//   u64  start time             NowNanos() when the capture began
+// Record (16b header, repeated until end of file):
+//   u64  timestamp              nanoseconds since the start time
+//   u16  type                   kCaptureRecord*
+//   u16  payload size           bytes, excluding padding
+//   u32  reserved
+//   payload, zero padded to a multiple of 8 bytes
+//
+// Files are append-only and records self-delimiting, so a capture cut short
+// by a crash replays up to its last complete record. The writer flushes at
+// least every kCaptureFlushIntervalNanos while records arrive, so a crash
+// loses no more than that much of the capture. Payloads are 8-byte
+// aligned in the file and in a mapping of it, so readers use them in place.
+const uint32_t kCaptureVersion = 1;
+const uint64_t kCaptureFlushIntervalNanos = 100000000;
+
+enum CaptureRecordType {
+  // CaptureHmdInfo, whenever an HMD is attached.
+  kCaptureRecordHmdInfo = 1,
+  // FusionSample, for every raw tracker sample.
+  kCaptureRecordImuSample = 2,
+  // CaptureHmdPose, for every fused pose the sampling thread publishes.
+  kCaptureRecordHmdPose = 3,
+  // SixenseFrame, for every controller frame poll returns.
+  kCaptureRecordSixenseFrame = 4,
+};
+
+// The OVR::HMDInfo fields exec reports, in SDK-independent form.
+struct CaptureHmdInfo {
+  char      product_name[32];
+  char      manufacturer[32];
+  uint32_t  version;
+  int32_t   desktop_x;
+  int32_t   desktop_y;
+  uint32_t  h_resolution;
+  uint32_t  v_resolution;
+  float     h_screen_size;
+  float     v_screen_size;
+  float     v_screen_center;
+  float     eye_to_screen_distance;
+  float     lens_separation_distance;
+  float     interpupillary_distance;
+  float     distortion_k[4];
+  float     chroma_ab_correction[4];
+};
+
+// Mirrors HmdSnapshot without the timestamp, which the record carries.
+struct CaptureHmdPose {
+  float orientation[4];
+  float angular_velocity[3];
+  float angular_acceleration[3];
+  float acceleration[3];
+};
+
+// Appends records to a capture file. Thread safe; the sensor, sampling and
+// browser threads all write to the same file.
+class CaptureWriter {
+public:
+  CaptureWriter();
+  ~CaptureWriter();
+
+  // The process-wide writer, opened on first call from the path in the
+  // NPVR_CAPTURE environment variable. NULL when capture is off. Call once
+  // before starting threads that may use it.
+  static CaptureWriter* Instance();
+
+  bool Open(const char* path);
+  void Close();
+  bool is_open() const { return file_ != NULL; }
+
+  void WriteHmdInfo(const CaptureHmdInfo& info);
+  void WriteImuSample(const FusionSample& sample);
+  void WriteHmdPose(const CaptureHmdPose& pose);
+  void WriteSixenseFrame(const SixenseFrame& frame);
+
+private:
+  void Write(CaptureRecordType type, const void* payload, uint16_t size);
+
+  Mutex     mutex_;
+  FILE*     file_;
+  uint64_t  start_time_;
+  uint64_t  flush_time_;
+};
+
+// A record as found in the file. data points into the mapping.
+struct CaptureRecord {
+  uint64_t    timestamp;
+  uint16_t    type;
+  uint16_t    size;
+  const void* data;
+};
+
+// Read-only memory mapping of a capture file.
+class CaptureReader {
+public:
+  CaptureReader();
+  ~CaptureReader();
+
+  // Maps the file and checks its header.
+  bool Open(const char* path);
+  void Close();
+
+  // Steps to the next record. Returns false at the end of the file or at a
+  // truncated record.
+  bool Next(CaptureRecord* out_record);
+  void Rewind();
+
+private:
+  const uint8_t*  data_;
+  size_t          size_;
+  size_t          offset_;
+#if defined(XP_WIN)
+  HANDLE          file_;
+  HANDLE          mapping_;
+#endif  // XP_WIN
+};
+
+// Receives replayed records. Records of unknown type or unexpected size are
+// skipped before reaching it.
+class CaptureSink {
+public:
+  virtual ~CaptureSink() {}
+  virtual void OnHmdInfo(const CaptureHmdInfo& info) {}
+  virtual void OnImuSample(const FusionSample& sample) {}
+  virtual void OnHmdPose(const CaptureHmdPose& pose) {}
+  virtual void OnSixenseFrame(const SixenseFrame& frame) {}
+};
+
+// Feeds a capture to a sink, either paced to the capture's own timestamps or
+// as fast as the sink can take it.
+class CapturePlayer {
+public:
+  CapturePlayer(CaptureReader* reader, bool realtime);
+
+  // Delivers every record that is due: all records up to the current
+  // replay time when realtime, otherwise the next one. Returns false once
+  // the capture is exhausted.
+  bool Step(CaptureSink* sink);
+
+  uint64_t record_count() const { return record_count_; }
+
+private:
+  void Dispatch(const CaptureRecord& record, CaptureSink* sink);
+
+  CaptureReader*  reader_;
+  bool            realtime_;
+  bool            started_;
+  uint64_t        start_time_;
+  bool            has_pending_;
+  CaptureRecord   pending_;
+  uint64_t        record_count_;
+};
+
+// Path from NPVR_REPLAY, or NULL when not replaying.
+const char* GetReplayPath();
+// True unless NPVR_REPLAY_SPEED=fast.
+bool IsReplayRealtime();
+
+}  // namespace npvr
+
+
+#endif  // NPVR_CAPTURE_H_
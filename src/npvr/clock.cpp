@@ -0,0 +1,60 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/clock.h>
+
+#if defined(XP_MACOSX)
+#include <mach/mach_time.h>
+#include <unistd.h>
+#elif !defined(XP_WIN)
+#include <time.h>
+#include <unistd.h>
+#endif
+
+
+uint64_t npvr::NowNanos() {
+#if defined(XP_WIN)
+  static LARGE_INTEGER frequency = { 0 };
+  if (!frequency.QuadPart) {
+    QueryPerformanceFrequency(&frequency);
+  }
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  // Split to avoid overflowing 64 bits on long uptimes.
+  uint64_t seconds = counter.QuadPart / frequency.QuadPart;
+  uint64_t remainder = counter.QuadPart % frequency.QuadPart;
+  return seconds * 1000000000ull +
+      remainder * 1000000000ull / frequency.QuadPart;
+#elif defined(XP_MACOSX)
+  static mach_timebase_info_data_t timebase = { 0, 0 };
+  if (!timebase.denom) {
+    mach_timebase_info(&timebase);
+  }
+  return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+void npvr::SleepMicros(uint32_t micros) {
+#if defined(XP_WIN)
+  Sleep(micros / 1000);
+#else
+  usleep(micros);
+#endif
+}
@@ -0,0 +1,37 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_CLOCK_H_
+#define NPVR_CLOCK_H_
+
+#include <npvr.h>
+
+
+namespace npvr {
+
+// Monotonic time in nanoseconds from an arbitrary epoch. Not affected by
+// wall clock changes; only meaningful relative to other NowNanos() values,
+// which may come from other processes on the same machine.
+uint64_t NowNanos();
+
+// Sleeps the calling thread for at least the given number of microseconds.
+// Resolution is platform dependent (1ms on Windows).
+void SleepMicros(uint32_t micros);
+
+}  // namespace npvr
+
+
+#endif  // NPVR_CLOCK_H_
@@ -0,0 +1,287 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <npvr/distortion.h>
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NPVR_DISTORTION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+using namespace npvr;
+
+
+namespace {
+
+// k0 + k1 r^2 + k2 r^4 + k3 r^6 and its derivative over r of r times it,
+// k0 + 3 k1 r^2 + 5 k2 r^4 + 7 k3 r^6, in Horner form. The SSE2 path
+// evaluates them in the same order so that the two agree bit for bit.
+inline float Polynomial(const float* k, float r_sq) {
+  return k[0] + r_sq * (k[1] + r_sq * (k[2] + r_sq * k[3]));
+}
+
+inline float Derivative(const float* k, float r_sq) {
+  return k[0] + r_sq * (3 * k[1] + r_sq * (5 * k[2] + r_sq * (7 * k[3])));
+}
+
+float Undistort(const float* k, float distorted_r) {
+  float r = distorted_r / k[0];
+  for (int n = 0; n < kMaxUndistortIterations; n++) {
+    float r_sq = r * r;
+    float error = r * Polynomial(k, r_sq) - distorted_r;
+    if (fabsf(error) <= kUndistortTolerance * fabsf(distorted_r)) {
+      break;
+    }
+    r = r - error / Derivative(k, r_sq);
+  }
+  return r;
+}
+
+void WarpPointsScalar(const WarpParams& params, const float* points,
+                      size_t count, float* out_points) {
+  const float* k = params.distortion_k;
+  for (size_t n = 0; n < count * 2; n += 2) {
+    float x = (points[n] - params.lens_center[0]) * params.scale_in[0];
+    float y = (points[n + 1] - params.lens_center[1]) * params.scale_in[1];
+    float distortion = Polynomial(k, x * x + y * y);
+    out_points[n] = params.lens_center[0] + params.scale[0] * x * distortion;
+    out_points[n + 1] =
+        params.lens_center[1] + params.scale[1] * y * distortion;
+  }
+}
+
+void UnwarpPointsScalar(const WarpParams& params, const float* points,
+                        size_t count, float* out_points) {
+  // Back out the distorted radius, undistort it and scale the point along
+  // the same direction from the lens center.
+  const float* k = params.distortion_k;
+  for (size_t n = 0; n < count * 2; n += 2) {
+    float x = (points[n] - params.lens_center[0]) / params.scale[0];
+    float y = (points[n + 1] - params.lens_center[1]) / params.scale[1];
+    float distorted_r = sqrtf(x * x + y * y);
+    float r = Undistort(k, distorted_r);
+    float factor = distorted_r > 0 ? r / distorted_r : 0;
+    out_points[n] = params.lens_center[0] + x * factor / params.scale_in[0];
+    out_points[n + 1] =
+        params.lens_center[1] + y * factor / params.scale_in[1];
+  }
+}
+
+#if defined(NPVR_DISTORTION_SSE2)
+// The coefficients of Polynomial and Derivative, splatted.
+struct Coefficients {
+  explicit Coefficients(const float* k) {
+    for (int n = 0; n < 4; n++) {
+      k_[n] = _mm_set1_ps(k[n]);
+      dk_[n] = _mm_set1_ps((2 * n + 1) * k[n]);
+    }
+  }
+  __m128 Polynomial(__m128 r_sq) const {
+    return _mm_add_ps(k_[0], _mm_mul_ps(r_sq, _mm_add_ps(k_[1],
+        _mm_mul_ps(r_sq, _mm_add_ps(k_[2], _mm_mul_ps(r_sq, k_[3]))))));
+  }
+  __m128 Derivative(__m128 r_sq) const {
+    return _mm_add_ps(dk_[0], _mm_mul_ps(r_sq, _mm_add_ps(dk_[1],
+        _mm_mul_ps(r_sq, _mm_add_ps(dk_[2], _mm_mul_ps(r_sq, dk_[3]))))));
+  }
+  __m128 k_[4];
+  __m128 dk_[4];
+};
+
+__m128 Abs(__m128 v) {
+  return _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)));
+}
+
+// Lanes that have converged keep their value while the others iterate, so
+// each lane stops where Undistort would.
+__m128 UndistortSse2(const Coefficients& c, __m128 distorted_r) {
+  __m128 r = _mm_div_ps(distorted_r, c.k_[0]);
+  __m128 tolerance =
+      _mm_mul_ps(_mm_set1_ps(kUndistortTolerance), Abs(distorted_r));
+  for (int n = 0; n < kMaxUndistortIterations; n++) {
+    __m128 r_sq = _mm_mul_ps(r, r);
+    __m128 error =
+        _mm_sub_ps(_mm_mul_ps(r, c.Polynomial(r_sq)), distorted_r);
+    __m128 active = _mm_cmpgt_ps(Abs(error), tolerance);
+    if (!_mm_movemask_ps(active)) {
+      break;
+    }
+    __m128 step = _mm_div_ps(error, c.Derivative(r_sq));
+    r = _mm_sub_ps(r, _mm_and_ps(active, step));
+  }
+  return r;
+}
+
+void DistortRadiiSse2(const float* k, const float* radii, size_t count,
+                      float* out_radii) {
+  Coefficients c(k);
+  for (size_t n = 0; n < count; n += 4) {
+    __m128 r = _mm_loadu_ps(radii + n);
+    _mm_storeu_ps(out_radii + n,
+                  _mm_mul_ps(r, c.Polynomial(_mm_mul_ps(r, r))));
+  }
+}
+
+void UndistortRadiiSse2(const float* k, const float* radii, size_t count,
+                        float* out_radii) {
+  Coefficients c(k);
+  for (size_t n = 0; n < count; n += 4) {
+    _mm_storeu_ps(out_radii + n, UndistortSse2(c, _mm_loadu_ps(radii + n)));
+  }
+}
+
+// Four x, y pairs at a time, split into x and y vectors.
+void LoadPoints(const float* points, __m128* x, __m128* y) {
+  __m128 a = _mm_loadu_ps(points);
+  __m128 b = _mm_loadu_ps(points + 4);
+  *x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+  *y = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+}
+
+void StorePoints(__m128 x, __m128 y, float* out_points) {
+  _mm_storeu_ps(out_points, _mm_unpacklo_ps(x, y));
+  _mm_storeu_ps(out_points + 4, _mm_unpackhi_ps(x, y));
+}
+
+void WarpPointsSse2(const WarpParams& params, const float* points,
+                    size_t count, float* out_points) {
+  Coefficients c(params.distortion_k);
+  __m128 center_x = _mm_set1_ps(params.lens_center[0]);
+  __m128 center_y = _mm_set1_ps(params.lens_center[1]);
+  __m128 scale_x = _mm_set1_ps(params.scale[0]);
+  __m128 scale_y = _mm_set1_ps(params.scale[1]);
+  __m128 scale_in_x = _mm_set1_ps(params.scale_in[0]);
+  __m128 scale_in_y = _mm_set1_ps(params.scale_in[1]);
+  for (size_t n = 0; n < count * 2; n += 8) {
+    __m128 x;
+    __m128 y;
+    LoadPoints(points + n, &x, &y);
+    x = _mm_mul_ps(_mm_sub_ps(x, center_x), scale_in_x);
+    y = _mm_mul_ps(_mm_sub_ps(y, center_y), scale_in_y);
+    __m128 distortion = c.Polynomial(
+        _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+    x = _mm_add_ps(center_x, _mm_mul_ps(_mm_mul_ps(scale_x, x), distortion));
+    y = _mm_add_ps(center_y, _mm_mul_ps(_mm_mul_ps(scale_y, y), distortion));
+    StorePoints(x, y, out_points + n);
+  }
+}
+
+void UnwarpPointsSse2(const WarpParams& params, const float* points,
+                      size_t count, float* out_points) {
+  Coefficients c(params.distortion_k);
+  __m128 center_x = _mm_set1_ps(params.lens_center[0]);
+  __m128 center_y = _mm_set1_ps(params.lens_center[1]);
+  __m128 scale_x = _mm_set1_ps(params.scale[0]);
+  __m128 scale_y = _mm_set1_ps(params.scale[1]);
+  __m128 scale_in_x = _mm_set1_ps(params.scale_in[0]);
+  __m128 scale_in_y = _mm_set1_ps(params.scale_in[1]);
+  __m128 zero = _mm_setzero_ps();
+  for (size_t n = 0; n < count * 2; n += 8) {
+    __m128 x;
+    __m128 y;
+    LoadPoints(points + n, &x, &y);
+    x = _mm_div_ps(_mm_sub_ps(x, center_x), scale_x);
+    y = _mm_div_ps(_mm_sub_ps(y, center_y), scale_y);
+    __m128 distorted_r =
+        _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+    __m128 r = UndistortSse2(c, distorted_r);
+    // Zero at the lens center, where the division is 0 / 0.
+    __m128 factor = _mm_and_ps(_mm_cmpgt_ps(distorted_r, zero),
+                               _mm_div_ps(r, distorted_r));
+    x = _mm_add_ps(center_x,
+                   _mm_div_ps(_mm_mul_ps(x, factor), scale_in_x));
+    y = _mm_add_ps(center_y,
+                   _mm_div_ps(_mm_mul_ps(y, factor), scale_in_y));
+    StorePoints(x, y, out_points + n);
+  }
+}
+#endif  // NPVR_DISTORTION_SSE2
+
+}  // namespace
+
+
+bool npvr::DistortionSimdSupported() {
+#if defined(NPVR_DISTORTION_SSE2)
+  return true;
+#else
+  return false;
+#endif  // NPVR_DISTORTION_SSE2
+}
+
+float npvr::DistortRadius(const float k[4], float r) {
+  return r * Polynomial(k, r * r);
+}
+
+float npvr::UndistortRadius(const float k[4], float distorted_r) {
+  return Undistort(k, distorted_r);
+}
+
+void npvr::DistortRadii(const float k[4], const float* radii, size_t count,
+                        float* out_radii, bool use_simd) {
+  size_t n = 0;
+#if defined(NPVR_DISTORTION_SSE2)
+  if (use_simd) {
+    n = count & ~(size_t)3;
+    DistortRadiiSse2(k, radii, n, out_radii);
+  }
+#endif  // NPVR_DISTORTION_SSE2
+  for (; n < count; n++) {
+    out_radii[n] = radii[n] * Polynomial(k, radii[n] * radii[n]);
+  }
+}
+
+void npvr::UndistortRadii(const float k[4], const float* radii, size_t count,
+                          float* out_radii, bool use_simd) {
+  size_t n = 0;
+#if defined(NPVR_DISTORTION_SSE2)
+  if (use_simd) {
+    n = count & ~(size_t)3;
+    UndistortRadiiSse2(k, radii, n, out_radii);
+  }
+#endif  // NPVR_DISTORTION_SSE2
+  for (; n < count; n++) {
+    out_radii[n] = Undistort(k, radii[n]);
+  }
+}
+
+void npvr::WarpPoints(const WarpParams& params, const float* points,
+                      size_t count, float* out_points, bool use_simd) {
+  size_t n = 0;
+#if defined(NPVR_DISTORTION_SSE2)
+  if (use_simd) {
+    n = count & ~(size_t)3;
+    WarpPointsSse2(params, points, n, out_points);
+  }
+#endif  // NPVR_DISTORTION_SSE2
+  WarpPointsScalar(params, points + n * 2, count - n, out_points + n * 2);
+}
+
+void npvr::UnwarpPoints(const WarpParams& params, const float* points,
+                        size_t count, float* out_points, bool use_simd) {
+  size_t n = 0;
+#if defined(NPVR_DISTORTION_SSE2)
+  if (use_simd) {
+    n = count & ~(size_t)3;
+    UnwarpPointsSse2(params, points, n, out_points);
+  }
+#endif  // NPVR_DISTORTION_SSE2
+  UnwarpPointsScalar(params, points + n * 2, count - n, out_points + n * 2);
+}
@@ -0,0 +1,68 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef NPVR_DISTORTION_H_
+#define NPVR_DISTORTION_H_
+
+#include <npvr.h>
+#include <npvr/warp_mesh.h>
+
+
+namespace npvr {
+
+// Batch kernels for the radial lens distortion the warp applies,
+//   distort(r) = r * (k0 + k1 r^2 + k2 r^4 + k3 r^6)
+// as vr.HmdInfo.prototype.distort evaluates it one value at a time, and for
+// its inverse. Each takes use_simd to select the SSE2 path when it is
+// compiled in; the scalar path is the reference it must match.
+
+// Most Newton iterations the inverse takes per value. It starts from
+// r = d / k0, which with non-negative coefficients (every HMD's) lies above
+// the root, and the polynomial is convex there, so each step closes in from
+// above. The far corner of a DK1 eye needs 9.
+const int kMaxUndistortIterations = 10;
+// The inverse stops once distort(r) is within this fraction of the distorted
+// radius.
+const float kUndistortTolerance = 1e-6f;
+
+bool DistortionSimdSupported();
+
+float DistortRadius(const float k[4], float r);
+// Returns r such that DistortRadius(k, r) is distorted_r, to within
+// kUndistortTolerance or the closest kMaxUndistortIterations got.
+float UndistortRadius(const float k[4], float distorted_r);
+
+// Distort or undistort count radii from radii into out_radii, which may be
+// the same array.
+void DistortRadii(const float k[4], const float* radii, size_t count,
+                  float* out_radii, bool use_simd = true);
+void UndistortRadii(const float k[4], const float* radii, size_t count,
+                    float* out_radii, bool use_simd = true);
+
+// Map count x, y pairs through the warp for one eye, as the green channel of
+// WarpTexCoord does: from screen to render target texture coordinates, or
+// back with UnwarpPoints. Both are in [0-1] across the whole render target.
+// points and out_points may be the same array.
+void WarpPoints(const WarpParams& params, const float* points, size_t count,
+                float* out_points, bool use_simd = true);
+void UnwarpPoints(const WarpParams& params, const float* points, size_t count,
+                  float* out_points, bool use_simd = true);
+
+}  // namespace npvr
+
+
+#endif  // NPVR_DISTORTION_H_
@@ -0,0 +1,248 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/fusion_engine.h>
+
+#include <math.h>
+
+
+using namespace npvr;
+
+
+namespace {
+
+const float kGravity = 9.81f;
+const float kPi = 3.14159265f;
+
+// The tracker counts as still when the accelerometer reads gravity alone and
+// the gyro is nearly quiet, for kStillPeriod samples in a row.
+const float kGravityEpsilon = 0.4f;
+const float kAngularVelocityEpsilon = 0.1f;
+const uint32_t kStillPeriod = 50;
+
+// Weight of each sample in the world-frame running means; roughly a 20
+// sample window.
+const float kMeanWeight = 0.1f;
+
+// Tilt errors are picked up above kMaxTiltError and corrected down to
+// kMinTiltError. Large errors right after a reset are corrected at once.
+const float kMaxTiltError = 0.05f;
+const float kMinTiltError = 0.01f;
+const float kSnapTiltError = 0.4f;
+const uint32_t kSnapTiltSamples = 2000;
+const float kTiltGain = 0.05f * 0.005f;
+
+// Fraction of the heading error removed per sample.
+const float kYawGain = 0.0005f;
+const float kMinYawError = 0.002f;
+// Below this horizontal field strength, in gauss, the heading is noise.
+const float kMinHorizontalField = 0.05f;
+
+const uint32_t kNormalizeInterval = 100;
+
+float Length(const float v[3]) {
+  return sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+}
+
+// out = a * b. out may alias either input.
+void QuatMultiply(const float a[4], const float b[4], float out[4]) {
+  float x = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+  float y = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+  float z = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+  float w = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+  out[0] = x;
+  out[1] = y;
+  out[2] = z;
+  out[3] = w;
+}
+
+// Rotates v by the unit quaternion q.
+void QuatRotate(const float q[4], const float v[3], float out[3]) {
+  // t = 2 * cross(q.xyz, v); out = v + q.w * t + cross(q.xyz, t)
+  float tx = 2 * (q[1] * v[2] - q[2] * v[1]);
+  float ty = 2 * (q[2] * v[0] - q[0] * v[2]);
+  float tz = 2 * (q[0] * v[1] - q[1] * v[0]);
+  out[0] = v[0] + q[3] * tx + q[1] * tz - q[2] * ty;
+  out[1] = v[1] + q[3] * ty + q[2] * tx - q[0] * tz;
+  out[2] = v[2] + q[3] * tz + q[0] * ty - q[1] * tx;
+}
+
+void QuatNormalize(float q[4]) {
+  float length = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+  if (length > 0) {
+    float inv = 1 / length;
+    q[0] *= inv;
+    q[1] *= inv;
+    q[2] *= inv;
+    q[3] *= inv;
+  }
+}
+
+}  // namespace
+
+
+FusionEngine::FusionEngine() :
+    gravity_enabled_(true),
+    yaw_enabled_(false) {
+  Reset();
+}
+
+void FusionEngine::Reset() {
+  orientation_[0] = orientation_[1] = orientation_[2] = 0;
+  orientation_[3] = 1;
+  memset(angular_velocity_, 0, sizeof(angular_velocity_));
+  memset(acceleration_, 0, sizeof(acceleration_));
+  sample_count_ = 0;
+  memset(mean_acceleration_, 0, sizeof(mean_acceleration_));
+  memset(mean_magnetic_field_, 0, sizeof(mean_magnetic_field_));
+  still_count_ = 0;
+  tilt_error_angle_ = 0;
+  tilt_error_axis_[0] = tilt_error_axis_[2] = 0;
+  tilt_error_axis_[1] = 1;
+  has_yaw_reference_ = false;
+  yaw_reference_ = 0;
+  yaw_error_ = 0;
+}
+
+void FusionEngine::Reset(const float orientation[4]) {
+  Reset();
+  memcpy(orientation_, orientation, sizeof(orientation_));
+  QuatNormalize(orientation_);
+}
+
+void FusionEngine::set_gravity_correction_enabled(bool enabled) {
+  gravity_enabled_ = enabled;
+  tilt_error_angle_ = 0;
+}
+
+void FusionEngine::set_yaw_correction_enabled(bool enabled) {
+  yaw_enabled_ = enabled;
+  has_yaw_reference_ = false;
+  yaw_error_ = 0;
+}
+
+void FusionEngine::ApplyWorldRotation(const float axis[3], float angle) {
+  float s = sinf(angle * 0.5f);
+  float delta[4] = {
+    axis[0] * s, axis[1] * s, axis[2] * s, cosf(angle * 0.5f),
+  };
+  QuatMultiply(delta, orientation_, orientation_);
+}
+
+void FusionEngine::Update(const FusionSample& sample) {
+  memcpy(angular_velocity_, sample.rotation_rate, sizeof(angular_velocity_));
+  memcpy(acceleration_, sample.acceleration, sizeof(acceleration_));
+  sample_count_++;
+
+  // Gyro: rotate about the body-frame axis, applied on the right.
+  float rate = Length(sample.rotation_rate);
+  if (rate > 0) {
+    float half_angle = rate * sample.time_delta * 0.5f;
+    float s = sinf(half_angle) / rate;
+    float delta[4] = {
+      sample.rotation_rate[0] * s, sample.rotation_rate[1] * s,
+      sample.rotation_rate[2] * s, cosf(half_angle),
+    };
+    QuatMultiply(orientation_, delta, orientation_);
+  }
+  if (sample_count_ % kNormalizeInterval == 0) {
+    QuatNormalize(orientation_);
+  }
+
+  if (!gravity_enabled_ && !yaw_enabled_) {
+    return;
+  }
+
+  float world[3];
+  QuatRotate(orientation_, sample.acceleration, world);
+  for (int n = 0; n < 3; n++) {
+    mean_acceleration_[n] += (world[n] - mean_acceleration_[n]) * kMeanWeight;
+  }
+  if (yaw_enabled_) {
+    QuatRotate(orientation_, sample.magnetic_field, world);
+    for (int n = 0; n < 3; n++) {
+      mean_magnetic_field_[n] +=
+          (world[n] - mean_magnetic_field_[n]) * kMeanWeight;
+    }
+  }
+
+  float accel_length = Length(sample.acceleration);
+  if (fabsf(accel_length - kGravity) < kGravityEpsilon &&
+      rate < kAngularVelocityEpsilon) {
+    still_count_++;
+  } else {
+    still_count_ = 0;
+  }
+
+  if (still_count_ >= kStillPeriod) {
+    still_count_ = 0;
+
+    // Gravity should point straight up; the error is the angle between it
+    // and +Y, corrected about the horizontal axis perpendicular to both.
+    const float* g = mean_acceleration_;
+    float g_length = Length(g);
+    float axis_length = sqrtf(g[0] * g[0] + g[2] * g[2]);
+    if (gravity_enabled_ && g_length > 0 && axis_length > 0) {
+      float cos_tilt = g[1] / g_length;
+      float tilt = cos_tilt >= 1 ? 0 : cos_tilt <= -1 ? kPi : acosf(cos_tilt);
+      if (tilt > kMaxTiltError) {
+        tilt_error_angle_ = tilt;
+        tilt_error_axis_[0] = -g[2] / axis_length;
+        tilt_error_axis_[1] = 0;
+        tilt_error_axis_[2] = g[0] / axis_length;
+      }
+    }
+
+    // Heading is only meaningful once tilt has settled.
+    const float* m = mean_magnetic_field_;
+    if (yaw_enabled_ && tilt_error_angle_ <= kMinTiltError &&
+        sqrtf(m[0] * m[0] + m[2] * m[2]) > kMinHorizontalField) {
+      float heading = atan2f(m[0], m[2]);
+      if (!has_yaw_reference_) {
+        has_yaw_reference_ = true;
+        yaw_reference_ = heading;
+      } else {
+        float error = heading - yaw_reference_;
+        if (error > kPi) {
+          error -= 2 * kPi;
+        } else if (error < -kPi) {
+          error += 2 * kPi;
+        }
+        yaw_error_ = error;
+      }
+    }
+  }
+
+  if (tilt_error_angle_ > kMinTiltError) {
+    if (tilt_error_angle_ > kSnapTiltError &&
+        sample_count_ < kSnapTiltSamples) {
+      ApplyWorldRotation(tilt_error_axis_, tilt_error_angle_);
+      tilt_error_angle_ = 0;
+    } else {
+      float delta = kTiltGain * tilt_error_angle_ * (5 * rate + 1);
+      ApplyWorldRotation(tilt_error_axis_, delta);
+      tilt_error_angle_ -= delta;
+    }
+  }
+
+  if (fabsf(yaw_error_) > kMinYawError) {
+    // Rotating the world by angle about +Y moves the heading by angle.
+    static const float kUp[3] = { 0, 1, 0 };
+    float delta = kYawGain * yaw_error_;
+    ApplyWorldRotation(kUp, -delta);
+    yaw_error_ -= delta;
+  }
+}
@@ -0,0 +1,98 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_FUSION_ENGINE_H_
+#define NPVR_FUSION_ENGINE_H_
+
+#include <npvr.h>
+
+
+namespace npvr {
+
+// One reading from the tracker, as delivered at 1kHz. Units match
+// OVR::MessageBodyFrame.
+struct FusionSample {
+  // Seconds since the previous sample.
+  float time_delta;
+  // Meters per second squared, body frame.
+  float acceleration[3];
+  // Radians per second, body frame.
+  float rotation_rate[3];
+  // Gauss, body frame.
+  float magnetic_field[3];
+};
+
+// Self-contained orientation filter, usable in place of OVR::SensorFusion
+// and without the Oculus SDK. Integrates the gyro, slowly pulls the measured
+// gravity vector back to +Y while the tracker is still, and optionally holds
+// yaw against the magnetometer heading seen when it was first still.
+//
+// Not thread safe; callers serialize Update with the accessors.
+class FusionEngine {
+public:
+  FusionEngine();
+
+  // Returns to the identity orientation and forgets all correction state.
+  void Reset();
+  // Resets and starts from the given orientation instead, so that fusion can
+  // be handed over from another filter without a jump.
+  void Reset(const float orientation[4]);
+  void Update(const FusionSample& sample);
+
+  bool gravity_correction_enabled() const { return gravity_enabled_; }
+  void set_gravity_correction_enabled(bool enabled);
+  // Off by default: an uncalibrated magnetometer can pull yaw the wrong way
+  // near metal.
+  bool yaw_correction_enabled() const { return yaw_enabled_; }
+  void set_yaw_correction_enabled(bool enabled);
+
+  // Quaternion x, y, z, w taking body to world.
+  const float* orientation() const { return orientation_; }
+  // Latest body-frame readings.
+  const float* angular_velocity() const { return angular_velocity_; }
+  const float* acceleration() const { return acceleration_; }
+
+private:
+  void ApplyWorldRotation(const float axis[3], float angle);
+
+  bool      gravity_enabled_;
+  bool      yaw_enabled_;
+
+  float     orientation_[4];
+  float     angular_velocity_[3];
+  float     acceleration_[3];
+  uint32_t  sample_count_;
+
+  // Running means of the world-frame accelerometer and magnetometer.
+  float     mean_acceleration_[3];
+  float     mean_magnetic_field_[3];
+  // Consecutive samples that looked still.
+  uint32_t  still_count_;
+
+  // Remaining tilt error and the world axis to correct it about.
+  float     tilt_error_angle_;
+  float     tilt_error_axis_[3];
+
+  bool      has_yaw_reference_;
+  float     yaw_reference_;
+  // Remaining heading error, in radians.
+  float     yaw_error_;
+};
+
+}  // namespace npvr
+
+
+#endif  // NPVR_FUSION_ENGINE_H_
@@ -0,0 +1,579 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/hidraw_provider.h>
+
+#include <npvr/atomic.h>
+#include <npvr/clock.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/hidraw.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace npvr;
+
+
+namespace {
+
+const uint16_t kTrackerVendorId = 0x2833;
+const uint16_t kTrackerProductId = 0x0001;
+
+// Input report carrying sensor samples.
+const uint8_t kTrackerSensorsReportId = 1;
+
+// Feature report that keeps the tracker streaming for the given interval.
+const uint8_t kKeepAliveReportId = 8;
+const size_t kKeepAliveReportSize = 5;
+const uint16_t kKeepAliveIntervalMs = 10000;
+// Resent well inside the interval so a late wakeup never stops the stream.
+const uint64_t kKeepAlivePeriod = 3000000000ull;
+
+// Feature report describing the panel and lenses.
+const uint8_t kDisplayInfoReportId = 9;
+const size_t kDisplayInfoReportSize = 56;
+const uint8_t kDisplayInfoScreen = 1;
+const uint8_t kDisplayInfoDistortion = 2;
+
+// How often to look for a tracker while none is open.
+const uint64_t kRescanInterval = 1000000000ull;
+
+// Reports read before decoding; at 1kHz a wakeup rarely finds more than a
+// few queued.
+const size_t kMaxReportsPerRead = 32;
+
+// Gyro rates are differenced over at least this many seconds to estimate
+// angular acceleration, with each estimate weighted into a running average.
+const float kAccelerationWindow = 0.005f;
+const float kAccelerationSmoothing = 0.3f;
+
+uint16_t DecodeUInt16(const uint8_t* data) {
+  return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+uint32_t DecodeUInt32(const uint8_t* data) {
+  return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+float DecodeFloat32(const uint8_t* data) {
+  uint32_t bits = DecodeUInt32(data);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// The node each device slot has open, or 0, so two slots never read the same
+// tracker.
+Mutex g_claimed_mutex;
+dev_t g_claimed_nodes[kMaxHmdDevices];
+
+bool IsNodeClaimed(dev_t node) {
+  for (int n = 0; n < kMaxHmdDevices; n++) {
+    if (g_claimed_nodes[n] == node) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Opens the first hidraw node belonging to a tracker that no other slot has
+// open and claims it for slot, or returns -1.
+int OpenTrackerNode(int slot) {
+  DIR* dir = opendir("/dev");
+  if (!dir) {
+    return -1;
+  }
+  MutexLock lock(&g_claimed_mutex);
+  int fd = -1;
+  while (struct dirent* entry = readdir(dir)) {
+    if (strncmp(entry->d_name, "hidraw", 6)) {
+      continue;
+    }
+    char path[sizeof("/dev/") + sizeof(entry->d_name)];
+    snprintf(path, sizeof(path), "/dev/%s", entry->d_name);
+    struct stat node;
+    if (stat(path, &node) || IsNodeClaimed(node.st_rdev)) {
+      continue;
+    }
+    fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+      continue;
+    }
+    struct hidraw_devinfo info;
+    if (ioctl(fd, HIDIOCGRAWINFO, &info) == 0 &&
+        (uint16_t)info.vendor == kTrackerVendorId &&
+        (uint16_t)info.product == kTrackerProductId) {
+      g_claimed_nodes[slot] = node.st_rdev;
+      break;
+    }
+    close(fd);
+    fd = -1;
+  }
+  closedir(dir);
+  return fd;
+}
+
+void ReleaseTrackerNode(int slot) {
+  MutexLock lock(&g_claimed_mutex);
+  g_claimed_nodes[slot] = 0;
+}
+
+}  // namespace
+
+
+// Waits on the tracker and a wake eventfd, so Release never waits out a
+// timeout.
+class HidrawProvider::ReaderThread : public Thread {
+public:
+  ReaderThread(HidrawProvider* provider) :
+      provider_(provider),
+      wake_fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+      exit_requested_(0) {
+  }
+
+  virtual ~ReaderThread() {
+    if (wake_fd_ >= 0) {
+      close(wake_fd_);
+    }
+  }
+
+  bool Start() {
+    AtomicStoreRelease(&exit_requested_, 0);
+    return Thread::Start();
+  }
+
+  void RequestExit() {
+    AtomicStoreRelease(&exit_requested_, 1);
+    uint64_t value = 1;
+    if (write(wake_fd_, &value, sizeof(value)) < 0) {
+      // Counter saturated; the thread is already being woken.
+    }
+  }
+
+protected:
+  virtual void Run() {
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    Watch(epoll_fd, wake_fd_);
+
+    uint64_t next_scan = 0;
+    uint64_t next_keep_alive = 0;
+    while (!AtomicLoadAcquire(&exit_requested_)) {
+      uint64_t now = NowNanos();
+      if (provider_->fd_ < 0 && now >= next_scan) {
+        if (provider_->OpenTracker()) {
+          Watch(epoll_fd, provider_->fd_);
+          next_keep_alive = now + kKeepAlivePeriod;
+        }
+        next_scan = now + kRescanInterval;
+        AtomicStoreRelease(&provider_->ready_, 1);
+      }
+      if (provider_->fd_ >= 0 && now >= next_keep_alive) {
+        if (!provider_->SendKeepAlive()) {
+          provider_->CloseTracker();
+        }
+        next_keep_alive = now + kKeepAlivePeriod;
+      }
+
+      uint64_t deadline = provider_->fd_ >= 0 ? next_keep_alive : next_scan;
+      int timeout_ms = 0;
+      if (deadline > now) {
+        timeout_ms = (int)((deadline - now) / 1000000) + 1;
+      }
+      struct epoll_event events[2];
+      int count = epoll_wait(epoll_fd, events, 2, timeout_ms);
+      for (int n = 0; n < count; n++) {
+        if (events[n].data.fd != provider_->fd_) {
+          continue;
+        }
+        // Unplugging shows up as a hangup or as a failed read.
+        if ((events[n].events & (EPOLLERR | EPOLLHUP)) ||
+            !provider_->ReadReports()) {
+          provider_->CloseTracker();
+          next_scan = NowNanos() + kRescanInterval;
+        }
+      }
+    }
+
+    // Closing the descriptors also drops them from the epoll set.
+    provider_->CloseTracker();
+    close(epoll_fd);
+    uint64_t value;
+    if (read(wake_fd_, &value, sizeof(value)) < 0) {
+      // Nothing pending.
+    }
+  }
+
+private:
+  static void Watch(int epoll_fd, int fd) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+  }
+
+  HidrawProvider*   provider_;
+  int               wake_fd_;
+  volatile uint32_t exit_requested_;
+};
+
+
+HidrawProvider* HidrawProvider::Instance() {
+  static HidrawProvider instance(0);
+  return &instance;
+}
+
+HidrawProvider::HidrawProvider(int index) :
+    index_(index),
+    ref_count_(0),
+    thread_(NULL),
+    capture_(index ? NULL : CaptureWriter::Instance()),
+    ready_(0),
+    device_present_(0),
+    connection_generation_(0),
+    fd_(-1),
+    samples_(kMaxReportsPerRead * kTrackerMaxSamplesPerReport),
+    report_buffer_(new uint8_t[kMaxReportsPerRead * kTrackerReportSize]),
+    velocity_time_(0) {
+  memset(last_velocity_, 0, sizeof(last_velocity_));
+  memset(angular_acceleration_, 0, sizeof(angular_acceleration_));
+  memset(serial_, 0, sizeof(serial_));
+  thread_ = new ReaderThread(this);
+
+  memset(devices_, 0, sizeof(devices_));
+  devices_[0] = this;
+  if (!index_) {
+    for (int n = 1; n < kMaxHmdDevices; n++) {
+      devices_[n] = new HidrawProvider(n);
+    }
+  }
+}
+
+HidrawProvider::~HidrawProvider() {
+  if (!index_) {
+    for (int n = 1; n < kMaxHmdDevices; n++) {
+      delete devices_[n];
+    }
+  }
+  thread_->RequestExit();
+  thread_->Join();
+  delete thread_;
+  delete[] report_buffer_;
+}
+
+void HidrawProvider::Acquire() {
+  if (AtomicIncrement(&ref_count_) == 1) {
+    UpdateReader();
+  }
+}
+
+void HidrawProvider::Release() {
+  if (AtomicDecrement(&ref_count_) == 0) {
+    UpdateReader();
+  }
+}
+
+void HidrawProvider::UpdateReader() {
+  MutexLock lock(&lifecycle_mutex_);
+  bool wanted = AtomicCompareExchange(&ref_count_, 0, 0) > 0;
+  if (wanted == thread_->is_started()) {
+    return;
+  }
+  if (wanted) {
+    if (!thread_->Start()) {
+      // Nothing will ever be found; say so rather than leave script waiting.
+      AtomicStoreRelease(&ready_, 1);
+    }
+  } else {
+    thread_->RequestExit();
+    thread_->Join();
+  }
+}
+
+bool HidrawProvider::IsReady() const {
+  return AtomicLoadAcquire(&ready_) != 0;
+}
+
+bool HidrawProvider::DevicePresent() const {
+  return AtomicLoadAcquire(&device_present_) != 0;
+}
+
+uint32_t HidrawProvider::connection_generation() const {
+  return AtomicLoadAcquire(&connection_generation_);
+}
+
+bool HidrawProvider::GetDeviceInfo(OVR::HMDInfo* out_info) const {
+  if (!DevicePresent()) {
+    return false;
+  }
+  MutexLock lock(&info_mutex_);
+  *out_info = hmd_info_;
+  return true;
+}
+
+bool HidrawProvider::GetSnapshot(HmdSnapshot* out_snapshot) const {
+  return snapshot_.Read(out_snapshot);
+}
+
+OVR::Quatf HidrawProvider::PredictOrientation(const HmdSnapshot& snapshot,
+                                              float interval) const {
+  float age = (NowNanos() / 1000 - snapshot.timestamp) / 1000000.0f;
+  return ExtrapolateSnapshot(snapshot, age + interval);
+}
+
+void HidrawProvider::ResetOrientation() {
+  MutexLock lock(&engine_mutex_);
+  fusion_engine_.Reset();
+}
+
+FusionMode HidrawProvider::fusion_mode() const {
+  return kFusionModeNative;
+}
+
+void HidrawProvider::SetFusionMode(FusionMode mode) {
+}
+
+bool HidrawProvider::GetSerial(char* out_serial) const {
+  if (!DevicePresent()) {
+    return false;
+  }
+  MutexLock lock(&info_mutex_);
+  memcpy(out_serial, serial_, kHmdSerialSize);
+  return serial_[0] != 0;
+}
+
+int HidrawProvider::device_count() const {
+  return index_ ? 1 : kMaxHmdDevices;
+}
+
+HmdProvider* HidrawProvider::device(int index) {
+  if (index < 0 || index >= device_count()) {
+    return NULL;
+  }
+  return devices_[index];
+}
+
+bool HidrawProvider::OpenTracker() {
+  fd_ = OpenTrackerNode(index_);
+  if (fd_ < 0) {
+    return false;
+  }
+  if (!SendKeepAlive()) {
+    close(fd_);
+    fd_ = -1;
+    ReleaseTrackerNode(index_);
+    return false;
+  }
+  ReadDisplayInfo();
+
+  decoder_.Reset();
+  velocity_time_ = 0;
+  memset(last_velocity_, 0, sizeof(last_velocity_));
+  memset(angular_acceleration_, 0, sizeof(angular_acceleration_));
+  {
+    MutexLock lock(&engine_mutex_);
+    fusion_engine_.Reset();
+  }
+  AtomicStoreRelease(&connection_generation_, connection_generation_ + 1);
+  AtomicStoreRelease(&device_present_, 1);
+  return true;
+}
+
+void HidrawProvider::CloseTracker() {
+  if (fd_ < 0) {
+    return;
+  }
+  close(fd_);
+  fd_ = -1;
+  ReleaseTrackerNode(index_);
+  AtomicStoreRelease(&device_present_, 0);
+  AtomicStoreRelease(&connection_generation_, connection_generation_ + 1);
+}
+
+bool HidrawProvider::SendKeepAlive() {
+  uint8_t report[kKeepAliveReportSize];
+  report[0] = kKeepAliveReportId;
+  report[1] = 0;
+  report[2] = 0;
+  report[3] = (uint8_t)(kKeepAliveIntervalMs & 0xFF);
+  report[4] = (uint8_t)(kKeepAliveIntervalMs >> 8);
+  return ioctl(fd_, HIDIOCSFEATURE(sizeof(report)), report) >= 0;
+}
+
+void HidrawProvider::ReadDisplayInfo() {
+  OVR::HMDInfo info;
+  SetDefaultHmdInfo(&info);
+  memset(info.ProductName, 0, sizeof(info.ProductName));
+  if (ioctl(fd_, HIDIOCGRAWNAME(sizeof(info.ProductName) - 1),
+            info.ProductName) < 0) {
+    strcpy(info.ProductName, "Oculus Rift");
+  }
+  strncpy(info.Manufacturer, "Oculus VR, Inc.",
+          sizeof(info.Manufacturer) - 1);
+  info.Manufacturer[sizeof(info.Manufacturer) - 1] = 0;
+
+  // Layout per SensorDisplayInfoImpl in the SDK and HmdInfo in
+  // experimental/usb-driver/driver.js. Lengths are in micrometers.
+  uint8_t report[kDisplayInfoReportSize];
+  memset(report, 0, sizeof(report));
+  report[0] = kDisplayInfoReportId;
+  if (ioctl(fd_, HIDIOCGFEATURE(sizeof(report)), report) >=
+      (int)kDisplayInfoReportSize) {
+    uint8_t type = report[3] & 0x0F;
+    if (type == kDisplayInfoScreen || type == kDisplayInfoDistortion) {
+      info.HResolution = DecodeUInt16(report + 4);
+      info.VResolution = DecodeUInt16(report + 6);
+      info.HScreenSize = DecodeUInt32(report + 8) * 1e-6f;
+      info.VScreenSize = DecodeUInt32(report + 12) * 1e-6f;
+      info.VScreenCenter = DecodeUInt32(report + 16) * 1e-6f;
+      info.LensSeparationDistance = DecodeUInt32(report + 20) * 1e-6f;
+      // Left eye; both eyes are the same on shipping units.
+      info.EyeToScreenDistance = DecodeUInt32(report + 24) * 1e-6f;
+    }
+    if (type == kDisplayInfoDistortion) {
+      for (int n = 0; n < 4; n++) {
+        info.DistortionK[n] = DecodeFloat32(report + 32 + n * 4);
+      }
+    }
+  }
+
+  char serial[kHmdSerialSize];
+  memset(serial, 0, sizeof(serial));
+#if defined(HIDIOCGRAWUNIQ)
+  if (ioctl(fd_, HIDIOCGRAWUNIQ(sizeof(serial) - 1), serial) < 0 ||
+      !serial[0]) {
+    memset(serial, 0, sizeof(serial));
+    ioctl(fd_, HIDIOCGRAWPHYS(sizeof(serial) - 1), serial);
+  }
+#else
+  ioctl(fd_, HIDIOCGRAWPHYS(sizeof(serial) - 1), serial);
+#endif  // HIDIOCGRAWUNIQ
+
+  if (capture_) {
+    CaptureHmdInfo capture_info;
+    ToCaptureHmdInfo(info, &capture_info);
+    capture_->WriteHmdInfo(capture_info);
+  }
+
+  MutexLock lock(&info_mutex_);
+  hmd_info_ = info;
+  memcpy(serial_, serial, sizeof(serial_));
+}
+
+bool HidrawProvider::ReadReports() {
+  uint64_t sample_nanos = NowNanos();
+  size_t count = 0;
+  bool alive = true;
+  while (true) {
+    uint8_t* report = report_buffer_ + count * kTrackerReportSize;
+    ssize_t length = read(fd_, report, kTrackerReportSize);
+    if (length < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      alive = errno == EAGAIN || errno == EWOULDBLOCK;
+      break;
+    }
+    if (length != (ssize_t)kTrackerReportSize ||
+        report[0] != kTrackerSensorsReportId) {
+      continue;
+    }
+    if (++count == kMaxReportsPerRead) {
+      samples_.Clear();
+      decoder_.Decode(report_buffer_, count, &samples_);
+      Fuse(samples_, sample_nanos);
+      count = 0;
+    }
+  }
+  if (count) {
+    samples_.Clear();
+    decoder_.Decode(report_buffer_, count, &samples_);
+    Fuse(samples_, sample_nanos);
+  }
+  return alive;
+}
+
+void HidrawProvider::Fuse(const TrackerSamples& samples,
+                          uint64_t sample_nanos) {
+  if (!samples.count()) {
+    return;
+  }
+  HmdSnapshot snapshot;
+  snapshot.sample_nanos = sample_nanos;
+  {
+    MutexLock lock(&engine_mutex_);
+    for (size_t n = 0; n < samples.count(); n++) {
+      FusionSample sample;
+      sample.time_delta = samples.time_delta()[n];
+      for (int axis = 0; axis < 3; axis++) {
+        sample.acceleration[axis] = samples.acceleration(axis)[n];
+        sample.rotation_rate[axis] = samples.rotation_rate(axis)[n];
+        sample.magnetic_field[axis] = samples.magnetic_field(axis)[n];
+      }
+      fusion_engine_.Update(sample);
+      if (capture_) {
+        capture_->WriteImuSample(sample);
+      }
+
+      velocity_time_ += sample.time_delta;
+      if (velocity_time_ >= kAccelerationWindow) {
+        for (int axis = 0; axis < 3; axis++) {
+          float estimate = (sample.rotation_rate[axis] - last_velocity_[axis]) /
+              velocity_time_;
+          angular_acceleration_[axis] +=
+              (estimate - angular_acceleration_[axis]) *
+              kAccelerationSmoothing;
+          last_velocity_[axis] = sample.rotation_rate[axis];
+        }
+        velocity_time_ = 0;
+      }
+    }
+    const float* q = fusion_engine_.orientation();
+    const float* w = fusion_engine_.angular_velocity();
+    const float* a = fusion_engine_.acceleration();
+    snapshot.orientation = OVR::Quatf(q[0], q[1], q[2], q[3]);
+    snapshot.angular_velocity = OVR::Vector3f(w[0], w[1], w[2]);
+    snapshot.acceleration = OVR::Vector3f(a[0], a[1], a[2]);
+  }
+  snapshot.fusion_nanos = NowNanos();
+  snapshot.timestamp = snapshot.fusion_nanos / 1000;
+  snapshot.angular_acceleration = OVR::Vector3f(angular_acceleration_[0],
+      angular_acceleration_[1], angular_acceleration_[2]);
+  snapshot.publish_nanos = NowNanos();
+  snapshot_.Write(snapshot);
+  if (capture_) {
+    CaptureHmdPose pose;
+    pose.orientation[0] = snapshot.orientation.x;
+    pose.orientation[1] = snapshot.orientation.y;
+    pose.orientation[2] = snapshot.orientation.z;
+    pose.orientation[3] = snapshot.orientation.w;
+    pose.angular_velocity[0] = snapshot.angular_velocity.x;
+    pose.angular_velocity[1] = snapshot.angular_velocity.y;
+    pose.angular_velocity[2] = snapshot.angular_velocity.z;
+    pose.angular_acceleration[0] = snapshot.angular_acceleration.x;
+    pose.angular_acceleration[1] = snapshot.angular_acceleration.y;
+    pose.angular_acceleration[2] = snapshot.angular_acceleration.z;
+    pose.acceleration[0] = snapshot.acceleration.x;
+    pose.acceleration[1] = snapshot.acceleration.y;
+    pose.acceleration[2] = snapshot.acceleration.z;
+    capture_->WriteHmdPose(pose);
+  }
+}
@@ -0,0 +1,133 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_HIDRAW_PROVIDER_H_
+#define NPVR_HIDRAW_PROVIDER_H_
+
+#include <npvr.h>
+#include <npvr/capture.h>
+#include <npvr/fusion_engine.h>
+#include <npvr/seqlock.h>
+#include <npvr/thread.h>
+#include <npvr/tracker_decoder.h>
+#include <npvr/tracking_provider.h>
+
+
+namespace npvr {
+
+// Reads the Rift tracker straight from /dev/hidraw* on Linux, without the
+// Oculus SDK. A dedicated thread waits on the device with epoll, decodes
+// every report with TrackerDecoder and fuses the samples with FusionEngine,
+// so the 1kHz stream never passes through a browser or script event loop.
+// The thread also sends the keep-alive feature report the tracker needs to
+// keep streaming, and rescans for the device after it is unplugged.
+//
+// Each of the kMaxHmdDevices device slots is a HidrawProvider with its own
+// reader thread, and opens whichever tracker no other slot has open. Like
+// OVRManager, only slot 0 is recorded when NPVR_CAPTURE is set.
+//
+// The hidraw node must be readable and writable by the browser user; see the
+// udev rule in README.md.
+class HidrawProvider : public HmdProvider {
+public:
+  // Slot 0 creates the other slots and owns them.
+  explicit HidrawProvider(int index);
+  virtual ~HidrawProvider();
+
+  // Slot 0.
+  static HidrawProvider* Instance();
+
+  // The first Acquire starts the reader thread; the last Release stops it
+  // and closes the device.
+  virtual void Acquire();
+  virtual void Release();
+  // True once the first scan for the tracker has finished.
+  virtual bool IsReady() const;
+
+  virtual bool DevicePresent() const;
+  virtual uint32_t connection_generation() const;
+  // Display parameters read from the tracker's display info feature report,
+  // or DK1 defaults if it has none.
+  virtual bool GetDeviceInfo(OVR::HMDInfo* out_info) const;
+  virtual bool GetSnapshot(HmdSnapshot* out_snapshot) const;
+  virtual OVR::Quatf PredictOrientation(const HmdSnapshot& snapshot,
+                                        float interval) const;
+  virtual void ResetOrientation();
+  // There is no SDK filter here; always kFusionModeNative.
+  virtual FusionMode fusion_mode() const;
+  virtual void SetFusionMode(FusionMode mode);
+  // The USB serial number where the kernel exposes it, else the node's
+  // physical path.
+  virtual bool GetSerial(char* out_serial) const;
+  virtual int device_count() const;
+  virtual HmdProvider* device(int index);
+
+private:
+  class ReaderThread;
+
+  // Starts or stops the reader thread to match ref_count_.
+  void UpdateReader();
+
+  // Reader thread only.
+  bool OpenTracker();
+  void CloseTracker();
+  bool SendKeepAlive();
+  void ReadDisplayInfo();
+  // Drains every queued report. Returns false if the device went away.
+  bool ReadReports();
+  // sample_nanos is when the reports were read, for latency tracing.
+  void Fuse(const TrackerSamples& samples, uint64_t sample_nanos);
+
+  int                   index_;
+  HidrawProvider*       devices_[kMaxHmdDevices];
+  volatile int32_t      ref_count_;
+  // Held while the reader thread is started or stopped. Whichever of a
+  // racing Acquire and Release takes it last sees the final ref_count_, so
+  // the thread always ends up matching it.
+  Mutex                 lifecycle_mutex_;
+  ReaderThread*         thread_;
+  // Slot 0 only, and only when NPVR_CAPTURE is set.
+  CaptureWriter*        capture_;
+  volatile uint32_t     ready_;
+  volatile uint32_t     device_present_;
+  // Only written by the reader thread.
+  volatile uint32_t     connection_generation_;
+
+  // Guards hmd_info_ and serial_, which are written by the reader thread on
+  // attach.
+  mutable Mutex         info_mutex_;
+  OVR::HMDInfo          hmd_info_;
+  char                  serial_[kHmdSerialSize];
+
+  // Guards fusion_engine_ against ResetOrientation.
+  Mutex                 engine_mutex_;
+  FusionEngine          fusion_engine_;
+  SeqLock<HmdSnapshot>  snapshot_;
+
+  // Reader thread only.
+  int                   fd_;
+  TrackerDecoder        decoder_;
+  TrackerSamples        samples_;
+  uint8_t*              report_buffer_;
+  float                 last_velocity_[3];
+  float                 velocity_time_;
+  float                 angular_acceleration_[3];
+};
+
+}  // namespace npvr
+
+
+#endif  // NPVR_HIDRAW_PROVIDER_H_
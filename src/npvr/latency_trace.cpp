@@ -0,0 +1,216 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/latency_trace.h>
+#include <npvr/atomic.h>
+
+#include <algorithm>
+#include <vector>
+
+#if !defined(XP_WIN)
+#include <unistd.h>
+#endif  // !XP_WIN
+
+using namespace npvr;
+
+
+namespace {
+
+// Names of the intervals ending at each stage, for the percentile and trace
+// output. The sample stage has no interval of its own.
+const char* const kIntervalNames[kLatencyStageCount] = {
+  NULL,
+  "fusion",
+  "publish",
+  "wait",
+  "poll",
+  "handoff",
+};
+
+// Chrome trace thread ids for the two sides of the path.
+const int kTrackerTid = 1;
+const int kPollTid = 2;
+
+LatencyTrace g_latency_trace;
+
+uint32_t ProcessId() {
+#if defined(XP_WIN)
+  return (uint32_t)GetCurrentProcessId();
+#else
+  return (uint32_t)getpid();
+#endif  // XP_WIN
+}
+
+// Stages are stamped on different threads, so a later one can carry the
+// earlier time; that interval is empty rather than wrapped.
+uint64_t Interval(uint64_t begin, uint64_t end) {
+  return end > begin ? end - begin : 0;
+}
+
+float Microseconds(uint64_t nanos) {
+  return nanos / 1000.0f;
+}
+
+void WriteInterval(TextWriter& s, const char* name,
+                   std::vector<uint64_t>& nanos) {
+  std::sort(nanos.begin(), nanos.end());
+  size_t count = nanos.size();
+  s << name << ",";
+  s << Microseconds(nanos[count / 2]) << ",";
+  s << Microseconds(nanos[count * 90 / 100]) << ",";
+  s << Microseconds(nanos[count * 99 / 100]) << ",";
+  s << Microseconds(nanos[count - 1]) << "|";
+}
+
+void WriteEvent(FILE* file, const char* name, int tid, uint64_t begin,
+                uint64_t end) {
+  fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%d,"
+          "\"ts\":%.3f,\"dur\":%.3f}", name, ProcessId(), tid,
+          begin / 1000.0, Interval(begin, end) / 1000.0);
+}
+
+}  // namespace
+
+
+LatencyTrace::LatencyTrace() :
+    next_(0),
+    cleared_(0) {
+  memset((void*)slots_, 0, sizeof(slots_));
+}
+
+void LatencyTrace::Record(const LatencyRecord& record) {
+  uint32_t index = (uint32_t)AtomicIncrement(&next_) - 1;
+  volatile Slot& slot = slots_[index % kCapacity];
+  AtomicStoreRelease(&slot.sequence, 0);
+  AtomicFence();
+  const uint32_t* words = (const uint32_t*)&record;
+  for (size_t n = 0; n < kWordCount; n++) {
+    slot.words[n] = words[n];
+  }
+  AtomicStoreRelease(&slot.sequence, index + 1);
+}
+
+void LatencyTrace::Clear() {
+  AtomicStoreRelease(&cleared_,
+                     AtomicLoadAcquire((const volatile uint32_t*)&next_));
+}
+
+uint32_t LatencyTrace::Read(LatencyRecord* out_records) const {
+  uint32_t end = AtomicLoadAcquire((const volatile uint32_t*)&next_);
+  uint32_t available = end - AtomicLoadAcquire(&cleared_);
+  if (available > kCapacity) {
+    available = kCapacity;
+  }
+  uint32_t count = 0;
+  for (uint32_t index = end - available; index != end; index++) {
+    const volatile Slot& slot = slots_[index % kCapacity];
+    uint32_t sequence = AtomicLoadAcquire(&slot.sequence);
+    if (sequence != index + 1) {
+      // Still being written, or already overwritten by a newer record.
+      continue;
+    }
+    uint32_t* words = (uint32_t*)&out_records[count];
+    for (size_t n = 0; n < kWordCount; n++) {
+      words[n] = slot.words[n];
+    }
+    AtomicFence();
+    if (AtomicLoadAcquire(&slot.sequence) == sequence) {
+      count++;
+    }
+  }
+  return count;
+}
+
+void LatencyTrace::WritePercentiles(TextWriter& s) const {
+  std::vector<LatencyRecord> records(kCapacity);
+  uint32_t count = Read(&records[0]);
+  s << "n," << count << "|";
+  if (!count) {
+    return;
+  }
+
+  std::vector<uint64_t> nanos(count);
+  for (int stage = kLatencyStageFusion; stage < kLatencyStageCount;
+       stage++) {
+    for (uint32_t n = 0; n < count; n++) {
+      nanos[n] = Interval(records[n].stages[stage - 1],
+                          records[n].stages[stage]);
+    }
+    WriteInterval(s, kIntervalNames[stage], nanos);
+  }
+  for (uint32_t n = 0; n < count; n++) {
+    nanos[n] = Interval(records[n].stages[kLatencyStageSample],
+                        records[n].stages[kLatencyStageHandoff]);
+  }
+  WriteInterval(s, "age", nanos);
+}
+
+bool LatencyTrace::WriteChromeTrace(const char* path) const {
+  std::vector<LatencyRecord> records(kCapacity);
+  uint32_t count = Read(&records[0]);
+
+  FILE* file = fopen(path, "w");
+  if (!file) {
+    return false;
+  }
+  uint32_t pid = ProcessId();
+  fprintf(file, "{\"traceEvents\":[\n");
+  fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,"
+          "\"args\":{\"name\":\"npvr\"}}", pid);
+  fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,"
+          "\"tid\":%d,\"args\":{\"name\":\"tracker\"}}", pid, kTrackerTid);
+  fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,"
+          "\"tid\":%d,\"args\":{\"name\":\"poll\"}}", pid, kPollTid);
+
+  for (uint32_t n = 0; n < count; n++) {
+    const uint64_t* stages = records[n].stages;
+    // Polls faster than the tracker hand out the same sample more than
+    // once; its tracker side is only drawn the first time.
+    if (!n || stages[kLatencyStageSample] !=
+        records[n - 1].stages[kLatencyStageSample]) {
+      WriteEvent(file, kIntervalNames[kLatencyStageFusion], kTrackerTid,
+                 stages[kLatencyStageSample], stages[kLatencyStageFusion]);
+      WriteEvent(file, kIntervalNames[kLatencyStagePublish], kTrackerTid,
+                 stages[kLatencyStageFusion], stages[kLatencyStagePublish]);
+    }
+    fprintf(file, ",\n{\"name\":\"poll\",\"ph\":\"X\",\"pid\":%u,"
+            "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+            "\"args\":{\"age_us\":%.3f}}", pid, kPollTid,
+            stages[kLatencyStagePollBegin] / 1000.0,
+            Interval(stages[kLatencyStagePollBegin],
+                     stages[kLatencyStagePollEnd]) / 1000.0,
+            Interval(stages[kLatencyStageSample],
+                     stages[kLatencyStageHandoff]) / 1000.0);
+    WriteEvent(file, kIntervalNames[kLatencyStageHandoff], kPollTid,
+               stages[kLatencyStagePollEnd], stages[kLatencyStageHandoff]);
+    // Arrow from the publish to the poll that picked the sample up, which
+    // may have begun before the publish.
+    fprintf(file, ",\n{\"name\":\"pose\",\"ph\":\"s\",\"id\":%u,\"pid\":%u,"
+            "\"tid\":%d,\"ts\":%.3f}", n, pid, kTrackerTid,
+            stages[kLatencyStagePublish] / 1000.0);
+    fprintf(file, ",\n{\"name\":\"pose\",\"ph\":\"f\",\"bp\":\"e\","
+            "\"id\":%u,\"pid\":%u,\"tid\":%d,\"ts\":%.3f}", n, pid, kPollTid,
+            std::max(stages[kLatencyStagePollBegin],
+                     stages[kLatencyStagePublish]) / 1000.0);
+  }
+
+  fprintf(file, "\n]}\n");
+  return fclose(file) == 0;
+}
+
+LatencyTrace* npvr::GetLatencyTrace() {
+  return &g_latency_trace;
+}
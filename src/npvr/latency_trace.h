@@ -0,0 +1,100 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_LATENCY_TRACE_H_
+#define NPVR_LATENCY_TRACE_H_
+
+#include <npvr.h>
+#include <npvr/text_writer.h>
+
+
+namespace npvr {
+
+// Points on the way from a tracker sample to the page script that receives
+// the pose derived from it.
+enum LatencyStage {
+  // The sample reached the process.
+  kLatencyStageSample = 0,
+  // Fusion finished with it.
+  kLatencyStageFusion,
+  // The snapshot holding the result was published to readers.
+  kLatencyStagePublish,
+  // poll was entered, or a subscription delivery began. The sampler may
+  // publish after this, while poll gathers controller state; the wait for
+  // such a snapshot counts as zero.
+  kLatencyStagePollBegin,
+  // The response was serialized.
+  kLatencyStagePollEnd,
+  // The response was copied into the string returned to the browser.
+  kLatencyStageHandoff,
+
+  kLatencyStageCount,
+};
+
+// When one poll's pose passed each stage, from NowNanos().
+struct LatencyRecord {
+  uint64_t stages[kLatencyStageCount];
+};
+
+// Fixed-size ring of the most recent LatencyRecords. Recording is lock free
+// and may happen on any thread; reads copy out whatever complete records
+// are present and skip ones being overwritten.
+class LatencyTrace {
+public:
+  static const uint32_t kCapacity = 4096;
+
+  LatencyTrace();
+
+  void Record(const LatencyRecord& record);
+  void Clear();
+
+  // Writes the record count and, for each stage, the 50th, 90th and 99th
+  // percentile and maximum time in microseconds since the stage before it
+  // (zero if that stage was stamped later), then the same for the whole
+  // path:
+  //   n,[count]|[stage],[p50],[p90],[p99],[max]|...|age,...|
+  void WritePercentiles(TextWriter& s) const;
+
+  // Writes the records as Chrome trace events (chrome://tracing, Perfetto).
+  // NowNanos() uses the same clock as Chrome's trace timestamps, so the
+  // events line up with a browser trace taken at the same time.
+  bool WriteChromeTrace(const char* path) const;
+
+private:
+  // Copies out the complete records, oldest first. Returns the count.
+  uint32_t Read(LatencyRecord* out_records) const;
+
+  static const size_t kWordCount = sizeof(LatencyRecord) / sizeof(uint32_t);
+
+  struct Slot {
+    // Index of the record plus one once written, zero while being written.
+    uint32_t  sequence;
+    uint32_t  words[kWordCount];
+  };
+
+  volatile int32_t  next_;
+  // Value of next_ at the last Clear; older records are not read.
+  volatile uint32_t cleared_;
+  volatile Slot     slots_[kCapacity];
+};
+
+// The process-wide trace all VRObjects record into.
+LatencyTrace* GetLatencyTrace();
+
+}  // namespace npvr
+
+
+#endif  // NPVR_LATENCY_TRACE_H_
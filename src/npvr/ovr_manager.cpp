@@ -14,31 +14,669 @@
  * limitations under the License.
  */
 
+
 #include <npvr/ovr_manager.h>
 
+#include <npvr/atomic.h>
+#include <npvr/clock.h>
+#include <npvr/fusion_engine.h>
+#include <npvr/seqlock.h>
+#include <npvr/sequenced_ring.h>
+#include <npvr/sixense_manager.h>
+
+#include <stdlib.h>
+
 
 using namespace npvr;
 
+
+namespace {
+
+// Angular velocity is differenced over at least this many microseconds; the
+// gyro is too noisy to difference sample to sample.
+const OVR::UInt64 kAccelerationWindow = 10000;
+
+// Weight of each new angular acceleration estimate in the running average.
+const float kAccelerationSmoothing = 0.3f;
+
+// How often the device thread looks for attach and detach notifications.
+const unsigned kDeviceCheckIntervalMs = 5;
+
+// IMU samples queued for native fusion: 64ms of them, far longer than a
+// sampling thread ever stalls.
+const uint32_t kPendingSampleCount = 64;
+
+// An IMU sample and NowNanos() when it reached the process.
+struct PendingSample {
+  FusionSample  sample;
+  uint64_t      sample_nanos;
+};
+
+void CopySerial(const char* serial, size_t size, char* out_serial) {
+  size_t length = strnlen(serial, size);
+  if (length > kHmdSerialSize - 1) {
+    length = kHmdSerialSize - 1;
+  }
+  memcpy(out_serial, serial, length);
+  memset(out_serial + length, 0, kHmdSerialSize - length);
+}
+
+// DK1 display parameters under the tracker's own names, for a tracker with
+// no display found for it.
+void SetSensorHmdInfo(const OVR::SensorInfo& sensor, OVR::HMDInfo* out_info) {
+  SetDefaultHmdInfo(out_info);
+  strncpy(out_info->ProductName, sensor.ProductName,
+          sizeof(out_info->ProductName) - 1);
+  out_info->ProductName[sizeof(out_info->ProductName) - 1] = 0;
+  strncpy(out_info->Manufacturer, sensor.Manufacturer,
+          sizeof(out_info->Manufacturer) - 1);
+  out_info->Manufacturer[sizeof(out_info->Manufacturer) - 1] = 0;
+}
+
+}  // namespace
+
+
+// One device slot: a tracker, both filters fed from it and the thread that
+// fuses and samples them. The SDK delivers every tracker's samples on its one
+// sensor thread, so all that happens there is queueing them; native fusion
+// and snapshot publishing run on the slot's own thread, and slots never wait
+// on each other.
+class OVRManager::Tracker : public HmdProvider, public OVR::MessageHandler {
+public:
+  Tracker(OVRManager* manager, int index);
+  virtual ~Tracker();
+
+  // Device thread only. Attach takes over the reference to sensor and
+  // starts the sampling thread; Detach stops it and releases the sensor.
+  void Attach(OVR::SensorDevice* sensor, const OVR::HMDInfo& info,
+              const OVR::SensorInfo& sensor_info);
+  void Detach();
+  bool is_attached() const { return sensor_device_ != NULL; }
+  bool HasSerial(const char* serial) const;
+  // Stands in for Attach when replaying a capture. The replay thread then
+  // publishes through the two calls below instead of a sampling thread.
+  void AttachReplay(const OVR::HMDInfo& info);
+  void PublishImuSample(const FusionSample& sample);
+  void PublishPose(const CaptureHmdPose& pose);
+
+  // Resets the native filter to the current orientation, for a switch to
+  // it.
+  void SeedFusionEngine();
+
+  virtual void Acquire() {}
+  virtual void Release() {}
+  virtual bool IsReady() const;
+  virtual bool DevicePresent() const;
+  virtual uint32_t connection_generation() const;
+  virtual bool GetDeviceInfo(OVR::HMDInfo* out_info) const;
+  virtual bool GetSnapshot(HmdSnapshot* out_snapshot) const;
+  virtual OVR::Quatf PredictOrientation(const HmdSnapshot& snapshot,
+                                        float interval) const;
+  virtual void ResetOrientation();
+  virtual FusionMode fusion_mode() const;
+  virtual void SetFusionMode(FusionMode mode);
+  virtual bool GetSerial(char* out_serial) const;
+
+  // Body frames forwarded by sensor_fusion_ on the SDK's sensor thread.
+  virtual void OnMessage(const OVR::Message &message);
+
+private:
+  class SamplerThread;
+
+  // Sampling thread only.
+  void FusePendingSamples();
+  void Sample();
+
+  void ReadFusionEngine(HmdSnapshot* snapshot);
+  void EstimateAngularAcceleration(HmdSnapshot* snapshot);
+  // Stamps the publish time, makes the snapshot visible to GetSnapshot and
+  // records it if capturing.
+  void PublishSnapshot(HmdSnapshot snapshot);
+
+  OVRManager*         manager_;
+  int                 index_;
+  // Set for slot 0 only.
+  CaptureWriter*      capture_;
+
+  // Written on the device thread only.
+  OVR::SensorDevice*  sensor_device_;
+  SamplerThread*      sampler_thread_;
+
+  // Guards sensor_fusion_, hmd_info_, serial_ and the angular acceleration
+  // state, which are also read from the browser and sampling threads.
+  mutable OVR::Lock   device_lock_;
+  OVR::SensorFusion*  sensor_fusion_;
+  OVR::HMDInfo        hmd_info_;
+  char                serial_[kHmdSerialSize];
+  OVR::UInt64         last_velocity_time_;
+  OVR::Vector3f       last_velocity_;
+  OVR::Vector3f       angular_acceleration_;
+
+  SeqLock<HmdSnapshot> snapshot_;
+  volatile uint32_t   device_present_;
+  volatile uint32_t   connection_generation_;
+
+  // Pushed by OnMessage in native mode, drained by the sampling thread.
+  SequencedRing<PendingSample, kPendingSampleCount> pending_samples_;
+  uint32_t            pending_position_;
+
+  // Guards fusion_engine_. Taken after device_lock_ when both are needed.
+  OVR::Lock           engine_lock_;
+  FusionEngine        fusion_engine_;
+  // Under engine_lock_: when the newest sample arrived and when fusion
+  // finished with it.
+  uint64_t            sample_nanos_;
+  uint64_t            fusion_nanos_;
+};
+
+
+// Runs native fusion on the samples the SDK queued and publishes the fused
+// state every millisecond, matching the tracker's rate.
+class OVRManager::Tracker::SamplerThread : public OVR::Thread {
+public:
+  SamplerThread(Tracker* tracker) :
+      tracker_(tracker), exit_requested_(0) {
+  }
+
+  void RequestExit() {
+    AtomicStoreRelease(&exit_requested_, 1);
+  }
+
+  // Millisecond sleeps rely on the timer period the device thread sets on
+  // Windows, which lasts as long as the process.
+  virtual int Run() {
+    while (!AtomicLoadAcquire(&exit_requested_)) {
+      tracker_->FusePendingSamples();
+      tracker_->Sample();
+      OVR::Thread::MSleep(1);
+    }
+    return 0;
+  }
+
+private:
+  Tracker*          tracker_;
+  volatile uint32_t exit_requested_;
+};
+
+
+OVRManager::Tracker::Tracker(OVRManager* manager, int index) :
+    manager_(manager),
+    index_(index),
+    capture_(index ? NULL : manager->capture_),
+    sensor_device_(NULL),
+    sampler_thread_(NULL),
+    sensor_fusion_(NULL),
+    last_velocity_time_(0),
+    device_present_(0),
+    connection_generation_(0),
+    pending_position_(0),
+    sample_nanos_(0),
+    fusion_nanos_(0) {
+  memset(serial_, 0, sizeof(serial_));
+}
+
+OVRManager::Tracker::~Tracker() {
+  Detach();
+}
+
+void OVRManager::Tracker::Attach(OVR::SensorDevice* sensor,
+                                 const OVR::HMDInfo& info,
+                                 const OVR::SensorInfo& sensor_info) {
+  Detach();
+  sensor_device_ = sensor;
+  OVR::SensorFusion* sensor_fusion = new OVR::SensorFusion();
+  sensor_fusion->AttachToSensor(sensor_device_);
+  sensor_fusion->SetDelegateMessageHandler(this);
+
+  {
+    OVR::Lock::Locker locker(&device_lock_);
+    hmd_info_ = info;
+    CopySerial(sensor_info.SerialNumber, sizeof(sensor_info.SerialNumber),
+               serial_);
+    sensor_fusion_ = sensor_fusion;
+    last_velocity_time_ = 0;
+    angular_acceleration_ = OVR::Vector3f();
+  }
+  {
+    OVR::Lock::Locker locker(&engine_lock_);
+    fusion_engine_.Reset();
+    pending_position_ = pending_samples_.count();
+  }
+  if (capture_) {
+    CaptureHmdInfo capture_info;
+    ToCaptureHmdInfo(info, &capture_info);
+    capture_->WriteHmdInfo(capture_info);
+  }
+  AtomicStoreRelease(&connection_generation_, connection_generation_ + 1);
+  AtomicStoreRelease(&device_present_, 1);
+
+  sampler_thread_ = new SamplerThread(this);
+  sampler_thread_->Start();
+}
+
+void OVRManager::Tracker::Detach() {
+  if (!sensor_device_) {
+    return;
+  }
+  AtomicStoreRelease(&device_present_, 0);
+  sampler_thread_->RequestExit();
+  sampler_thread_->Wait();
+  sampler_thread_->Release();
+  sampler_thread_ = NULL;
+  {
+    OVR::Lock::Locker locker(&device_lock_);
+    delete sensor_fusion_;
+    sensor_fusion_ = NULL;
+  }
+  sensor_device_->Release();
+  sensor_device_ = NULL;
+  AtomicStoreRelease(&connection_generation_, connection_generation_ + 1);
+}
+
+bool OVRManager::Tracker::HasSerial(const char* serial) const {
+  // Sensors without a serial cannot be told apart, so none of them match.
+  return is_attached() && serial[0] &&
+      !strncmp(serial_, serial, kHmdSerialSize);
+}
+
+void OVRManager::Tracker::AttachReplay(const OVR::HMDInfo& info) {
+  {
+    OVR::Lock::Locker locker(&device_lock_);
+    hmd_info_ = info;
+    last_velocity_time_ = 0;
+    angular_acceleration_ = OVR::Vector3f();
+  }
+  {
+    OVR::Lock::Locker locker(&engine_lock_);
+    fusion_engine_.Reset();
+  }
+  AtomicStoreRelease(&connection_generation_, connection_generation_ + 1);
+  AtomicStoreRelease(&device_present_, 1);
+}
+
+void OVRManager::Tracker::PublishImuSample(const FusionSample& sample) {
+  if (fusion_mode() != kFusionModeNative) {
+    return;
+  }
+  HmdSnapshot snapshot;
+  snapshot.sample_nanos = NowNanos();
+  {
+    OVR::Lock::Locker locker(&engine_lock_);
+    fusion_engine_.Update(sample);
+  }
+  snapshot.fusion_nanos = NowNanos();
+  snapshot.timestamp = OVR::Timer::GetTicks();
+  ReadFusionEngine(&snapshot);
+  EstimateAngularAcceleration(&snapshot);
+  PublishSnapshot(snapshot);
+}
+
+void OVRManager::Tracker::PublishPose(const CaptureHmdPose& pose) {
+  if (fusion_mode() != kFusionModeSdk) {
+    return;
+  }
+  // Recorded poses are replayed as they were, acceleration included.
+  HmdSnapshot snapshot;
+  snapshot.sample_nanos = NowNanos();
+  snapshot.fusion_nanos = snapshot.sample_nanos;
+  snapshot.timestamp = OVR::Timer::GetTicks();
+  snapshot.orientation = OVR::Quatf(pose.orientation[0],
+      pose.orientation[1], pose.orientation[2], pose.orientation[3]);
+  snapshot.angular_velocity = OVR::Vector3f(pose.angular_velocity[0],
+      pose.angular_velocity[1], pose.angular_velocity[2]);
+  snapshot.angular_acceleration = OVR::Vector3f(
+      pose.angular_acceleration[0], pose.angular_acceleration[1],
+      pose.angular_acceleration[2]);
+  snapshot.acceleration = OVR::Vector3f(pose.acceleration[0],
+      pose.acceleration[1], pose.acceleration[2]);
+  PublishSnapshot(snapshot);
+}
+
+void OVRManager::Tracker::SeedFusionEngine() {
+  HmdSnapshot snapshot;
+  OVR::Quatf current(0, 0, 0, 1);
+  if (GetSnapshot(&snapshot)) {
+    current = snapshot.orientation;
+  }
+  const float orientation[4] = { current.x, current.y, current.z, current.w };
+  OVR::Lock::Locker locker(&engine_lock_);
+  fusion_engine_.Reset(orientation);
+}
+
+bool OVRManager::Tracker::IsReady() const {
+  return manager_->IsReady();
+}
+
+bool OVRManager::Tracker::DevicePresent() const {
+  return AtomicLoadAcquire(&device_present_) != 0;
+}
+
+uint32_t OVRManager::Tracker::connection_generation() const {
+  return AtomicLoadAcquire(&connection_generation_);
+}
+
+bool OVRManager::Tracker::GetDeviceInfo(OVR::HMDInfo* out_info) const {
+  if (!DevicePresent()) {
+    return false;
+  }
+  OVR::Lock::Locker locker(&device_lock_);
+  *out_info = hmd_info_;
+  return true;
+}
+
+bool OVRManager::Tracker::GetSnapshot(HmdSnapshot* out_snapshot) const {
+  return snapshot_.Read(out_snapshot);
+}
+
+OVR::Quatf OVRManager::Tracker::PredictOrientation(
+    const HmdSnapshot& snapshot, float interval) const {
+  float age = (OVR::Timer::GetTicks() - snapshot.timestamp) / 1000000.0f;
+  return ExtrapolateSnapshot(snapshot, age + interval);
+}
+
+void OVRManager::Tracker::ResetOrientation() {
+  OVR::Lock::Locker locker(&device_lock_);
+  if (sensor_fusion_) {
+    sensor_fusion_->Reset();
+  }
+  OVR::Lock::Locker engine_locker(&engine_lock_);
+  fusion_engine_.Reset();
+}
+
+FusionMode OVRManager::Tracker::fusion_mode() const {
+  return manager_->fusion_mode();
+}
+
+void OVRManager::Tracker::SetFusionMode(FusionMode mode) {
+  manager_->SetFusionMode(mode);
+}
+
+bool OVRManager::Tracker::GetSerial(char* out_serial) const {
+  if (!DevicePresent()) {
+    return false;
+  }
+  OVR::Lock::Locker locker(&device_lock_);
+  memcpy(out_serial, serial_, kHmdSerialSize);
+  return serial_[0] != 0;
+}
+
+void OVRManager::Tracker::OnMessage(const OVR::Message &message) {
+  if (message.Type != OVR::Message_BodyFrame) {
+    return;
+  }
+  // Called after SensorFusion has applied the frame itself.
+  uint64_t sample_nanos = NowNanos();
+  bool native = fusion_mode() == kFusionModeNative;
+  if (capture_ || native) {
+    const OVR::MessageBodyFrame& frame =
+        static_cast<const OVR::MessageBodyFrame&>(message);
+    PendingSample pending;
+    FusionSample& sample = pending.sample;
+    sample.time_delta = frame.TimeDelta;
+    sample.acceleration[0] = frame.Acceleration.x;
+    sample.acceleration[1] = frame.Acceleration.y;
+    sample.acceleration[2] = frame.Acceleration.z;
+    sample.rotation_rate[0] = frame.RotationRate.x;
+    sample.rotation_rate[1] = frame.RotationRate.y;
+    sample.rotation_rate[2] = frame.RotationRate.z;
+    sample.magnetic_field[0] = frame.MagneticField.x;
+    sample.magnetic_field[1] = frame.MagneticField.y;
+    sample.magnetic_field[2] = frame.MagneticField.z;
+    pending.sample_nanos = sample_nanos;
+    if (capture_) {
+      capture_->WriteImuSample(sample);
+    }
+    if (native) {
+      pending_samples_.Push(pending);
+      return;
+    }
+  }
+  OVR::Lock::Locker locker(&engine_lock_);
+  sample_nanos_ = sample_nanos;
+  fusion_nanos_ = NowNanos();
+}
+
+void OVRManager::Tracker::FusePendingSamples() {
+  uint32_t count = pending_samples_.count();
+  OVR::Lock::Locker locker(&engine_lock_);
+  if (count - pending_position_ > kPendingSampleCount) {
+    pending_position_ = count - kPendingSampleCount;
+  }
+  bool native = fusion_mode() == kFusionModeNative;
+  for (; pending_position_ != count; pending_position_++) {
+    PendingSample pending;
+    if (!native || !pending_samples_.Read(pending_position_, &pending)) {
+      continue;
+    }
+    fusion_engine_.Update(pending.sample);
+    sample_nanos_ = pending.sample_nanos;
+    fusion_nanos_ = NowNanos();
+  }
+}
+
+void OVRManager::Tracker::Sample() {
+  HmdSnapshot snapshot;
+  {
+    OVR::Lock::Locker locker(&device_lock_);
+    if (!sensor_fusion_) {
+      return;
+    }
+    snapshot.timestamp = OVR::Timer::GetTicks();
+    if (fusion_mode() == kFusionModeNative) {
+      ReadFusionEngine(&snapshot);
+    } else {
+      snapshot.orientation = sensor_fusion_->GetOrientation();
+      snapshot.angular_velocity = sensor_fusion_->GetAngularVelocity();
+      snapshot.acceleration = sensor_fusion_->GetAcceleration();
+    }
+  }
+  {
+    OVR::Lock::Locker locker(&engine_lock_);
+    snapshot.sample_nanos = sample_nanos_;
+    snapshot.fusion_nanos = fusion_nanos_;
+  }
+  EstimateAngularAcceleration(&snapshot);
+  PublishSnapshot(snapshot);
+}
+
+void OVRManager::Tracker::ReadFusionEngine(HmdSnapshot* snapshot) {
+  OVR::Lock::Locker locker(&engine_lock_);
+  const float* q = fusion_engine_.orientation();
+  const float* w = fusion_engine_.angular_velocity();
+  const float* a = fusion_engine_.acceleration();
+  snapshot->orientation = OVR::Quatf(q[0], q[1], q[2], q[3]);
+  snapshot->angular_velocity = OVR::Vector3f(w[0], w[1], w[2]);
+  snapshot->acceleration = OVR::Vector3f(a[0], a[1], a[2]);
+}
+
+void OVRManager::Tracker::EstimateAngularAcceleration(HmdSnapshot* snapshot) {
+  OVR::Lock::Locker locker(&device_lock_);
+  OVR::UInt64 elapsed = snapshot->timestamp - last_velocity_time_;
+  if (!last_velocity_time_) {
+    last_velocity_time_ = snapshot->timestamp;
+    last_velocity_ = snapshot->angular_velocity;
+  } else if (elapsed >= kAccelerationWindow) {
+    float inv_dt = 1000000.0f / elapsed;
+    const OVR::Vector3f& v = snapshot->angular_velocity;
+    OVR::Vector3f& a = angular_acceleration_;
+    a.x += ((v.x - last_velocity_.x) * inv_dt - a.x) * kAccelerationSmoothing;
+    a.y += ((v.y - last_velocity_.y) * inv_dt - a.y) * kAccelerationSmoothing;
+    a.z += ((v.z - last_velocity_.z) * inv_dt - a.z) * kAccelerationSmoothing;
+    last_velocity_time_ = snapshot->timestamp;
+    last_velocity_ = v;
+  }
+  snapshot->angular_acceleration = angular_acceleration_;
+}
+
+void OVRManager::Tracker::PublishSnapshot(HmdSnapshot snapshot) {
+  snapshot.publish_nanos = NowNanos();
+  snapshot_.Write(snapshot);
+  if (capture_) {
+    CaptureHmdPose pose;
+    pose.orientation[0] = snapshot.orientation.x;
+    pose.orientation[1] = snapshot.orientation.y;
+    pose.orientation[2] = snapshot.orientation.z;
+    pose.orientation[3] = snapshot.orientation.w;
+    pose.angular_velocity[0] = snapshot.angular_velocity.x;
+    pose.angular_velocity[1] = snapshot.angular_velocity.y;
+    pose.angular_velocity[2] = snapshot.angular_velocity.z;
+    pose.angular_acceleration[0] = snapshot.angular_acceleration.x;
+    pose.angular_acceleration[1] = snapshot.angular_acceleration.y;
+    pose.angular_acceleration[2] = snapshot.angular_acceleration.z;
+    pose.acceleration[0] = snapshot.acceleration.x;
+    pose.acceleration[1] = snapshot.acceleration.y;
+    pose.acceleration[2] = snapshot.acceleration.z;
+    capture_->WriteHmdPose(pose);
+  }
+}
+
+
+// Routes replayed records to where live data would have gone.
+class OVRManager::ReplaySink : public CaptureSink {
+public:
+  ReplaySink(Tracker* tracker) :
+      tracker_(tracker) {
+  }
+
+  virtual void OnHmdInfo(const CaptureHmdInfo& info) {
+    OVR::HMDInfo hmd_info;
+    FromCaptureHmdInfo(info, &hmd_info);
+    tracker_->AttachReplay(hmd_info);
+  }
+
+  virtual void OnImuSample(const FusionSample& sample) {
+    tracker_->PublishImuSample(sample);
+  }
+
+  virtual void OnHmdPose(const CaptureHmdPose& pose) {
+    tracker_->PublishPose(pose);
+  }
+
+  virtual void OnSixenseFrame(const SixenseFrame& frame) {
+    SixenseManager::Instance()->PublishReplayFrame(frame);
+  }
+
+private:
+  Tracker* tracker_;
+};
+
+
+// Brings up the device manager and attaches and detaches trackers, all off
+// the browser thread: enumerating devices blocks on USB for hundreds of
+// milliseconds.
+class OVRManager::DeviceThread : public OVR::Thread {
+public:
+  DeviceThread(OVRManager* manager) :
+      manager_(manager), exit_requested_(0) {
+  }
+
+  void RequestExit() {
+    AtomicStoreRelease(&exit_requested_, 1);
+  }
+
+  virtual int Run() {
+#ifdef _WIN32
+    // Default timer resolution would give us ~15ms sleeps.
+    timeBeginPeriod(1);
+#endif  // _WIN32
+    if (manager_->replay_reader_) {
+      RunReplay();
+    } else {
+      RunDevices();
+    }
+#ifdef _WIN32
+    timeEndPeriod(1);
+#endif  // _WIN32
+    return 0;
+  }
+
+private:
+  void RunDevices() {
+    manager_->InitDevices();
+    while (!AtomicLoadAcquire(&exit_requested_)) {
+      if (AtomicCompareExchange(&manager_->devices_changed_, 1, 0)) {
+        manager_->RefreshDevices();
+      }
+      OVR::Thread::MSleep(kDeviceCheckIntervalMs);
+    }
+  }
+
+  void RunReplay() {
+    bool realtime = IsReplayRealtime();
+    CapturePlayer player(manager_->replay_reader_, realtime);
+    ReplaySink sink(manager_->trackers_[0]);
+    AtomicStoreRelease(&manager_->ready_, 1);
+    while (!AtomicLoadAcquire(&exit_requested_)) {
+      // Once the capture runs out the last state is held.
+      bool more = player.Step(&sink);
+      if (realtime || !more) {
+        OVR::Thread::MSleep(1);
+      }
+    }
+  }
+
+  OVRManager*       manager_;
+  volatile uint32_t exit_requested_;
+};
+
+
 OVRManager *OVRManager::Instance() {
   static OVRManager instance;
   return &instance;
 }
 
 OVRManager::OVRManager() :
-    hmd_device_(NULL),
-    sensor_fusion_(NULL) {
-  OVR::System::Init();
-  device_manager_ = OVR::DeviceManager::Create();
-  device_manager_->SetMessageHandler(this);
-  OVR::HMDDevice* hmd_device = device_manager_->EnumerateDevices<OVR::HMDDevice>().CreateDevice();
-  if (hmd_device) {
-    SetDevice(hmd_device);
+    device_manager_(NULL),
+    device_thread_(NULL),
+    ready_(0),
+    devices_changed_(0),
+    fusion_mode_(kFusionModeSdk),
+    capture_(NULL),
+    replay_reader_(NULL) {
+  const char* fusion = getenv("NPVR_FUSION");
+  if (fusion && !strcmp(fusion, "native")) {
+    fusion_mode_ = kFusionModeNative;
+  }
+
+  // Replay stands in for the devices entirely; otherwise capture what they
+  // report if asked to.
+  const char* replay_path = GetReplayPath();
+  if (replay_path) {
+    replay_reader_ = new CaptureReader();
+    if (!replay_reader_->Open(replay_path)) {
+      delete replay_reader_;
+      replay_reader_ = NULL;
+    }
+  } else {
+    capture_ = CaptureWriter::Instance();
+  }
+
+  for (int n = 0; n < kMaxHmdDevices; n++) {
+    trackers_[n] = new Tracker(this, n);
   }
+
+  // Cheap; sets up the SDK allocator that OVR::Thread itself depends on.
+  OVR::System::Init();
+
+  device_thread_ = new DeviceThread(this);
+  device_thread_->Start();
 }
 
 OVRManager::~OVRManager() {
-  SetDevice(NULL);
-  device_manager_->Release();
+  device_thread_->RequestExit();
+  device_thread_->Wait();
+  device_thread_->Release();
+  device_thread_ = NULL;
+  delete replay_reader_;
+  replay_reader_ = NULL;
+
+  for (int n = 0; n < kMaxHmdDevices; n++) {
+    delete trackers_[n];
+    trackers_[n] = NULL;
+  }
+  if (device_manager_) {
+    device_manager_->Release();
+  }
 
   // TODO(benvanik): figure out why we cannot call this. It blocks forever in
   // Thread::FinishAllThreads(), waiting for a thread that seems to have already
@@ -47,64 +685,193 @@ OVRManager::~OVRManager() {
   //OVR::System::Destroy();
 }
 
+void OVRManager::InitDevices() {
+  device_manager_ = OVR::DeviceManager::Create();
+  if (device_manager_) {
+    device_manager_->SetMessageHandler(this);
+    RefreshDevices();
+  }
+  AtomicStoreRelease(&ready_, 1);
+}
+
+void OVRManager::RefreshDevices() {
+  if (!device_manager_) {
+    return;
+  }
+
+  // Trackers are what is tracked, so they are what fills slots. The SDK
+  // cannot tell which display a tracker is built into, so slot n takes the
+  // parameters of the nth display, or a DK1's without one.
+  OVR::HMDInfo displays[kMaxHmdDevices];
+  int display_count = 0;
+  OVR::DeviceEnumerator<OVR::HMDDevice> hmds =
+      device_manager_->EnumerateDevices<OVR::HMDDevice>();
+  while (hmds.GetType() != OVR::Device_None &&
+         display_count < kMaxHmdDevices) {
+    if (hmds.GetDeviceInfo(&displays[display_count])) {
+      display_count++;
+    }
+    if (!hmds.Next()) {
+      break;
+    }
+  }
+
+  // The enumerators only list devices that are still attached, so any
+  // tracker missing from them has gone away. A sensor without a serial is
+  // never found again, so it is detached and attached afresh below.
+  char serials[kMaxHmdDevices][kHmdSerialSize];
+  int sensor_count = 0;
+  OVR::DeviceEnumerator<OVR::SensorDevice> sensors =
+      device_manager_->EnumerateDevices<OVR::SensorDevice>();
+  while (sensors.GetType() != OVR::Device_None &&
+         sensor_count < kMaxHmdDevices) {
+    OVR::SensorInfo info;
+    if (sensors.GetDeviceInfo(&info)) {
+      CopySerial(info.SerialNumber, sizeof(info.SerialNumber),
+                 serials[sensor_count++]);
+    }
+    if (!sensors.Next()) {
+      break;
+    }
+  }
+  for (int n = 0; n < kMaxHmdDevices; n++) {
+    Tracker* tracker = trackers_[n];
+    if (!tracker->is_attached()) {
+      continue;
+    }
+    bool found = false;
+    for (int i = 0; i < sensor_count && !found; i++) {
+      found = tracker->HasSerial(serials[i]);
+    }
+    if (!found) {
+      tracker->Detach();
+    }
+  }
+
+  // Then new trackers take the lowest free slots.
+  OVR::DeviceEnumerator<OVR::SensorDevice> added =
+      device_manager_->EnumerateDevices<OVR::SensorDevice>();
+  while (added.GetType() != OVR::Device_None) {
+    OVR::SensorInfo info;
+    int slot = -1;
+    if (added.GetDeviceInfo(&info)) {
+      char serial[kHmdSerialSize];
+      CopySerial(info.SerialNumber, sizeof(info.SerialNumber), serial);
+      if (FindTracker(serial) < 0) {
+        slot = 0;
+        while (slot < kMaxHmdDevices && trackers_[slot]->is_attached()) {
+          slot++;
+        }
+        if (slot == kMaxHmdDevices) {
+          break;
+        }
+      }
+    }
+    OVR::SensorDevice* sensor = slot >= 0 ? added.CreateDevice() : NULL;
+    if (sensor) {
+      OVR::HMDInfo hmd_info;
+      if (slot < display_count) {
+        hmd_info = displays[slot];
+      } else {
+        SetSensorHmdInfo(info, &hmd_info);
+      }
+      trackers_[slot]->Attach(sensor, hmd_info, info);
+    }
+    if (!added.Next()) {
+      break;
+    }
+  }
+}
+
+int OVRManager::FindTracker(const char* serial) const {
+  for (int n = 0; n < kMaxHmdDevices; n++) {
+    if (trackers_[n]->HasSerial(serial)) {
+      return n;
+    }
+  }
+  return -1;
+}
+
+bool OVRManager::IsReady() const {
+  return AtomicLoadAcquire(&ready_) != 0;
+}
+
 void OVRManager::OnMessage(const OVR::Message &message) {
+  // Called on the SDK's device thread with its locks held, so only flag the
+  // change; the device thread attaches or detaches trackers.
   switch(message.Type) {
   case OVR::Message_DeviceAdded:
-    break;
   case OVR::Message_DeviceRemoved:
+    AtomicCompareExchange(&devices_changed_, 0, 1);
     break;
   default:
     break;
   }
 }
 
-OVR::HMDDevice* OVRManager::GetDevice() const {
-  return hmd_device_;
+bool OVRManager::DevicePresent() const {
+  return trackers_[0]->DevicePresent();
 }
 
-const OVR::HMDInfo* OVRManager::GetDeviceInfo() const {
-  return &hmd_device_info_;
+uint32_t OVRManager::connection_generation() const {
+  return trackers_[0]->connection_generation();
 }
 
-void OVRManager::SetDevice(OVR::HMDDevice* device) {
-  if (hmd_device_ == device) {
-    return;
-  }
-  if (hmd_device_) {
-    // Release existing device.
-    hmd_device_->Release();
-    delete sensor_fusion_;
-  }
-  if (!device) {
-    return;
-  }
+bool OVRManager::GetDeviceInfo(OVR::HMDInfo* out_info) const {
+  return trackers_[0]->GetDeviceInfo(out_info);
+}
 
-  hmd_device_ = device;
-  if (!hmd_device_->GetDeviceInfo(&hmd_device_info_)) {
-    hmd_device_ = NULL;
-    hmd_device_->Release();
-    return;
+OVR::Quatf OVRManager::GetOrientation() const {
+  HmdSnapshot snapshot;
+  if (GetSnapshot(&snapshot)) {
+    return snapshot.orientation;
+  } else {
+    return OVR::Quatf(0, 0, 0, 1);
   }
+}
 
-  sensor_fusion_ = new OVR::SensorFusion();
-  sensor_fusion_->AttachToSensor(hmd_device_->GetSensor());
-  sensor_fusion_->SetDelegateMessageHandler(this);
+bool OVRManager::GetSnapshot(HmdSnapshot* out_snapshot) const {
+  return trackers_[0]->GetSnapshot(out_snapshot);
 }
 
-bool OVRManager::DevicePresent() const {
-  return hmd_device_ != NULL;
+OVR::Quatf OVRManager::PredictOrientation(const HmdSnapshot& snapshot,
+                                          float interval) const {
+  return trackers_[0]->PredictOrientation(snapshot, interval);
 }
 
-OVR::Quatf OVRManager::GetOrientation() const {
-  if (sensor_fusion_) {
-    return sensor_fusion_->GetOrientation();
-  } else {
-    return OVR::Quatf(0, 0, 0, 1);
+void OVRManager::ResetOrientation() {
+  trackers_[0]->ResetOrientation();
+}
+
+FusionMode OVRManager::fusion_mode() const {
+  return (FusionMode)AtomicLoadAcquire(&fusion_mode_);
+}
+
+void OVRManager::SetFusionMode(FusionMode mode) {
+  if (mode == fusion_mode()) {
+    return;
+  }
+  // The SDK filter keeps running in native mode and cannot be seeded, so
+  // switching back to it may jump.
+  if (mode == kFusionModeNative) {
+    for (int n = 0; n < kMaxHmdDevices; n++) {
+      trackers_[n]->SeedFusionEngine();
+    }
   }
+  AtomicStoreRelease(&fusion_mode_, mode);
 }
 
-void OVRManager::ResetOrientation() {
-  if (sensor_fusion_) {
-    sensor_fusion_->Reset();
+bool OVRManager::GetSerial(char* out_serial) const {
+  return trackers_[0]->GetSerial(out_serial);
+}
+
+int OVRManager::device_count() const {
+  return kMaxHmdDevices;
+}
+
+HmdProvider* OVRManager::device(int index) {
+  if (index < 0 || index >= kMaxHmdDevices) {
+    return NULL;
   }
+  return index ? static_cast<HmdProvider*>(trackers_[index]) : this;
 }
@@ -18,27 +18,76 @@
 #define NPVR_OVR_MANAGER_H_
 
 #include <OVR.h>
+#include <npvr/capture.h>
+#include <npvr/tracking_provider.h>
 
 
 namespace npvr {
 
-class OVRManager: public OVR::MessageHandler {
+// Owns the Oculus SDK and is the HmdProvider backed by it. Trackers are
+// enumerated on a thread started by Instance(), and each one attached gets a
+// device slot with its own SensorFusion, FusionEngine and sampling thread;
+// the manager itself reports slot 0. The SDK stays up for the life of the
+// process, so Acquire and Release do nothing.
+class OVRManager: public HmdProvider, public OVR::MessageHandler {
 public:
   virtual ~OVRManager();
   static OVRManager *Instance();
-  OVR::HMDDevice* GetDevice() const;
-  const OVR::HMDInfo* GetDeviceInfo() const;
-  bool DevicePresent() const;
+
+  virtual void Acquire() {}
+  virtual void Release() {}
+  virtual bool IsReady() const;
+  virtual bool DevicePresent() const;
+  virtual uint32_t connection_generation() const;
+  virtual bool GetDeviceInfo(OVR::HMDInfo* out_info) const;
+  // Copies out the latest sample published by the sampling thread without
+  // touching the SDK.
+  virtual bool GetSnapshot(HmdSnapshot* out_snapshot) const;
+  virtual OVR::Quatf PredictOrientation(const HmdSnapshot& snapshot,
+                                        float interval) const;
+  virtual void ResetOrientation();
+  virtual FusionMode fusion_mode() const;
+  // Switches filters on every tracker, seeding each new one with the
+  // tracker's current orientation.
+  virtual void SetFusionMode(FusionMode mode);
+  // The tracker's serial number.
+  virtual bool GetSerial(char* out_serial) const;
+  // A tracker keeps its slot until it is unplugged; a new one takes the
+  // lowest free slot.
+  virtual int device_count() const;
+  virtual HmdProvider* device(int index);
+
   OVR::Quatf GetOrientation() const;
-  void ResetOrientation();
   virtual void OnMessage(const OVR::Message &message);
 private:
+  class DeviceThread;
+  class ReplaySink;
+  class Tracker;
+
   OVRManager();
-  void SetDevice(OVR::HMDDevice* device);
+  void InitDevices();
+  void RefreshDevices();
+  // The slot tracking the sensor with this serial number, or -1. An empty
+  // serial is never found.
+  int FindTracker(const char* serial) const;
+
+  // Devices are attached and detached only on the device thread.
   OVR::DeviceManager *device_manager_;
-  OVR::HMDDevice     *hmd_device_;
-  OVR::HMDInfo       hmd_device_info_;
-  OVR::SensorFusion  *sensor_fusion_;
+  Tracker            *trackers_[kMaxHmdDevices];
+
+  DeviceThread       *device_thread_;
+  volatile uint32_t  ready_;
+  // Set from OnMessage on the SDK's device thread.
+  volatile int32_t   devices_changed_;
+  volatile uint32_t  fusion_mode_;
+
+  // Set when NPVR_CAPTURE is. Never set while replaying. Only slot 0 is
+  // captured.
+  CaptureWriter      *capture_;
+  // Set when NPVR_REPLAY names a readable capture. The devices are then
+  // never opened and the device thread plays the capture back into slot 0
+  // instead.
+  CaptureReader      *replay_reader_;
 };
 
 }  // namespace npvr
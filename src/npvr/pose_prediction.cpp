@@ -0,0 +1,60 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/pose_prediction.h>
+
+#include <math.h>
+
+
+using namespace npvr;
+
+
+void npvr::PredictOrientation(const float orientation[4],
+                              const float angular_velocity[3],
+                              const float angular_acceleration[3],
+                              float dt, float out_orientation[4]) {
+  if (dt < 0) {
+    dt = 0;
+  } else if (dt > kMaxPredictionInterval) {
+    dt = kMaxPredictionInterval;
+  }
+
+  float half_dt_sq = 0.5f * dt * dt;
+  float rx = angular_velocity[0] * dt + angular_acceleration[0] * half_dt_sq;
+  float ry = angular_velocity[1] * dt + angular_acceleration[1] * half_dt_sq;
+  float rz = angular_velocity[2] * dt + angular_acceleration[2] * half_dt_sq;
+  float angle = sqrtf(rx * rx + ry * ry + rz * rz);
+  if (angle < 1e-6f) {
+    memcpy(out_orientation, orientation, sizeof(float) * 4);
+    return;
+  }
+
+  // Delta rotation about the body-frame axis, applied on the right.
+  float s = sinf(angle * 0.5f) / angle;
+  float dx = rx * s;
+  float dy = ry * s;
+  float dz = rz * s;
+  float dw = cosf(angle * 0.5f);
+
+  float qx = orientation[0];
+  float qy = orientation[1];
+  float qz = orientation[2];
+  float qw = orientation[3];
+  out_orientation[0] = qw * dx + qx * dw + qy * dz - qz * dy;
+  out_orientation[1] = qw * dy - qx * dz + qy * dw + qz * dx;
+  out_orientation[2] = qw * dz + qx * dy - qy * dx + qz * dw;
+  out_orientation[3] = qw * dw - qx * dx - qy * dy - qz * dz;
+}
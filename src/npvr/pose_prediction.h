@@ -0,0 +1,42 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_POSE_PREDICTION_H_
+#define NPVR_POSE_PREDICTION_H_
+
+#include <npvr.h>
+
+
+namespace npvr {
+
+// Longest interval we will extrapolate over, in seconds. Past this the
+// constant-acceleration model is worse than no prediction at all.
+const float kMaxPredictionInterval = 0.1f;
+
+// Extrapolates an orientation quaternion (x, y, z, w) forward by dt seconds
+// assuming constant body-frame angular acceleration. The rotation over the
+// interval is approximated by the rotation vector w*dt + a*dt^2/2, which is
+// what the SDK does with velocity alone plus the acceleration term.
+// dt is clamped to [0, kMaxPredictionInterval].
+void PredictOrientation(const float orientation[4],
+                        const float angular_velocity[3],
+                        const float angular_acceleration[3],
+                        float dt, float out_orientation[4]);
+
+}  // namespace npvr
+
+
+#endif  // NPVR_POSE_PREDICTION_H_
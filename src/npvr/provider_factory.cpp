@@ -0,0 +1,94 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <npvr/provider_factory.h>
+
+#include <npvr/capture.h>
+#include <npvr/ovr_manager.h>
+#include <npvr/shared_tracking.h>
+#include <npvr/sixense_manager.h>
+#include <npvr/synthetic_provider.h>
+
+#ifdef USE_HIDRAW
+#include <npvr/hidraw_provider.h>
+#endif  // USE_HIDRAW
+
+#include <stdlib.h>
+
+using namespace npvr;
+
+
+namespace {
+
+bool IsProviderSelected(const char* name) {
+  const char* provider = getenv("NPVR_PROVIDER");
+  return provider && !strcmp(provider, name);
+}
+
+bool UseSyntheticProvider() {
+  return IsProviderSelected("synthetic");
+}
+
+// The daemon's devices, if one is running and neither a provider nor a
+// replay was asked for.
+SharedTrackingProvider* GetSharedProvider() {
+  if (getenv("NPVR_PROVIDER") || GetReplayPath()) {
+    return NULL;
+  }
+  return SharedTrackingProvider::Instance();
+}
+
+}  // namespace
+
+
+HmdProvider* npvr::GetHmdProvider() {
+  SharedTrackingProvider* shared = GetSharedProvider();
+  if (shared) {
+    return shared;
+  }
+  return GetLocalHmdProvider();
+}
+
+ControllerProvider* npvr::GetControllerProvider() {
+  SharedTrackingProvider* shared = GetSharedProvider();
+  if (shared) {
+    return shared;
+  }
+  return GetLocalControllerProvider();
+}
+
+HmdProvider* npvr::GetLocalHmdProvider() {
+  // Never touch OVRManager::Instance() unless it is wanted; constructing it
+  // starts the SDK.
+  if (UseSyntheticProvider()) {
+    return SyntheticProvider::Instance();
+  }
+#ifdef USE_HIDRAW
+  // Replay is driven by OVRManager.
+  if (!GetReplayPath() && !IsProviderSelected("ovr")) {
+    return HidrawProvider::Instance();
+  }
+#endif  // USE_HIDRAW
+  return OVRManager::Instance();
+}
+
+ControllerProvider* npvr::GetLocalControllerProvider() {
+  if (UseSyntheticProvider()) {
+    return SyntheticProvider::Instance();
+  }
+  return SixenseManager::Instance();
+}
@@ -0,0 +1,43 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef NPVR_PROVIDER_FACTORY_H_
+#define NPVR_PROVIDER_FACTORY_H_
+
+#include <npvr/tracking_provider.h>
+
+
+namespace npvr {
+
+// The providers for this process: the devices a running npvr_daemon shares,
+// unless NPVR_PROVIDER or NPVR_REPLAY is set or no daemon is running, in
+// which case the local providers below.
+HmdProvider* GetHmdProvider();
+ControllerProvider* GetControllerProvider();
+
+// Providers that read the devices in this process. NPVR_PROVIDER=synthetic
+// selects SyntheticProvider for both. Otherwise controllers come from the
+// Sixense SDK, and the HMD from HidrawProvider on Linux (unless
+// NPVR_PROVIDER=ovr or a capture is being replayed) or the Oculus SDK
+// everywhere else. NPVR_PROVIDER=local selects these without naming one.
+HmdProvider* GetLocalHmdProvider();
+ControllerProvider* GetLocalControllerProvider();
+
+}  // namespace npvr
+
+
+#endif  // NPVR_PROVIDER_FACTORY_H_
@@ -0,0 +1,110 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_SEQLOCK_H_
+#define NPVR_SEQLOCK_H_
+
+#include <npvr.h>
+#include <npvr/atomic.h>
+
+
+namespace npvr {
+
+// Single-writer, multi-reader snapshot of a plain-old-data value.
+//
+// The writer alternates between two slots and then publishes which one is
+// newest, so a reader always copies a slot the writer is not touching. A
+// read only retries if the writer lapped it (finished two more writes during
+// the copy), which at sensor rates means reads are effectively wait-free and
+// never block the writer.
+//
+// T must be trivially copyable and a multiple of 4 bytes. The layout has no
+// pointers, so a SeqLock may live in memory shared across processes.
+template <typename T>
+class SeqLock {
+public:
+  SeqLock() : write_count_(0) {
+    memset((void*)slots_, 0, sizeof(slots_));
+  }
+
+  // Number of values written so far. Changes whenever a new value is
+  // published.
+  uint32_t write_count() const {
+    return AtomicLoadAcquire(&write_count_);
+  }
+
+  // Publishes a new value. Must only be called from one thread at a time.
+  void Write(const T& value) {
+    uint32_t count = write_count_;
+    volatile Slot& slot = slots_[(count + 1) & 1];
+    uint32_t sequence = slot.sequence;
+
+    // Odd sequence marks the slot as being written.
+    AtomicStoreRelease(&slot.sequence, sequence + 1);
+    AtomicFence();
+    CopyWords(slot.words, (const uint32_t*)&value);
+    AtomicStoreRelease(&slot.sequence, sequence + 2);
+
+    AtomicStoreRelease(&write_count_, count + 1);
+  }
+
+  // Copies out the newest value. Returns false if nothing has been written.
+  bool Read(T* out_value) const {
+    while (true) {
+      uint32_t count = AtomicLoadAcquire(&write_count_);
+      if (!count) {
+        return false;
+      }
+      const volatile Slot& slot = slots_[count & 1];
+      uint32_t sequence = AtomicLoadAcquire(&slot.sequence);
+      if (sequence & 1) {
+        // Writer lapped us and is rewriting this slot.
+        continue;
+      }
+      // A plain copy, which is much faster than word by word through
+      // volatile; a torn one is caught by the recheck the fence orders it
+      // before.
+      memcpy(out_value, (const void*)slot.words, sizeof(T));
+      AtomicFenceAcquire();
+      if (AtomicLoadAcquire(&slot.sequence) == sequence) {
+        return true;
+      }
+    }
+  }
+
+private:
+  static const size_t kWordCount = sizeof(T) / sizeof(uint32_t);
+  typedef char SizeMustBeWordMultiple[sizeof(T) % sizeof(uint32_t) ? -1 : 1];
+
+  struct Slot {
+    uint32_t sequence;
+    uint32_t words[kWordCount];
+  };
+
+  static void CopyWords(volatile uint32_t* dest, const volatile uint32_t* src) {
+    for (size_t n = 0; n < kWordCount; n++) {
+      dest[n] = src[n];
+    }
+  }
+
+  volatile uint32_t write_count_;
+  volatile Slot     slots_[2];
+};
+
+}  // namespace npvr
+
+
+#endif  // NPVR_SEQLOCK_H_
@@ -0,0 +1,99 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_SEQUENCED_RING_H_
+#define NPVR_SEQUENCED_RING_H_
+
+#include <npvr.h>
+#include <npvr/atomic.h>
+
+
+namespace npvr {
+
+// Single-writer, multi-reader ring of the most recent kCapacity values of a
+// plain-old-data type. Values are numbered from zero as they are pushed;
+// readers copy them out by number and find out if the writer overwrote one
+// during the copy, so neither side ever blocks.
+//
+// Same constraints as SeqLock: T must be trivially copyable and a multiple
+// of 4 bytes, and the layout has no pointers, so a SequencedRing may live in
+// memory shared across processes.
+template <typename T, uint32_t kCapacity>
+class SequencedRing {
+public:
+  static const uint32_t kSize = kCapacity;
+
+  SequencedRing() : count_(0) {
+    memset((void*)slots_, 0, sizeof(slots_));
+  }
+
+  // Values pushed so far; the next value pushed is numbered count().
+  uint32_t count() const {
+    return AtomicLoadAcquire(&count_);
+  }
+
+  // Must only be called from one thread at a time.
+  void Push(const T& value) {
+    uint32_t count = count_;
+    volatile Slot& slot = slots_[count % kCapacity];
+    // Zero marks the slot as being written.
+    AtomicStoreRelease(&slot.sequence, 0);
+    AtomicFence();
+    CopyWords(slot.words, (const uint32_t*)&value);
+    AtomicStoreRelease(&slot.sequence, count + 1);
+    AtomicStoreRelease(&count_, count + 1);
+  }
+
+  // Copies out value index, which must be below count(). Returns false if
+  // it has been overwritten or is being overwritten.
+  bool Read(uint32_t index, T* out_value) const {
+    const volatile Slot& slot = slots_[index % kCapacity];
+    uint32_t sequence = AtomicLoadAcquire(&slot.sequence);
+    if (sequence != index + 1) {
+      return false;
+    }
+    // A plain copy, which is much faster than word by word through
+    // volatile; a torn one is caught by the recheck the fence orders it
+    // before.
+    memcpy(out_value, (const void*)slot.words, sizeof(T));
+    AtomicFenceAcquire();
+    return AtomicLoadAcquire(&slot.sequence) == sequence;
+  }
+
+private:
+  static const size_t kWordCount = sizeof(T) / sizeof(uint32_t);
+  typedef char SizeMustBeWordMultiple[sizeof(T) % sizeof(uint32_t) ? -1 : 1];
+
+  struct Slot {
+    // Number of the value held plus one; zero while being written.
+    uint32_t sequence;
+    uint32_t words[kWordCount];
+  };
+
+  static void CopyWords(volatile uint32_t* dest, const volatile uint32_t* src) {
+    for (size_t n = 0; n < kWordCount; n++) {
+      dest[n] = src[n];
+    }
+  }
+
+  volatile uint32_t count_;
+  volatile Slot     slots_[kCapacity];
+};
+
+}  // namespace npvr
+
+
+#endif  // NPVR_SEQUENCED_RING_H_
@@ -0,0 +1,179 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/shared_memory.h>
+
+#if !defined(XP_WIN)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // !XP_WIN
+
+using namespace npvr;
+
+
+SharedMemory::SharedMemory() :
+    data_(NULL),
+    size_(0) {
+#if defined(XP_WIN)
+  mapping_ = NULL;
+#endif  // XP_WIN
+}
+
+SharedMemory::~SharedMemory() {
+  Close();
+}
+
+bool SharedMemory::Create(const char* name, size_t size) {
+  return Map(name, size, true);
+}
+
+bool SharedMemory::Open(const char* name, size_t size) {
+  return Map(name, size, false);
+}
+
+bool SharedMemory::Map(const char* name, size_t size, bool create) {
+  Close();
+
+#if defined(XP_WIN)
+  // Local\ mappings are per session, which is as far as a user's browsers
+  // reach.
+  if (create) {
+    mapping_ = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                  0, (DWORD)size, name);
+  } else {
+    mapping_ = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+  }
+  if (!mapping_) {
+    return false;
+  }
+  data_ = MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+  int fd = shm_open(name, create ? O_RDWR | O_CREAT : O_RDWR, 0600);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) ||
+      ((size_t)st.st_size < size && (!create || ftruncate(fd, size)))) {
+    close(fd);
+    return false;
+  }
+  void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  // The mapping keeps the object alive.
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  data_ = data;
+#endif  // XP_WIN
+  if (!data_) {
+    Close();
+    return false;
+  }
+  size_ = size;
+  return true;
+}
+
+void SharedMemory::Close() {
+#if defined(XP_WIN)
+  if (data_) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_) {
+    CloseHandle(mapping_);
+    mapping_ = NULL;
+  }
+#else
+  if (data_) {
+    munmap(data_, size_);
+  }
+#endif  // XP_WIN
+  data_ = NULL;
+  size_ = 0;
+}
+
+
+NamedLock::NamedLock() {
+#if defined(XP_WIN)
+  mutex_ = NULL;
+#else
+  fd_ = -1;
+#endif  // XP_WIN
+}
+
+NamedLock::~NamedLock() {
+  Release();
+}
+
+bool NamedLock::TryAcquire(const char* name) {
+  if (is_held()) {
+    return false;
+  }
+#if defined(XP_WIN)
+  // Only lock holders open the mutex, so it exists exactly while one does.
+  HANDLE mutex = CreateMutexA(NULL, FALSE, name);
+  if (!mutex) {
+    return false;
+  }
+  if (GetLastError() == ERROR_ALREADY_EXISTS) {
+    CloseHandle(mutex);
+    return false;
+  }
+  mutex_ = mutex;
+#else
+  // The file may sit in a shared directory, so refuse links and files that
+  // another user planted.
+  int fd = open(name, O_RDWR | O_CREAT | O_NOFOLLOW, 0600);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) || st.st_uid != getuid() ||
+      flock(fd, LOCK_EX | LOCK_NB)) {
+    close(fd);
+    return false;
+  }
+  fd_ = fd;
+#endif  // XP_WIN
+  return true;
+}
+
+void NamedLock::Release() {
+#if defined(XP_WIN)
+  if (mutex_) {
+    CloseHandle(mutex_);
+    mutex_ = NULL;
+  }
+#else
+  if (fd_ >= 0) {
+    // Closing drops the lock. The file stays, as unlinking it would race
+    // with a process that has it open but not yet locked.
+    close(fd_);
+    fd_ = -1;
+  }
+#endif  // XP_WIN
+}
+
+bool NamedLock::is_held() const {
+#if defined(XP_WIN)
+  return mutex_ != NULL;
+#else
+  return fd_ >= 0;
+#endif  // XP_WIN
+}
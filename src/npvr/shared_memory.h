@@ -0,0 +1,78 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_SHARED_MEMORY_H_
+#define NPVR_SHARED_MEMORY_H_
+
+#include <npvr.h>
+
+
+namespace npvr {
+
+// A named block of memory mapped into every process that opens it, visible
+// only to the current user.
+class SharedMemory {
+public:
+  SharedMemory();
+  ~SharedMemory();
+
+  // Maps the named block, creating it if it does not exist. New blocks are
+  // zero filled.
+  bool Create(const char* name, size_t size);
+  // Maps the named block. Fails if no process has created it.
+  bool Open(const char* name, size_t size);
+  void Close();
+
+  void* data() const { return data_; }
+
+private:
+  bool Map(const char* name, size_t size, bool create);
+
+  void*   data_;
+  size_t  size_;
+#if defined(XP_WIN)
+  HANDLE  mapping_;
+#endif  // XP_WIN
+};
+
+// An exclusive lock held by at most one process at a time. The system drops
+// it when the holder exits, however it exits, so a crash never leaves it
+// stuck.
+class NamedLock {
+public:
+  NamedLock();
+  ~NamedLock();
+
+  // Takes the lock without waiting. name is a file path outside Windows, and
+  // the file must belong to the current user. Fails if any process, this one
+  // included, holds the lock.
+  bool TryAcquire(const char* name);
+  void Release();
+
+  bool is_held() const;
+
+private:
+#if defined(XP_WIN)
+  HANDLE  mutex_;
+#else
+  int     fd_;
+#endif  // XP_WIN
+};
+
+}  // namespace npvr
+
+
+#endif  // NPVR_SHARED_MEMORY_H_
@@ -0,0 +1,417 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/shared_tracking.h>
+
+#include <npvr/atomic.h>
+#include <npvr/clock.h>
+
+#include <new>
+
+#if !defined(XP_WIN)
+#include <unistd.h>
+#endif  // !XP_WIN
+
+using namespace npvr;
+
+
+namespace {
+
+// 'NPVR'
+const uint32_t kSharedTrackingMagic = 0x5256504e;
+
+// One region per user: a session on Windows, a uid elsewhere.
+void GetRegionName(char* buffer, size_t size) {
+#if defined(XP_WIN)
+  strncpy(buffer, "Local\\npvr_tracking", size - 1);
+  buffer[size - 1] = 0;
+#else
+  snprintf(buffer, size, "/npvr_tracking.%u", (unsigned)getuid());
+#endif  // XP_WIN
+}
+
+// Held by the one daemon publishing into the region.
+void GetLockName(char* buffer, size_t size) {
+#if defined(XP_WIN)
+  strncpy(buffer, "Local\\npvr_tracking_publisher", size - 1);
+  buffer[size - 1] = 0;
+#else
+  snprintf(buffer, size, "/tmp/npvr_tracking.%u.lock", (unsigned)getuid());
+#endif  // XP_WIN
+}
+
+bool IsRegionValid(const SharedTrackingRegion* region) {
+  return region->magic == kSharedTrackingMagic &&
+      region->version == kSharedTrackingVersion &&
+      region->size == sizeof(SharedTrackingRegion);
+}
+
+bool IsRegionAlive(const SharedTrackingRegion* region) {
+  uint64_t heartbeat;
+  return region->heartbeat.Read(&heartbeat) && heartbeat &&
+      NowNanos() - heartbeat < kSharedTrackingTimeoutNanos;
+}
+
+}  // namespace
+
+
+SharedTrackingPublisher::SharedTrackingPublisher() :
+    region_(NULL),
+    requested_fusion_mode_(0) {
+  memset(hmd_states_, 0, sizeof(hmd_states_));
+}
+
+SharedTrackingPublisher::~SharedTrackingPublisher() {
+  Close();
+}
+
+bool SharedTrackingPublisher::Open() {
+  Close();
+
+  // Two daemons that both saw a stale heartbeat would otherwise initialize
+  // the region over each other.
+  char name[64];
+  GetLockName(name, sizeof(name));
+  if (!lock_.TryAcquire(name)) {
+    return false;
+  }
+  GetRegionName(name, sizeof(name));
+  if (!memory_.Create(name, sizeof(SharedTrackingRegion))) {
+    lock_.Release();
+    return false;
+  }
+
+  // Left behind by a daemon that exited or crashed, or new. Readers still
+  // mapping it see no heartbeat until the first Publish.
+  SharedTrackingRegion* region = (SharedTrackingRegion*)memory_.data();
+  region_ = new (region) SharedTrackingRegion();
+  region_->hmd_count = 0;
+  region_->fusion_mode = kFusionModeSdk;
+  region_->requested_fusion_mode = 0;
+  for (int n = 0; n < kMaxHmdDevices; n++) {
+    SharedHmdBlock& block = region_->hmds[n];
+    block.status = 0;
+    block.connection_generation = 0;
+    block.reset_requests = 0;
+  }
+  region_->controller_status = 0;
+  region_->version = kSharedTrackingVersion;
+  region_->size = sizeof(SharedTrackingRegion);
+  AtomicFence();
+  region_->magic = kSharedTrackingMagic;
+
+  requested_fusion_mode_ = 0;
+  memset(hmd_states_, 0, sizeof(hmd_states_));
+  cursor_ = ControllerCursor();
+  return true;
+}
+
+void SharedTrackingPublisher::Close() {
+  if (region_) {
+    region_->heartbeat.Write(0);
+    region_ = NULL;
+  }
+  memory_.Close();
+  lock_.Release();
+}
+
+void SharedTrackingPublisher::Publish(HmdProvider* hmd,
+                                      ControllerProvider* controllers) {
+  if (!region_) {
+    return;
+  }
+  // Fusion mode is shared by every device, so device 0 takes the request.
+  uint32_t requested_fusion_mode =
+      AtomicLoadAcquire(&region_->requested_fusion_mode);
+  if (requested_fusion_mode != requested_fusion_mode_) {
+    requested_fusion_mode_ = requested_fusion_mode;
+    if (requested_fusion_mode) {
+      hmd->SetFusionMode((FusionMode)(requested_fusion_mode - 1));
+    }
+  }
+  AtomicStoreRelease(&region_->fusion_mode, hmd->fusion_mode());
+
+  int count = hmd->device_count();
+  for (int n = 0; n < count; n++) {
+    PublishHmd(hmd->device(n), &region_->hmds[n], &hmd_states_[n]);
+  }
+  AtomicStoreRelease(&region_->hmd_count, (uint32_t)count);
+  PublishControllers(controllers);
+  region_->heartbeat.Write(NowNanos());
+}
+
+void SharedTrackingPublisher::PublishHmd(HmdProvider* hmd,
+                                         SharedHmdBlock* block,
+                                         HmdState* state) {
+  int32_t reset_requests = (int32_t)AtomicLoadAcquire(
+      (const volatile uint32_t*)&block->reset_requests);
+  if (reset_requests != state->reset_requests) {
+    state->reset_requests = reset_requests;
+    hmd->ResetOrientation();
+  }
+
+  uint32_t generation = hmd->connection_generation();
+  if (!state->info_published || generation != state->info_generation) {
+    OVR::HMDInfo info;
+    if (hmd->GetDeviceInfo(&info)) {
+      SharedHmdInfo shared_info;
+      ToCaptureHmdInfo(info, &shared_info.info);
+      memset(shared_info.serial, 0, sizeof(shared_info.serial));
+      hmd->GetSerial(shared_info.serial);
+      block->info.Write(shared_info);
+    }
+    state->info_published = true;
+    state->info_generation = generation;
+    AtomicStoreRelease(&block->connection_generation, generation);
+  }
+
+  HmdSnapshot snapshot;
+  if (hmd->GetSnapshot(&snapshot) &&
+      snapshot.timestamp != state->snapshot_timestamp) {
+    state->snapshot_timestamp = snapshot.timestamp;
+    block->snapshot.Write(snapshot);
+  }
+
+  uint32_t status = 0;
+  if (hmd->IsReady()) {
+    status |= kSharedStatusReady;
+  }
+  if (hmd->DevicePresent()) {
+    status |= kSharedStatusPresent;
+  }
+  AtomicStoreRelease(&block->status, status);
+}
+
+void SharedTrackingPublisher::PublishControllers(
+    ControllerProvider* controllers) {
+  SharedTrackingRegion* region = region_;
+
+  uint32_t status = 0;
+  if (controllers->IsReady()) {
+    status |= kSharedStatusReady;
+  }
+  uint32_t connected = 0;
+  if (controllers->IsAvailable()) {
+    status |= kSharedStatusPresent;
+    // History includes the newest frames, so the region's newest frames
+    // follow from publishing it.
+    controllers->Gather(true, &cursor_, &poll_);
+    for (int n = 0; n < poll_.history_count; n++) {
+      region->controller_frames.Publish(poll_.history[n]);
+    }
+    for (int n = 0; n < poll_.controller_count; n++) {
+      const SixenseFrame& frame = poll_.controllers[n];
+      connected |= SixenseControllerBit(frame.base, frame.controller);
+    }
+  }
+  // Controllers the provider stopped reporting drop out of the region too.
+  region->controller_frames.SetConnected(connected);
+  AtomicStoreRelease(&region->controller_status, status);
+}
+
+
+// Reads one HMD's block of the region.
+class SharedTrackingProvider::Hmd : public HmdProvider {
+public:
+  Hmd(SharedTrackingProvider* provider, int index) :
+      provider_(provider),
+      index_(index) {
+  }
+
+  virtual void Acquire() {}
+  virtual void Release() {}
+
+  virtual bool IsReady() const {
+    return provider_->IsAlive() &&
+        (AtomicLoadAcquire(&block()->status) & kSharedStatusReady);
+  }
+
+  virtual bool DevicePresent() const {
+    return provider_->IsAlive() &&
+        (AtomicLoadAcquire(&block()->status) & kSharedStatusPresent);
+  }
+
+  virtual uint32_t connection_generation() const {
+    return AtomicLoadAcquire(&block()->connection_generation);
+  }
+
+  virtual bool GetDeviceInfo(OVR::HMDInfo* out_info) const {
+    SharedHmdInfo info;
+    if (!DevicePresent() || !block()->info.Read(&info)) {
+      return false;
+    }
+    FromCaptureHmdInfo(info.info, out_info);
+    return true;
+  }
+
+  virtual bool GetSnapshot(HmdSnapshot* out_snapshot) const {
+    return provider_->IsAlive() && block()->snapshot.Read(out_snapshot);
+  }
+
+  virtual OVR::Quatf PredictOrientation(const HmdSnapshot& snapshot,
+                                        float interval) const {
+    float age = (int64_t)(NowNanos() - snapshot.sample_nanos) / 1e9f;
+    return ExtrapolateSnapshot(snapshot, age + interval);
+  }
+
+  virtual void ResetOrientation() {
+    AtomicIncrement(&block()->reset_requests);
+  }
+
+  virtual FusionMode fusion_mode() const {
+    return provider_->fusion_mode();
+  }
+
+  virtual void SetFusionMode(FusionMode mode) {
+    provider_->SetFusionMode(mode);
+  }
+
+  virtual bool GetSerial(char* out_serial) const {
+    SharedHmdInfo info;
+    if (!DevicePresent() || !block()->info.Read(&info)) {
+      return false;
+    }
+    memcpy(out_serial, info.serial, kHmdSerialSize);
+    out_serial[kHmdSerialSize - 1] = 0;
+    return out_serial[0] != 0;
+  }
+
+private:
+  SharedHmdBlock* block() const {
+    return &provider_->region_->hmds[index_];
+  }
+
+  SharedTrackingProvider* provider_;
+  int                     index_;
+};
+
+
+SharedTrackingProvider::SharedTrackingProvider() :
+    region_(NULL) {
+  for (int n = 0; n < kMaxHmdDevices; n++) {
+    hmds_[n] = new Hmd(this, n);
+  }
+}
+
+SharedTrackingProvider::~SharedTrackingProvider() {
+  for (int n = 0; n < kMaxHmdDevices; n++) {
+    delete hmds_[n];
+  }
+}
+
+SharedTrackingProvider* SharedTrackingProvider::Instance() {
+  static SharedTrackingProvider instance;
+  // Retried on every call, so a daemon started after the browser is picked
+  // up by the next page that asks for devices.
+  if (!instance.region_ && !instance.Open()) {
+    return NULL;
+  }
+  return instance.IsAlive() ? &instance : NULL;
+}
+
+bool SharedTrackingProvider::Open() {
+  char name[64];
+  GetRegionName(name, sizeof(name));
+  if (!memory_.Open(name, sizeof(SharedTrackingRegion))) {
+    return false;
+  }
+  SharedTrackingRegion* region = (SharedTrackingRegion*)memory_.data();
+  if (!IsRegionValid(region)) {
+    memory_.Close();
+    return false;
+  }
+  region_ = region;
+  return true;
+}
+
+bool SharedTrackingProvider::IsAlive() const {
+  return region_ && IsRegionAlive(region_);
+}
+
+void SharedTrackingProvider::Acquire() {
+}
+
+void SharedTrackingProvider::Release() {
+}
+
+bool SharedTrackingProvider::IsReady() const {
+  return hmds_[0]->IsReady() &&
+      (AtomicLoadAcquire(&region_->controller_status) & kSharedStatusReady);
+}
+
+bool SharedTrackingProvider::DevicePresent() const {
+  return hmds_[0]->DevicePresent();
+}
+
+uint32_t SharedTrackingProvider::connection_generation() const {
+  return hmds_[0]->connection_generation();
+}
+
+bool SharedTrackingProvider::GetDeviceInfo(OVR::HMDInfo* out_info) const {
+  return hmds_[0]->GetDeviceInfo(out_info);
+}
+
+bool SharedTrackingProvider::GetSnapshot(HmdSnapshot* out_snapshot) const {
+  return hmds_[0]->GetSnapshot(out_snapshot);
+}
+
+OVR::Quatf SharedTrackingProvider::PredictOrientation(
+    const HmdSnapshot& snapshot, float interval) const {
+  return hmds_[0]->PredictOrientation(snapshot, interval);
+}
+
+void SharedTrackingProvider::ResetOrientation() {
+  hmds_[0]->ResetOrientation();
+}
+
+FusionMode SharedTrackingProvider::fusion_mode() const {
+  return (FusionMode)AtomicLoadAcquire(&region_->fusion_mode);
+}
+
+void SharedTrackingProvider::SetFusionMode(FusionMode mode) {
+  AtomicStoreRelease(&region_->requested_fusion_mode, mode + 1);
+}
+
+bool SharedTrackingProvider::GetSerial(char* out_serial) const {
+  return hmds_[0]->GetSerial(out_serial);
+}
+
+int SharedTrackingProvider::device_count() const {
+  uint32_t count = region_ ? AtomicLoadAcquire(&region_->hmd_count) : 0;
+  if (count < 1) {
+    return 1;
+  }
+  return count > (uint32_t)kMaxHmdDevices ? kMaxHmdDevices : (int)count;
+}
+
+HmdProvider* SharedTrackingProvider::device(int index) {
+  if (index < 0 || index >= device_count()) {
+    return NULL;
+  }
+  return index ? static_cast<HmdProvider*>(hmds_[index]) : this;
+}
+
+bool SharedTrackingProvider::IsAvailable() const {
+  return IsAlive() &&
+      (AtomicLoadAcquire(&region_->controller_status) & kSharedStatusPresent);
+}
+
+void SharedTrackingProvider::Gather(bool include_history,
+                                    ControllerCursor* cursor,
+                                    SixensePoll* poll) {
+  region_->controller_frames.Gather(include_history, &cursor->position,
+                                    poll);
+}
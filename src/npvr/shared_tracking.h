@@ -0,0 +1,183 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_SHARED_TRACKING_H_
+#define NPVR_SHARED_TRACKING_H_
+
+#include <npvr.h>
+#include <npvr/capture.h>
+#include <npvr/seqlock.h>
+#include <npvr/shared_memory.h>
+#include <npvr/sixense_frame.h>
+#include <npvr/tracking_provider.h>
+
+
+namespace npvr {
+
+// Bumped whenever SharedTrackingRegion changes layout.
+const uint32_t kSharedTrackingVersion = 3;
+
+// Readers treat the daemon as gone once its heartbeat is this old.
+const uint64_t kSharedTrackingTimeoutNanos = 1000000000ull;
+
+// Device bring-up has finished, and whether it found the device.
+const uint32_t kSharedStatusReady = 1 << 0;
+const uint32_t kSharedStatusPresent = 1 << 1;
+
+// What an HMD reports about itself, written together.
+struct SharedHmdInfo {
+  CaptureHmdInfo          info;
+  char                    serial[kHmdSerialSize];
+};
+
+// One HMD's part of SharedTrackingRegion.
+struct SharedHmdBlock {
+  // kSharedStatus*.
+  volatile uint32_t       status;
+  // HmdProvider::connection_generation(). Updated after info, so a reader
+  // that sees a new generation also sees the new info.
+  volatile uint32_t       connection_generation;
+  SeqLock<SharedHmdInfo>  info;
+  SeqLock<HmdSnapshot>    snapshot;
+  // Incremented by readers to ask for ResetOrientation.
+  volatile int32_t        reset_requests;
+};
+
+// Layout of the memory npvr_daemon publishes device state into. Every field
+// is written by the daemon only, except the requests, which readers set.
+// Plain data without pointers so that it means the same in every process.
+struct SharedTrackingRegion {
+  uint32_t                magic;
+  uint32_t                version;
+  uint32_t                size;
+
+  // NowNanos() at the daemon's latest publish. The clock is system wide, so
+  // readers compare it against their own NowNanos() to tell a live daemon
+  // from a dead one.
+  SeqLock<uint64_t>       heartbeat;
+
+  // HmdProvider::device_count() of the daemon's provider; the first that
+  // many of hmds are in use.
+  volatile uint32_t       hmd_count;
+  volatile uint32_t       fusion_mode;
+  // One plus the FusionMode a reader last asked for; zero if none has.
+  volatile uint32_t       requested_fusion_mode;
+  SharedHmdBlock          hmds[kMaxHmdDevices];
+
+  // kSharedStatus* for the controllers.
+  volatile uint32_t       controller_status;
+  // Every frame the daemon gathered, in order.
+  SixenseFrameBuffer      controller_frames;
+};
+
+// The daemon side: owns the region and copies providers into it.
+class SharedTrackingPublisher {
+public:
+  SharedTrackingPublisher();
+  ~SharedTrackingPublisher();
+
+  // Takes the per-user publisher lock, then creates or takes over the
+  // region. Fails if another daemon holds the lock.
+  bool Open();
+  // Marks the region abandoned, so readers stop trusting it immediately
+  // rather than after the timeout, unmaps it and drops the lock.
+  void Close();
+
+  // Carries out the requests readers made since the last call, then copies
+  // the providers' current state, every HMD device included, into the
+  // region. Called in a loop; each call only writes what changed, apart from
+  // the newest controller frames and the heartbeat.
+  void Publish(HmdProvider* hmd, ControllerProvider* controllers);
+
+private:
+  // What was last published for one HMD device.
+  struct HmdState {
+    int32_t             reset_requests;
+    bool                info_published;
+    uint32_t            info_generation;
+    OVR::UInt64         snapshot_timestamp;
+  };
+
+  void PublishHmd(HmdProvider* hmd, SharedHmdBlock* block, HmdState* state);
+  void PublishControllers(ControllerProvider* controllers);
+
+  NamedLock             lock_;
+  SharedMemory          memory_;
+  SharedTrackingRegion* region_;
+
+  uint32_t              requested_fusion_mode_;
+  HmdState              hmd_states_[kMaxHmdDevices];
+  ControllerCursor      cursor_;
+  SixensePoll           poll_;
+};
+
+// The browser side: reads what a running npvr_daemon publishes. Every
+// browser process maps the same region, so all of them share the one set of
+// devices the daemon holds open. Reports no devices once the daemon stops.
+// The HmdProvider methods report device 0; the other devices read their own
+// blocks of the region.
+class SharedTrackingProvider : public HmdProvider, public ControllerProvider {
+public:
+  SharedTrackingProvider();
+  virtual ~SharedTrackingProvider();
+
+  // The instance reading from the running daemon, or NULL if there is none.
+  static SharedTrackingProvider* Instance();
+
+  // Maps the region. Fails if no daemon has created it or it was created by
+  // an incompatible version.
+  bool Open();
+  // True if the daemon published within kSharedTrackingTimeoutNanos.
+  bool IsAlive() const;
+
+  // The daemon holds the devices open, so these do nothing.
+  virtual void Acquire();
+  virtual void Release();
+  virtual bool IsReady() const;
+
+  virtual bool DevicePresent() const;
+  virtual uint32_t connection_generation() const;
+  virtual bool GetDeviceInfo(OVR::HMDInfo* out_info) const;
+  virtual bool GetSnapshot(HmdSnapshot* out_snapshot) const;
+  // Snapshot timestamps are on the daemon's provider clock, so the age is
+  // taken from sample_nanos instead.
+  virtual OVR::Quatf PredictOrientation(const HmdSnapshot& snapshot,
+                                        float interval) const;
+  // Forwarded to the daemon, which carries them out on its next publish.
+  virtual void ResetOrientation();
+  virtual FusionMode fusion_mode() const;
+  virtual void SetFusionMode(FusionMode mode);
+  virtual bool GetSerial(char* out_serial) const;
+  virtual int device_count() const;
+  virtual HmdProvider* device(int index);
+
+  virtual bool IsAvailable() const;
+  virtual void Gather(bool include_history, ControllerCursor* cursor,
+                      SixensePoll* poll);
+
+private:
+  class Hmd;
+
+  NamedLock             lock_;
+  SharedMemory          memory_;
+  SharedTrackingRegion* region_;
+  Hmd*                  hmds_[kMaxHmdDevices];
+};
+
+}  // namespace npvr
+
+
+#endif  // NPVR_SHARED_TRACKING_H_
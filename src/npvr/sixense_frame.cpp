@@ -0,0 +1,85 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/sixense_frame.h>
+
+#include <npvr/atomic.h>
+
+using namespace npvr;
+
+
+SixenseFrameBuffer::SixenseFrameBuffer() :
+    newest_valid_(0) {
+}
+
+void SixenseFrameBuffer::Publish(const SixenseFrame& frame) {
+  if (frame.base >= kMaxSixenseBases ||
+      frame.controller >= kMaxSixenseControllers) {
+    return;
+  }
+  newest_[frame.base][frame.controller].Write(frame);
+  uint32_t bit = SixenseControllerBit(frame.base, frame.controller);
+  if (!(newest_valid_ & bit)) {
+    AtomicStoreRelease(&newest_valid_, newest_valid_ | bit);
+  }
+  history_.Push(frame);
+}
+
+void SixenseFrameBuffer::SetConnected(uint32_t mask) {
+  if (newest_valid_ & ~mask) {
+    AtomicStoreRelease(&newest_valid_, newest_valid_ & mask);
+  }
+}
+
+void SixenseFrameBuffer::Gather(bool include_history, uint32_t* cursor,
+                                SixensePoll* poll) const {
+  poll->base_count = 0;
+  poll->controller_count = 0;
+  poll->history_count = 0;
+
+  uint32_t valid = AtomicLoadAcquire(&newest_valid_);
+  for (int base = 0; base < kMaxSixenseBases; base++) {
+    bool any = false;
+    for (int cont = 0; cont < kMaxSixenseControllers; cont++) {
+      if ((valid & SixenseControllerBit(base, cont)) &&
+          newest_[base][cont].Read(
+              &poll->controllers[poll->controller_count])) {
+        poll->controller_count++;
+        any = true;
+      }
+    }
+    if (any) {
+      poll->bases[poll->base_count++] = base;
+    }
+  }
+
+  uint32_t count = history_.count();
+  uint32_t begin = *cursor;
+  if (count - begin > (uint32_t)kMaxSixenseHistorySamples) {
+    // Fell behind; the oldest frames are gone or about to be.
+    begin = count > (uint32_t)kMaxSixenseHistorySamples ?
+        count - kMaxSixenseHistorySamples : 0;
+  }
+  if (include_history) {
+    for (uint32_t n = begin; n != count; n++) {
+      // A frame the publisher lapped during the copy is lost.
+      if (history_.Read(n, &poll->history[poll->history_count])) {
+        poll->history_count++;
+      }
+    }
+  }
+  *cursor = count;
+}
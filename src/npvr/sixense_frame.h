@@ -0,0 +1,112 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_SIXENSE_FRAME_H_
+#define NPVR_SIXENSE_FRAME_H_
+
+#include <npvr.h>
+#include <npvr/seqlock.h>
+#include <npvr/sequenced_ring.h>
+
+
+namespace npvr {
+
+const int kMaxSixenseBases = 4;
+const int kMaxSixenseControllers = 4;
+// Upper bound on sixenseGetHistorySize() that we will walk.
+const int kMaxSixenseHistory = 16;
+// Upper bound on history samples returned by a single poll.
+const int kMaxSixenseHistorySamples = 64;
+// Frames SixenseFrameBuffer keeps. Twice what one poll returns, so a reader
+// that falls slightly behind still finds every frame.
+const uint32_t kSixenseFrameRingSize = 2 * kMaxSixenseHistorySamples;
+
+const uint8_t kSixenseFrameFlagDocked = 1 << 0;
+const uint8_t kSixenseFrameFlagHemiTracking = 1 << 1;
+
+// One controller sample, in the fields poll reports. Kept independent of
+// the Sixense SDK so frames can be captured, replayed and serialized on
+// machines without it. Plain data; written to capture files as is.
+struct SixenseFrame {
+  uint8_t   base;
+  uint8_t   controller;
+  uint8_t   sequence;
+  // kSixenseFrameFlag*.
+  uint8_t   flags;
+  uint8_t   hand;
+  uint8_t   reserved[3];
+  float     position[3];
+  float     rotation[4];
+  float     joystick[2];
+  float     trigger;
+  uint32_t  buttons;
+};
+
+// Sixense state gathered once per poll and then serialized.
+struct SixensePoll {
+  int base_count;
+  int bases[kMaxSixenseBases];
+
+  // Newest frame for each enabled controller.
+  int controller_count;
+  SixenseFrame controllers[kMaxSixenseBases * kMaxSixenseControllers];
+
+  // Every frame since the previous poll, oldest first per controller.
+  int history_count;
+  SixenseFrame history[kMaxSixenseHistorySamples];
+};
+
+// A controller's bit in SixenseFrameBuffer's connected mask.
+inline uint32_t SixenseControllerBit(int base, int controller) {
+  return 1u << (base * kMaxSixenseControllers + controller);
+}
+
+// The newest frame of every controller plus a ring of the most recent
+// frames, for sources that push frames from their own thread rather than
+// being polled. One thread publishes; any number gather, without locks, so
+// a slow reader never delays the publisher. Plain data without pointers, so
+// it may also live in memory shared across processes.
+class SixenseFrameBuffer {
+public:
+  SixenseFrameBuffer();
+
+  // Frames naming an out of range base or controller are dropped. Must only
+  // be called from one thread at a time.
+  void Publish(const SixenseFrame& frame);
+  // Forgets the newest frame of every controller whose SixenseControllerBit
+  // is clear in mask, so that Gather stops reporting controllers that were
+  // disabled or whose base went away. A controller's next frame brings it
+  // back. Same thread as Publish.
+  void SetConnected(uint32_t mask);
+  // Fills poll with the newest frame of every connected controller and, if
+  // include_history, the frames published since *cursor, which is advanced.
+  // A cursor more than a poll behind skips the oldest frames, as does one
+  // ahead of the buffer (it was recreated).
+  void Gather(bool include_history, uint32_t* cursor,
+              SixensePoll* poll) const;
+
+private:
+  SeqLock<SixenseFrame> newest_[kMaxSixenseBases][kMaxSixenseControllers];
+  // A controller's SixenseControllerBit is set once its newest frame has
+  // been written, until SetConnected clears it.
+  volatile uint32_t     newest_valid_;
+  SequencedRing<SixenseFrame, kSixenseFrameRingSize> history_;
+};
+
+}  // namespace npvr
+
+
+#endif  // NPVR_SIXENSE_FRAME_H_
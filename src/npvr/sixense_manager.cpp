@@ -0,0 +1,353 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/sixense_manager.h>
+
+#include <npvr/atomic.h>
+#include <npvr/capture.h>
+#include <npvr/clock.h>
+
+#ifdef USE_SIXENSE
+#include <third_party/sixense/include/sixense.h>
+#endif // USE_SIXENSE
+
+using namespace npvr;
+
+
+namespace {
+
+enum State {
+  kStateIdle,
+  kStateInitializing,
+  kStateAvailable,
+  kStateFailed,
+};
+
+// How often the sampling thread wakes. Faster than a base reports, so each
+// wake finds at most a few new frames per controller; the walk back through
+// the SDK's history picks up any that arrived in between.
+const uint32_t kSamplingIntervalMicros = 4000;
+
+#ifdef USE_SIXENSE
+// Which bases are connected and which controllers are enabled on each.
+// Probing this takes several SDK calls per base, so it is cached and only
+// refreshed every kSixenseTopologyInterval or when a sample disagrees with
+// it.
+struct SixenseTopology {
+  bool      valid;
+  uint64_t  refresh_time;
+  int       base_count;
+  int       bases[kMaxSixenseBases];
+  uint32_t  controller_masks[kMaxSixenseBases];
+  // sixenseGetHistorySize(), clamped to kMaxSixenseHistory.
+  int       history_size;
+  // Last base passed to sixenseSetActiveBase, or -1.
+  int       active_base;
+};
+
+const uint64_t kSixenseTopologyInterval = 1000000000ull;
+
+void RefreshSixenseTopology(uint64_t now, SixenseTopology* out_topology) {
+  SixenseTopology& topology = *out_topology;
+  topology.valid = true;
+  topology.refresh_time = now;
+  topology.base_count = 0;
+
+  topology.history_size = sixenseGetHistorySize();
+  if (topology.history_size > kMaxSixenseHistory) {
+    topology.history_size = kMaxSixenseHistory;
+  } else if (topology.history_size < 1) {
+    topology.history_size = 1;
+  }
+
+  int max_bases = sixenseGetMaxBases();
+  if (max_bases > kMaxSixenseBases) {
+    max_bases = kMaxSixenseBases;
+  }
+  for (int base = 0; base < max_bases; base++) {
+    if (!sixenseIsBaseConnected(base)) {
+      continue;
+    }
+    sixenseSetActiveBase(base);
+    topology.active_base = base;
+
+    uint32_t mask = 0;
+    int max_conts = sixenseGetMaxControllers();
+    if (max_conts > kMaxSixenseControllers) {
+      max_conts = kMaxSixenseControllers;
+    }
+    for (int cont = 0; cont < max_conts; cont++) {
+      if (sixenseIsControllerEnabled(cont)) {
+        mask |= 1 << cont;
+      }
+    }
+
+    topology.bases[topology.base_count] = base;
+    topology.controller_masks[topology.base_count] = mask;
+    topology.base_count++;
+  }
+}
+
+// The controllers topology lists, as a SixenseFrameBuffer connected mask.
+uint32_t GetConnectedMask(const SixenseTopology& topology) {
+  uint32_t mask = 0;
+  for (int n = 0; n < topology.base_count; n++) {
+    for (int cont = 0; cont < kMaxSixenseControllers; cont++) {
+      if (topology.controller_masks[n] & (1 << cont)) {
+        mask |= SixenseControllerBit(topology.bases[n], cont);
+      }
+    }
+  }
+  return mask;
+}
+
+void ToSixenseFrame(int base, int controller, const sixenseControllerData& cd,
+                    SixenseFrame* out) {
+  out->base = (uint8_t)base;
+  out->controller = (uint8_t)controller;
+  out->sequence = cd.sequence_number;
+  out->flags = 0;
+  if (cd.is_docked) {
+    out->flags |= kSixenseFrameFlagDocked;
+  }
+  if (cd.hemi_tracking_enabled) {
+    out->flags |= kSixenseFrameFlagHemiTracking;
+  }
+  out->hand = cd.which_hand;
+  memset(out->reserved, 0, sizeof(out->reserved));
+  memcpy(out->position, cd.pos, sizeof(out->position));
+  memcpy(out->rotation, cd.rot_quat, sizeof(out->rotation));
+  out->joystick[0] = cd.joystick_x;
+  out->joystick[1] = cd.joystick_y;
+  out->trigger = cd.trigger;
+  out->buttons = cd.buttons;
+}
+#endif // USE_SIXENSE
+
+}  // namespace
+
+
+class SixenseManager::SamplingThread : public Thread {
+public:
+  SamplingThread(SixenseManager* manager) :
+      manager_(manager) {
+  }
+
+protected:
+  virtual void Run() {
+#ifdef USE_SIXENSE
+    if (sixenseInit() != SIXENSE_SUCCESS) {
+      AtomicStoreRelease(&manager_->state_, kStateFailed);
+      return;
+    }
+    AtomicStoreRelease(&manager_->state_, kStateAvailable);
+
+    topology_.valid = false;
+    topology_.active_base = -1;
+    memset(seen_, 0, sizeof(seen_));
+    while (AtomicLoadAcquire(&manager_->running_)) {
+      Sample();
+      SleepMicros(kSamplingIntervalMicros);
+    }
+    // Nothing is connected once the SDK is gone.
+    manager_->frames_.SetConnected(0);
+    sixenseExit();
+#else
+    AtomicStoreRelease(&manager_->state_, kStateFailed);
+#endif // USE_SIXENSE
+  }
+
+private:
+#ifdef USE_SIXENSE
+  // Publishes every frame that arrived since the last call, oldest first per
+  // controller.
+  void Sample() {
+    SixenseTopology& topology = topology_;
+    uint64_t now = NowNanos();
+    if (!topology.valid ||
+        now - topology.refresh_time > kSixenseTopologyInterval) {
+      RefreshSixenseTopology(now, &topology);
+      manager_->frames_.SetConnected(GetConnectedMask(topology));
+    }
+    CaptureWriter* capture = CaptureWriter::Instance();
+
+    for (int n = 0; n < topology.base_count; n++) {
+      int base = topology.bases[n];
+      uint32_t mask = topology.controller_masks[n];
+      if (topology.active_base != base) {
+        sixenseSetActiveBase(base);
+        topology.active_base = base;
+      }
+      if (sixenseGetAllNewestData(&history_[0]) != SIXENSE_SUCCESS) {
+        // Base went away; reprobe next time, but stop reporting its
+        // controllers now.
+        topology.valid = false;
+        uint32_t base_mask = 0;
+        for (int cont = 0; cont < kMaxSixenseControllers; cont++) {
+          base_mask |= SixenseControllerBit(base, cont);
+        }
+        manager_->frames_.SetConnected(~base_mask);
+        continue;
+      }
+
+      int fetched = 1;
+      for (int cont = 0; cont < kMaxSixenseControllers; cont++) {
+        bool enabled = (mask & (1 << cont)) != 0;
+        if (enabled != (history_[0].controllers[cont].enabled != 0)) {
+          // Controller was enabled or disabled; reprobe next time.
+          topology.valid = false;
+          if (enabled) {
+            manager_->frames_.SetConnected(
+                ~SixenseControllerBit(base, cont));
+            continue;
+          }
+        }
+        if (!enabled) {
+          continue;
+        }
+
+        // Walk back until we hit the last sample we published. Sequence
+        // numbers are 8 bits, but the history is far shorter than 256.
+        int count = 1;
+        if (seen_[base][cont]) {
+          count = 0;
+          while (count < topology.history_size) {
+            if (count == fetched) {
+              sixenseGetAllData(fetched, &history_[fetched]);
+              fetched++;
+            }
+            if (history_[count].controllers[cont].sequence_number ==
+                last_sequence_[base][cont]) {
+              break;
+            }
+            count++;
+          }
+        }
+
+        // history_[back] is the data that many samples back from the
+        // newest. The SDK may take a sample between the calls above, which
+        // shifts the older entries by one and repeats a frame; skip it.
+        for (int back = count - 1; back >= 0; back--) {
+          const sixenseControllerData& data = history_[back].controllers[cont];
+          if (seen_[base][cont] &&
+              data.sequence_number == last_sequence_[base][cont]) {
+            continue;
+          }
+          last_sequence_[base][cont] = data.sequence_number;
+          seen_[base][cont] = true;
+          SixenseFrame frame;
+          ToSixenseFrame(base, cont, data, &frame);
+          manager_->frames_.Publish(frame);
+          if (capture) {
+            capture->WriteSixenseFrame(frame);
+          }
+        }
+      }
+    }
+  }
+
+  SixenseTopology           topology_;
+  // Sequence number of the newest frame published for each controller.
+  uint8_t                   last_sequence_[kMaxSixenseBases]
+                                          [kMaxSixenseControllers];
+  bool                      seen_[kMaxSixenseBases][kMaxSixenseControllers];
+  sixenseAllControllerData  history_[kMaxSixenseHistory];
+#endif // USE_SIXENSE
+
+  SixenseManager* manager_;
+};
+
+
+SixenseManager* SixenseManager::Instance() {
+  static SixenseManager instance;
+  return &instance;
+}
+
+SixenseManager::SixenseManager() :
+    ref_count_(0),
+    sampling_thread_(NULL),
+    running_(0),
+#ifdef USE_SIXENSE
+    state_(kStateIdle) {
+#else
+    state_(kStateFailed) {
+#endif // USE_SIXENSE
+  sampling_thread_ = new SamplingThread(this);
+
+  replaying_ = GetReplayPath() != NULL;
+  if (replaying_) {
+    state_ = kStateAvailable;
+  }
+}
+
+SixenseManager::~SixenseManager() {
+  AtomicStoreRelease(&running_, 0);
+  sampling_thread_->Join();
+  delete sampling_thread_;
+}
+
+void SixenseManager::Acquire() {
+  if (AtomicIncrement(&ref_count_) == 1 && !replaying_) {
+    UpdateSampling();
+  }
+}
+
+void SixenseManager::Release() {
+  if (AtomicDecrement(&ref_count_) == 0 && !replaying_) {
+    UpdateSampling();
+  }
+}
+
+void SixenseManager::UpdateSampling() {
+#ifdef USE_SIXENSE
+  MutexLock lock(&lifecycle_mutex_);
+  bool wanted = AtomicCompareExchange(&ref_count_, 0, 0) > 0;
+  if (wanted == sampling_thread_->is_started()) {
+    return;
+  }
+  if (wanted) {
+    AtomicStoreRelease(&state_, kStateInitializing);
+    AtomicStoreRelease(&running_, 1);
+    if (!sampling_thread_->Start()) {
+      AtomicStoreRelease(&state_, kStateFailed);
+    }
+  } else {
+    // Blocks only if the last object goes away while sixenseInit is still
+    // running; the SDK cannot be torn down mid-init.
+    AtomicStoreRelease(&running_, 0);
+    sampling_thread_->Join();
+    AtomicStoreRelease(&state_, kStateIdle);
+  }
+#endif // USE_SIXENSE
+}
+
+bool SixenseManager::IsReady() const {
+  uint32_t state = AtomicLoadAcquire(&state_);
+  return state == kStateAvailable || state == kStateFailed;
+}
+
+bool SixenseManager::IsAvailable() const {
+  return AtomicLoadAcquire(&state_) == kStateAvailable;
+}
+
+void SixenseManager::PublishReplayFrame(const SixenseFrame& frame) {
+  frames_.Publish(frame);
+}
+
+void SixenseManager::Gather(bool include_history, ControllerCursor* cursor,
+                            SixensePoll* poll) {
+  frames_.Gather(include_history, &cursor->position, poll);
+}
@@ -0,0 +1,87 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_SIXENSE_MANAGER_H_
+#define NPVR_SIXENSE_MANAGER_H_
+
+#include <npvr.h>
+#include <npvr/sixense_frame.h>
+#include <npvr/thread.h>
+#include <npvr/tracking_provider.h>
+
+
+namespace npvr {
+
+// Owns the Sixense SDK lifetime and is the ControllerProvider backed by it.
+// Every SDK call, from sixenseInit() (which probes USB and can stall for
+// seconds) through sampling to sixenseExit(), is made on one sampling
+// thread. It publishes each frame into a SixenseFrameBuffer, so Gather is a
+// lock-free read that never touches the SDK, and callers check IsReady()
+// instead of waiting on init. Without USE_SIXENSE the manager is always
+// ready and never available.
+//
+// When replaying a capture (NPVR_REPLAY) the SDK is never touched; the
+// manager is available at once and serves frames published by the replay.
+class SixenseManager : public ControllerProvider {
+public:
+  static SixenseManager* Instance();
+
+  // Reference counted and safe to call from any thread. The first Acquire
+  // starts the sampling thread and the last Release stops it, which shuts
+  // the SDK down.
+  virtual void Acquire();
+  virtual void Release();
+
+  virtual bool IsReady() const;
+  virtual bool IsAvailable() const;
+  // Any thread.
+  virtual void Gather(bool include_history, ControllerCursor* cursor,
+                      SixensePoll* poll);
+
+  bool is_replaying() const { return replaying_; }
+  // Records a replayed frame. Called from the replay thread only.
+  void PublishReplayFrame(const SixenseFrame& frame);
+
+private:
+  class SamplingThread;
+
+  SixenseManager();
+  virtual ~SixenseManager();
+
+  // Starts or stops the sampling thread to match ref_count_.
+  void UpdateSampling();
+
+  volatile int32_t  ref_count_;
+  // Held while the sampling thread is started or stopped. Whichever of a
+  // racing Acquire and Release takes it last sees the final ref_count_, so
+  // the thread always ends up matching it.
+  Mutex             lifecycle_mutex_;
+  SamplingThread*   sampling_thread_;
+  // Cleared to ask the sampling thread to shut the SDK down and exit.
+  volatile uint32_t running_;
+  // One of the State values in sixense_manager.cpp, written by the sampling
+  // thread.
+  volatile uint32_t state_;
+
+  bool              replaying_;
+  // Written by the sampling thread, or the replay thread when replaying.
+  SixenseFrameBuffer frames_;
+};
+
+}  // namespace npvr
+
+
+#endif  // NPVR_SIXENSE_MANAGER_H_
@@ -0,0 +1,152 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/stereo_params.h>
+
+#include <math.h>
+#include <string.h>
+
+
+using namespace npvr;
+
+
+namespace {
+
+// Where the distortion should reach the edge of the viewport, in viewport
+// coordinates: the left edge, halfway down.
+const float kDistortionFitX = -1.0f;
+const float kDistortionFitY = 0.0f;
+
+// Field of view the 2D (HUD) projection covers.
+const float k2DFov = 85.0f * 3.14159265f / 180.0f;
+
+float Distort(const OVR::HMDInfo& info, float r) {
+  const float* k = info.DistortionK;
+  float rsq = r * r;
+  return r * (k[0] + k[1] * rsq + k[2] * rsq * rsq + k[3] * rsq * rsq * rsq);
+}
+
+void MakeIdentity(float m[16]) {
+  memset(m, 0, 16 * sizeof(float));
+  m[0] = m[5] = m[10] = m[15] = 1;
+}
+
+void MakeTranslation(float m[16], float x) {
+  MakeIdentity(m);
+  m[12] = x;
+}
+
+void MakePerspective(float m[16], float fov_y, float aspect, float z_near,
+                     float z_far) {
+  float f = 1 / tanf(fov_y / 2);
+  float nf = 1 / (z_near - z_far);
+  memset(m, 0, 16 * sizeof(float));
+  m[0] = f / aspect;
+  m[5] = f;
+  m[10] = (z_far + z_near) * nf;
+  m[11] = -1;
+  m[14] = 2 * z_far * z_near * nf;
+}
+
+// out = a * b. out must not alias either.
+void Multiply(float out[16], const float a[16], const float b[16]) {
+  for (int col = 0; col < 4; col++) {
+    for (int row = 0; row < 4; row++) {
+      out[col * 4 + row] =
+          b[col * 4 + 0] * a[0 + row] + b[col * 4 + 1] * a[4 + row] +
+          b[col * 4 + 2] * a[8 + row] + b[col * 4 + 3] * a[12 + row];
+    }
+  }
+}
+
+}  // namespace
+
+
+void npvr::ComputeStereoParams(const OVR::HMDInfo& info,
+                               const StereoConfig& config,
+                               StereoParams* out_params) {
+  float ipd = config.interpupillary_distance > 0 ?
+      config.interpupillary_distance : info.InterpupillaryDistance;
+  float h_resolution = (float)info.HResolution;
+  float v_resolution = (float)info.VResolution;
+
+  // Distortion offset and scale.
+  float lens_offset = info.LensSeparationDistance / 2;
+  float lens_shift = info.HScreenSize / 4 - lens_offset;
+  float distortion_center_offset_x = 4 * lens_shift / info.HScreenSize;
+  float distortion_scale = 1;
+  if (fabsf(kDistortionFitX) >= 0.0001f || fabsf(kDistortionFitY) >= 0.0001f) {
+    float stereo_aspect = h_resolution / v_resolution / 2;
+    float dx = kDistortionFitX - distortion_center_offset_x;
+    float dy = kDistortionFitY / stereo_aspect;
+    float fit_radius = sqrtf(dx * dx + dy * dy);
+    distortion_scale = Distort(info, fit_radius) / fit_radius;
+  }
+
+  float perceived_half_rt_distance = info.VScreenSize / 2 * distortion_scale;
+  float fov_y = 2 * atanf(perceived_half_rt_distance /
+                          info.EyeToScreenDistance);
+
+  // Projection center offset.
+  float view_center = info.HScreenSize / 4;
+  float eye_projection_shift = view_center - info.LensSeparationDistance / 2;
+  float projection_center_offset = 4 * eye_projection_shift / info.HScreenSize;
+
+  // 2D.
+  float meters_to_pixels = h_resolution / info.HScreenSize;
+  float lens_distance_pixels = meters_to_pixels * info.LensSeparationDistance;
+  float eye_distance_pixels = meters_to_pixels * ipd;
+  float off_center_shift_pixels =
+      (info.EyeToScreenDistance / 0.8f) * eye_distance_pixels;
+  float left_pixel_center = h_resolution / 2 - lens_distance_pixels / 2;
+  float right_pixel_center = lens_distance_pixels / 2;
+  float pixel_difference = left_pixel_center - right_pixel_center;
+  float perceived_half_screen_distance =
+      tanf(k2DFov / 2) * info.EyeToScreenDistance;
+  float vfov_size = 2 * perceived_half_screen_distance / distortion_scale;
+  float fov_pixels = v_resolution * vfov_size / info.VScreenSize;
+  float ortho_pixel_offset =
+      (pixel_difference + off_center_shift_pixels / distortion_scale) / 2;
+  ortho_pixel_offset = ortho_pixel_offset * 2 / fov_pixels;
+
+  // Per eye: the left is offset one way, the right the other.
+  float projection[16];
+  float ortho[16];
+  float offset[16];
+  MakePerspective(projection, fov_y, h_resolution / v_resolution / 2,
+                  config.z_near, config.z_far);
+  MakeIdentity(ortho);
+  ortho[0] = fov_pixels / (h_resolution / 2);
+  ortho[5] = -fov_pixels / v_resolution;
+
+  out_params->distortion_scale = distortion_scale;
+  out_params->fov_y = fov_y;
+  for (int n = 0; n < 2; n++) {
+    StereoParams::Eye& eye = out_params->eyes[n];
+    float sign = n ? -1.0f : 1.0f;
+    eye.viewport[0] = n ? 0.5f : 0.0f;
+    eye.viewport[1] = 0;
+    eye.viewport[2] = 0.5f;
+    eye.viewport[3] = 1;
+    eye.distortion_center_offset_x = sign * distortion_center_offset_x;
+    eye.distortion_center_offset_y = 0;
+    MakeTranslation(eye.view_adjust, -sign * ipd / 2);
+    MakeTranslation(offset, sign * projection_center_offset);
+    Multiply(eye.projection, offset, projection);
+    MakeTranslation(offset, sign * ortho_pixel_offset);
+    Multiply(eye.ortho_projection, ortho, offset);
+  }
+}
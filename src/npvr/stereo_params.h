@@ -0,0 +1,59 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_STEREO_PARAMS_H_
+#define NPVR_STEREO_PARAMS_H_
+
+#include <OVR.h>
+
+
+namespace npvr {
+
+// Inputs to ComputeStereoParams besides the HMD info. A zero IPD means the
+// one the HMD info reports.
+struct StereoConfig {
+  float interpupillary_distance;
+  float z_near;
+  float z_far;
+};
+
+// What vr.StereoParams derives from the HMD info, for both eyes. Matrices are
+// column-major, as WebGL takes them.
+struct StereoParams {
+  float distortion_scale;
+  float fov_y;
+
+  struct Eye {
+    // [left, top, width, height] in [0-1] view coordinates.
+    float viewport[4];
+    float distortion_center_offset_x;
+    float distortion_center_offset_y;
+    float projection[16];
+    float view_adjust[16];
+    float ortho_projection[16];
+  } eyes[2];
+};
+
+// Computes the stereo rendering parameters the way the Oculus SDK's
+// StereoConfig does with the default distortion fit point, matching
+// vr.StereoParams.prototype.update.
+void ComputeStereoParams(const OVR::HMDInfo& info, const StereoConfig& config,
+                         StereoParams* out_params);
+
+}  // namespace npvr
+
+
+#endif  // NPVR_STEREO_PARAMS_H_
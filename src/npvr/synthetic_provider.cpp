@@ -0,0 +1,385 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/synthetic_provider.h>
+
+#include <npvr/atomic.h>
+#include <npvr/clock.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace npvr;
+
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+const uint64_t kNanosPerSecond = 1000000000ull;
+// Longest the generator sleeps, so Release is never kept waiting.
+const uint32_t kMaxSleepMicros = 10000;
+
+// Head script: yaw and pitch sinusoids at unrelated frequencies, so the
+// motion does not repeat for a long while and velocity and acceleration are
+// never both zero.
+const double kYawAmplitude = 0.6;
+const double kYawFrequency = 0.25;
+const double kPitchAmplitude = 0.3;
+const double kPitchFrequency = 0.4;
+// Seconds each further HMD runs ahead of the one before it in the script.
+const double kDevicePhase = 1.7;
+
+uint32_t GetEnvUInt32(const char* name, uint32_t default_value) {
+  const char* value = getenv(name);
+  if (!value || !*value) {
+    return default_value;
+  }
+  return (uint32_t)strtoul(value, NULL, 10);
+}
+
+// out = a * b, quaternions as (x, y, z, w). out may not alias a or b.
+void MultiplyQuat(const float a[4], const float b[4], float out[4]) {
+  out[0] = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+  out[1] = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+  out[2] = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+  out[3] = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+}
+
+}  // namespace
+
+
+SyntheticConfig npvr::GetSyntheticConfig() {
+  SyntheticConfig config;
+  config.hmd_rate = GetEnvUInt32("NPVR_SYNTHETIC_HMD_RATE", 1000);
+  config.controller_rate = GetEnvUInt32("NPVR_SYNTHETIC_CONTROLLER_RATE", 60);
+  config.controller_count = (int)GetEnvUInt32("NPVR_SYNTHETIC_CONTROLLERS", 2);
+  config.hmd_count = (int)GetEnvUInt32("NPVR_SYNTHETIC_HMDS", 1);
+  return config;
+}
+
+
+class SyntheticProvider::GeneratorThread : public Thread {
+public:
+  GeneratorThread(SyntheticProvider* provider) :
+      provider_(provider),
+      exit_requested_(0) {
+  }
+
+  bool Start() {
+    AtomicStoreRelease(&exit_requested_, 0);
+    return Thread::Start();
+  }
+
+  void RequestExit() {
+    AtomicStoreRelease(&exit_requested_, 1);
+  }
+
+protected:
+  virtual void Run() {
+    const SyntheticConfig& config = provider_->config_;
+    uint64_t start = NowNanos();
+    uint64_t hmd_ticks = 0;
+    uint64_t controller_ticks = 0;
+    while (!AtomicLoadAcquire(&exit_requested_)) {
+      uint64_t elapsed = NowNanos() - start;
+      uint64_t hmd_due = elapsed * config.hmd_rate / kNanosPerSecond;
+      uint64_t controller_due =
+          elapsed * config.controller_rate / kNanosPerSecond;
+      // After a stall of more than a second drop the backlog rather than
+      // bursting through it.
+      if (hmd_due - hmd_ticks > config.hmd_rate) {
+        hmd_ticks = hmd_due - 1;
+      }
+      if (controller_due - controller_ticks > config.controller_rate) {
+        controller_ticks = controller_due - 1;
+      }
+      while (hmd_ticks < hmd_due) {
+        hmd_ticks++;
+        provider_->GenerateHmd((double)hmd_ticks / config.hmd_rate);
+      }
+      while (controller_ticks < controller_due) {
+        controller_ticks++;
+        provider_->GenerateControllers(
+            (double)controller_ticks / config.controller_rate,
+            (uint32_t)controller_ticks);
+      }
+
+      // Sleep until the next sample of either stream is due.
+      uint64_t next = elapsed + kMaxSleepMicros * 1000ull;
+      if (config.hmd_rate) {
+        uint64_t t = (hmd_ticks + 1) * kNanosPerSecond / config.hmd_rate;
+        next = t < next ? t : next;
+      }
+      if (config.controller_rate) {
+        uint64_t t = (controller_ticks + 1) * kNanosPerSecond /
+            config.controller_rate;
+        next = t < next ? t : next;
+      }
+      uint64_t now = NowNanos() - start;
+      if (next > now) {
+        SleepMicros((uint32_t)((next - now) / 1000) + 1);
+      }
+    }
+  }
+
+private:
+  SyntheticProvider*  provider_;
+  volatile uint32_t   exit_requested_;
+};
+
+
+SyntheticProvider* SyntheticProvider::Instance() {
+  static SyntheticProvider instance(GetSyntheticConfig());
+  return &instance;
+}
+
+SyntheticProvider::SyntheticProvider(const SyntheticConfig& config) :
+    config_(config),
+    index_(0),
+    primary_(this),
+    ref_count_(0),
+    thread_(NULL),
+    running_(0),
+    generation_(0),
+    fusion_mode_(kFusionModeSdk),
+    reset_requested_(false),
+    reset_(0, 0, 0, 1),
+    hmd_sample_count_(0),
+    controller_sample_count_(0) {
+  if (config_.controller_count < 0) {
+    config_.controller_count = 0;
+  } else if (config_.controller_count > kMaxSyntheticControllers) {
+    config_.controller_count = kMaxSyntheticControllers;
+  }
+  if (config_.hmd_count < 1) {
+    config_.hmd_count = 1;
+  } else if (config_.hmd_count > kMaxHmdDevices) {
+    config_.hmd_count = kMaxHmdDevices;
+  }
+  thread_ = new GeneratorThread(this);
+
+  // The other HMDs only generate head motion.
+  memset(devices_, 0, sizeof(devices_));
+  devices_[0] = this;
+  SyntheticConfig device_config = config_;
+  device_config.controller_rate = 0;
+  device_config.controller_count = 0;
+  device_config.hmd_count = 1;
+  for (int n = 1; n < config_.hmd_count; n++) {
+    devices_[n] = new SyntheticProvider(device_config);
+    devices_[n]->index_ = n;
+    devices_[n]->primary_ = this;
+  }
+}
+
+SyntheticProvider::~SyntheticProvider() {
+  for (int n = 1; n < config_.hmd_count; n++) {
+    delete devices_[n];
+  }
+  thread_->RequestExit();
+  thread_->Join();
+  delete thread_;
+}
+
+void SyntheticProvider::Acquire() {
+  if (ref_count_++) {
+    return;
+  }
+  if (thread_->Start()) {
+    AtomicStoreRelease(&generation_, generation_ + 1);
+    AtomicStoreRelease(&running_, 1);
+  }
+}
+
+void SyntheticProvider::Release() {
+  if (--ref_count_) {
+    return;
+  }
+  if (AtomicLoadAcquire(&running_)) {
+    AtomicStoreRelease(&running_, 0);
+    AtomicStoreRelease(&generation_, generation_ + 1);
+  }
+  thread_->RequestExit();
+  thread_->Join();
+  // The controllers stop with the thread that generated them, which leaves
+  // this one to publish.
+  frames_.SetConnected(0);
+}
+
+bool SyntheticProvider::IsReady() const {
+  return true;
+}
+
+bool SyntheticProvider::DevicePresent() const {
+  return config_.hmd_rate && AtomicLoadAcquire(&running_);
+}
+
+uint32_t SyntheticProvider::connection_generation() const {
+  return AtomicLoadAcquire(&generation_);
+}
+
+bool SyntheticProvider::GetDeviceInfo(OVR::HMDInfo* out_info) const {
+  if (!DevicePresent()) {
+    return false;
+  }
+  strncpy(out_info->ProductName, "npvr Synthetic HMD",
+          sizeof(out_info->ProductName) - 1);
+  out_info->ProductName[sizeof(out_info->ProductName) - 1] = 0;
+  strncpy(out_info->Manufacturer, "npvr",
+          sizeof(out_info->Manufacturer) - 1);
+  out_info->Manufacturer[sizeof(out_info->Manufacturer) - 1] = 0;
+  SetDefaultHmdInfo(out_info);
+  return true;
+}
+
+bool SyntheticProvider::GetSnapshot(HmdSnapshot* out_snapshot) const {
+  return snapshot_.Read(out_snapshot);
+}
+
+OVR::Quatf SyntheticProvider::PredictOrientation(const HmdSnapshot& snapshot,
+                                                 float interval) const {
+  float age = (NowNanos() / 1000 - snapshot.timestamp) / 1000000.0f;
+  return ExtrapolateSnapshot(snapshot, age + interval);
+}
+
+void SyntheticProvider::ResetOrientation() {
+  MutexLock lock(&reset_mutex_);
+  reset_requested_ = true;
+}
+
+FusionMode SyntheticProvider::fusion_mode() const {
+  return (FusionMode)AtomicLoadAcquire(&primary_->fusion_mode_);
+}
+
+void SyntheticProvider::SetFusionMode(FusionMode mode) {
+  AtomicStoreRelease(&primary_->fusion_mode_, (uint32_t)mode);
+}
+
+bool SyntheticProvider::GetSerial(char* out_serial) const {
+  if (!DevicePresent()) {
+    return false;
+  }
+  sprintf(out_serial, "NPVRSYN%04d", index_);
+  return true;
+}
+
+int SyntheticProvider::device_count() const {
+  return config_.hmd_rate ? config_.hmd_count : 1;
+}
+
+HmdProvider* SyntheticProvider::device(int index) {
+  if (index < 0 || index >= device_count()) {
+    return NULL;
+  }
+  return devices_[index];
+}
+
+bool SyntheticProvider::IsAvailable() const {
+  return config_.controller_count > 0 && config_.controller_rate > 0;
+}
+
+void SyntheticProvider::Gather(bool include_history, ControllerCursor* cursor,
+                               SixensePoll* poll) {
+  frames_.Gather(include_history, &cursor->position, poll);
+}
+
+void SyntheticProvider::GenerateHmd(double t) {
+  t += index_ * kDevicePhase;
+  double yaw_phase = 2 * kPi * kYawFrequency;
+  double pitch_phase = 2 * kPi * kPitchFrequency;
+  double yaw = kYawAmplitude * sin(yaw_phase * t);
+  double yaw_rate = kYawAmplitude * yaw_phase * cos(yaw_phase * t);
+  double yaw_accel = -yaw_phase * yaw_phase * yaw;
+  double pitch = kPitchAmplitude * sin(pitch_phase * t);
+  double pitch_rate = kPitchAmplitude * pitch_phase * cos(pitch_phase * t);
+  double pitch_accel = -pitch_phase * pitch_phase * pitch;
+
+  // Yaw about world Y, then pitch about the head's X.
+  const float yaw_quat[4] = {
+    0, (float)sin(yaw / 2), 0, (float)cos(yaw / 2),
+  };
+  const float pitch_quat[4] = {
+    (float)sin(pitch / 2), 0, 0, (float)cos(pitch / 2),
+  };
+  float scripted[4];
+  MultiplyQuat(yaw_quat, pitch_quat, scripted);
+
+  float reset[4];
+  {
+    MutexLock lock(&reset_mutex_);
+    if (reset_requested_) {
+      reset_ = OVR::Quatf(-scripted[0], -scripted[1], -scripted[2],
+                          scripted[3]);
+      reset_requested_ = false;
+    }
+    reset[0] = reset_.x;
+    reset[1] = reset_.y;
+    reset[2] = reset_.z;
+    reset[3] = reset_.w;
+  }
+  float q[4];
+  MultiplyQuat(reset, scripted, q);
+
+  // Body frame rates: pitch rate about X plus the yaw rate about world Y
+  // seen from the pitched head.
+  double cp = cos(pitch);
+  double sp = sin(pitch);
+  HmdSnapshot snapshot;
+  // Generated rather than fused, so both stages happen at once.
+  snapshot.sample_nanos = NowNanos();
+  snapshot.fusion_nanos = snapshot.sample_nanos;
+  snapshot.timestamp = snapshot.sample_nanos / 1000;
+  snapshot.orientation = OVR::Quatf(q[0], q[1], q[2], q[3]);
+  snapshot.angular_velocity = OVR::Vector3f((float)pitch_rate,
+      (float)(yaw_rate * cp), (float)(-yaw_rate * sp));
+  snapshot.angular_acceleration = OVR::Vector3f((float)pitch_accel,
+      (float)(yaw_accel * cp - yaw_rate * sp * pitch_rate),
+      (float)(-yaw_accel * sp - yaw_rate * cp * pitch_rate));
+  snapshot.acceleration = OVR::Vector3f(0, (float)(9.81 * cp),
+                                        (float)(-9.81 * sp));
+  snapshot.publish_nanos = NowNanos();
+  snapshot_.Write(snapshot);
+  hmd_sample_count_++;
+}
+
+void SyntheticProvider::GenerateControllers(double t, uint32_t tick) {
+  for (int n = 0; n < config_.controller_count; n++) {
+    // Each controller sweeps its own circle, a little out of phase.
+    double phase = t + n * 0.5;
+    SixenseFrame frame;
+    frame.base = (uint8_t)(n / kMaxSixenseControllers);
+    frame.controller = (uint8_t)(n % kMaxSixenseControllers);
+    frame.sequence = (uint8_t)tick;
+    frame.flags = kSixenseFrameFlagHemiTracking;
+    frame.hand = (uint8_t)(1 + n % 2);
+    memset(frame.reserved, 0, sizeof(frame.reserved));
+    frame.position[0] = (float)(200 * cos(phase) + (n % 2 ? 150 : -150));
+    frame.position[1] = (float)(100 * sin(2 * phase) + 50 * (n / 2));
+    frame.position[2] = -300.0f;
+    frame.rotation[0] = 0;
+    frame.rotation[1] = (float)sin(phase / 2);
+    frame.rotation[2] = 0;
+    frame.rotation[3] = (float)cos(phase / 2);
+    frame.joystick[0] = (float)sin(phase);
+    frame.joystick[1] = (float)cos(phase);
+    frame.trigger = (float)(0.5 + 0.5 * sin(3 * phase));
+    // A different button held every second.
+    frame.buttons = 1u << ((uint32_t)phase % 8);
+    frames_.Publish(frame);
+  }
+  controller_sample_count_ += config_.controller_count;
+}
@@ -0,0 +1,134 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_SYNTHETIC_PROVIDER_H_
+#define NPVR_SYNTHETIC_PROVIDER_H_
+
+#include <npvr.h>
+#include <npvr/seqlock.h>
+#include <npvr/sixense_frame.h>
+#include <npvr/thread.h>
+#include <npvr/tracking_provider.h>
+
+
+namespace npvr {
+
+// Most controllers SyntheticProvider will simulate; every slot a poll can
+// report.
+const int kMaxSyntheticControllers =
+    kMaxSixenseBases * kMaxSixenseControllers;
+
+struct SyntheticConfig {
+  // Samples per second. The HMD rate may be several kHz; 0 disables the HMD.
+  uint32_t hmd_rate;
+  uint32_t controller_rate;
+  // Up to kMaxSyntheticControllers, filling four controllers per base.
+  int      controller_count;
+  // Up to kMaxHmdDevices, each generated on its own thread at hmd_rate.
+  int      hmd_count;
+};
+
+// Default config overridden by NPVR_SYNTHETIC_HMD_RATE,
+// NPVR_SYNTHETIC_CONTROLLER_RATE, NPVR_SYNTHETIC_CONTROLLERS and
+// NPVR_SYNTHETIC_HMDS.
+SyntheticConfig GetSyntheticConfig();
+
+// Generates scripted, repeatable motion for an HMD and any number of
+// controllers on its own thread, at rates and device counts no real hardware
+// produces, for load testing poll and its consumers on machines with no
+// devices. Samples are produced on schedule even when the thread wakes late,
+// so the configured rates hold on average regardless of sleep resolution.
+class SyntheticProvider : public HmdProvider, public ControllerProvider {
+public:
+  explicit SyntheticProvider(const SyntheticConfig& config);
+  virtual ~SyntheticProvider();
+
+  // The instance used when NPVR_PROVIDER=synthetic.
+  static SyntheticProvider* Instance();
+
+  // The first Acquire starts the generator thread; the last Release stops
+  // it.
+  virtual void Acquire();
+  virtual void Release();
+  virtual bool IsReady() const;
+
+  virtual bool DevicePresent() const;
+  virtual uint32_t connection_generation() const;
+  // A DK1's parameters under a synthetic name.
+  virtual bool GetDeviceInfo(OVR::HMDInfo* out_info) const;
+  virtual bool GetSnapshot(HmdSnapshot* out_snapshot) const;
+  virtual OVR::Quatf PredictOrientation(const HmdSnapshot& snapshot,
+                                        float interval) const;
+  // Makes the current scripted orientation the new identity.
+  virtual void ResetOrientation();
+  // Recorded and reported back; the script is the same in both modes.
+  virtual FusionMode fusion_mode() const;
+  virtual void SetFusionMode(FusionMode mode);
+  // "NPVRSYN" and the device index.
+  virtual bool GetSerial(char* out_serial) const;
+  // Every device past the first is another SyntheticProvider, offset in
+  // phase so their orientations differ.
+  virtual int device_count() const;
+  virtual HmdProvider* device(int index);
+
+  virtual bool IsAvailable() const;
+  virtual void Gather(bool include_history, ControllerCursor* cursor,
+                      SixensePoll* poll);
+
+  const SyntheticConfig& config() const { return config_; }
+  // Samples generated so far. Only stable once the generator has stopped.
+  uint64_t hmd_sample_count() const { return hmd_sample_count_; }
+  uint64_t controller_sample_count() const {
+    return controller_sample_count_;
+  }
+
+private:
+  class GeneratorThread;
+
+  void GenerateHmd(double t);
+  void GenerateControllers(double t, uint32_t tick);
+
+  SyntheticConfig       config_;
+  // Index of this device and the device 0 that owns it, which holds the
+  // shared fusion mode.
+  int                   index_;
+  SyntheticProvider*    primary_;
+  SyntheticProvider*    devices_[kMaxHmdDevices];
+  int                   ref_count_;
+  GeneratorThread*      thread_;
+  volatile uint32_t     running_;
+  volatile uint32_t     generation_;
+  volatile uint32_t     fusion_mode_;
+
+  // Guards reset_requested_ and reset_.
+  Mutex                 reset_mutex_;
+  // Set by ResetOrientation; the generator then captures the rotation that
+  // undoes the current orientation and applies it to every later sample.
+  bool                  reset_requested_;
+  OVR::Quatf            reset_;
+
+  SeqLock<HmdSnapshot>  snapshot_;
+  SixenseFrameBuffer    frames_;
+
+  // Written by the generator thread only.
+  uint64_t              hmd_sample_count_;
+  uint64_t              controller_sample_count_;
+};
+
+}  // namespace npvr
+
+
+#endif  // NPVR_SYNTHETIC_PROVIDER_H_
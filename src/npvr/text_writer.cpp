@@ -0,0 +1,263 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/text_writer.h>
+
+#include <math.h>
+
+
+using namespace npvr;
+
+
+namespace {
+
+// Exact up to 1e22, correctly rounded beyond. Covers every scale needed to
+// bring a float (1e-45 to 3.4e38) to 9 integer digits.
+const double kPow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+  1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+  1e20, 1e21, 1e22, 1e23, 1e24, 1e25, 1e26, 1e27, 1e28, 1e29,
+  1e30, 1e31, 1e32, 1e33, 1e34, 1e35, 1e36, 1e37, 1e38, 1e39,
+  1e40, 1e41, 1e42, 1e43, 1e44, 1e45, 1e46, 1e47, 1e48, 1e49,
+  1e50, 1e51, 1e52, 1e53, 1e54, 1e55, 1e56, 1e57, 1e58, 1e59,
+  1e60,
+};
+const int kMaxPow10 = (int)(sizeof(kPow10) / sizeof(double)) - 1;
+
+const uint32_t kPow10Int[] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+};
+
+// Returns value * 10^exponent. Dividing by an exact power is more precise
+// than multiplying by an inexact negative one.
+double Scale(double value, int exponent) {
+  if (exponent >= 0) {
+    return value * kPow10[exponent > kMaxPow10 ? kMaxPow10 : exponent];
+  } else {
+    return value / kPow10[-exponent > kMaxPow10 ? kMaxPow10 : -exponent];
+  }
+}
+
+// Writes the digits of value in reverse and returns the count.
+size_t FormatUIntReversed(uint32_t value, char* out) {
+  size_t n = 0;
+  do {
+    out[n++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  return n;
+}
+
+}  // namespace
+
+
+size_t npvr::FormatFloat(float value, char* out) {
+  char* p = out;
+  if (value != value) {
+    memcpy(p, "nan", 4);
+    return 3;
+  }
+  double d = value;
+  if (d < 0 || (d == 0 && 1.0 / d < 0)) {
+    *p++ = '-';
+    d = -d;
+  }
+  if (d == 0) {
+    *p++ = '0';
+    *p = 0;
+    return p - out;
+  }
+  if (d > 3.5e38) {
+    memcpy(p, "inf", 4);
+    return p - out + 3;
+  }
+  float target = (float)d;
+
+  // Decimal exponent of the leading digit; log10 may be off by one near
+  // powers of ten.
+  int exponent = (int)floor(log10(d));
+  if (Scale(d, -exponent) >= 10) {
+    exponent++;
+  } else if (Scale(d, -exponent) < 1) {
+    exponent--;
+  }
+
+  // Round to 9 significant digits, which always round-trips a float, then
+  // binary search for the fewest digits that still parse back to the same
+  // value. Shorter candidates are derived from the 9 digit integer; a
+  // double-rounding error there only costs a digit, never correctness.
+  double rounded = floor(Scale(d, 8 - exponent) + 0.5);
+  if (rounded >= kPow10Int[9]) {
+    // Rounded up to the next power of ten (9.99 -> 10).
+    rounded /= 10;
+    exponent++;
+  }
+  uint32_t digits9 = (uint32_t)rounded;
+  uint32_t digits = digits9;
+  int digit_count = 9;
+  int digit_exponent = exponent;
+  int lo = 1;
+  int hi = 9;
+  while (lo < hi) {
+    int count = (lo + hi) / 2;
+    uint32_t divisor = kPow10Int[9 - count];
+    uint32_t candidate = (digits9 + divisor / 2) / divisor;
+    int candidate_exponent = exponent;
+    if (candidate >= kPow10Int[count]) {
+      candidate /= 10;
+      candidate_exponent++;
+    }
+    if ((float)Scale(candidate, candidate_exponent - count + 1) == target) {
+      digits = candidate;
+      digit_count = count;
+      digit_exponent = candidate_exponent;
+      hi = count;
+    } else {
+      lo = count + 1;
+    }
+  }
+  while (digit_count > 1 && digits % 10 == 0) {
+    digits /= 10;
+    digit_count--;
+  }
+
+  char reversed[10];
+  FormatUIntReversed(digits, reversed);
+  const char* digit = reversed + digit_count;
+
+  if (digit_exponent < -4 || digit_exponent >= 6) {
+    // d.ddde+XX
+    *p++ = *--digit;
+    if (digit_count > 1) {
+      *p++ = '.';
+      while (digit != reversed) {
+        *p++ = *--digit;
+      }
+    }
+    *p++ = 'e';
+    int e = digit_exponent;
+    if (e < 0) {
+      *p++ = '-';
+      e = -e;
+    } else {
+      *p++ = '+';
+    }
+    if (e < 10) {
+      *p++ = '0';
+    }
+    char e_reversed[4];
+    size_t e_count = FormatUIntReversed(e, e_reversed);
+    while (e_count) {
+      *p++ = e_reversed[--e_count];
+    }
+  } else if (digit_exponent < 0) {
+    // 0.000ddd
+    *p++ = '0';
+    *p++ = '.';
+    for (int n = -1; n > digit_exponent; n--) {
+      *p++ = '0';
+    }
+    while (digit != reversed) {
+      *p++ = *--digit;
+    }
+  } else {
+    // ddd.ddd or ddd00
+    for (int n = 0; n <= digit_exponent; n++) {
+      *p++ = digit != reversed ? *--digit : '0';
+    }
+    if (digit != reversed) {
+      *p++ = '.';
+      while (digit != reversed) {
+        *p++ = *--digit;
+      }
+    }
+  }
+
+  *p = 0;
+  return p - out;
+}
+
+
+TextWriter::TextWriter() :
+    length_(0), overflowed_(false) {
+  buffer_[0] = 0;
+}
+
+void TextWriter::Reset() {
+  length_ = 0;
+  overflowed_ = false;
+  buffer_[0] = 0;
+}
+
+void TextWriter::Append(const char* value) {
+  Append(value, strlen(value));
+}
+
+void TextWriter::Append(const char* value, size_t length) {
+  if (length_ + length >= kCapacity) {
+    overflowed_ = true;
+    return;
+  }
+  memcpy(buffer_ + length_, value, length);
+  length_ += length;
+  buffer_[length_] = 0;
+}
+
+void TextWriter::AppendChar(char value) {
+  if (length_ + 1 >= kCapacity) {
+    overflowed_ = true;
+    return;
+  }
+  buffer_[length_++] = value;
+  buffer_[length_] = 0;
+}
+
+void TextWriter::AppendInt(int32_t value) {
+  if (value < 0) {
+    AppendChar('-');
+    // Negate in unsigned space so INT32_MIN does not overflow.
+    AppendUInt(0u - (uint32_t)value);
+  } else {
+    AppendUInt((uint32_t)value);
+  }
+}
+
+void TextWriter::AppendUInt(uint32_t value) {
+  char reversed[10];
+  size_t count = FormatUIntReversed(value, reversed);
+  if (length_ + count >= kCapacity) {
+    overflowed_ = true;
+    return;
+  }
+  while (count) {
+    buffer_[length_++] = reversed[--count];
+  }
+  buffer_[length_] = 0;
+}
+
+void TextWriter::AppendFloat(float value) {
+  if (length_ + kMaxFloatLength >= kCapacity) {
+    overflowed_ = true;
+    return;
+  }
+  length_ += FormatFloat(value, buffer_ + length_);
+}
+
+void TextWriter::ToNPVariant(NPVariant* result) const {
+  NPUTF8* ret_str = (NPUTF8*)NPN_MemAlloc(length_ + 1);
+  memcpy(ret_str, buffer_, length_ + 1);
+  STRINGZ_TO_NPVARIANT(ret_str, *result);
+}
@@ -0,0 +1,77 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_TEXT_WRITER_H_
+#define NPVR_TEXT_WRITER_H_
+
+#include <npvr.h>
+
+
+namespace npvr {
+
+// Maximum number of characters FormatFloat will write, excluding the NUL.
+const size_t kMaxFloatLength = 16;
+
+// Formats a float in the style of printf %g (fixed notation for exponents in
+// [-4, 6), exponential otherwise) using the fewest significant digits that
+// parse back to the same float. Values that %g would print exactly, which is
+// anything representable in 6 digits, format identically to the default
+// ostream output. The decimal separator is always '.', regardless of locale.
+// Writes up to kMaxFloatLength characters and a trailing NUL, and returns the
+// number of characters written excluding the NUL.
+size_t FormatFloat(float value, char* out);
+
+// Builds text responses in a fixed buffer owned by the caller, so that a
+// response can be assembled without any heap allocations.
+class TextWriter {
+public:
+  TextWriter();
+
+  void Reset();
+  const char* data() const { return buffer_; }
+  size_t length() const { return length_; }
+  bool overflowed() const { return overflowed_; }
+
+  void Append(const char* value);
+  void Append(const char* value, size_t length);
+  void AppendChar(char value);
+  void AppendInt(int32_t value);
+  void AppendUInt(uint32_t value);
+  void AppendFloat(float value);
+
+  // Stream-style helpers so call sites read like the ostringstream code they
+  // replaced.
+  TextWriter& operator<<(const char* value) { Append(value); return *this; }
+  TextWriter& operator<<(int32_t value) { AppendInt(value); return *this; }
+  TextWriter& operator<<(uint32_t value) { AppendUInt(value); return *this; }
+  TextWriter& operator<<(float value) { AppendFloat(value); return *this; }
+
+  // Copies the response into a browser-owned string and sets it as the
+  // result. This is the only allocation made for a response.
+  void ToNPVariant(NPVariant* result) const;
+
+private:
+  static const size_t kCapacity = 16 * 1024;
+
+  char      buffer_[kCapacity];
+  size_t    length_;
+  bool      overflowed_;
+};
+
+}  // namespace npvr
+
+
+#endif  // NPVR_TEXT_WRITER_H_
@@ -0,0 +1,104 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/thread.h>
+
+
+using namespace npvr;
+
+
+Thread::Thread() :
+    started_(false) {
+#if defined(XP_WIN)
+  handle_ = NULL;
+#endif  // XP_WIN
+}
+
+Thread::~Thread() {
+  Join();
+}
+
+bool Thread::Start() {
+  if (started_) {
+    return false;
+  }
+#if defined(XP_WIN)
+  handle_ = CreateThread(NULL, 0, ThreadProc, this, 0, NULL);
+  started_ = handle_ != NULL;
+#else
+  started_ = pthread_create(&handle_, NULL, ThreadProc, this) == 0;
+#endif  // XP_WIN
+  return started_;
+}
+
+void Thread::Join() {
+  if (!started_) {
+    return;
+  }
+#if defined(XP_WIN)
+  WaitForSingleObject(handle_, INFINITE);
+  CloseHandle(handle_);
+  handle_ = NULL;
+#else
+  pthread_join(handle_, NULL);
+#endif  // XP_WIN
+  started_ = false;
+}
+
+#if defined(XP_WIN)
+DWORD WINAPI Thread::ThreadProc(LPVOID param) {
+  ((Thread*)param)->Run();
+  return 0;
+}
+#else
+void* Thread::ThreadProc(void* param) {
+  ((Thread*)param)->Run();
+  return NULL;
+}
+#endif  // XP_WIN
+
+
+Mutex::Mutex() {
+#if defined(XP_WIN)
+  InitializeCriticalSection(&critical_section_);
+#else
+  pthread_mutex_init(&mutex_, NULL);
+#endif  // XP_WIN
+}
+
+Mutex::~Mutex() {
+#if defined(XP_WIN)
+  DeleteCriticalSection(&critical_section_);
+#else
+  pthread_mutex_destroy(&mutex_);
+#endif  // XP_WIN
+}
+
+void Mutex::Lock() {
+#if defined(XP_WIN)
+  EnterCriticalSection(&critical_section_);
+#else
+  pthread_mutex_lock(&mutex_);
+#endif  // XP_WIN
+}
+
+void Mutex::Unlock() {
+#if defined(XP_WIN)
+  LeaveCriticalSection(&critical_section_);
+#else
+  pthread_mutex_unlock(&mutex_);
+#endif  // XP_WIN
+}
@@ -0,0 +1,88 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_THREAD_H_
+#define NPVR_THREAD_H_
+
+#include <npvr.h>
+
+#if !defined(XP_WIN)
+#include <pthread.h>
+#endif  // !XP_WIN
+
+
+namespace npvr {
+
+// Minimal joinable thread for code that cannot depend on the Oculus SDK's
+// OVR::Thread. Subclasses implement Run; the owner must Join before
+// destroying the object.
+class Thread {
+public:
+  Thread();
+  virtual ~Thread();
+
+  bool Start();
+  void Join();
+  bool is_started() const { return started_; }
+
+protected:
+  virtual void Run() = 0;
+
+private:
+#if defined(XP_WIN)
+  static DWORD WINAPI ThreadProc(LPVOID param);
+  HANDLE      handle_;
+#else
+  static void* ThreadProc(void* param);
+  pthread_t   handle_;
+#endif  // XP_WIN
+  bool        started_;
+};
+
+// Non-recursive mutex, for the same code.
+class Mutex {
+public:
+  Mutex();
+  ~Mutex();
+
+  void Lock();
+  void Unlock();
+
+private:
+#if defined(XP_WIN)
+  CRITICAL_SECTION  critical_section_;
+#else
+  pthread_mutex_t   mutex_;
+#endif  // XP_WIN
+
+  Mutex(const Mutex&);
+  void operator=(const Mutex&);
+};
+
+// Holds a Mutex for its lifetime.
+class MutexLock {
+public:
+  explicit MutexLock(Mutex* mutex) : mutex_(mutex) { mutex_->Lock(); }
+  ~MutexLock() { mutex_->Unlock(); }
+
+private:
+  Mutex* mutex_;
+};
+
+}  // namespace npvr
+
+
+#endif  // NPVR_THREAD_H_
@@ -0,0 +1,248 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/tracker_decoder.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NPVR_TRACKER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+using namespace npvr;
+
+
+namespace {
+
+// Report layout.
+const size_t kSampleCountOffset = 1;
+const size_t kTimestampOffset = 2;
+const size_t kTemperatureOffset = 6;
+const size_t kSamplesOffset = 8;
+const size_t kSampleStride = 16;
+const size_t kMagneticFieldOffset = 56;
+const int kMaxReportSamples = 3;
+
+// The tracker's clock ticks once per millisecond. Gaps larger than this are
+// treated as a restart rather than as dropped reports.
+const float kTimeUnit = 0.001f;
+const uint16_t kMaxRepeatGap = 254;
+
+const float kMotionScale = 0.0001f;
+const float kMagneticFieldScale = 0.0001f;
+const float kTemperatureScale = 0.01f;
+
+// Accelerometer x, y, z then gyro x, y, z.
+typedef float Motion[6];
+
+int16_t DecodeInt16(const uint8_t* data) {
+  return (int16_t)(data[0] | (data[1] << 8));
+}
+
+// Sign extends a 21-bit two's complement value. The shift left is done
+// unsigned, as shifting a set bit into the sign of an int32_t is undefined.
+int32_t SignExtend21(uint32_t value) {
+  return (int32_t)(value << 11) >> 11;
+}
+
+// Three big-endian 21-bit two's complement values packed into 8 bytes.
+void Unpack21(const uint8_t* data, float* out) {
+  uint32_t x = ((uint32_t)data[0] << 13) | (data[1] << 5) |
+               ((data[2] & 0xF8) >> 3);
+  uint32_t y = ((uint32_t)(data[2] & 0x07) << 18) | (data[3] << 10) |
+               (data[4] << 2) | ((data[5] & 0xC0) >> 6);
+  uint32_t z = ((uint32_t)(data[5] & 0x3F) << 15) | (data[6] << 7) |
+               (data[7] >> 1);
+  out[0] = SignExtend21(x) * kMotionScale;
+  out[1] = SignExtend21(y) * kMotionScale;
+  out[2] = SignExtend21(z) * kMotionScale;
+}
+
+void UnpackMotionScalar(const uint8_t* report, int count, Motion* out) {
+  for (int n = 0; n < count; n++) {
+    const uint8_t* data = report + kSamplesOffset + kSampleStride * n;
+    Unpack21(data, out[n]);
+    Unpack21(data + 8, out[n] + 3);
+  }
+}
+
+#if defined(NPVR_TRACKER_SSE2)
+// Each sample's accelerometer and gyro triplets are adjacent, so one 16 byte
+// load covers a whole sample: two packed triplets, one per 64-bit lane.
+void UnpackMotionSse2(const uint8_t* report, int count, Motion* out) {
+  const __m128i mask = _mm_set_epi32(0, 0x1FFFFF, 0, 0x1FFFFF);
+  const __m128 scale = _mm_set1_ps(kMotionScale);
+  for (int n = 0; n < count; n++) {
+    __m128i v = _mm_loadu_si128(
+        (const __m128i*)(report + kSamplesOffset + kSampleStride * n));
+
+    // Byte swap each 64-bit lane: bytes within words, then the words.
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+
+    // x is in bits 63-43, y in 42-22 and z in 21-1 of each lane.
+    __m128i x = _mm_srli_epi64(v, 43);
+    __m128i y = _mm_and_si128(_mm_srli_epi64(v, 22), mask);
+    __m128i z = _mm_and_si128(_mm_srli_epi64(v, 1), mask);
+
+    // [ax, ay, gx, gy] and [az, 0, gz, 0], sign extended from 21 bits.
+    __m128i xy = _mm_or_si128(x, _mm_slli_epi64(y, 32));
+    xy = _mm_srai_epi32(_mm_slli_epi32(xy, 11), 11);
+    z = _mm_srai_epi32(_mm_slli_epi32(z, 11), 11);
+
+    float values[8];
+    _mm_storeu_ps(values, _mm_mul_ps(_mm_cvtepi32_ps(xy), scale));
+    _mm_storeu_ps(values + 4, _mm_mul_ps(_mm_cvtepi32_ps(z), scale));
+    out[n][0] = values[0];
+    out[n][1] = values[1];
+    out[n][2] = values[4];
+    out[n][3] = values[2];
+    out[n][4] = values[3];
+    out[n][5] = values[6];
+  }
+}
+#endif  // NPVR_TRACKER_SSE2
+
+}  // namespace
+
+
+TrackerSamples::TrackerSamples(size_t capacity) :
+    capacity_(capacity),
+    count_(0) {
+  // One allocation for all 11 fields, each array contiguous.
+  storage_ = new float[capacity * 11];
+  float* p = storage_;
+  time_delta_ = p;
+  p += capacity;
+  for (int n = 0; n < 3; n++) {
+    acceleration_[n] = p;
+    p += capacity;
+  }
+  for (int n = 0; n < 3; n++) {
+    rotation_rate_[n] = p;
+    p += capacity;
+  }
+  for (int n = 0; n < 3; n++) {
+    magnetic_field_[n] = p;
+    p += capacity;
+  }
+  temperature_ = p;
+}
+
+TrackerSamples::~TrackerSamples() {
+  delete[] storage_;
+}
+
+
+TrackerDecoder::TrackerDecoder(bool use_simd) :
+    use_simd_(use_simd && simd_supported()) {
+  Reset();
+}
+
+bool TrackerDecoder::simd_supported() {
+#if defined(NPVR_TRACKER_SSE2)
+  return true;
+#else
+  return false;
+#endif  // NPVR_TRACKER_SSE2
+}
+
+void TrackerDecoder::Reset() {
+  has_last_ = false;
+  last_timestamp_ = 0;
+  last_sample_count_ = 0;
+  memset(last_sample_, 0, sizeof(last_sample_));
+}
+
+size_t TrackerDecoder::Decode(const uint8_t* reports, size_t report_count,
+                              TrackerSamples* out) {
+  size_t consumed = 0;
+  for (; consumed < report_count; consumed++) {
+    if (out->capacity_ - out->count_ < kTrackerMaxSamplesPerReport) {
+      break;
+    }
+    const uint8_t* report = reports + consumed * kTrackerReportSize;
+
+    uint8_t sample_count = report[kSampleCountOffset];
+    uint16_t timestamp = (uint16_t)(report[kTimestampOffset] |
+                                    (report[kTimestampOffset + 1] << 8));
+    float temperature =
+        DecodeInt16(report + kTemperatureOffset) * kTemperatureScale;
+    // Note the XZY order on the wire.
+    const uint8_t* mag = report + kMagneticFieldOffset;
+    float magnetic_field[3] = {
+      DecodeInt16(mag) * kMagneticFieldScale,
+      DecodeInt16(mag + 4) * kMagneticFieldScale,
+      DecodeInt16(mag + 2) * kMagneticFieldScale,
+    };
+
+    // Repeat the previous sample to cover any reports that were dropped.
+    if (has_last_) {
+      uint16_t gap = (uint16_t)(timestamp - last_timestamp_);
+      if (gap > last_sample_count_ && gap <= kMaxRepeatGap) {
+        size_t i = out->count_++;
+        const float* s = last_sample_;
+        out->time_delta_[i] = (gap - last_sample_count_) * kTimeUnit;
+        for (int axis = 0; axis < 3; axis++) {
+          out->acceleration_[axis][i] = s[1 + axis];
+          out->rotation_rate_[axis][i] = s[4 + axis];
+          out->magnetic_field_[axis][i] = s[7 + axis];
+        }
+        out->temperature_[i] = s[10];
+      }
+    }
+    has_last_ = true;
+    last_timestamp_ = timestamp;
+    last_sample_count_ = sample_count;
+
+    int count = sample_count < kMaxReportSamples ?
+        sample_count : kMaxReportSamples;
+    Motion motion[kMaxReportSamples];
+#if defined(NPVR_TRACKER_SSE2)
+    if (use_simd_) {
+      UnpackMotionSse2(report, count, motion);
+    } else {
+      UnpackMotionScalar(report, count, motion);
+    }
+#else
+    UnpackMotionScalar(report, count, motion);
+#endif  // NPVR_TRACKER_SSE2
+
+    for (int n = 0; n < count; n++) {
+      size_t i = out->count_++;
+      out->time_delta_[i] = kTimeUnit;
+      for (int axis = 0; axis < 3; axis++) {
+        out->acceleration_[axis][i] = motion[n][axis];
+        out->rotation_rate_[axis][i] = motion[n][3 + axis];
+        out->magnetic_field_[axis][i] = magnetic_field[axis];
+      }
+      out->temperature_[i] = temperature;
+    }
+
+    // A report without samples still updates the field and temperature that
+    // a later repeat will carry.
+    float* s = last_sample_;
+    s[0] = kTimeUnit;
+    if (count) {
+      memcpy(s + 1, motion[count - 1], sizeof(Motion));
+    }
+    memcpy(s + 7, magnetic_field, sizeof(magnetic_field));
+    s[10] = temperature;
+  }
+  return consumed;
+}
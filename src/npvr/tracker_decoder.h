@@ -0,0 +1,110 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_TRACKER_DECODER_H_
+#define NPVR_TRACKER_DECODER_H_
+
+#include <npvr.h>
+
+
+namespace npvr {
+
+// Size of a raw tracker input report, as read from the device.
+const size_t kTrackerReportSize = 62;
+
+// A report carries up to three samples. When reports were dropped the
+// decoder also repeats the previous sample to cover the gap, so a single
+// report can produce one more than that.
+const size_t kTrackerMaxSamplesPerReport = 4;
+
+// Decoded tracker samples in structure-of-arrays form, with a fixed
+// capacity. Units match OVR::MessageBodyFrame.
+class TrackerSamples {
+public:
+  explicit TrackerSamples(size_t capacity);
+  ~TrackerSamples();
+
+  size_t capacity() const { return capacity_; }
+  size_t count() const { return count_; }
+  void Clear() { count_ = 0; }
+
+  // Seconds since the previous sample.
+  const float* time_delta() const { return time_delta_; }
+  // Meters per second squared; axis 0-2 is x, y, z.
+  const float* acceleration(int axis) const { return acceleration_[axis]; }
+  // Radians per second.
+  const float* rotation_rate(int axis) const { return rotation_rate_[axis]; }
+  // Gauss.
+  const float* magnetic_field(int axis) const {
+    return magnetic_field_[axis];
+  }
+  // Degrees Celsius.
+  const float* temperature() const { return temperature_; }
+
+private:
+  friend class TrackerDecoder;
+
+  size_t  capacity_;
+  size_t  count_;
+  float*  storage_;
+  float*  time_delta_;
+  float*  acceleration_[3];
+  float*  rotation_rate_[3];
+  float*  magnetic_field_[3];
+  float*  temperature_;
+};
+
+// Batch decoder for raw tracker reports, the native counterpart of
+// OculusDevice.prototype.inputPump_ in experimental/usb-driver/driver.js.
+// It unpacks the 21-bit packed accelerometer and gyro triplets, unwraps the
+// 16-bit timestamp and repeats the previous sample when reports were
+// dropped. State carries across calls so a long capture can be decoded in
+// chunks.
+class TrackerDecoder {
+public:
+  // use_simd selects the SSE2 unpack path when it is compiled in; the scalar
+  // path is the reference the SIMD one must match bit for bit.
+  explicit TrackerDecoder(bool use_simd = true);
+
+  static bool simd_supported();
+  bool use_simd() const { return use_simd_; }
+
+  // Forgets the previous report, as if starting a new capture.
+  void Reset();
+
+  // Decodes report_count reports laid end to end, kTrackerReportSize bytes
+  // apiece, appending to out. Stops early when out cannot hold another
+  // report's worth of samples. Returns the number of reports consumed.
+  size_t Decode(const uint8_t* reports, size_t report_count,
+                TrackerSamples* out);
+
+private:
+  // Number of floats in a sample, in the order time delta, acceleration,
+  // rotation rate, magnetic field, temperature.
+  static const int kSampleFields = 11;
+
+  bool      use_simd_;
+  bool      has_last_;
+  uint16_t  last_timestamp_;
+  uint8_t   last_sample_count_;
+  // Last sample emitted, repeated when reports are dropped.
+  float     last_sample_[kSampleFields];
+};
+
+}  // namespace npvr
+
+
+#endif  // NPVR_TRACKER_DECODER_H_
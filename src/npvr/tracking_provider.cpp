@@ -0,0 +1,112 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/tracking_provider.h>
+
+#include <npvr/capture.h>
+#include <npvr/pose_prediction.h>
+
+using namespace npvr;
+
+
+void npvr::SetDefaultHmdInfo(OVR::HMDInfo* info) {
+  // The 7" DK1, as the SDK describes it when the tracker does not.
+  info->Version = 0;
+  info->HResolution = 1280;
+  info->VResolution = 800;
+  info->HScreenSize = 0.14976f;
+  info->VScreenSize = 0.0936f;
+  info->VScreenCenter = 0.0468f;
+  info->EyeToScreenDistance = 0.041f;
+  info->LensSeparationDistance = 0.0635f;
+  info->InterpupillaryDistance = 0.064f;
+  info->DistortionK[0] = 1.0f;
+  info->DistortionK[1] = 0.22f;
+  info->DistortionK[2] = 0.24f;
+  info->DistortionK[3] = 0.0f;
+  info->ChromaAbCorrection[0] = 0.996f;
+  info->ChromaAbCorrection[1] = -0.004f;
+  info->ChromaAbCorrection[2] = 1.014f;
+  info->ChromaAbCorrection[3] = 0.0f;
+  info->DesktopX = 0;
+  info->DesktopY = 0;
+  info->DisplayDeviceName[0] = 0;
+  info->DisplayId = 0;
+}
+
+OVR::Quatf npvr::ExtrapolateSnapshot(const HmdSnapshot& snapshot, float dt) {
+  const float orientation[4] = {
+    snapshot.orientation.x, snapshot.orientation.y,
+    snapshot.orientation.z, snapshot.orientation.w,
+  };
+  const float angular_velocity[3] = {
+    snapshot.angular_velocity.x, snapshot.angular_velocity.y,
+    snapshot.angular_velocity.z,
+  };
+  const float angular_acceleration[3] = {
+    snapshot.angular_acceleration.x, snapshot.angular_acceleration.y,
+    snapshot.angular_acceleration.z,
+  };
+  float predicted[4];
+  PredictOrientation(orientation, angular_velocity, angular_acceleration, dt,
+                     predicted);
+  return OVR::Quatf(predicted[0], predicted[1], predicted[2], predicted[3]);
+}
+
+void npvr::ToCaptureHmdInfo(const OVR::HMDInfo& info, CaptureHmdInfo* out) {
+  memset(out, 0, sizeof(*out));
+  strncpy(out->product_name, info.ProductName,
+          sizeof(out->product_name) - 1);
+  strncpy(out->manufacturer, info.Manufacturer,
+          sizeof(out->manufacturer) - 1);
+  out->version = info.Version;
+  out->desktop_x = info.DesktopX;
+  out->desktop_y = info.DesktopY;
+  out->h_resolution = info.HResolution;
+  out->v_resolution = info.VResolution;
+  out->h_screen_size = info.HScreenSize;
+  out->v_screen_size = info.VScreenSize;
+  out->v_screen_center = info.VScreenCenter;
+  out->eye_to_screen_distance = info.EyeToScreenDistance;
+  out->lens_separation_distance = info.LensSeparationDistance;
+  out->interpupillary_distance = info.InterpupillaryDistance;
+  memcpy(out->distortion_k, info.DistortionK, sizeof(out->distortion_k));
+  memcpy(out->chroma_ab_correction, info.ChromaAbCorrection,
+         sizeof(out->chroma_ab_correction));
+}
+
+void npvr::FromCaptureHmdInfo(const CaptureHmdInfo& info, OVR::HMDInfo* out) {
+  memcpy(out->ProductName, info.product_name, sizeof(info.product_name));
+  out->ProductName[sizeof(info.product_name) - 1] = 0;
+  memcpy(out->Manufacturer, info.manufacturer, sizeof(info.manufacturer));
+  out->Manufacturer[sizeof(info.manufacturer) - 1] = 0;
+  out->Version = info.version;
+  out->DesktopX = info.desktop_x;
+  out->DesktopY = info.desktop_y;
+  out->HResolution = info.h_resolution;
+  out->VResolution = info.v_resolution;
+  out->HScreenSize = info.h_screen_size;
+  out->VScreenSize = info.v_screen_size;
+  out->VScreenCenter = info.v_screen_center;
+  out->EyeToScreenDistance = info.eye_to_screen_distance;
+  out->LensSeparationDistance = info.lens_separation_distance;
+  out->InterpupillaryDistance = info.interpupillary_distance;
+  memcpy(out->DistortionK, info.distortion_k, sizeof(info.distortion_k));
+  memcpy(out->ChromaAbCorrection, info.chroma_ab_correction,
+         sizeof(info.chroma_ab_correction));
+  out->DisplayDeviceName[0] = 0;
+  out->DisplayId = 0;
+}
@@ -0,0 +1,153 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_TRACKING_PROVIDER_H_
+#define NPVR_TRACKING_PROVIDER_H_
+
+#include <OVR.h>
+#include <npvr/sixense_frame.h>
+
+
+namespace npvr {
+
+struct CaptureHmdInfo;
+
+// Most HMDs one provider tracks at once.
+const int kMaxHmdDevices = 4;
+// Bytes GetSerial may write, terminator included.
+const size_t kHmdSerialSize = 32;
+
+// A timestamped sample of the fused sensor state.
+struct HmdSnapshot {
+  // Time the sample was taken, in microseconds on the provider's clock. Only
+  // meaningful to the provider that produced it.
+  OVR::UInt64 timestamp;
+  OVR::Quatf  orientation;
+  // Radians per second.
+  OVR::Vector3f angular_velocity;
+  // Radians per second squared, estimated from the change in angular
+  // velocity across samples.
+  OVR::Vector3f angular_acceleration;
+  // Meters per second squared.
+  OVR::Vector3f acceleration;
+
+  // NowNanos() when the tracker sample behind this snapshot reached the
+  // process, when fusion finished with it and when the snapshot was
+  // published. Only used for latency tracing.
+  uint64_t  sample_nanos;
+  uint64_t  fusion_nanos;
+  uint64_t  publish_nanos;
+};
+
+// Which filter turns the tracker's samples into an orientation.
+enum FusionMode {
+  // OVR::SensorFusion. The default.
+  kFusionModeSdk = 0,
+  // npvr::FusionEngine, fed the same samples. Selected at startup by setting
+  // NPVR_FUSION=native in the environment.
+  kFusionModeNative = 1,
+};
+
+// Source of head tracking. Acquire and Release are reference counted and
+// called from the browser thread only; everything else may be called from
+// any thread.
+class HmdProvider {
+public:
+  virtual ~HmdProvider() {}
+
+  // The first Acquire starts device bring-up without waiting for it.
+  virtual void Acquire() = 0;
+  virtual void Release() = 0;
+
+  // True once bring-up has finished, whether or not an HMD was found. Until
+  // then DevicePresent() is false.
+  virtual bool IsReady() const = 0;
+  virtual bool DevicePresent() const = 0;
+  // Incremented every time an HMD is attached or detached, so callers can
+  // tell when cached device info is stale.
+  virtual uint32_t connection_generation() const = 0;
+  // Copies out the info of the attached HMD. Returns false if none is.
+  virtual bool GetDeviceInfo(OVR::HMDInfo* out_info) const = 0;
+  // Copies out the latest sample. Returns false if there is none yet.
+  virtual bool GetSnapshot(HmdSnapshot* out_snapshot) const = 0;
+  // Extrapolates the snapshot orientation to interval seconds from now,
+  // accounting for the age of the snapshot.
+  virtual OVR::Quatf PredictOrientation(const HmdSnapshot& snapshot,
+                                        float interval) const = 0;
+  virtual void ResetOrientation() = 0;
+  virtual FusionMode fusion_mode() const = 0;
+  virtual void SetFusionMode(FusionMode mode) = 0;
+
+  // Copies the attached HMD's serial number into out_serial, which holds
+  // kHmdSerialSize bytes. Returns false if none is attached or the serial
+  // cannot be read.
+  virtual bool GetSerial(char* out_serial) const { return false; }
+
+  // Every HMD the provider can track, up to kMaxHmdDevices. Device 0 is this
+  // provider, the one the methods above report. The others are providers of
+  // their own, each with its own sensor pipeline and thread and its own
+  // Acquire and Release; a device keeps its index while the provider lives.
+  // Fusion mode is shared by all of them.
+  virtual int device_count() const { return 1; }
+  virtual HmdProvider* device(int index) { return index ? NULL : this; }
+};
+
+// What one consumer has already been handed by a ControllerProvider, so each
+// history sample is returned to it once.
+struct ControllerCursor {
+  ControllerCursor() : position(0) {}
+
+  // Frames already returned, numbered by the provider.
+  uint32_t  position;
+};
+
+// Source of hand controllers. Same threading rules as HmdProvider, except
+// that Gather is browser thread only.
+class ControllerProvider {
+public:
+  virtual ~ControllerProvider() {}
+
+  virtual void Acquire() = 0;
+  virtual void Release() = 0;
+
+  // True once bring-up has finished, successfully or not.
+  virtual bool IsReady() const = 0;
+  // True if bring-up finished and succeeded.
+  virtual bool IsAvailable() const = 0;
+  // Fills poll with the newest frame of every enabled controller and, if
+  // include_history, the frames that arrived since cursor, which is advanced.
+  virtual void Gather(bool include_history, ControllerCursor* cursor,
+                      SixensePoll* poll) = 0;
+};
+
+// Fills in the display parameters of a DK1, for providers that cannot read
+// them from the device. Leaves the name fields alone.
+void SetDefaultHmdInfo(OVR::HMDInfo* info);
+
+// Converts between OVR::HMDInfo and the plain form written to captures and
+// shared memory. HMDInfo is not plain data, so FromCaptureHmdInfo assigns
+// every field rather than clearing the whole struct.
+void ToCaptureHmdInfo(const OVR::HMDInfo& info, CaptureHmdInfo* out);
+void FromCaptureHmdInfo(const CaptureHmdInfo& info, OVR::HMDInfo* out);
+
+// Extrapolates a snapshot's orientation dt seconds past its timestamp with
+// npvr::PredictOrientation.
+OVR::Quatf ExtrapolateSnapshot(const HmdSnapshot& snapshot, float dt);
+
+}  // namespace npvr
+
+
+#endif  // NPVR_TRACKING_PROVIDER_H_
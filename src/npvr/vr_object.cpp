@@ -15,11 +15,15 @@
  */
 
 #include <npvr/vr_object.h>
-#include <npvr/ovr_manager.h>
+#include <npvr/atomic.h>
+#include <npvr/clock.h>
+#include <npvr/distortion.h>
+#include <npvr/provider_factory.h>
+#include <npvr/thread.h>
+#include <npvr/warp_mesh.h>
 
-#ifdef USE_SIXENSE
-#include <third_party/sixense/include/sixense.h>
-#endif // USE_SIXENSE
+#include <stddef.h>
+#include <stdlib.h>
 
 using namespace npvr;
 
@@ -28,13 +32,152 @@ namespace {
 
 DECLARE_NPOBJECT_CLASS_WITH_BASE(VRObject, VRObject::Allocate);
 
-#ifdef USE_SIXENSE
-// HACK: not thread safe!
-static int sixense_init_count_ = 0;
-#endif // USE_SIXENSE
 
+// Returns the numeric value of the variant, or default_value if it is not a
+// number.
+double VariantToDouble(const NPVariant& value, double default_value) {
+  if (NPVARIANT_IS_INT32(value)) {
+    return NPVARIANT_TO_INT32(value);
+  } else if (NPVARIANT_IS_DOUBLE(value)) {
+    return NPVARIANT_TO_DOUBLE(value);
+  }
+  return default_value;
+}
+
+// Most values exec 10 and 11 take in one call. Their results fit the text
+// writer with room to spare.
+const size_t kMaxDistortionValues = 512;
+
+// Reads comma separated numbers from str into values, stopping at the first
+// that does not parse. Returns how many were read, at most max_count + 1 so
+// that callers can tell when there were too many.
+size_t ParseFloats(const char* str, float* values, size_t max_count) {
+  size_t count = 0;
+  while (*str && count <= max_count) {
+    char* end = NULL;
+    double value = strtod(str, &end);
+    if (end == str) {
+      break;
+    }
+    values[count++] = (float)value;
+    str = *end == ',' ? end + 1 : end;
+  }
+  return count;
 }
 
+// Subscription rates outside this range are clamped to it.
+const uint32_t kMinSubscriptionRate = 1;
+const uint32_t kMaxSubscriptionRate = 1000;
+
+// Identifies an HMD in polls without sending its serial number each time:
+// FNV-1a of the serial, or zero if it has none. Polls and exec 7 send zero
+// for devices that are not present. Pages map it back to the serial with
+// exec 7.
+uint32_t GetSerialId(const HmdProvider* hmd) {
+  char serial[kHmdSerialSize];
+  if (!hmd->GetSerial(serial)) {
+    return 0;
+  }
+  uint32_t hash = 2166136261u;
+  for (size_t n = 0; n < kHmdSerialSize && serial[n]; n++) {
+    hash = (hash ^ (uint8_t)serial[n]) * 16777619u;
+  }
+  return hash ? hash : 1;
+}
+
+// Reads an HMD device's orientation and, if prediction is set, predicted
+// orientation into values, zero if it is not present. Returns
+// kBinaryHmdDeviceFlag*.
+uint8_t ReadHmdDevice(const HmdProvider* hmd, float prediction,
+                      float values[8]) {
+  memset(values, 0, 8 * sizeof(float));
+  if (!hmd->DevicePresent()) {
+    return 0;
+  }
+  uint8_t flags = kBinaryHmdDeviceFlagPresent;
+  HmdSnapshot snapshot;
+  bool has_snapshot = hmd->GetSnapshot(&snapshot);
+  OVR::Quatf o = has_snapshot ? snapshot.orientation : OVR::Quatf(0, 0, 0, 1);
+  values[0] = o.x;
+  values[1] = o.y;
+  values[2] = o.z;
+  values[3] = o.w;
+  if (has_snapshot && prediction > 0) {
+    OVR::Quatf p = hmd->PredictOrientation(snapshot, prediction);
+    values[4] = p.x;
+    values[5] = p.y;
+    values[6] = p.z;
+    values[7] = p.w;
+    flags |= kBinaryHmdDeviceFlagPredicted;
+  }
+  return flags;
+}
+
+}
+
+
+// Wakes at the subscription rate and, whenever there may be something new
+// and no delivery is already waiting, schedules one on the browser thread.
+// Delivery builds a delta record and drops it if nothing changed, so this
+// only has to be cheap, not exact. Gather is browser thread only, so
+// controllers count as always possibly new.
+class VRObject::SubscriptionThread : public Thread {
+public:
+  SubscriptionThread(VRObject* object, uint32_t rate) :
+      object_(object),
+      interval_nanos_(1000000000ull / rate),
+      exit_requested_(0) {
+  }
+
+  void RequestExit() {
+    AtomicStoreRelease(&exit_requested_, 1);
+  }
+
+protected:
+  virtual void Run() {
+    // The other HMD devices were acquired before the thread started, if the
+    // subscription wants them.
+    int hmd_count = 1;
+    if (object_->subscription_flags_ & kPollFlagHmdDevices) {
+      hmd_count = object_->hmd_device_count_;
+    }
+    OVR::UInt64 last_timestamps[kMaxHmdDevices] = { 0 };
+    uint64_t next = NowNanos();
+    while (!AtomicLoadAcquire(&exit_requested_)) {
+      bool fresh = false;
+      for (int n = 0; n < hmd_count; n++) {
+        HmdProvider* hmd = n ? object_->hmd_devices_[n] : object_->hmd_;
+        HmdSnapshot snapshot;
+        if (hmd && hmd->GetSnapshot(&snapshot) &&
+            snapshot.timestamp != last_timestamps[n]) {
+          last_timestamps[n] = snapshot.timestamp;
+          fresh = true;
+        }
+      }
+      if ((fresh || object_->controllers_->IsAvailable()) &&
+          !AtomicCompareExchange(&object_->delivery_pending_, 0, 1)) {
+        NPN_PluginThreadAsyncCall(object_->npp_, &VRObject::DeliverThunk,
+                                  object_);
+      }
+
+      // Ticks missed while descheduled are dropped; the next delivery
+      // coalesces them.
+      next += interval_nanos_;
+      uint64_t now = NowNanos();
+      if (next > now) {
+        SleepMicros((uint32_t)((next - now) / 1000));
+      } else {
+        next = now;
+      }
+    }
+  }
+
+private:
+  VRObject*           object_;
+  uint64_t            interval_nanos_;
+  volatile uint32_t   exit_requested_;
+};
+
 
 NPClass* VRObject::np_class() {
   return GET_NPOBJECT_CLASS(VRObject);
@@ -46,32 +189,59 @@ NPObject* VRObject::Allocate(NPP npp, NPClass* aClass) {
 
 VRObject::VRObject(NPP npp) :
     NPObjectBase(npp),
-    sixense_ready_(false) {
+    hmd_(GetHmdProvider()),
+    hmd_device_count_(0),
+    controllers_(GetControllerProvider()),
+    subscription_callback_(NULL),
+    subscription_flags_(0),
+    subscription_thread_(NULL),
+    subscription_generation_(0),
+    delivery_pending_(0),
+    stereo_params_valid_(false),
+    stereo_params_generation_(0),
+    stereo_params_length_(0),
+    latency_valid_(false) {
+  memset(hmd_devices_, 0, sizeof(hmd_devices_));
+  sent_.Reset();
+
   exec_id_ = NPN_GetStringIdentifier("exec");
+  exec_batch_id_ = NPN_GetStringIdentifier("execBatch");
   poll_id_ = NPN_GetStringIdentifier("poll");
+  subscribe_id_ = NPN_GetStringIdentifier("subscribe");
+  unsubscribe_id_ = NPN_GetStringIdentifier("unsubscribe");
+  warp_mesh_id_ = NPN_GetStringIdentifier("warpMesh");
 
-#ifdef USE_SIXENSE
-  // Initialize sixense library, if needed.
-  if (!sixense_init_count_) {
-    sixense_ready_ = sixenseInit() == SIXENSE_SUCCESS;
-  } else {
-    sixense_ready_ = true;
-  }
-  if (sixense_ready_) {
-    sixense_init_count_++;
-  }
-#endif // USE_SIXENSE
+  // Both start device bring-up on worker threads and return immediately;
+  // page script waits on QueryReadiness.
+  hmd_->Acquire();
+  controllers_->Acquire();
 }
 
 VRObject::~VRObject() {
-#ifdef USE_SIXENSE
-  sixense_init_count_--;
-  if (!sixense_init_count_) {
-    sixenseExit();
+  Unsubscribe();
+  controllers_->Release();
+  for (int n = 1; n < hmd_device_count_; n++) {
+    if (hmd_devices_[n]) {
+      hmd_devices_[n]->Release();
+    }
   }
-#endif // USE_SIXENSE
+  hmd_->Release();
 }
 
+const VRObject::ExecCommand VRObject::kExecCommands[] = {
+  { 0x0001, &VRObject::QueryHmdInfo },
+  { 0x0002, &VRObject::ResetHmdOrientation },
+  { 0x0003, &VRObject::QueryReadiness },
+  { 0x0004, &VRObject::SetFusionMode },
+  { 0x0005, &VRObject::QueryLatency },
+  { 0x0006, &VRObject::WriteLatencyTrace },
+  { 0x0007, &VRObject::QueryHmdDevices },
+  { 0x0008, &VRObject::QueryHmdDeviceInfo },
+  { 0x0009, &VRObject::QueryStereoParams },
+  { 0x000A, &VRObject::MapDistortionRadii },
+  { 0x000B, &VRObject::MapWarpPoints },
+};
+
 bool VRObject::InvokeExec(const NPVariant* args, uint32_t arg_count,
                           NPVariant* result) {
   // arg0: command id
@@ -79,48 +249,306 @@ bool VRObject::InvokeExec(const NPVariant* args, uint32_t arg_count,
   if (arg_count != 2) {
     return false;
   }
-  if (!(NPVARIANT_IS_INT32(args[0]) || NPVARIANT_IS_DOUBLE(args[0])) ||
-      !NPVARIANT_IS_STRING(args[1])) {
+
+  TextWriter& s = text_writer_;
+  s.Reset();
+
+  if (!DispatchExec(args[0], args[1], s)) {
     return false;
   }
 
-  int32_t command_id = 0;
-  if (NPVARIANT_IS_INT32(args[0])) {
-    command_id = NPVARIANT_TO_INT32(args[0]);
-  } else if (NPVARIANT_IS_DOUBLE(args[0])) {
-    command_id = (int)NPVARIANT_TO_DOUBLE(args[0]);
+  if (s.overflowed()) {
+    return false;
   }
-  const NPUTF8* command_str = NPVARIANT_TO_STRING(args[1]).UTF8Characters;
+  s.ToNPVariant(result);
 
-  std::ostringstream s;
+  return true;
+}
 
-  switch (command_id) {
-    case 0x0001:
-      QueryHmdInfo((const char*)command_str, s);
-      break;
-    case 0x0002:
-      ResetHmdOrientation((const char*)command_str, s);
-      break;
+bool VRObject::InvokeExecBatch(const NPVariant* args, uint32_t arg_count,
+                               NPVariant* result) {
+  // argN: command id
+  // argN+1: command string
+  //   ...
+  // Returns each command's result in order, separated by
+  // kExecBatchSeparator, so a page can run several commands in one call
+  // into the plugin.
+  if (arg_count % 2) {
+    return false;
   }
 
-  // TODO(benvanik): avoid this extra allocation/copy somehow - perhaps
-  //     by preallocating a large enough buffer (fixed size 8K or something)
-  std::string s_value = s.str();
-  size_t s_len = s_value.length();
-  NPUTF8* ret_str = (NPUTF8*)NPN_MemAlloc(s_len + 1);
-  strcpy(ret_str, s_value.c_str());
-  STRINGZ_TO_NPVARIANT(ret_str, *result);
+  TextWriter& s = text_writer_;
+  s.Reset();
+
+  for (uint32_t n = 0; n < arg_count; n += 2) {
+    if (n) {
+      s.AppendChar(kExecBatchSeparator);
+    }
+    if (!DispatchExec(args[n], args[n + 1], s)) {
+      return false;
+    }
+  }
+
+  if (s.overflowed()) {
+    return false;
+  }
+  s.ToNPVariant(result);
 
   return true;
 }
 
-void VRObject::QueryHmdInfo(const char* command_str, std::ostringstream& s) {
-  OVRManager *manager = OVRManager::Instance();
-  if (!manager->DevicePresent()) {
+bool VRObject::DispatchExec(const NPVariant& id_arg, const NPVariant& str_arg,
+                            TextWriter& s) {
+  if (!(NPVARIANT_IS_INT32(id_arg) || NPVARIANT_IS_DOUBLE(id_arg)) ||
+      !NPVARIANT_IS_STRING(str_arg)) {
+    return false;
+  }
+
+  int32_t command_id = 0;
+  if (NPVARIANT_IS_INT32(id_arg)) {
+    command_id = NPVARIANT_TO_INT32(id_arg);
+  } else if (NPVARIANT_IS_DOUBLE(id_arg)) {
+    command_id = (int)NPVARIANT_TO_DOUBLE(id_arg);
+  }
+  const NPUTF8* command_str = NPVARIANT_TO_STRING(str_arg).UTF8Characters;
+
+  // Unknown commands succeed with an empty result, as they always have.
+  for (size_t n = 0; n < sizeof(kExecCommands) / sizeof(kExecCommands[0]);
+       n++) {
+    if (kExecCommands[n].id == command_id) {
+      (this->*kExecCommands[n].handler)((const char*)command_str, s);
+      break;
+    }
+  }
+  return true;
+}
+
+void VRObject::QueryReadiness(const char* command_str, TextWriter& s) {
+  bool ready = hmd_->IsReady() && controllers_->IsReady();
+  s << (ready ? "1" : "0");
+}
+
+void VRObject::SetFusionMode(const char* command_str, TextWriter& s) {
+  // An empty command string just queries the current mode.
+  if (!strcmp(command_str, "0")) {
+    hmd_->SetFusionMode(kFusionModeSdk);
+  } else if (!strcmp(command_str, "1")) {
+    hmd_->SetFusionMode(kFusionModeNative);
+  }
+  s << (int32_t)hmd_->fusion_mode();
+}
+
+void VRObject::QueryLatency(const char* command_str, TextWriter& s) {
+  // "1" starts a new measurement once this one is reported.
+  GetLatencyTrace()->WritePercentiles(s);
+  if (!strcmp(command_str, "1")) {
+    GetLatencyTrace()->Clear();
+  }
+}
+
+void VRObject::WriteLatencyTrace(const char* command_str, TextWriter& s) {
+  // The page cannot pick the path; only whoever launched the browser can.
+  const char* path = getenv("NPVR_TRACE_FILE");
+  bool written = path && *path && GetLatencyTrace()->WriteChromeTrace(path);
+  s << (written ? "1" : "0");
+}
+
+void VRObject::QueryStereoParams(const char* command_str, TextWriter& s) {
+  // command_str is [ipd],[z near],[z far]; an IPD of zero means the HMD's.
+  // Returns nothing if there is no HMD, otherwise
+  //   [connection generation],[distortion scale],[fov y]|
+  // then for each eye
+  //   [viewport x],[y],[width],[height],
+  //   [distortion center offset x],[y],[view adjust x],
+  //   [projection, 16 values],[ortho projection, 16 values]|
+  StereoConfig config;
+  char* end = NULL;
+  config.interpupillary_distance = (float)strtod(command_str, &end);
+  config.z_near = (float)strtod(*end == ',' ? end + 1 : end, &end);
+  config.z_far = (float)strtod(*end == ',' ? end + 1 : end, &end);
+  // Written so that NaN fails too.
+  if (!(config.z_near > 0) || !(config.z_far > config.z_near)) {
+    return;
+  }
+
+  // Read first, as for exec 1.
+  uint32_t generation = hmd_->connection_generation();
+  if (stereo_params_valid_ && generation == stereo_params_generation_ &&
+      hmd_->DevicePresent() &&
+      !memcmp(&config, &stereo_config_, sizeof(config))) {
+    s.Append(stereo_params_text_, stereo_params_length_);
+    return;
+  }
+
+  OVR::HMDInfo info;
+  if (!hmd_->GetDeviceInfo(&info)) {
+    stereo_params_valid_ = false;
+    return;
+  }
+  StereoParams params;
+  ComputeStereoParams(info, config, &params);
+
+  size_t start = s.length();
+  s << generation << "," << params.distortion_scale << ",";
+  s << params.fov_y << "|";
+  for (int n = 0; n < 2; n++) {
+    const StereoParams::Eye& eye = params.eyes[n];
+    for (int i = 0; i < 4; i++) {
+      s << eye.viewport[i] << ",";
+    }
+    s << eye.distortion_center_offset_x << ",";
+    s << eye.distortion_center_offset_y << ",";
+    s << eye.view_adjust[12];
+    for (int i = 0; i < 16; i++) {
+      s << "," << eye.projection[i];
+    }
+    for (int i = 0; i < 16; i++) {
+      s << "," << eye.ortho_projection[i];
+    }
+    s << "|";
+  }
+
+  size_t length = s.length() - start;
+  stereo_params_valid_ = !s.overflowed() && length <= kMaxStereoParamsLength;
+  if (stereo_params_valid_) {
+    memcpy(stereo_params_text_, s.data() + start, length);
+    stereo_params_length_ = length;
+    stereo_params_generation_ = generation;
+    stereo_config_ = config;
+  }
+}
+
+void VRObject::MapDistortionRadii(const char* command_str, TextWriter& s) {
+  // command_str is [inverse],[radius],[radius],... with up to
+  // kMaxDistortionValues radii. Returns the distorted radii, or with inverse
+  // set the undistorted ones, as [radius],[radius],... Returns nothing if
+  // there is no HMD or too many radii.
+  float values[kMaxDistortionValues + 2];
+  size_t count = ParseFloats(command_str, values, kMaxDistortionValues + 1);
+  OVR::HMDInfo info;
+  if (!count || count > kMaxDistortionValues + 1 ||
+      !hmd_->GetDeviceInfo(&info)) {
     return;
   }
+  bool inverse = values[0] != 0;
+  float* radii = values + 1;
+  count--;
+  if (inverse) {
+    UndistortRadii(info.DistortionK, radii, count, radii);
+  } else {
+    DistortRadii(info.DistortionK, radii, count, radii);
+  }
+  for (size_t n = 0; n < count; n++) {
+    if (n) {
+      s << ",";
+    }
+    s << radii[n];
+  }
+}
 
-  const OVR::HMDInfo& info = *manager->GetDeviceInfo();
+void VRObject::MapWarpPoints(const char* command_str, TextWriter& s) {
+  // command_str is [eye],[inverse],[x],[y],[x],[y],... with up to
+  // kMaxDistortionValues coordinates, in [0-1] across the whole render
+  // target. Returns where the warp samples the render target for each screen
+  // point, or with inverse set where each render target point appears on
+  // screen, as [x],[y],... Returns nothing if there is no HMD or the points
+  // are malformed.
+  float values[kMaxDistortionValues + 3];
+  size_t count = ParseFloats(command_str, values, kMaxDistortionValues + 2);
+  OVR::HMDInfo info;
+  if (count < 2 || count > kMaxDistortionValues + 2 || count % 2 ||
+      (values[0] != 0 && values[0] != 1) || !hmd_->GetDeviceInfo(&info)) {
+    return;
+  }
+  int eye = (int)values[0];
+  bool inverse = values[1] != 0;
+  float* points = values + 2;
+  size_t point_count = (count - 2) / 2;
+
+  // As for warpMesh, the warp does not depend on the config.
+  StereoConfig config;
+  config.interpupillary_distance = 0;
+  config.z_near = 0.01f;
+  config.z_far = 1000;
+  StereoParams params;
+  ComputeStereoParams(info, config, &params);
+  WarpParams warp;
+  GetWarpParams(info, params, eye, &warp);
+  if (inverse) {
+    UnwarpPoints(warp, points, point_count, points);
+  } else {
+    WarpPoints(warp, points, point_count, points);
+  }
+  for (size_t n = 0; n < point_count * 2; n++) {
+    if (n) {
+      s << ",";
+    }
+    s << points[n];
+  }
+}
+
+void VRObject::QueryHmdInfo(const char* command_str, TextWriter& s) {
+  WriteHmdInfo(hmd_, command_str, s);
+}
+
+void VRObject::QueryHmdDevices(const char* command_str, TextWriter& s) {
+  // [index],[present],[connection generation],[serial id],[serial]|...
+  // for every device, including the first. Serials that cannot be read are
+  // empty.
+  AcquireHmdDevices();
+  for (int n = 0; n < hmd_device_count_; n++) {
+    HmdProvider* hmd = hmd_devices_[n];
+    if (!hmd) {
+      continue;
+    }
+    uint32_t generation = hmd->connection_generation();
+    bool present = hmd->DevicePresent();
+    char serial[kHmdSerialSize];
+    if (!present || !hmd->GetSerial(serial)) {
+      serial[0] = 0;
+    }
+    s << n << "," << (present ? "1," : "0,") << generation << ",";
+    s << (present ? GetSerialId(hmd) : 0) << ",";
+    // Keep the separators unambiguous.
+    for (size_t i = 0; i < kHmdSerialSize && serial[i]; i++) {
+      char c = serial[i];
+      s.AppendChar(c == ',' || c == '|' ? '_' : c);
+    }
+    s << "|";
+  }
+}
+
+void VRObject::QueryHmdDeviceInfo(const char* command_str, TextWriter& s) {
+  // command_str is the device index, then optionally a comma and the
+  // connection generation the caller already has info for, as for exec 1.
+  char* end = NULL;
+  long index = strtol(command_str, &end, 10);
+  if (end == command_str) {
+    return;
+  }
+  HmdProvider* hmd = GetHmdDevice((int)index);
+  if (!hmd) {
+    return;
+  }
+  WriteHmdInfo(hmd, *end == ',' ? end + 1 : "", s);
+}
+
+void VRObject::WriteHmdInfo(HmdProvider* hmd, const char* generation_str,
+                            TextWriter& s) {
+  // generation_str is optionally the connection generation the caller already
+  // has info for. Read first so that a reconnect while the info is gathered
+  // makes the caller ask again rather than keep the old info.
+  uint32_t generation = hmd->connection_generation();
+  if (*generation_str && hmd->DevicePresent() &&
+      strtod(generation_str, NULL) == (double)generation) {
+    s << "=";
+    return;
+  }
+
+  OVR::HMDInfo info;
+  if (!hmd->GetDeviceInfo(&info)) {
+    return;
+  }
 
   s << info.ProductName << "," << info.Manufacturer << "," << info.Version << ",";
   s << info.DesktopX << "," << info.DesktopY << ",";
@@ -138,98 +566,695 @@ void VRObject::QueryHmdInfo(const char* command_str, std::ostringstream& s) {
   s << info.ChromaAbCorrection[1] << ",";
   s << info.ChromaAbCorrection[2] << ",";
   s << info.ChromaAbCorrection[3];
+  if (*generation_str) {
+    s << "," << generation;
+  }
 }
 
-void VRObject::ResetHmdOrientation(const char* command_str, std::ostringstream& s) {
-  OVRManager *manager = OVRManager::Instance();
-  if (!manager->DevicePresent()) {
+void VRObject::ResetHmdOrientation(const char* command_str, TextWriter& s) {
+  // command_str is optionally the index of the device to reset; the first
+  // otherwise.
+  HmdProvider* hmd = *command_str ? GetHmdDevice(atoi(command_str)) : hmd_;
+  if (!hmd || !hmd->DevicePresent()) {
     return;
   }
 
-  manager->ResetOrientation();
+  hmd->ResetOrientation();
+}
+
+void VRObject::AcquireHmdDevices() {
+  if (hmd_device_count_) {
+    return;
+  }
+  int count = hmd_->device_count();
+  if (count > kMaxHmdDevices) {
+    count = kMaxHmdDevices;
+  }
+  hmd_devices_[0] = hmd_;
+  for (int n = 1; n < count; n++) {
+    hmd_devices_[n] = hmd_->device(n);
+    if (hmd_devices_[n]) {
+      hmd_devices_[n]->Acquire();
+    }
+  }
+  hmd_device_count_ = count < 1 ? 1 : count;
+}
+
+HmdProvider* VRObject::GetHmdDevice(int index) {
+  if (!index) {
+    return hmd_;
+  }
+  AcquireHmdDevices();
+  if (index < 0 || index >= hmd_device_count_) {
+    return NULL;
+  }
+  return hmd_devices_[index];
 }
 
 bool VRObject::InvokePoll(const NPVariant* args, uint32_t arg_count,
                           NPVariant* result) {
-  std::ostringstream s;
+  // arg0: optional poll format (0 = text, 1 = binary)
+  // arg1: optional HMD prediction interval, in milliseconds
+  // arg2: optional PollFlags bitmask
+  // arg3: optional generation from a previous binary poll, for
+  //       kPollFlagDelta
+  latency_.stages[kLatencyStagePollBegin] = NowNanos();
+  latency_valid_ = false;
+  int32_t format = 0;
+  if (arg_count >= 1) {
+    format = (int32_t)VariantToDouble(args[0], 0);
+  }
+  float prediction = 0;
+  if (arg_count >= 2) {
+    prediction = (float)(VariantToDouble(args[1], 0) / 1000.0);
+  }
+  uint32_t poll_flags = 0;
+  if (arg_count >= 3) {
+    poll_flags = (uint32_t)VariantToDouble(args[2], 0);
+  }
+  uint32_t since_generation = 0;
+  if (arg_count >= 4) {
+    since_generation = (uint32_t)VariantToDouble(args[3], 0);
+  }
+  if (format == 1) {
+    return InvokeBinaryPoll(prediction, poll_flags, since_generation, result);
+  }
 
-  PollSixenseState(s);
-  PollHmdState(s);
+  TextWriter& s = text_writer_;
+  s.Reset();
 
-  // TODO(benvanik): avoid this extra allocation/copy somehow - perhaps
-  //     by preallocating a large enough buffer (fixed size 8K or something)
-  std::string s_value = s.str();
-  size_t s_len = s_value.length();
-  NPUTF8* ret_str = (NPUTF8*)NPN_MemAlloc(s_len + 1);
-  strcpy(ret_str, s_value.c_str());
-  STRINGZ_TO_NPVARIANT(ret_str, *result);
+  PollSixenseState(s, poll_flags);
+  PollHmdState(s, prediction);
+  if (poll_flags & kPollFlagHmdDevices) {
+    PollHmdDevices(s, prediction);
+  }
+
+  if (s.overflowed()) {
+    return false;
+  }
+  uint64_t poll_end = NowNanos();
+  s.ToNPVariant(result);
+  FinishTrace(poll_end);
 
   return true;
 }
 
-void VRObject::PollSixenseState(std::ostringstream& s) {
-  if (!sixense_ready_) {
+void VRObject::PollSixenseState(TextWriter& s, uint32_t poll_flags) {
+  if (!controllers_->IsAvailable()) {
     return;
   }
 
-#ifdef USE_SIXENSE
-  s << "s,";
-
-  sixenseAllControllerData acd;
-  int max_bases = sixenseGetMaxBases();
-  for (int base = 0; base < max_bases; base++) {
-    if (!sixenseIsBaseConnected(base)) {
-      continue;
-    }
-    sixenseSetActiveBase(base);
+  SixensePoll poll;
+  controllers_->Gather((poll_flags & kPollFlagSixenseHistory) != 0,
+                       &controller_cursor_, &poll);
 
-    // TODO(benvanik): stash sequence numbers and get all recent data
-    sixenseGetAllNewestData(&acd);
+  s << "s,";
 
+  for (int n = 0; n < poll.base_count; n++) {
+    int base = poll.bases[n];
     s << "b," << base << ",";
 
-    int max_conts = sixenseGetMaxControllers();
-    for (int cont = 0; cont < max_conts; cont++) {
-      if (!sixenseIsControllerEnabled(cont)) {
+    for (int m = 0; m < poll.controller_count; m++) {
+      const SixenseFrame& frame = poll.controllers[m];
+      if (frame.base != base) {
         continue;
       }
 
-      s << "c," << cont << ",";
-
-      s << acd.controllers[cont].pos[0] << ",";
-      s << acd.controllers[cont].pos[1] << ",";
-      s << acd.controllers[cont].pos[2] << ",";
-      s << acd.controllers[cont].rot_quat[0] << ",";
-      s << acd.controllers[cont].rot_quat[1] << ",";
-      s << acd.controllers[cont].rot_quat[2] << ",";
-      s << acd.controllers[cont].rot_quat[3] << ",";
-      s << acd.controllers[cont].joystick_x << ",";
-      s << acd.controllers[cont].joystick_y << ",";
-      s << acd.controllers[cont].trigger << ",";
-      s << acd.controllers[cont].buttons << ",";
-      s << (acd.controllers[cont].is_docked ? "1," : "0,");
-      s << (int)acd.controllers[cont].which_hand << ",";
-      s << (int)acd.controllers[cont].hemi_tracking_enabled << ",";
+      s << "c," << (int32_t)frame.controller << ",";
+
+      s << frame.position[0] << ",";
+      s << frame.position[1] << ",";
+      s << frame.position[2] << ",";
+      s << frame.rotation[0] << ",";
+      s << frame.rotation[1] << ",";
+      s << frame.rotation[2] << ",";
+      s << frame.rotation[3] << ",";
+      s << frame.joystick[0] << ",";
+      s << frame.joystick[1] << ",";
+      s << frame.trigger << ",";
+      s << frame.buttons << ",";
+      s << ((frame.flags & kSixenseFrameFlagDocked) ? "1," : "0,");
+      s << (int32_t)frame.hand << ",";
+      s << ((frame.flags & kSixenseFrameFlagHemiTracking) ? "1," : "0,");
     }
   }
 
   s << "|";
-#endif // USE_SIXENSE
+
+  if (poll_flags & kPollFlagSixenseHistory) {
+    // h,[base],[controller],[sequence],
+    //   [x],[y],[z],[q0],[q1],[q2],[q3],[jx],[jy],[tr],[buttons],[docked],
+    //   ...
+    s << "h,";
+    for (int n = 0; n < poll.history_count; n++) {
+      const SixenseFrame& frame = poll.history[n];
+      s << (int32_t)frame.base << "," << (int32_t)frame.controller << ",";
+      s << (int32_t)frame.sequence << ",";
+      s << frame.position[0] << ",";
+      s << frame.position[1] << ",";
+      s << frame.position[2] << ",";
+      s << frame.rotation[0] << ",";
+      s << frame.rotation[1] << ",";
+      s << frame.rotation[2] << ",";
+      s << frame.rotation[3] << ",";
+      s << frame.joystick[0] << ",";
+      s << frame.joystick[1] << ",";
+      s << frame.trigger << ",";
+      s << frame.buttons << ",";
+      s << ((frame.flags & kSixenseFrameFlagDocked) ? "1," : "0,");
+    }
+    s << "|";
+  }
 }
 
-void VRObject::PollHmdState(std::ostringstream& s) {
-  OVRManager *manager = OVRManager::Instance();
-  if (manager->DevicePresent()) {
+void VRObject::PollHmdState(TextWriter& s, float prediction) {
+  if (hmd_->IsReady()) {
+    s << "g," << hmd_->connection_generation() << "|";
+  }
+  if (hmd_->DevicePresent()) {
+    HmdSnapshot snapshot;
+    if (!hmd_->GetSnapshot(&snapshot)) {
+      snapshot.orientation = OVR::Quatf(0, 0, 0, 1);
+      prediction = 0;
+    } else {
+      TraceSnapshot(snapshot);
+    }
     s << "r,";
-    OVR::Quatf o = manager->GetOrientation();
+    OVR::Quatf o = snapshot.orientation;
     s << o.x << "," << o.y << "," << o.z << "," << o.w;
     s << "|";
+
+    if (prediction > 0) {
+      s << "p,";
+      OVR::Quatf p = hmd_->PredictOrientation(snapshot, prediction);
+      s << p.x << "," << p.y << "," << p.z << "," << p.w;
+      s << "|";
+    }
+  }
+}
+
+void VRObject::PollHmdDevices(TextWriter& s, float prediction) {
+  // d,[index],[connection generation],[serial id]
+  //   then if present ,[x],[y],[z],[w]
+  //   then if predicted ,[px],[py],[pz],[pw]
+  // for every device past the first.
+  AcquireHmdDevices();
+  for (int n = 1; n < hmd_device_count_; n++) {
+    HmdProvider* hmd = hmd_devices_[n];
+    if (!hmd) {
+      continue;
+    }
+    uint32_t generation = hmd->connection_generation();
+    float values[8];
+    uint8_t flags = ReadHmdDevice(hmd, prediction, values);
+    // As in the binary form, a device that is not present has no serial id.
+    uint32_t serial_id = flags ? GetSerialId(hmd) : 0;
+    s << "d," << n << "," << generation << "," << serial_id;
+    int value_count = 0;
+    if (flags & kBinaryHmdDeviceFlagPredicted) {
+      value_count = 8;
+    } else if (flags & kBinaryHmdDeviceFlagPresent) {
+      value_count = 4;
+    }
+    for (int i = 0; i < value_count; i++) {
+      s << "," << values[i];
+    }
+    s << "|";
+  }
+}
+
+bool VRObject::InvokeWarpMesh(const NPVariant* args, uint32_t arg_count,
+                              NPVariant* result) {
+  // arg0: cells across each eye
+  // arg1: cells down each eye
+  // Returns null if there is no HMD.
+  if (arg_count < 2) {
+    return false;
+  }
+  double columns = VariantToDouble(args[0], 0);
+  double rows = VariantToDouble(args[1], 0);
+  if (!(columns >= 1 && columns <= kMaxWarpMeshCells &&
+        rows >= 1 && rows <= kMaxWarpMeshCells)) {
+    return false;
+  }
+
+  // Read first, as for exec 1.
+  uint32_t generation = hmd_->connection_generation();
+  OVR::HMDInfo info;
+  if (!hmd_->GetDeviceInfo(&info)) {
+    NULL_TO_NPVARIANT(*result);
+    return true;
+  }
+  // The distortion scale and eye layout do not depend on the config.
+  StereoConfig config;
+  config.interpupillary_distance = 0;
+  config.z_near = 0.01f;
+  config.z_far = 1000;
+  StereoParams params;
+  ComputeStereoParams(info, config, &params);
+
+  // The mesh is generated once per HMD, so unlike poll this allocates.
+  int vertex_count = GetWarpMeshVertexCount((int)columns, (int)rows);
+  int index_count = GetWarpMeshIndexCount((int)columns, (int)rows);
+  WarpVertex* vertices = new WarpVertex[vertex_count];
+  uint16_t* indices = new uint16_t[index_count];
+  size_t capacity = kWarpMeshHeaderSize +
+      kWarpMeshEyeCount * vertex_count * kWarpMeshVertexSize +
+      index_count * 2;
+  uint8_t* buffer = new uint8_t[capacity];
+  BinaryWriter w(buffer, capacity);
+
+  w.WriteUInt8(kWarpMeshVersion);
+  w.WriteUInt8(kWarpMeshEyeCount);
+  w.WriteUInt16(0);
+  w.WriteUInt16((uint16_t)columns);
+  w.WriteUInt16((uint16_t)rows);
+  w.WriteUInt32(generation);
+  w.WriteUInt32(vertex_count);
+  w.WriteUInt32(index_count);
+  for (int eye = 0; eye < kWarpMeshEyeCount; eye++) {
+    WarpParams warp;
+    GetWarpParams(info, params, eye, &warp);
+    GenerateWarpMesh(warp, params.eyes[eye].viewport, (int)columns, (int)rows,
+                     vertices);
+    for (int n = 0; n < vertex_count; n++) {
+      const WarpVertex& vertex = vertices[n];
+      for (int i = 0; i < 2; i++) {
+        w.WriteFloat32(vertex.position[i]);
+      }
+      for (int i = 0; i < 2; i++) {
+        w.WriteFloat32(vertex.red[i]);
+      }
+      for (int i = 0; i < 2; i++) {
+        w.WriteFloat32(vertex.green[i]);
+      }
+      for (int i = 0; i < 2; i++) {
+        w.WriteFloat32(vertex.blue[i]);
+      }
+    }
+  }
+  GenerateWarpMeshIndices((int)columns, (int)rows, indices);
+  for (int n = 0; n < index_count; n++) {
+    w.WriteUInt16(indices[n]);
+  }
+
+  NPUTF8* ret_str = (NPUTF8*)NPN_MemAlloc(w.encoded_length() + 1);
+  w.Encode(ret_str);
+  STRINGZ_TO_NPVARIANT(ret_str, *result);
+
+  delete[] buffer;
+  delete[] indices;
+  delete[] vertices;
+  return true;
+}
+
+bool VRObject::InvokeBinaryPoll(float prediction, uint32_t poll_flags,
+                                uint32_t since_generation,
+                                NPVariant* result) {
+  if (!WriteBinaryPoll(prediction, poll_flags, since_generation,
+                       &controller_cursor_, &sent_)) {
+    return false;
+  }
+
+  BinaryWriter& w = binary_writer_;
+  uint64_t poll_end = NowNanos();
+  NPUTF8* ret_str = (NPUTF8*)NPN_MemAlloc(w.encoded_length() + 1);
+  w.Encode(ret_str);
+  STRINGZ_TO_NPVARIANT(ret_str, *result);
+  FinishTrace(poll_end);
+
+  return true;
+}
+
+bool VRObject::WriteBinaryPoll(float prediction, uint32_t poll_flags,
+                               uint32_t since_generation,
+                               ControllerCursor* cursor, SentState* sent) {
+  BinaryWriter& w = binary_writer_;
+  w.Reset();
+
+  // A caller that missed a poll made by someone else gets everything.
+  bool delta = (poll_flags & kPollFlagDelta) &&
+      since_generation == sent->generation;
+
+  // Header. Flags, counts and the generation are patched in once known.
+  w.WriteUInt8(kBinaryPollVersion);
+  w.WriteUInt8(0);
+  w.WriteUInt8(0);
+  w.WriteUInt8(0);
+  if (poll_flags & kPollFlagDelta) {
+    w.WriteUInt32(0);
+  }
+
+  sent->changed = false;
+  sent->history_count = 0;
+  uint8_t flags = 0;
+  flags |= PollHmdState(w, prediction, delta, sent);
+  if (poll_flags & kPollFlagHmdDevices) {
+    flags |= PollHmdDevices(w, prediction, delta, sent);
+  }
+  flags |= PollSixenseState(w, poll_flags, delta, cursor, sent);
+  if (sent->changed && !++sent->generation) {
+    sent->generation = 1;
+  }
+  if (poll_flags & kPollFlagDelta) {
+    w.PatchUInt32(4, sent->generation);
+    flags |= kBinaryPollFlagDelta;
+  }
+  w.PatchUInt8(1, flags);
+
+  return !w.overflowed();
+}
+
+namespace {
+
+void WriteSixenseFrame(BinaryWriter& w, const SixenseFrame& frame) {
+  w.WriteFloat32(frame.position[0]);
+  w.WriteFloat32(frame.position[1]);
+  w.WriteFloat32(frame.position[2]);
+  w.WriteFloat32(frame.rotation[0]);
+  w.WriteFloat32(frame.rotation[1]);
+  w.WriteFloat32(frame.rotation[2]);
+  w.WriteFloat32(frame.rotation[3]);
+  w.WriteFloat32(frame.joystick[0]);
+  w.WriteFloat32(frame.joystick[1]);
+  w.WriteFloat32(frame.trigger);
+  w.WriteUInt32(frame.buttons);
+}
+
+// The binary controller flags share their bits with SixenseFrame's.
+uint8_t SixenseControllerFlags(const SixenseFrame& frame) {
+  return frame.flags & (kBinaryControllerFlagDocked |
+                        kBinaryControllerFlagHemiTracking);
+}
+
+// True if the frame reports anything other than sent did. The sequence
+// number is left out as it advances with every sample, moving or not.
+bool SixenseFrameDiffers(const SixenseFrame& frame, const SixenseFrame& sent) {
+  return frame.flags != sent.flags || frame.hand != sent.hand ||
+      memcmp(frame.position, sent.position,
+             sizeof(SixenseFrame) - offsetof(SixenseFrame, position)) != 0;
+}
+
+}  // namespace
+
+uint8_t VRObject::PollSixenseState(BinaryWriter& w, uint32_t poll_flags,
+                                   bool delta, ControllerCursor* cursor,
+                                   SentState* sent) {
+  if (!controllers_->IsAvailable()) {
+    return 0;
+  }
+
+  SixensePoll poll;
+  controllers_->Gather((poll_flags & kPollFlagSixenseHistory) != 0,
+                       cursor, &poll);
+  if ((poll.base_count != 0) != sent->sixense_present) {
+    sent->sixense_present = poll.base_count != 0;
+    sent->changed = true;
+  }
+
+  int controller_count = 0;
+  for (int n = 0; n < poll.controller_count; n++) {
+    const SixenseFrame& frame = poll.controllers[n];
+    if (frame.base < kMaxSixenseBases &&
+        frame.controller < kMaxSixenseControllers) {
+      int slot = frame.base * kMaxSixenseControllers + frame.controller;
+      if (!sent->controller_valid[slot] ||
+          SixenseFrameDiffers(frame, sent->controllers[slot])) {
+        sent->controller_valid[slot] = true;
+        sent->controllers[slot] = frame;
+        sent->changed = true;
+      } else if (delta) {
+        continue;
+      }
+    }
+    w.WriteUInt8(frame.base);
+    w.WriteUInt8(frame.controller);
+    w.WriteUInt8(frame.hand);
+    w.WriteUInt8(SixenseControllerFlags(frame));
+    WriteSixenseFrame(w, frame);
+    controller_count++;
+  }
+  w.PatchUInt8(2, (uint8_t)controller_count);
+
+  uint8_t flags = 0;
+  if (poll_flags & kPollFlagSixenseHistory) {
+    for (int n = 0; n < poll.history_count; n++) {
+      const SixenseFrame& frame = poll.history[n];
+      w.WriteUInt8(frame.base);
+      w.WriteUInt8(frame.controller);
+      w.WriteUInt8(frame.sequence);
+      w.WriteUInt8(SixenseControllerFlags(frame));
+      WriteSixenseFrame(w, frame);
+    }
+    w.PatchUInt8(3, (uint8_t)poll.history_count);
+    sent->history_count = poll.history_count;
+    flags |= kBinaryPollFlagSixenseHistory;
+  }
+  if (poll.base_count) {
+    flags |= kBinaryPollFlagSixensePresent;
+  }
+  return flags;
+}
+
+uint8_t VRObject::PollHmdState(BinaryWriter& w, float prediction,
+                               bool delta, SentState* sent) {
+  uint8_t flags = 0;
+  uint32_t connection_generation = hmd_->connection_generation();
+  // Orientation, then the predicted orientation.
+  float values[8] = { 0 };
+  HmdSnapshot snapshot;
+  bool has_snapshot = false;
+  if (hmd_->DevicePresent()) {
+    has_snapshot = hmd_->GetSnapshot(&snapshot);
+    OVR::Quatf o =
+        has_snapshot ? snapshot.orientation : OVR::Quatf(0, 0, 0, 1);
+    if (has_snapshot) {
+      TraceSnapshot(snapshot);
+    }
+    values[0] = o.x;
+    values[1] = o.y;
+    values[2] = o.z;
+    values[3] = o.w;
+    flags |= kBinaryPollFlagHmdPresent;
+  }
+  if (has_snapshot && prediction > 0) {
+    OVR::Quatf p = hmd_->PredictOrientation(snapshot, prediction);
+    values[4] = p.x;
+    values[5] = p.y;
+    values[6] = p.z;
+    values[7] = p.w;
+    flags |= kBinaryPollFlagHmdPredicted;
+  }
+
+  if (flags != sent->hmd_flags ||
+      connection_generation != sent->connection_generation ||
+      memcmp(values, sent->hmd_orientation, sizeof(values))) {
+    sent->hmd_flags = flags;
+    sent->connection_generation = connection_generation;
+    memcpy(sent->hmd_orientation, values, sizeof(values));
+    sent->changed = true;
+  } else if (delta) {
+    return flags | kBinaryPollFlagHmdUnchanged;
+  }
+
+  w.WriteUInt32(connection_generation);
+  int value_count = (flags & kBinaryPollFlagHmdPredicted) ? 8 : 4;
+  for (int n = 0; n < value_count; n++) {
+    w.WriteFloat32(values[n]);
+  }
+  return flags;
+}
+
+uint8_t VRObject::PollHmdDevices(BinaryWriter& w, float prediction,
+                                 bool delta, SentState* sent) {
+  AcquireHmdDevices();
+  // Count, patched in once known, and padding.
+  size_t count_offset = w.length();
+  w.WriteUInt8(0);
+  w.WriteUInt8(0);
+  w.WriteUInt8(0);
+  w.WriteUInt8(0);
+
+  int count = 0;
+  for (int n = 1; n < hmd_device_count_; n++) {
+    HmdProvider* hmd = hmd_devices_[n];
+    if (!hmd) {
+      continue;
+    }
+    uint32_t connection_generation = hmd->connection_generation();
+    float values[8];
+    uint8_t flags = ReadHmdDevice(hmd, prediction, values);
+    uint32_t serial_id = flags ? GetSerialId(hmd) : 0;
+
+    SentState::HmdDevice& sent_device = sent->hmd_devices[n];
+    if (flags != sent_device.flags ||
+        serial_id != sent_device.serial_id ||
+        connection_generation != sent_device.connection_generation ||
+        memcmp(values, sent_device.orientation, sizeof(values))) {
+      sent_device.flags = flags;
+      sent_device.serial_id = serial_id;
+      sent_device.connection_generation = connection_generation;
+      memcpy(sent_device.orientation, values, sizeof(values));
+      sent->changed = true;
+    } else if (delta) {
+      continue;
+    }
+
+    w.WriteUInt8((uint8_t)n);
+    w.WriteUInt8(flags);
+    w.WriteUInt8(0);
+    w.WriteUInt8(0);
+    w.WriteUInt32(serial_id);
+    w.WriteUInt32(connection_generation);
+    for (int i = 0; i < 8; i++) {
+      w.WriteFloat32(values[i]);
+    }
+    count++;
+  }
+  w.PatchUInt8(count_offset, (uint8_t)count);
+  return kBinaryPollFlagHmdDevices;
+}
+
+bool VRObject::InvokeSubscribe(const NPVariant* args, uint32_t arg_count,
+                               NPVariant* result) {
+  // arg0: function called with each binary poll record
+  // arg1: optional deliveries per second, at most
+  // arg2: optional PollFlags bitmask
+  if (arg_count < 1 || !NPVARIANT_IS_OBJECT(args[0])) {
+    return false;
+  }
+  if (!NPN_HasPluginThreadAsyncCall()) {
+    // Deliveries could never reach the main thread; let the page poll.
+    BOOLEAN_TO_NPVARIANT(false, *result);
+    return true;
   }
+  double rate = arg_count >= 2 ? VariantToDouble(args[1], 0) : 0;
+  if (!(rate >= kMinSubscriptionRate)) {
+    rate = kMinSubscriptionRate;
+  } else if (rate > kMaxSubscriptionRate) {
+    rate = kMaxSubscriptionRate;
+  }
+  uint32_t poll_flags = 0;
+  if (arg_count >= 3) {
+    poll_flags = (uint32_t)VariantToDouble(args[2], 0);
+  }
+
+  Unsubscribe();
+  if (poll_flags & kPollFlagHmdDevices) {
+    // Before the subscription thread starts, which then reads them.
+    AcquireHmdDevices();
+  }
+  subscription_callback_ = NPN_RetainObject(NPVARIANT_TO_OBJECT(args[0]));
+  subscription_flags_ = poll_flags;
+  subscription_cursor_ = ControllerCursor();
+  subscription_sent_.Reset();
+  subscription_generation_ = 0;
+  subscription_thread_ = new SubscriptionThread(this, (uint32_t)rate);
+  subscription_thread_->Start();
+
+  BOOLEAN_TO_NPVARIANT(true, *result);
+  return true;
+}
+
+bool VRObject::InvokeUnsubscribe(const NPVariant* args, uint32_t arg_count,
+                                 NPVariant* result) {
+  Unsubscribe();
+  VOID_TO_NPVARIANT(*result);
+  return true;
+}
+
+void VRObject::Unsubscribe() {
+  if (subscription_thread_) {
+    subscription_thread_->RequestExit();
+    subscription_thread_->Join();
+    delete subscription_thread_;
+    subscription_thread_ = NULL;
+  }
+  if (subscription_callback_) {
+    NPN_ReleaseObject(subscription_callback_);
+    subscription_callback_ = NULL;
+  }
+  // A Deliver already scheduled still runs, finds no callback and clears
+  // this. Browsers drop scheduled calls when the instance is destroyed,
+  // which is the only time this object is.
+}
+
+void VRObject::DeliverThunk(void* data) {
+  ((VRObject*)data)->Deliver();
+}
+
+void VRObject::Deliver() {
+  // Cleared first so that data arriving from here on schedules another.
+  AtomicCompareExchange(&delivery_pending_, 1, 0);
+  if (!subscription_callback_) {
+    return;
+  }
+
+  // Traced as a poll would be, up to the callback.
+  latency_.stages[kLatencyStagePollBegin] = NowNanos();
+  latency_valid_ = false;
+  if (!WriteBinaryPoll(0, subscription_flags_ | kPollFlagDelta,
+                       subscription_generation_, &subscription_cursor_,
+                       &subscription_sent_)) {
+    return;
+  }
+  if (subscription_generation_ == subscription_sent_.generation &&
+      !subscription_sent_.history_count) {
+    // Nothing new since the previous delivery.
+    return;
+  }
+  subscription_generation_ = subscription_sent_.generation;
+
+  BinaryWriter& w = binary_writer_;
+  uint64_t poll_end = NowNanos();
+  NPUTF8* record = (NPUTF8*)NPN_MemAlloc(w.encoded_length() + 1);
+  w.Encode(record);
+  NPVariant arg;
+  STRINGZ_TO_NPVARIANT(record, arg);
+  FinishTrace(poll_end);
+
+  // The callback may unsubscribe, so hold on to it until it returns.
+  NPObject* callback = NPN_RetainObject(subscription_callback_);
+  NPVariant ret;
+  VOID_TO_NPVARIANT(ret);
+  if (NPN_InvokeDefault(npp_, callback, &arg, 1, &ret)) {
+    NPN_ReleaseVariantValue(&ret);
+  }
+  NPN_ReleaseObject(callback);
+  NPN_MemFree(record);
+}
+
+void VRObject::TraceSnapshot(const HmdSnapshot& snapshot) {
+  // Providers that do not stamp their snapshots are not traced.
+  if (!snapshot.sample_nanos) {
+    return;
+  }
+  latency_.stages[kLatencyStageSample] = snapshot.sample_nanos;
+  latency_.stages[kLatencyStageFusion] = snapshot.fusion_nanos;
+  latency_.stages[kLatencyStagePublish] = snapshot.publish_nanos;
+  latency_valid_ = true;
+}
+
+void VRObject::FinishTrace(uint64_t poll_end) {
+  if (!latency_valid_) {
+    return;
+  }
+  latency_.stages[kLatencyStagePollEnd] = poll_end;
+  latency_.stages[kLatencyStageHandoff] = NowNanos();
+  GetLatencyTrace()->Record(latency_);
+}
+
+void VRObject::Invalidate() {
+  Unsubscribe();
 }
 
 bool VRObject::HasMethod(NPIdentifier name) {
   if (name == exec_id_ ||
-      name == poll_id_) {
+      name == exec_batch_id_ ||
+      name == poll_id_ ||
+      name == subscribe_id_ ||
+      name == unsubscribe_id_ ||
+      name == warp_mesh_id_) {
     return true;
   }
   return false;
@@ -239,8 +1264,16 @@ bool VRObject::Invoke(NPIdentifier name, const NPVariant* args,
                       uint32_t argCount, NPVariant* result) {
   if (name == exec_id_) {
     return InvokeExec(args, argCount, result);
+  } else if (name == exec_batch_id_) {
+    return InvokeExecBatch(args, argCount, result);
   } else if (name == poll_id_) {
     return InvokePoll(args, argCount, result);
+  } else if (name == subscribe_id_) {
+    return InvokeSubscribe(args, argCount, result);
+  } else if (name == unsubscribe_id_) {
+    return InvokeUnsubscribe(args, argCount, result);
+  } else if (name == warp_mesh_id_) {
+    return InvokeWarpMesh(args, argCount, result);
   }
   return false;
 }
@@ -263,12 +1296,16 @@ bool VRObject::SetProperty(NPIdentifier name, const NPVariant* value) {
 }
 
 bool VRObject::Enumerate(NPIdentifier** identifiers, uint32_t* count) {
-  static NPIdentifier all_ids[] = {
+  NPIdentifier all_ids[] = {
     exec_id_,
+    exec_batch_id_,
     poll_id_,
+    subscribe_id_,
+    unsubscribe_id_,
+    warp_mesh_id_,
   };
   int id_count = (int)(sizeof(all_ids) / sizeof(NPIdentifier));
-  NPIdentifier* ids = (NPIdentifier*)NPN_MemAlloc(id_count);
+  NPIdentifier* ids = (NPIdentifier*)NPN_MemAlloc(sizeof(all_ids));
   memcpy(ids, all_ids, sizeof(all_ids));
   *identifiers = ids;
   *count = id_count;
@@ -19,17 +19,39 @@
 
 #include <npvr.h>
 #include <np_object_base.h>
+#include <npvr/binary_writer.h>
+#include <npvr/latency_trace.h>
+#include <npvr/sixense_frame.h>
+#include <npvr/stereo_params.h>
+#include <npvr/text_writer.h>
+#include <npvr/tracking_provider.h>
 
 namespace npvr {
 
 class VRObject : public NPObjectBase {
 public:
+  // Bits for the optional flags argument to poll.
+  enum PollFlags {
+    // Include every Sixense sample recorded since the previous poll.
+    kPollFlagSixenseHistory = 1 << 0,
+    // Binary only: leave out whatever is unchanged since the poll that
+    // returned the generation passed as the fourth argument.
+    kPollFlagDelta = 1 << 1,
+    // Also report every HMD device past the first, by device index.
+    kPollFlagHmdDevices = 1 << 2,
+  };
+
+  // Separates the results in an execBatch response. Never appears in a
+  // command result.
+  static const char kExecBatchSeparator = '\x1e';
+
   static NPClass* np_class();
   static NPObject* Allocate(NPP npp, NPClass* aClass);
   VRObject(NPP npp);
   virtual ~VRObject();
 
 public:
+  virtual void Invalidate();
   virtual bool HasMethod(NPIdentifier name);
   virtual bool Invoke(NPIdentifier name, const NPVariant* args,
                       uint32_t argCount, NPVariant* result);
@@ -41,19 +63,168 @@ public:
   virtual bool Enumerate(NPIdentifier** identifier, uint32_t* count);
 
 private:
+  class SubscriptionThread;
+
+  // What one consumer of binary records has been sent so far, which delta
+  // records are relative to. generation is bumped whenever any of it
+  // changes.
+  struct SentState {
+    // Callers with nothing yet pass generation zero, which never matches.
+    void Reset() {
+      memset(this, 0, sizeof(*this));
+      generation = 1;
+    }
+
+    // What was sent for one HMD device past the first.
+    struct HmdDevice {
+      uint8_t     flags;
+      uint32_t    serial_id;
+      uint32_t    connection_generation;
+      float       orientation[8];
+    };
+
+    uint32_t      generation;
+    uint8_t       hmd_flags;
+    uint32_t      connection_generation;
+    float         hmd_orientation[8];
+    HmdDevice     hmd_devices[kMaxHmdDevices];
+    bool          sixense_present;
+    bool          controller_valid[kMaxSixenseBases * kMaxSixenseControllers];
+    SixenseFrame  controllers[kMaxSixenseBases * kMaxSixenseControllers];
+
+    // Set while writing a record.
+    bool          changed;
+    int           history_count;
+  };
+
+  typedef void (VRObject::*ExecHandler)(const char* command_str,
+                                        TextWriter& s);
+  struct ExecCommand {
+    int32_t     id;
+    ExecHandler handler;
+  };
+  // Every exec command, by id.
+  static const ExecCommand kExecCommands[];
+
   bool InvokeExec(const NPVariant* args, uint32_t arg_count, NPVariant* result);
-  void QueryHmdInfo(const char* command_str, std::ostringstream& s);
-  void ResetHmdOrientation(const char* command_str, std::ostringstream& s);
+  bool InvokeExecBatch(const NPVariant* args, uint32_t arg_count,
+                       NPVariant* result);
+  // Runs one command and appends its result to s. Returns false if the
+  // arguments are not a command id and string.
+  bool DispatchExec(const NPVariant& id_arg, const NPVariant& str_arg,
+                    TextWriter& s);
+  void QueryHmdInfo(const char* command_str, TextWriter& s);
+  void QueryHmdDevices(const char* command_str, TextWriter& s);
+  void QueryHmdDeviceInfo(const char* command_str, TextWriter& s);
+  // Shared by the two info queries. generation_str is the connection
+  // generation the caller already has info for, or empty.
+  void WriteHmdInfo(HmdProvider* hmd, const char* generation_str,
+                    TextWriter& s);
+  void QueryReadiness(const char* command_str, TextWriter& s);
+  void SetFusionMode(const char* command_str, TextWriter& s);
+  void ResetHmdOrientation(const char* command_str, TextWriter& s);
+  void QueryLatency(const char* command_str, TextWriter& s);
+  void WriteLatencyTrace(const char* command_str, TextWriter& s);
+  void QueryStereoParams(const char* command_str, TextWriter& s);
+  // Batch forms of vr.HmdInfo.prototype.distort and of the warp, and their
+  // inverses; see distortion.h.
+  void MapDistortionRadii(const char* command_str, TextWriter& s);
+  void MapWarpPoints(const char* command_str, TextWriter& s);
 
   bool InvokePoll(const NPVariant* args, uint32_t arg_count, NPVariant* result);
-  void PollSixenseState(std::ostringstream& s);
-  void PollHmdState(std::ostringstream& s);
+  void PollSixenseState(TextWriter& s, uint32_t poll_flags);
+  void PollHmdState(TextWriter& s, float prediction);
+  void PollHmdDevices(TextWriter& s, float prediction);
+
+  // Returns the warp mesh record described in warp_mesh.h.
+  bool InvokeWarpMesh(const NPVariant* args, uint32_t arg_count,
+                      NPVariant* result);
+
+  bool InvokeBinaryPoll(float prediction, uint32_t poll_flags,
+                        uint32_t since_generation, NPVariant* result);
+  // Writes a record for the consumer into binary_writer_. Returns false if
+  // it overflowed.
+  bool WriteBinaryPoll(float prediction, uint32_t poll_flags,
+                       uint32_t since_generation, ControllerCursor* cursor,
+                       SentState* sent);
+  // Both write only what differs from sent if delta is set, and update it.
+  uint8_t PollSixenseState(BinaryWriter& w, uint32_t poll_flags, bool delta,
+                           ControllerCursor* cursor, SentState* sent);
+  uint8_t PollHmdState(BinaryWriter& w, float prediction, bool delta,
+                       SentState* sent);
+  uint8_t PollHmdDevices(BinaryWriter& w, float prediction, bool delta,
+                         SentState* sent);
+
+  // Acquires every HMD device past the first the first time a page asks
+  // for one, so pages that never do cost nothing more.
+  void AcquireHmdDevices();
+  // Device index of hmd_, or NULL if there is no such device.
+  HmdProvider* GetHmdDevice(int index);
+
+  // Push delivery. The subscription thread schedules Deliver on the browser
+  // thread with NPN_PluginThreadAsyncCall, at most one at a time.
+  bool InvokeSubscribe(const NPVariant* args, uint32_t arg_count,
+                       NPVariant* result);
+  bool InvokeUnsubscribe(const NPVariant* args, uint32_t arg_count,
+                         NPVariant* result);
+  void Unsubscribe();
+  static void DeliverThunk(void* data);
+  void Deliver();
+
+  // Latency tracing for the poll in progress.
+  void TraceSnapshot(const HmdSnapshot& snapshot);
+  void FinishTrace(uint64_t poll_end);
 
 private:
   NPIdentifier    exec_id_;
+  NPIdentifier    exec_batch_id_;
   NPIdentifier    poll_id_;
+  NPIdentifier    subscribe_id_;
+  NPIdentifier    unsubscribe_id_;
+  NPIdentifier    warp_mesh_id_;
+
+  HmdProvider*        hmd_;
+  // hmd_->device(n), once AcquireHmdDevices has run; hmd_device_count_ is
+  // zero until then.
+  HmdProvider*        hmd_devices_[kMaxHmdDevices];
+  int                 hmd_device_count_;
+  ControllerProvider* controllers_;
+  // Used to find the controller samples that arrived since the previous
+  // poll.
+  ControllerCursor    controller_cursor_;
+  // What binary polls have returned.
+  SentState           sent_;
+
+  // The current subscription, if subscription_callback_ is set. It has its
+  // own cursor and sent state so that it and poll do not take samples or
+  // deltas from each other.
+  NPObject*           subscription_callback_;
+  uint32_t            subscription_flags_;
+  SubscriptionThread* subscription_thread_;
+  ControllerCursor    subscription_cursor_;
+  SentState           subscription_sent_;
+  // Zero until the first delivery, so that it is a full record.
+  uint32_t            subscription_generation_;
+  // 1 while a Deliver is scheduled and has not started.
+  volatile int32_t    delivery_pending_;
+
+  // The most recent QueryStereoParams result and what it was computed from.
+  // Pages only ask again when something changes, but every renderer on the
+  // page asks once.
+  static const size_t kMaxStereoParamsLength = 2048;
+  bool            stereo_params_valid_;
+  uint32_t        stereo_params_generation_;
+  StereoConfig    stereo_config_;
+  char            stereo_params_text_[kMaxStereoParamsLength];
+  size_t          stereo_params_length_;
+
+  // Stages of the poll in progress; only recorded if it carried a snapshot.
+  LatencyRecord   latency_;
+  bool            latency_valid_;
 
-  bool            sixense_ready_;
+  // Reused across calls to avoid per-frame allocations.
+  TextWriter      text_writer_;
+  BinaryWriter    binary_writer_;
 };
 
 }  // namespace npvr
@@ -0,0 +1,102 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <npvr/warp_mesh.h>
+
+
+using namespace npvr;
+
+
+void npvr::GetWarpParams(const OVR::HMDInfo& info, const StereoParams& params,
+                         int eye, WarpParams* out_params) {
+  const StereoParams::Eye& e = params.eyes[eye];
+  float x = e.viewport[0];
+  float y = e.viewport[1];
+  float w = e.viewport[2];
+  float h = e.viewport[3];
+  float aspect = (w * info.HResolution) / (h * info.VResolution);
+  float scale = 1 / params.distortion_scale;
+
+  out_params->lens_center[0] = x + (w + e.distortion_center_offset_x / 2) / 2;
+  out_params->lens_center[1] = y + h / 2;
+  out_params->screen_center[0] = x + w / 2;
+  out_params->screen_center[1] = y + h / 2;
+  out_params->scale[0] = w / 2 * scale;
+  out_params->scale[1] = h / 2 * scale * aspect;
+  out_params->scale_in[0] = 2 / w;
+  out_params->scale_in[1] = 2 / h / aspect;
+  for (int n = 0; n < 4; n++) {
+    out_params->distortion_k[n] = info.DistortionK[n];
+    out_params->chroma_ab[n] = info.ChromaAbCorrection[n];
+  }
+}
+
+void npvr::WarpTexCoord(const WarpParams& params, const float uv[2],
+                        float out_red[2], float out_green[2],
+                        float out_blue[2]) {
+  const float* k = params.distortion_k;
+  const float* c = params.chroma_ab;
+  float theta[2];
+  theta[0] = (uv[0] - params.lens_center[0]) * params.scale_in[0];
+  theta[1] = (uv[1] - params.lens_center[1]) * params.scale_in[1];
+  float r_sq = theta[0] * theta[0] + theta[1] * theta[1];
+  float distortion =
+      k[0] + k[1] * r_sq + k[2] * r_sq * r_sq + k[3] * r_sq * r_sq * r_sq;
+  float red = distortion * (c[0] + c[1] * r_sq);
+  float blue = distortion * (c[2] + c[3] * r_sq);
+  for (int n = 0; n < 2; n++) {
+    out_red[n] = params.lens_center[n] + params.scale[n] * theta[n] * red;
+    out_green[n] =
+        params.lens_center[n] + params.scale[n] * theta[n] * distortion;
+    out_blue[n] = params.lens_center[n] + params.scale[n] * theta[n] * blue;
+  }
+}
+
+void npvr::GenerateWarpMesh(const WarpParams& params, const float viewport[4],
+                            int columns, int rows, WarpVertex* out_vertices) {
+  WarpVertex* vertex = out_vertices;
+  for (int j = 0; j <= rows; j++) {
+    float v = (float)j / rows;
+    for (int i = 0; i <= columns; i++, vertex++) {
+      float u = (float)i / columns;
+      vertex->position[0] = u;
+      vertex->position[1] = v;
+      float uv[2];
+      uv[0] = viewport[0] + u * viewport[2];
+      uv[1] = viewport[1] + v * viewport[3];
+      WarpTexCoord(params, uv, vertex->red, vertex->green, vertex->blue);
+    }
+  }
+}
+
+void npvr::GenerateWarpMeshIndices(int columns, int rows,
+                                   uint16_t* out_indices) {
+  // Each cell as the quad draws it: TL TR BL, TR BR BL.
+  uint16_t* index = out_indices;
+  int stride = columns + 1;
+  for (int j = 0; j < rows; j++) {
+    for (int i = 0; i < columns; i++) {
+      uint16_t top_left = (uint16_t)(j * stride + i);
+      uint16_t bottom_left = (uint16_t)(top_left + stride);
+      *index++ = top_left;
+      *index++ = (uint16_t)(top_left + 1);
+      *index++ = bottom_left;
+      *index++ = (uint16_t)(top_left + 1);
+      *index++ = (uint16_t)(bottom_left + 1);
+      *index++ = bottom_left;
+    }
+  }
+}
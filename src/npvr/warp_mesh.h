@@ -0,0 +1,104 @@
+/**
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NPVR_WARP_MESH_H_
+#define NPVR_WARP_MESH_H_
+
+#include <npvr.h>
+#include <npvr/stereo_params.h>
+
+
+namespace npvr {
+
+// Most cells a warp mesh may have across or down. Keeps vertex indices within
+// 16 bits.
+const int kMaxWarpMeshCells = 128;
+
+// Warp mesh record layout, as returned by warpMesh, version 1. All values are
+// little-endian, and the record is encoded into a string as binary poll
+// records are (see binary_writer.h).
+//
+// Header (20b):
+//   u8  version                 kWarpMeshVersion
+//   u8  eye count               kWarpMeshEyeCount
+//   u16 reserved
+//   u16 columns
+//   u16 rows
+//   u32 connection generation   of the HMD the mesh was generated for
+//   u32 vertex count            per eye
+//   u32 index count             shared by the eyes
+// Vertices (32b, vertex count times for the left eye, then for the right):
+//   f32 position x, y           WarpVertex
+//   f32 red u, v
+//   f32 green u, v
+//   f32 blue u, v
+// Indices (2b, index count times):
+//   u16 vertex index            triangle list
+const uint8_t kWarpMeshVersion = 1;
+const uint8_t kWarpMeshEyeCount = 2;
+const size_t kWarpMeshHeaderSize = 4 + 4 + 4 * 3;
+const size_t kWarpMeshVertexSize = 8 * 4;
+
+// The lens distortion the warp post-process applies to one eye, in the same
+// terms as the uniforms vr.StereoRenderer.renderEye_ sets. Texture
+// coordinates span the whole render target, both eyes.
+struct WarpParams {
+  float lens_center[2];
+  float screen_center[2];
+  float scale[2];
+  float scale_in[2];
+  float distortion_k[4];
+  float chroma_ab[4];
+};
+
+// One warp mesh vertex. position is in [0-1] across the eye's viewport, as
+// the full-screen quad's; the texture coordinates are where to sample each
+// color channel, and may fall outside the eye.
+struct WarpVertex {
+  float position[2];
+  float red[2];
+  float green[2];
+  float blue[2];
+};
+
+void GetWarpParams(const OVR::HMDInfo& info, const StereoParams& params,
+                   int eye, WarpParams* out_params);
+
+// Where the warp samples each channel for the render target texture
+// coordinate uv.
+void WarpTexCoord(const WarpParams& params, const float uv[2],
+                  float out_red[2], float out_green[2], float out_blue[2]);
+
+// A mesh of columns * rows cells has (columns + 1) * (rows + 1) vertices,
+// row by row from the top left, and two triangles per cell.
+inline int GetWarpMeshVertexCount(int columns, int rows) {
+  return (columns + 1) * (rows + 1);
+}
+inline int GetWarpMeshIndexCount(int columns, int rows) {
+  return columns * rows * 6;
+}
+
+// Fills GetWarpMeshVertexCount vertices for the eye with the given viewport,
+// [left, top, width, height] in [0-1] render target coordinates.
+void GenerateWarpMesh(const WarpParams& params, const float viewport[4],
+                      int columns, int rows, WarpVertex* out_vertices);
+// Fills GetWarpMeshIndexCount indices, the same for every eye.
+void GenerateWarpMeshIndices(int columns, int rows, uint16_t* out_indices);
+
+}  // namespace npvr
+
+
+#endif  // NPVR_WARP_MESH_H_